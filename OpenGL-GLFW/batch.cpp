@@ -0,0 +1,108 @@
+#include "batch.hpp"
+#include "opengl.h"
+#include "state_cache.hpp"
+#include <algorithm>
+#include <cstddef>
+
+namespace program
+{
+	// The number of full batches the ring buffer holds, so up to three flushes can be in flight.
+	const GLsizei RING_BUFFER_BATCHES = 3;
+	QuadBatch::QuadBatch()
+		: m_vao(0), m_instance_count(0), m_capacity(0), m_index_count(0), m_index_type(GL_UNSIGNED_SHORT),
+		m_max_instances_per_draw(0), m_draw_call_count(0), m_dropped_count(0)
+	{
+
+	}
+	QuadBatch::~QuadBatch()
+	{
+
+	}
+	void QuadBatch::Create(GLuint vao, GLsizei capacity, GLsizei index_count, GLenum index_type)
+	{
+		m_vao = vao;
+		m_capacity = capacity;
+		m_index_count = index_count;
+		m_index_type = index_type;
+		render::GetStateCache().BindVertexArray(m_vao);
+		// Creating the ring buffer binds it to GL_ARRAY_BUFFER, which is where the attribute pointers read from.
+		m_ring_buffer.Create(GL_ARRAY_BUFFER, RING_BUFFER_BATCHES * capacity * sizeof(QuadInstance));
+		glEnableVertexAttribArray(INSTANCE_TRANSFORM);
+		glEnableVertexAttribArray(INSTANCE_COLOUR);
+		SetInstanceOffset(0);
+		// >> glVertexAttribDivisor modifies the rate at which generic vertex attributes advance when
+		// >> rendering multiple instances of primitives in a single draw call. If divisor is zero, the
+		// >> attribute advances once per vertex. If divisor is non-zero, the attribute advances once
+		// >> per divisor instances of the set(s) of vertices being rendered.
+		glVertexAttribDivisor(INSTANCE_TRANSFORM, 1);
+		glVertexAttribDivisor(INSTANCE_COLOUR, 1);
+	}
+	void QuadBatch::Destroy()
+	{
+		if (0 != m_allocation.pointer)
+			m_ring_buffer.Commit(m_allocation, 0);
+		m_instance_count = 0;
+		m_ring_buffer.Destroy();
+	}
+	void QuadBatch::Add(const QuadInstance &instance)
+	{
+		if (m_instance_count == m_capacity)
+			Flush();
+		if (0 == m_allocation.pointer)
+		{
+			m_allocation = m_ring_buffer.Allocate(m_capacity * sizeof(QuadInstance), sizeof(QuadInstance));
+			if (0 == m_allocation.pointer)
+			{
+				// Everything allocated before has been drawn, so fencing it lets the ring reclaim the space.
+				m_ring_buffer.Fence();
+				m_allocation = m_ring_buffer.Allocate(m_capacity * sizeof(QuadInstance), sizeof(QuadInstance));
+			}
+			if (0 == m_allocation.pointer)
+			{
+				++m_dropped_count;
+				return;
+			}
+		}
+		static_cast<QuadInstance*>(m_allocation.pointer)[m_instance_count++] = instance;
+	}
+	void QuadBatch::Add(GLfloat x, GLfloat y, GLfloat width, GLfloat height, GLubyte red, GLubyte green, GLubyte blue, GLubyte alpha)
+	{
+		const QuadInstance instance = { { x, y, width, height }, { red, green, blue, alpha } };
+		Add(instance);
+	}
+	void QuadBatch::Flush()
+	{
+		render::GetStateCache().BindVertexArray(m_vao);
+		if (0 == m_allocation.pointer)
+			return;
+		// Hand the written instances to OpenGL; the rest of the allocation goes back to the ring.
+		m_ring_buffer.Commit(m_allocation, m_instance_count * sizeof(QuadInstance));
+		const GLsizei per_draw = (m_max_instances_per_draw > 0 && m_max_instances_per_draw < m_capacity) ? m_max_instances_per_draw : m_capacity;
+		for (GLsizei first = 0; first < m_instance_count; first += per_draw)
+		{
+			// OpenGL 3.2 has no base instance, so every draw moves the attribute pointers instead.
+			SetInstanceOffset(m_allocation.offset + first * sizeof(QuadInstance));
+			// >> glDrawElementsInstanced behaves identically to glDrawElements except that primcount
+			// >> instances of the set of elements are executed and the value of the internal counter
+			// >> instanceID advances for each iteration.
+			glDrawElementsInstanced(GL_TRIANGLES, m_index_count, m_index_type, 0, std::min(per_draw, m_instance_count - first));
+			++m_draw_call_count;
+		}
+		m_allocation = stream::Allocation();
+		m_instance_count = 0;
+	}
+	void QuadBatch::EndFrame()
+	{
+		m_ring_buffer.Fence();
+	}
+	void QuadBatch::SetMaxInstancesPerDraw(GLsizei max_instances_per_draw)
+	{
+		m_max_instances_per_draw = max_instances_per_draw;
+	}
+	void QuadBatch::SetInstanceOffset(GLintptr offset)
+	{
+		glVertexAttribPointer(INSTANCE_TRANSFORM, 4, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (void*) (offset + offsetof(QuadInstance, transform)));
+		// The colour is stored as four unsigned bytes and normalized to 0.0 - 1.0 by OpenGL.
+		glVertexAttribPointer(INSTANCE_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(QuadInstance), (void*) (offset + offsetof(QuadInstance, colour)));
+	}
+}
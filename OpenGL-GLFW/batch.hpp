@@ -0,0 +1,76 @@
+#ifndef OPENGL_GLFW_TCU_BATCH_H_
+#define OPENGL_GLFW_TCU_BATCH_H_
+
+#include "standard.h"
+#include "stream.hpp"
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+typedef int GLsizei;
+typedef float GLfloat;
+typedef unsigned char GLubyte;
+
+namespace program
+{
+	// Store the per-instance vertex attributes. These follow VERTEX_POSITION and VERTEX_COLOUR
+	// and correspond to the number after "layout(location = " in the vertex shader.
+	enum InstanceAttribute
+	{
+		INSTANCE_TRANSFORM = 2, INSTANCE_COLOUR = 3
+	};
+	// QuadInstance is the per-instance data of one quad, exactly as it is stored in the instance buffer.
+	struct QuadInstance
+	{
+		// The position of the quad's centre (x, y) followed by its scale (width, height).
+		GLfloat transform[4];
+		// The colour the quad's vertex colours are multiplied with, 0 to 255 per component.
+		GLubyte colour[4];
+	};
+	// QuadBatch accumulates quads and draws them with as few glDrawElementsInstanced calls as possible.
+	// The quad geometry is whatever mesh the VAO passed to Create draws; the batch only adds the
+	// per-instance attributes. Quads are written straight into a stream::RingBuffer, so nothing is
+	// copied between Add and the GPU.
+	class QuadBatch
+	{
+	public:
+		QuadBatch();
+		~QuadBatch();
+		// Creates the instance ring buffer and attaches it to vao. capacity is the number of instances
+		// uploaded per draw; larger batches are split. index_count and index_type describe the
+		// index buffer bound to vao.
+		void Create(GLuint vao, GLsizei capacity, GLsizei index_count, GLenum index_type);
+		void Destroy();
+		// Queues a quad. Draws the queued quads first if the capacity is reached. If the ring buffer
+		// cannot hand out space for it even after fencing what was drawn, the quad is dropped and counted.
+		void Add(const QuadInstance &instance);
+		void Add(GLfloat x, GLfloat y, GLfloat width, GLfloat height, GLubyte red, GLubyte green, GLubyte blue, GLubyte alpha);
+		// Draws the queued quads. The batch's VAO is left bound.
+		void Flush();
+		// Fences the instance data drawn this frame. Call it once per frame after the last Flush.
+		void EndFrame();
+		// Limits the number of instances per draw call. 0 (the default) means the capacity.
+		// Setting it to 1 draws every quad with its own call, which is what the batch replaces.
+		void SetMaxInstancesPerDraw(GLsizei max_instances_per_draw);
+		// Returns the number of draw calls issued since the last ResetStatistics.
+		GLsizei GetDrawCallCount() const { return m_draw_call_count; }
+		// Returns the number of quads dropped since the last ResetStatistics. Anything but 0 is a bug.
+		GLsizei GetDroppedCount() const { return m_dropped_count; }
+		void ResetStatistics() { m_draw_call_count = 0; m_dropped_count = 0; }
+		const stream::RingBuffer &GetRingBuffer() const { return m_ring_buffer; }
+	private:
+		// Points the instance attributes at the instance at byte offset in the ring buffer.
+		void SetInstanceOffset(GLintptr offset);
+		GLuint m_vao;
+		// The instance data of the queued quads lives in m_allocation inside m_ring_buffer.
+		stream::RingBuffer m_ring_buffer;
+		stream::Allocation m_allocation;
+		GLsizei m_instance_count;
+		GLsizei m_capacity;
+		GLsizei m_index_count;
+		GLenum m_index_type;
+		GLsizei m_max_instances_per_draw;
+		GLsizei m_draw_call_count;
+		GLsizei m_dropped_count;
+	};
+}
+
+#endif
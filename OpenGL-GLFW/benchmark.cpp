@@ -0,0 +1,2541 @@
+#include "benchmark.hpp"
+#include "command_queue.hpp"
+#include "culling.hpp"
+#include "error.hpp"
+#include "file_watcher.hpp"
+#include "frame.hpp"
+#include "mesh.hpp"
+#include "mesh_converter.hpp"
+#include "jobs.hpp"
+#include "math.hpp"
+#include "memory.hpp"
+#include "offscreen.hpp"
+#include "program.hpp"
+#include "render_graph.hpp"
+#include "resource.hpp"
+#include "stream.hpp"
+#include "shader.hpp"
+#include "shader_cache.hpp"
+#include "shader_compiler.hpp"
+#include "shader_preprocessor.hpp"
+#include "sprite.hpp"
+#include "state_cache.hpp"
+#include "streaming.hpp"
+#include "trace.hpp"
+#include "uniform.hpp"
+#include "vertex_format.hpp"
+#include "opengl.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+namespace benchmark
+{
+	typedef std::chrono::steady_clock Clock;
+	// Returns the milliseconds elapsed between two time points.
+	inline double Milliseconds(Clock::time_point begin, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	}
+	Options::Options()
+		: scenario("program"), frames(1000), warmup_frames(60), width(640), height(480), headless(false), scene_megabytes(64),
+		  max_regression_percent(10.0)
+	{
+
+	}
+	Statistics::Statistics()
+		: count(0), mean(0.0), min(0.0), max(0.0), p50(0.0), p95(0.0), p99(0.0)
+	{
+
+	}
+	// Returns the nearest-rank percentile of sorted, non-empty samples.
+	inline double Percentile(const std::vector<double> &sorted, double percentile)
+	{
+		size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * sorted.size()));
+		if (rank < 1)
+			rank = 1;
+		return sorted[std::min(rank, sorted.size()) - 1];
+	}
+	Statistics Summarize(std::vector<double> samples)
+	{
+		Statistics statistics;
+		if (samples.empty())
+			return statistics;
+		std::sort(samples.begin(), samples.end());
+		double sum = 0.0;
+		for (size_t i = 0; i < samples.size(); ++i)
+			sum += samples[i];
+		statistics.count = samples.size();
+		statistics.mean = sum / samples.size();
+		statistics.min = samples.front();
+		statistics.max = samples.back();
+		statistics.p50 = Percentile(samples, 50.0);
+		statistics.p95 = Percentile(samples, 95.0);
+		statistics.p99 = Percentile(samples, 99.0);
+		return statistics;
+	}
+	JsonWriter::JsonWriter(std::ostream &stream)
+		: m_stream(stream)
+	{
+		m_stream << std::setprecision(9);
+	}
+	void JsonWriter::BeginObject(const char *key)
+	{
+		Separator(key);
+		m_stream << '{';
+		m_first.push_back(true);
+	}
+	void JsonWriter::EndObject()
+	{
+		m_first.pop_back();
+		m_stream << '}';
+		if (m_first.empty())
+			m_stream << '\n';
+	}
+	void JsonWriter::BeginArray(const char *key)
+	{
+		Separator(key);
+		m_stream << '[';
+		m_first.push_back(true);
+	}
+	void JsonWriter::EndArray()
+	{
+		m_first.pop_back();
+		m_stream << ']';
+	}
+	void JsonWriter::Value(const char *key, double value)
+	{
+		Separator(key);
+		// JSON has no representation for infinity or NaN.
+		if (value != value || value > 1.0e308 || value < -1.0e308)
+			m_stream << "null";
+		else
+			m_stream << value;
+	}
+	void JsonWriter::Value(const char *key, long long value)
+	{
+		Separator(key);
+		m_stream << value;
+	}
+	void JsonWriter::Value(const char *key, int value)
+	{
+		Separator(key);
+		m_stream << value;
+	}
+	void JsonWriter::Value(const char *key, bool value)
+	{
+		Separator(key);
+		m_stream << (value ? "true" : "false");
+	}
+	void JsonWriter::Value(const char *key, const std::string &value)
+	{
+		Separator(key);
+		String(value);
+	}
+	void JsonWriter::Value(const char *key, const Statistics &statistics)
+	{
+		BeginObject(key);
+		Value("count", static_cast<long long>(statistics.count));
+		Value("mean", statistics.mean);
+		Value("min", statistics.min);
+		Value("max", statistics.max);
+		Value("p50", statistics.p50);
+		Value("p95", statistics.p95);
+		Value("p99", statistics.p99);
+		EndObject();
+	}
+	void JsonWriter::Element(double value)
+	{
+		Value(0, value);
+	}
+	void JsonWriter::Separator(const char *key)
+	{
+		if (!m_first.empty())
+		{
+			if (!m_first.back())
+				m_stream << ',';
+			m_first.back() = false;
+		}
+		if (0 != key)
+		{
+			String(key);
+			m_stream << ':';
+		}
+	}
+	void JsonWriter::String(const std::string &value)
+	{
+		m_stream << '"';
+		for (size_t i = 0; i < value.size(); ++i)
+		{
+			const char c = value[i];
+			if (c == '"' || c == '\\')
+				m_stream << '\\' << c;
+			else if (static_cast<unsigned char>(c) < 0x20)
+				m_stream << ' ';
+			else
+				m_stream << c;
+		}
+		m_stream << '"';
+	}
+	GpuTimer::GpuTimer()
+		: m_next(0), m_oldest(0), m_supported(false)
+	{
+
+	}
+	GpuTimer::~GpuTimer()
+	{
+
+	}
+	bool GpuTimer::Create()
+	{
+		// >> GL_TIME_ELAPSED queries record the amount of time, in nanoseconds, that it takes to
+		// >> fully complete the commands issued between glBeginQuery and glEndQuery.
+		// Timer queries are core in OpenGL 3.3 and available on 3.2 through ARB_timer_query.
+		m_supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+		if (m_supported)
+			glGenQueries(QUERY_COUNT, m_queries);
+		m_next = 0;
+		m_oldest = 0;
+		return m_supported;
+	}
+	void GpuTimer::Destroy()
+	{
+		if (m_supported)
+			glDeleteQueries(QUERY_COUNT, m_queries);
+		m_supported = false;
+	}
+	void GpuTimer::Begin()
+	{
+		if (!m_supported)
+			return;
+		// If every query is still in flight, the oldest result has to be dropped.
+		if (m_next - m_oldest == QUERY_COUNT)
+			++m_oldest;
+		glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next % QUERY_COUNT]);
+	}
+	void GpuTimer::End()
+	{
+		if (!m_supported)
+			return;
+		glEndQuery(GL_TIME_ELAPSED);
+		++m_next;
+	}
+	void GpuTimer::Collect(std::vector<double> &samples, bool wait)
+	{
+		while (m_supported && m_oldest != m_next)
+		{
+			const GLuint query = m_queries[m_oldest % QUERY_COUNT];
+			if (!wait)
+			{
+				GLint available = GL_FALSE;
+				glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+				if (GL_FALSE == available)
+					return;
+			}
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+			samples.push_back(nanoseconds / 1.0e6);
+			++m_oldest;
+		}
+	}
+	// FrameSamples holds the per-frame measurements of a run, in milliseconds.
+	struct FrameSamples
+	{
+		// Time spent on the CPU submitting the frame.
+		std::vector<double> cpu;
+		// Time the GPU spent executing the frame.
+		std::vector<double> gpu;
+		// Time from the start of one frame to the start of the next (including the swap).
+		std::vector<double> frame;
+	};
+	// Renders options.frames frames with render (after options.warmup_frames unmeasured ones)
+	// and records the timings in samples. Swaps buffers when rendering to a window.
+	template <typename RenderFunction>
+	void RunFrames(const Options &options, offscreen::RenderTarget *target, RenderFunction render, FrameSamples &samples)
+	{
+		if (0 != target)
+			target->Bind();
+		for (int i = 0; i < options.warmup_frames; ++i)
+		{
+			render();
+			if (0 == target)
+				glfwSwapBuffers();
+			memory::GetFrameArena().Reset();
+		}
+		glFinish();
+		samples.cpu.reserve(options.frames);
+		samples.gpu.reserve(options.frames);
+		samples.frame.reserve(options.frames);
+		GpuTimer gpu_timer;
+		gpu_timer.Create();
+		Clock::time_point frame_begin = Clock::now();
+		for (int i = 0; i < options.frames; ++i)
+		{
+			gpu_timer.Begin();
+			render();
+			gpu_timer.End();
+			samples.cpu.push_back(Milliseconds(frame_begin, Clock::now()));
+			if (0 == target)
+				glfwSwapBuffers();
+			memory::GetFrameArena().Reset();
+			gpu_timer.Collect(samples.gpu, false);
+			const Clock::time_point frame_end = Clock::now();
+			samples.frame.push_back(Milliseconds(frame_begin, frame_end));
+			frame_begin = frame_end;
+		}
+		glFinish();
+		gpu_timer.Collect(samples.gpu, true);
+		gpu_timer.Destroy();
+		if (0 != target)
+			target->Unbind();
+	}
+	// Writes the fields every report shares: the scenario settings and the driver strings.
+	void WriteHeader(JsonWriter &writer, const Options &options)
+	{
+		writer.Value("scenario", options.scenario);
+		writer.Value("frames", options.frames);
+		writer.Value("warmup_frames", options.warmup_frames);
+		writer.Value("width", options.width);
+		writer.Value("height", options.height);
+		writer.Value("headless", options.headless);
+		writer.Value("vendor", std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))));
+		writer.Value("renderer", std::string(reinterpret_cast<const char*>(glGetString(GL_RENDERER))));
+		writer.Value("version", std::string(reinterpret_cast<const char*>(glGetString(GL_VERSION))));
+	}
+	// Writes the summaries and the raw per-frame samples.
+	void WriteFrameSamples(JsonWriter &writer, const FrameSamples &samples)
+	{
+		writer.Value("cpu_ms", Summarize(samples.cpu));
+		writer.Value("gpu_ms", Summarize(samples.gpu));
+		writer.Value("frame_ms", Summarize(samples.frame));
+		writer.BeginArray("cpu_ms_per_frame");
+		for (size_t i = 0; i < samples.cpu.size(); ++i)
+			writer.Element(samples.cpu[i]);
+		writer.EndArray();
+		writer.BeginArray("gpu_ms_per_frame");
+		for (size_t i = 0; i < samples.gpu.size(); ++i)
+			writer.Element(samples.gpu[i]);
+		writer.EndArray();
+	}
+	// Measures program::Program, exactly as main.cpp runs it, without vsync.
+	int RunProgramScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		program::Program program;
+		program.Init();
+		FrameSamples samples;
+		const bool linked = program.IsLinked();
+		RunFrames(options, target, [&program]() { program.Render(); }, samples);
+		const render::StateStatistics state_changes = render::GetStateCache().GetFrameStatistics();
+		program.Destroy();
+		writer.Value("linked", linked);
+		writer.Value("state_calls_issued_per_frame", static_cast<long long>(state_changes.issued));
+		writer.Value("state_calls_skipped_per_frame", static_cast<long long>(state_changes.redundant));
+		WriteFrameSamples(writer, samples);
+		// Timing a program that did not link measures nothing.
+		return linked ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// Returns a pseudo-random number between 0.0 and 1.0. Deterministic, so every run draws the same scene.
+	inline float NextRandom(unsigned int &state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	}
+	// Measures program::QuadBatch with 1 to 1M quads, once batched and once with a draw call per quad.
+	// Each step renders at most 100 frames, so the largest steps stay practical on software rasterizers.
+	int RunQuadsScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		program::Program program;
+		program.Init();
+		program::QuadBatch &batch = program.GetBatch();
+		std::vector<program::QuadInstance> quads;
+		unsigned int random_state = 1;
+		Options step_options = options;
+		step_options.frames = std::min(options.frames, 100);
+		step_options.warmup_frames = std::min(options.warmup_frames, 10);
+		GLsizei dropped_quads = 0;
+		writer.BeginArray("steps");
+		for (int quad_count = 1; quad_count <= 1000000; quad_count *= 10)
+		{
+			while (static_cast<int>(quads.size()) < quad_count)
+			{
+				const program::QuadInstance quad = {
+					{ NextRandom(random_state) * 2.0f - 1.0f, NextRandom(random_state) * 2.0f - 1.0f, 0.01f, 0.01f },
+					{ 255, static_cast<GLubyte>(NextRandom(random_state) * 255.0f), 255, 255 }
+				};
+				quads.push_back(quad);
+			}
+			for (int per_quad = 0; per_quad < 2; ++per_quad)
+			{
+				// A draw call per quad is hopeless beyond 100k quads; skip those steps.
+				if (per_quad && quad_count > 100000)
+					continue;
+				batch.SetMaxInstancesPerDraw(per_quad ? 1 : 0);
+				batch.ResetStatistics();
+				FrameSamples samples;
+				RunFrames(step_options, target, [&]() {
+					glClear(GL_COLOR_BUFFER_BIT);
+					for (int i = 0; i < quad_count; ++i)
+						batch.Add(quads[i]);
+					batch.Flush();
+					batch.EndFrame();
+				}, samples);
+				writer.BeginObject();
+				writer.Value("quads", quad_count);
+				writer.Value("mode", std::string(per_quad ? "draw_per_quad" : "batched"));
+				writer.Value("draw_calls_per_frame", batch.GetDrawCallCount() / (step_options.frames + step_options.warmup_frames));
+				writer.Value("dropped_quads", static_cast<int>(batch.GetDroppedCount()));
+				dropped_quads += batch.GetDroppedCount();
+				writer.Value("cpu_ms", Summarize(samples.cpu));
+				writer.Value("gpu_ms", Summarize(samples.gpu));
+				writer.Value("frame_ms", Summarize(samples.frame));
+				writer.EndObject();
+			}
+		}
+		writer.EndArray();
+		batch.SetMaxInstancesPerDraw(0);
+		program.Destroy();
+		return 0 == dropped_quads ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// Compares streaming through stream::RingBuffer with plain glBufferSubData: both write 4 MB per
+	// frame in 64 KB pieces, at most 200 frames, and report the upload rate including a final glFinish.
+	// Fails if the ring ever returns no allocation, which it only may for more than its size.
+	int RunStreamUploadScenario(const Options &options, offscreen::RenderTarget *, JsonWriter &writer)
+	{
+		const GLsizeiptr CHUNK_SIZE = 64 * 1024;
+		const int CHUNKS_PER_FRAME = 64;
+		const int frames = std::min(options.frames, 200);
+		const double megabytes = static_cast<double>(CHUNK_SIZE) * CHUNKS_PER_FRAME * frames / (1024.0 * 1024.0);
+		// A ring of three allocations has to keep handing out space as it wraps around, both when the
+		// GPU has caught up (after glFinish) and when it may not have. The 280 byte allocation after the
+		// 50 byte one only fits once the ring starts over at offset 0.
+		const GLsizeiptr WRAP_SIZES[] = { 100, 100, 100, 100, 100, 100, 50, 280, 100, 300, 100 };
+		int failed_wrap_allocations = 0;
+		stream::RingBuffer small_ring;
+		small_ring.Create(GL_ARRAY_BUFFER, 300);
+		for (size_t i = 0; i < sizeof(WRAP_SIZES) / sizeof(WRAP_SIZES[0]); ++i)
+		{
+			stream::Allocation allocation = small_ring.Allocate(WRAP_SIZES[i], 4);
+			if (0 == allocation.pointer)
+			{
+				++failed_wrap_allocations;
+				continue;
+			}
+			std::memset(allocation.pointer, static_cast<int>(i), WRAP_SIZES[i]);
+			small_ring.Commit(allocation, WRAP_SIZES[i]);
+			small_ring.Fence();
+			if (0 == i % 2)
+				glFinish();
+		}
+		small_ring.Destroy();
+		writer.Value("failed_wrap_allocations", failed_wrap_allocations);
+		// Ring buffer: the data is written straight into the mapped buffer.
+		stream::RingBuffer ring_buffer;
+		ring_buffer.Create(GL_ARRAY_BUFFER, 3 * CHUNK_SIZE * CHUNKS_PER_FRAME);
+		int failed_allocations = 0;
+		Clock::time_point begin = Clock::now();
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			for (int chunk = 0; chunk < CHUNKS_PER_FRAME; ++chunk)
+			{
+				stream::Allocation allocation = ring_buffer.Allocate(CHUNK_SIZE, 256);
+				if (0 == allocation.pointer)
+				{
+					++failed_allocations;
+					continue;
+				}
+				std::memset(allocation.pointer, frame + chunk, CHUNK_SIZE);
+				ring_buffer.Commit(allocation, CHUNK_SIZE);
+			}
+			ring_buffer.Fence();
+		}
+		glFinish();
+		const double ring_buffer_ms = Milliseconds(begin, Clock::now());
+		writer.BeginObject("ring_buffer");
+		writer.Value("persistent", ring_buffer.IsPersistent());
+		writer.Value("megabytes", megabytes);
+		writer.Value("milliseconds", ring_buffer_ms);
+		writer.Value("megabytes_per_second", megabytes / (ring_buffer_ms / 1000.0));
+		writer.Value("stalls", static_cast<int>(ring_buffer.GetStallCount()));
+		writer.Value("orphans", static_cast<int>(ring_buffer.GetOrphanCount()));
+		writer.Value("failed_allocations", failed_allocations);
+		writer.EndObject();
+		ring_buffer.Destroy();
+		// glBufferSubData: the data is written to client memory first and copied by the driver.
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, 3 * CHUNK_SIZE * CHUNKS_PER_FRAME, NULL, GL_STREAM_DRAW);
+		std::vector<unsigned char> staging(CHUNK_SIZE);
+		begin = Clock::now();
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			for (int chunk = 0; chunk < CHUNKS_PER_FRAME; ++chunk)
+			{
+				std::memset(&staging[0], frame + chunk, CHUNK_SIZE);
+				const GLintptr offset = ((frame % 3) * CHUNKS_PER_FRAME + chunk) * CHUNK_SIZE;
+				glBufferSubData(GL_ARRAY_BUFFER, offset, CHUNK_SIZE, &staging[0]);
+			}
+		}
+		glFinish();
+		const double sub_data_ms = Milliseconds(begin, Clock::now());
+		writer.BeginObject("buffer_sub_data");
+		writer.Value("megabytes", megabytes);
+		writer.Value("milliseconds", sub_data_ms);
+		writer.Value("megabytes_per_second", megabytes / (sub_data_ms / 1000.0));
+		writer.EndObject();
+		glDeleteBuffers(1, &buffer);
+		return (0 == failed_wrap_allocations && 0 == failed_allocations) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// Measures how long creating the program's shader program takes without (cold) and with (warm) a
+	// cached binary. Runs min(frames, 20) times each; every run waits for the link, which also stores
+	// the binary, and ends with glFinish. Fails if a program does not link, or if the cache is enabled
+	// and a warm run does not hit.
+	int RunShaderStartupScenario(const Options &options, offscreen::RenderTarget *, JsonWriter &writer)
+	{
+		shader::ProgramCache cache;
+		if (!cache.Create("shader_cache"))
+			std::cerr << "Program binaries are not supported; both runs will compile." << std::endl;
+		std::vector<std::string> sources;
+		sources.push_back(shader::LoadFileContents("shader.vert"));
+		sources.push_back(shader::LoadFileContents("shader.frag"));
+		const unsigned long long key = cache.MakeKey(sources, std::string());
+		const int runs = std::max(1, std::min(options.frames, 20));
+		// Program::Init builds its program with a ShaderCompiler on a one-thread pool; do the same.
+		jobs::ThreadPool pool;
+		pool.Create(1);
+		std::vector<double> cold;
+		std::vector<double> warm;
+		bool all_linked = true;
+		for (int i = 0; i < runs; ++i)
+		{
+			for (int is_warm = 0; is_warm < 2; ++is_warm)
+			{
+				if (!is_warm)
+					cache.Remove(key);
+				const Clock::time_point begin = Clock::now();
+				shader::ShaderProgram shader_program;
+				shader::ShaderCompiler compiler;
+				compiler.Create(&pool, &cache);
+				compiler.Add(shader_program, "shader.vert", "shader.frag");
+				compiler.Submit();
+				// The first status query is when a cold run stores its binary for the warm run.
+				all_linked = shader_program.IsLinked() && all_linked;
+				glFinish();
+				(is_warm ? warm : cold).push_back(Milliseconds(begin, Clock::now()));
+				shader_program.Destroy();
+			}
+		}
+		pool.Destroy();
+		writer.Value("cache_enabled", cache.IsEnabled());
+		writer.Value("cold_ms", Summarize(cold));
+		writer.Value("warm_ms", Summarize(warm));
+		writer.Value("hits", static_cast<int>(cache.GetHitCount()));
+		writer.Value("misses", static_cast<int>(cache.GetMissCount()));
+		writer.Value("rejects", static_cast<int>(cache.GetRejectCount()));
+		writer.Value("all_linked", all_linked);
+		const bool warm_runs_hit = !cache.IsEnabled() || static_cast<int>(cache.GetHitCount()) == runs;
+		if (!warm_runs_hit)
+			std::cerr << "Only " << cache.GetHitCount() << " of " << runs << " warm runs loaded the cached program." << std::endl;
+		return (all_linked && warm_runs_hit) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// The shader files of the shader permutation scenario. Written to the working directory while it runs.
+	const char PERMUTATION_VERTEX_SHADER[] =
+		"#version 150 core\n"
+		"#extension GL_ARB_explicit_attrib_location : require\n"
+		"\n"
+		"layout(location = 0) in vec4 vertex_position;\n"
+		"layout(location = 1) in vec4 vertex_colour;\n"
+		"\n"
+		"smooth out vec4 fragment_colour;\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"    vec4 position = vertex_position;\n"
+		"#ifdef FLIP_Y\n"
+		"    position.y = -position.y;\n"
+		"#endif\n"
+		"#ifdef HALF_SIZE\n"
+		"    position.xy *= 0.5;\n"
+		"#endif\n"
+		"    fragment_colour = vertex_colour;\n"
+		"    gl_Position = position;\n"
+		"}\n";
+	const char PERMUTATION_FRAGMENT_SHADER[] =
+		"#version 150 core\n"
+		"#include \"benchmark_permutation.glsl\"\n"
+		"\n"
+		"smooth in vec4 fragment_colour;\n"
+		"\n"
+		"out vec4 output_colour;\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"    vec4 colour = fragment_colour;\n"
+		"#ifdef DESATURATE\n"
+		"    colour.rgb = vec3(dot(colour.rgb, vec3(0.299, 0.587, 0.114)));\n"
+		"#endif\n"
+		"#ifdef INVERT\n"
+		"    colour.rgb = 1.0 - colour.rgb;\n"
+		"#endif\n"
+		"    output_colour = vec4(Encode(colour.rgb), colour.a);\n"
+		"}\n";
+	const char PERMUTATION_INCLUDE[] =
+		"vec3 Encode(vec3 colour)\n"
+		"{\n"
+		"#ifdef GAMMA\n"
+		"    return pow(colour, vec3(1.0 / 2.2));\n"
+		"#else\n"
+		"    return colour;\n"
+		"#endif\n"
+		"}\n";
+	// Writes contents to file_name. Returns false if it cannot.
+	bool WriteTextFile(const char *file_name, const char *contents)
+	{
+		std::ofstream file(file_name, std::ios::binary);
+		file << contents;
+		return static_cast<bool>(file);
+	}
+	// Builds every permutation of 7 shader features (two used by the vertex shader, two by the fragment
+	// shader, one by a file the fragment shader includes and two by neither): 128 programs. First each
+	// program compiles its own two shader objects, as without ShaderObjectCache, then the programs are
+	// created one at a time with CreateFromFiles, which compiles only the 4 + 8 distinct sources, and
+	// last they are built in one batch by a ShaderCompiler, which reads the files on a thread pool and
+	// submits every compile before it links anything. Every build ends with glFinish. Fails if a
+	// program does not link.
+	int RunShaderPermutationsScenario(const Options &, offscreen::RenderTarget *, JsonWriter &writer)
+	{
+		const char *vertex_file_name = "benchmark_permutation.vert";
+		const char *fragment_file_name = "benchmark_permutation.frag";
+		const char *include_file_name = "benchmark_permutation.glsl";
+		if (!WriteTextFile(vertex_file_name, PERMUTATION_VERTEX_SHADER) || !WriteTextFile(fragment_file_name, PERMUTATION_FRAGMENT_SHADER)
+			|| !WriteTextFile(include_file_name, PERMUTATION_INCLUDE))
+		{
+			std::cerr << "Cannot write the shader files of the permutation scenario." << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::vector<std::string> features;
+		features.push_back("FLIP_Y");
+		features.push_back("HALF_SIZE");
+		features.push_back("DESATURATE");
+		features.push_back("INVERT");
+		features.push_back("GAMMA");
+		features.push_back("SHADOWS");
+		features.push_back("FOG");
+		const unsigned long long permutations = 1ull << features.size();
+		bool all_linked = true;
+		// Without sharing: two compiles per program.
+		Clock::time_point begin = Clock::now();
+		for (unsigned long long permutation = 0; permutation < permutations; ++permutation)
+		{
+			const shader::Defines defines = shader::GetPermutationDefines(features, permutation);
+			std::string sources[2];
+			shader::PreprocessFile(vertex_file_name, defines, sources[0]);
+			shader::PreprocessFile(fragment_file_name, defines, sources[1]);
+			const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+			GLuint shaders[2];
+			const GLuint program = glCreateProgram();
+			for (int stage = 0; stage < 2; ++stage)
+			{
+				const GLchar *source = sources[stage].c_str();
+				shaders[stage] = glCreateShader(types[stage]);
+				glShaderSource(shaders[stage], 1, &source, 0);
+				glCompileShader(shaders[stage]);
+				glAttachShader(program, shaders[stage]);
+			}
+			glLinkProgram(program);
+			GLint linked = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &linked);
+			all_linked = all_linked && GL_TRUE == linked;
+			glDeleteProgram(program);
+			glDeleteShader(shaders[0]);
+			glDeleteShader(shaders[1]);
+		}
+		glFinish();
+		const double separate_ms = Milliseconds(begin, Clock::now());
+		// With sharing: the programs stay alive together, so they hold the shared objects.
+		shader::ShaderObjectCache &objects = shader::GetShaderObjectCache();
+		const unsigned int compiles_before = objects.GetCompileCount();
+		const unsigned int hits_before = objects.GetHitCount();
+		std::vector<shader::ShaderProgram> programs(static_cast<size_t>(permutations));
+		begin = Clock::now();
+		for (unsigned long long permutation = 0; permutation < permutations; ++permutation)
+			programs[permutation].CreateFromFiles(vertex_file_name, fragment_file_name, NULL, shader::GetPermutationDefines(features, permutation));
+		for (size_t program = 0; program < programs.size(); ++program)
+			all_linked = programs[program].IsLinked() && all_linked;
+		glFinish();
+		const double shared_ms = Milliseconds(begin, Clock::now());
+		const unsigned int compiles = objects.GetCompileCount() - compiles_before;
+		const unsigned int hits = objects.GetHitCount() - hits_before;
+		const size_t dependencies = programs[0].GetDependencies().size();
+		for (size_t program = 0; program < programs.size(); ++program)
+			programs[program].Destroy();
+		// Batched: the same programs again, now that the shared objects are gone.
+		jobs::ThreadPool pool;
+		pool.Create();
+		const unsigned int batched_compiles_before = objects.GetCompileCount();
+		begin = Clock::now();
+		shader::ShaderCompiler compiler;
+		compiler.Create(&pool);
+		for (unsigned long long permutation = 0; permutation < permutations; ++permutation)
+			compiler.Add(programs[permutation], vertex_file_name, fragment_file_name, shader::GetPermutationDefines(features, permutation));
+		compiler.Submit();
+		for (size_t program = 0; program < programs.size(); ++program)
+			all_linked = programs[program].IsLinked() && all_linked;
+		glFinish();
+		const double batched_ms = Milliseconds(begin, Clock::now());
+		const unsigned int batched_compiles = objects.GetCompileCount() - batched_compiles_before;
+		for (size_t program = 0; program < programs.size(); ++program)
+			programs[program].Destroy();
+		pool.Destroy();
+		std::remove(vertex_file_name);
+		std::remove(fragment_file_name);
+		std::remove(include_file_name);
+		writer.Value("features", static_cast<int>(features.size()));
+		writer.Value("programs", static_cast<int>(permutations));
+		writer.Value("separate_compiles", static_cast<int>(permutations * 2));
+		writer.Value("separate_ms", separate_ms);
+		writer.Value("shared_compiles", static_cast<int>(compiles));
+		writer.Value("shared_hits", static_cast<int>(hits));
+		writer.Value("shared_ms", shared_ms);
+		writer.Value("batched_compiles", static_cast<int>(batched_compiles));
+		writer.Value("batched_ms", batched_ms);
+		writer.Value("batched_speedup", batched_ms > 0.0 ? shared_ms / batched_ms : 0.0);
+		writer.Value("dependencies", static_cast<int>(dependencies));
+		writer.Value("all_linked", all_linked);
+		// 4 vertex shader variants (FLIP_Y, HALF_SIZE) and 8 fragment shader variants (DESATURATE, INVERT, GAMMA).
+		return (all_linked && 12 == compiles && 12 == batched_compiles && 0 == objects.GetSize()) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// The fragment shaders the shader reload scenario writes to benchmark_reload.frag, in order: the
+	// original, an edit that changes the colour and an edit that does not compile.
+	const char *const RELOAD_FRAGMENT_SHADERS[] = {
+		"#version 150 core\n"
+		"\n"
+		"out vec4 output_colour;\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"    output_colour = vec4(1.0, 0.0, 0.0, 1.0);\n"
+		"}\n",
+		"#version 150 core\n"
+		"\n"
+		"out vec4 output_colour;\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"    output_colour = vec4(0.0, 1.0, 0.0, 1.0);\n"
+		"}\n",
+		"#version 150 core\n"
+		"\n"
+		"out vec4 output_colour;\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"    output_colour = vec4(0.0, 0.0, 1.0, 1.0)\n"
+		"}\n"
+	};
+	// Waits for watcher to report an edit and reloads program like program::Program does, then
+	// waits for the reload to finish. Without a watcher it reloads right away. Returns true if
+	// the reload finished within timeout_ms; swapped tells whether the new program was swapped in.
+	bool WaitForReload(shader::ShaderProgram &program, shader::FileWatcher *watcher, jobs::ThreadPool &pool, double timeout_ms, bool &swapped)
+	{
+		swapped = false;
+		bool reloading = 0 == watcher;
+		if (reloading)
+			program.Reload(&pool);
+		const Clock::time_point begin = Clock::now();
+		while (Milliseconds(begin, Clock::now()) < timeout_ms)
+		{
+			if (!reloading && watcher->HasChanges())
+			{
+				std::vector<std::string> changed_files;
+				watcher->TakeChanges(changed_files);
+				program.Reload(&pool);
+				reloading = true;
+			}
+			if (reloading)
+			{
+				swapped = program.Update() || swapped;
+				if (!program.IsReloading())
+					return true;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return false;
+	}
+	// Builds a program from fullscreen.vert and benchmark_reload.frag, watches its files like
+	// program::Program, and edits the fragment shader twice: first into a different colour, which
+	// must be swapped in, then into one that does not compile, which must leave the previous program
+	// in use. Reports how long each reload took from the edit. Fails if a reload does not finish
+	// within RELOAD_TIMEOUT_MS, the wrong program is in use after it, or (headless) the drawn colour
+	// is not the one of the program in use.
+	int RunShaderReloadScenario(const Options &, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		const double RELOAD_TIMEOUT_MS = 5000.0;
+		const char *fragment_file_name = "benchmark_reload.frag";
+		if (!WriteTextFile(fragment_file_name, RELOAD_FRAGMENT_SHADERS[0]))
+		{
+			std::cerr << "Cannot write the shader file of the reload scenario." << std::endl;
+			return EXIT_FAILURE;
+		}
+		jobs::ThreadPool pool;
+		pool.Create(1);
+		shader::ShaderProgram program;
+		shader::ShaderCompiler compiler;
+		compiler.Create(&pool);
+		compiler.Add(program, "fullscreen.vert", fragment_file_name);
+		compiler.Submit();
+		bool passed = program.IsLinked();
+		shader::FileWatcher watcher;
+		const bool watching = watcher.Create(".");
+		if (watching)
+		{
+			const std::vector<std::string> &dependencies = program.GetDependencies();
+			for (size_t file = 0; file < dependencies.size(); ++file)
+				watcher.Watch(dependencies[file]);
+		}
+		else
+		{
+			std::cerr << "File change notifications are not supported; the scenario reloads without them." << std::endl;
+		}
+		render::StateCache &state = render::GetStateCache();
+		resource::VertexArray empty_vao;
+		empty_vao.Create(RESOURCE_SITE);
+		// Draws the program over the target and returns the colour of its centre, or 0 without a target.
+		const auto draw = [&]() -> unsigned long
+		{
+			if (0 == target)
+				return 0;
+			target->Bind();
+			state.UseProgram(program.GetOpenGLID());
+			state.BindVertexArray(empty_vao.Get());
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			std::vector<unsigned char> image;
+			target->ReadPixels(image);
+			const unsigned char *centre = &image[((target->GetHeight() / 2) * target->GetWidth() + target->GetWidth() / 2) * 4];
+			return (static_cast<unsigned long>(centre[0]) << 16) | (centre[1] << 8) | centre[2];
+		};
+		const unsigned long RED = 0xFF0000;
+		const unsigned long GREEN = 0x00FF00;
+		if (0 != target && draw() != RED)
+			passed = false;
+		writer.Value("file_watcher", watching);
+		writer.BeginArray("edits");
+		// The valid edit must be swapped in; the broken one must keep the program the valid one made.
+		for (int edit = 1; edit <= 2; ++edit)
+		{
+			const GLuint id_before = program.GetOpenGLID();
+			const Clock::time_point begin = Clock::now();
+			const bool written = WriteTextFile(fragment_file_name, RELOAD_FRAGMENT_SHADERS[edit]);
+			bool swapped = false;
+			const bool finished = written && WaitForReload(program, watching ? &watcher : NULL, pool, RELOAD_TIMEOUT_MS, swapped);
+			const double reload_ms = Milliseconds(begin, Clock::now());
+			const bool expect_swap = 1 == edit;
+			const bool id_changed = program.GetOpenGLID() != id_before;
+			const unsigned long colour = draw();
+			const bool correct = finished && swapped == expect_swap && id_changed == expect_swap && program.IsLinked()
+				&& (0 == target || GREEN == colour);
+			passed = passed && correct;
+			writer.BeginObject();
+			writer.Value("edit", std::string(expect_swap ? "valid" : "broken"));
+			writer.Value("finished", finished);
+			writer.Value("swapped", swapped);
+			writer.Value("reload_ms", reload_ms);
+			writer.Value("passed", correct);
+			writer.EndObject();
+		}
+		writer.EndArray();
+		state.BindVertexArray(0);
+		state.UseProgram(0);
+		empty_vao.Reset();
+		watcher.Destroy();
+		program.Destroy();
+		pool.Destroy();
+		std::remove(fragment_file_name);
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// The number of cells along each side of the grid mesh the vertex layout scenario draws.
+	const int LAYOUT_GRID_SIZE = 512;
+	// Returns the position (x, y), colour (r, g, b) and normal (x, y, z) of grid vertex (column, row).
+	inline void GridVertex(int column, int row, float values[8])
+	{
+		values[0] = column * 2.0f / LAYOUT_GRID_SIZE - 1.0f;
+		values[1] = row * 2.0f / LAYOUT_GRID_SIZE - 1.0f;
+		values[2] = static_cast<float>(column) / LAYOUT_GRID_SIZE;
+		values[3] = static_cast<float>(row) / LAYOUT_GRID_SIZE;
+		values[4] = 0.5f;
+		values[5] = 0.0f;
+		values[6] = 0.0f;
+		values[7] = 1.0f;
+	}
+	// Packs grid vertex values into a vertex of Format, which must start with position and colour.
+	template <typename Format>
+	void PackGridVertex(const float values[8], typename Format::Vertex &vertex);
+	typedef vertex::Format<vertex::Attribute<0, GLfloat, 2>, vertex::Attribute<1, GLfloat, 3> > InterleavedFloatFormat;
+	typedef vertex::Format<vertex::Attribute<0, vertex::Half, 2>, vertex::Attribute<1, GLubyte, 4, true> > PackedFormat;
+	typedef vertex::Format<vertex::Attribute<0, vertex::Half, 2>, vertex::Attribute<1, GLubyte, 4, true>,
+		vertex::Attribute<4, vertex::Int2101010Rev, 1, true> > PackedNormalFormat;
+	template <>
+	void PackGridVertex<InterleavedFloatFormat>(const float values[8], InterleavedFloatFormat::Vertex &vertex)
+	{
+		vertex.Set<0>(values[0], values[1]);
+		vertex.Set<1>(values[2], values[3], values[4]);
+	}
+	template <>
+	void PackGridVertex<PackedFormat>(const float values[8], PackedFormat::Vertex &vertex)
+	{
+		vertex.Set<0>(vertex::ToHalf(values[0]), vertex::ToHalf(values[1]));
+		vertex.Set<1>(vertex::ToUnsignedByte(values[2]), vertex::ToUnsignedByte(values[3]), vertex::ToUnsignedByte(values[4]), 255);
+	}
+	template <>
+	void PackGridVertex<PackedNormalFormat>(const float values[8], PackedNormalFormat::Vertex &vertex)
+	{
+		vertex.Set<0>(vertex::ToHalf(values[0]), vertex::ToHalf(values[1]));
+		vertex.Set<1>(vertex::ToUnsignedByte(values[2]), vertex::ToUnsignedByte(values[3]), vertex::ToUnsignedByte(values[4]), 255);
+		vertex.Set<2>(vertex::PackInt2101010Rev(values[5], values[6], values[7]));
+	}
+	// Draws the grid, already uploaded to the bound VAO, and writes the results of one layout.
+	void MeasureLayout(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer, const char *name,
+		size_t bytes_per_vertex, size_t vertex_count, GLsizei index_count)
+	{
+		FrameSamples samples;
+		RunFrames(options, target, [index_count]() {
+			glClear(GL_COLOR_BUFFER_BIT);
+			glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, 0);
+		}, samples);
+		const Statistics gpu = Summarize(samples.gpu);
+		writer.BeginObject();
+		writer.Value("layout", std::string(name));
+		writer.Value("bytes_per_vertex", static_cast<int>(bytes_per_vertex));
+		writer.Value("vertex_buffer_bytes", static_cast<long long>(bytes_per_vertex * vertex_count));
+		writer.Value("cpu_ms", Summarize(samples.cpu));
+		writer.Value("gpu_ms", gpu);
+		writer.Value("frame_ms", Summarize(samples.frame));
+		// Vertex shader invocations per second, counting every index (post-transform cache hits included).
+		writer.Value("million_indices_per_second", gpu.mean > 0.0 ? index_count / (gpu.mean * 1000.0) : 0.0);
+		writer.EndObject();
+	}
+	// Uploads the grid in Format into the bound VAO and measures it.
+	template <typename Format>
+	void MeasureInterleavedLayout(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer, const char *name, GLsizei index_count)
+	{
+		const int side = LAYOUT_GRID_SIZE + 1;
+		std::vector<typename Format::Vertex> vertices(side * side);
+		float values[8];
+		for (int row = 0; row < side; ++row)
+		{
+			for (int column = 0; column < side; ++column)
+			{
+				GridVertex(column, row, values);
+				PackGridVertex<Format>(values, vertices[row * side + column]);
+			}
+		}
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * Format::STRIDE, &vertices[0], GL_STATIC_DRAW);
+		Format::Apply();
+		MeasureLayout(options, target, writer, name, Format::STRIDE, vertices.size(), index_count);
+	}
+	// Draws a 512x512 cell grid with the vertex data stored in separate float blocks (the original
+	// layout of program.cpp), interleaved floats, and the packed layouts, and compares them.
+	int RunVertexLayoutsScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		shader::ShaderProgram shader_program;
+		shader_program.CreateFromFiles("shader.vert", "shader.frag");
+		// Throughput measured with a program that did not link means nothing.
+		writer.Value("linked", shader_program.IsLinked());
+		if (!shader_program.IsLinked())
+		{
+			shader_program.Destroy();
+			return EXIT_FAILURE;
+		}
+		glUseProgram(shader_program.GetOpenGLID());
+		// No instance buffer: give the instance attributes of shader.vert constant identity values.
+		glVertexAttrib4f(program::INSTANCE_TRANSFORM, 0.0f, 0.0f, 1.0f, 1.0f);
+		glVertexAttrib4f(program::INSTANCE_COLOUR, 1.0f, 1.0f, 1.0f, 1.0f);
+		const int side = LAYOUT_GRID_SIZE + 1;
+		std::vector<GLuint> indices;
+		indices.reserve(LAYOUT_GRID_SIZE * LAYOUT_GRID_SIZE * 6);
+		for (int row = 0; row < LAYOUT_GRID_SIZE; ++row)
+		{
+			for (int column = 0; column < LAYOUT_GRID_SIZE; ++column)
+			{
+				const GLuint corner = row * side + column;
+				const GLuint quad[6] = { corner, corner + 1, corner + side + 1, corner, corner + side + 1, corner + side };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+		const GLsizei index_count = static_cast<GLsizei>(indices.size());
+		writer.BeginArray("layouts");
+		for (int layout = 0; layout < 4; ++layout)
+		{
+			GLuint vao;
+			GLuint buffers[2];
+			glGenVertexArrays(1, &vao);
+			glBindVertexArray(vao);
+			glGenBuffers(2, buffers);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+			if (layout == 0)
+			{
+				// All positions first, then all colours.
+				std::vector<GLfloat> data(side * side * 5);
+				float values[8];
+				for (int i = 0; i < side * side; ++i)
+				{
+					GridVertex(i % side, i / side, values);
+					data[i * 2 + 0] = values[0];
+					data[i * 2 + 1] = values[1];
+					data[side * side * 2 + i * 3 + 0] = values[2];
+					data[side * side * 2 + i * 3 + 1] = values[3];
+					data[side * side * 2 + i * 3 + 2] = values[4];
+				}
+				glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(GLfloat), &data[0], GL_STATIC_DRAW);
+				vertex::SetAttributePointer(0, 2, GL_FLOAT, false, 0, 0);
+				vertex::SetAttributePointer(1, 3, GL_FLOAT, false, 0, side * side * 2 * sizeof(GLfloat));
+				MeasureLayout(options, target, writer, "separate_float", 5 * sizeof(GLfloat), side * side, index_count);
+			}
+			else if (layout == 1)
+				MeasureInterleavedLayout<InterleavedFloatFormat>(options, target, writer, "interleaved_float", index_count);
+			else if (layout == 2)
+				MeasureInterleavedLayout<PackedFormat>(options, target, writer, "packed_half_unorm8", index_count);
+			else
+				MeasureInterleavedLayout<PackedNormalFormat>(options, target, writer, "packed_half_unorm8_normal_2_10_10_10", index_count);
+			glBindVertexArray(0);
+			glDeleteVertexArrays(1, &vao);
+			glDeleteBuffers(2, buffers);
+		}
+		writer.EndArray();
+		glUseProgram(0);
+		shader_program.Destroy();
+		return EXIT_SUCCESS;
+	}
+	// The number of objects the command queue scenario records and draws every frame.
+	const int COMMAND_OBJECT_COUNT = 50000;
+	// SceneObject is what the command queue scenario traverses: a quad at (x, y) with the given
+	// radius and depth, drawn with one of the scenario's programs and VAOs.
+	struct SceneObject
+	{
+		float x;
+		float y;
+		float radius;
+		float depth;
+		unsigned int program;
+		unsigned int vao;
+	};
+	// Records the visible objects in [begin, end) into buffer. The visibility test against the
+	// clip space square stands in for the traversal and culling work of a real scene.
+	void RecordObjects(const std::vector<SceneObject> &objects, const GLuint programs[], const GLuint vaos[],
+		size_t begin, size_t end, render::CommandBuffer &buffer)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			const SceneObject &object = objects[i];
+			if (object.x + object.radius < -1.0f || object.x - object.radius > 1.0f
+				|| object.y + object.radius < -1.0f || object.y - object.radius > 1.0f)
+				continue;
+			buffer.Draw(programs[object.program], vaos[object.vao], 0, object.depth, GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+		}
+	}
+	// Records 50k objects per frame into per-thread render::CommandBuffers with 0 (the render thread
+	// alone) to one worker per hardware thread, then sorts and submits them on the render thread.
+	// Reports the recording, sorting and submission times of each step.
+	int RunCommandQueueScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		const int PROGRAM_COUNT = 4;
+		const int VAO_COUNT = 8;
+		// Separate programs from the same sources, so the queue has real program changes to sort.
+		shader::ShaderProgram shader_programs[PROGRAM_COUNT];
+		GLuint programs[PROGRAM_COUNT];
+		bool all_linked = true;
+		for (int i = 0; i < PROGRAM_COUNT; ++i)
+		{
+			shader_programs[i].CreateFromFiles("shader.vert", "shader.frag");
+			programs[i] = shader_programs[i].GetOpenGLID();
+			all_linked = shader_programs[i].IsLinked() && all_linked;
+		}
+		// Throughput measured with programs that did not link means nothing.
+		writer.Value("all_linked", all_linked);
+		if (!all_linked)
+		{
+			for (int i = 0; i < PROGRAM_COUNT; ++i)
+				shader_programs[i].Destroy();
+			return EXIT_FAILURE;
+		}
+		// The instance attributes are constant: every object is a small quad in the centre.
+		glVertexAttrib4f(program::INSTANCE_TRANSFORM, 0.0f, 0.0f, 0.02f, 0.02f);
+		glVertexAttrib4f(program::INSTANCE_COLOUR, 1.0f, 1.0f, 1.0f, 1.0f);
+		GLuint vaos[VAO_COUNT];
+		GLuint buffers[VAO_COUNT * 2];
+		glGenVertexArrays(VAO_COUNT, vaos);
+		glGenBuffers(VAO_COUNT * 2, buffers);
+		const float corners[4][2] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+		const GLushort indices[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int i = 0; i < VAO_COUNT; ++i)
+		{
+			PackedFormat::Vertex vertices[4];
+			for (int corner = 0; corner < 4; ++corner)
+			{
+				vertices[corner].Set<0>(vertex::ToHalf(corners[corner][0]), vertex::ToHalf(corners[corner][1]));
+				vertices[corner].Set<1>(255, static_cast<GLubyte>(i * 32), 255, 255);
+			}
+			glBindVertexArray(vaos[i]);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[i * 2]);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[i * 2 + 1]);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+			PackedFormat::Apply();
+		}
+		glBindVertexArray(0);
+		// The setup above bound objects behind the state cache's back.
+		render::StateCache &state = render::GetStateCache();
+		state.Invalidate();
+		// About a fifth of the objects lie outside the screen and are culled while recording.
+		std::vector<SceneObject> objects(COMMAND_OBJECT_COUNT);
+		unsigned int random_state = 1;
+		for (size_t i = 0; i < objects.size(); ++i)
+		{
+			objects[i].x = NextRandom(random_state) * 2.2f - 1.1f;
+			objects[i].y = NextRandom(random_state) * 2.2f - 1.1f;
+			objects[i].radius = 0.02f;
+			objects[i].depth = NextRandom(random_state);
+			objects[i].program = static_cast<unsigned int>(NextRandom(random_state) * PROGRAM_COUNT) % PROGRAM_COUNT;
+			objects[i].vao = static_cast<unsigned int>(NextRandom(random_state) * VAO_COUNT) % VAO_COUNT;
+		}
+		Options step_options = options;
+		step_options.frames = std::min(options.frames, 100);
+		step_options.warmup_frames = std::min(options.warmup_frames, 10);
+		const unsigned int hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+		writer.BeginArray("steps");
+		for (unsigned int thread_count = 0; thread_count <= hardware_threads; ++thread_count)
+		{
+			jobs::ThreadPool pool;
+			if (thread_count > 0)
+				pool.Create(thread_count);
+			render::CommandQueue queue;
+			queue.Create(std::max(1u, thread_count));
+			for (size_t i = 0; i < queue.GetBufferCount(); ++i)
+				queue.GetBuffer(i).Reserve(objects.size() / queue.GetBufferCount() + 1);
+			std::vector<double> record_ms;
+			std::vector<double> sort_ms;
+			std::vector<double> submit_ms;
+			FrameSamples samples;
+			RunFrames(step_options, target, [&]() {
+				glClear(GL_COLOR_BUFFER_BIT);
+				const Clock::time_point begin = Clock::now();
+				pool.ParallelFor(objects.size(), [&](size_t range, size_t range_begin, size_t range_end) {
+					RecordObjects(objects, programs, vaos, range_begin, range_end, queue.GetBuffer(range));
+				});
+				const Clock::time_point recorded = Clock::now();
+				queue.Sort();
+				const Clock::time_point sorted = Clock::now();
+				queue.Submit();
+				state.EndFrame();
+				const Clock::time_point submitted = Clock::now();
+				record_ms.push_back(Milliseconds(begin, recorded));
+				sort_ms.push_back(Milliseconds(recorded, sorted));
+				submit_ms.push_back(Milliseconds(sorted, submitted));
+			}, samples);
+			// Drop the warm-up frames, RunFrames only leaves them out of samples.
+			record_ms.erase(record_ms.begin(), record_ms.begin() + step_options.warmup_frames);
+			sort_ms.erase(sort_ms.begin(), sort_ms.begin() + step_options.warmup_frames);
+			submit_ms.erase(submit_ms.begin(), submit_ms.begin() + step_options.warmup_frames);
+			const render::SubmitStatistics &statistics = queue.GetStatistics();
+			writer.BeginObject();
+			writer.Value("threads", static_cast<int>(thread_count));
+			writer.Value("draws_per_frame", static_cast<long long>(statistics.draw_count));
+			writer.Value("program_changes_per_frame", static_cast<long long>(statistics.program_changes));
+			writer.Value("vao_changes_per_frame", static_cast<long long>(statistics.vao_changes));
+			writer.Value("state_calls_issued_per_frame", static_cast<long long>(state.GetFrameStatistics().issued));
+			writer.Value("state_calls_skipped_per_frame", static_cast<long long>(state.GetFrameStatistics().redundant));
+			writer.Value("steals", static_cast<long long>(pool.GetStealCount()));
+			writer.Value("record_ms", Summarize(record_ms));
+			writer.Value("sort_ms", Summarize(sort_ms));
+			writer.Value("submit_ms", Summarize(submit_ms));
+			writer.Value("cpu_ms", Summarize(samples.cpu));
+			writer.Value("gpu_ms", Summarize(samples.gpu));
+			writer.Value("frame_ms", Summarize(samples.frame));
+			writer.EndObject();
+			queue.Destroy();
+			pool.Destroy();
+		}
+		writer.EndArray();
+		state.UseProgram(0);
+		state.BindVertexArray(0);
+		state.DeleteVertexArrays(VAO_COUNT, vaos);
+		state.DeleteBuffers(VAO_COUNT * 2, buffers);
+		for (int i = 0; i < PROGRAM_COUNT; ++i)
+			shader_programs[i].Destroy();
+		return EXIT_SUCCESS;
+	}
+	// Writes a column-major perspective projection (like gluPerspective) to matrix. fov_y is in radians.
+	void Perspective(float fov_y, float aspect, float near_plane, float far_plane, float matrix[16])
+	{
+		const float focal_length = 1.0f / std::tan(fov_y / 2.0f);
+		for (int i = 0; i < 16; ++i)
+			matrix[i] = 0.0f;
+		matrix[0] = focal_length / aspect;
+		matrix[5] = focal_length;
+		matrix[10] = (far_plane + near_plane) / (near_plane - far_plane);
+		matrix[11] = -1.0f;
+		matrix[14] = 2.0f * far_plane * near_plane / (near_plane - far_plane);
+	}
+	// Culls 10k, 100k and 1M bounding spheres, spread through a box around a camera looking down -z,
+	// with every CPU path the processor supports and on the GPU. The CPU paths are timed over
+	// min(frames, 50) runs; the GPU paths through RunFrames, where gpu_ms is the culling pass itself.
+	// Drawing is left out: it costs the same whichever path culled. Fails if a SIMD path disagrees with
+	// the scalar one, or the GPU's visible count differs from it by more than 0.1%.
+	int RunCullingScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		float projection[16];
+		Perspective(1.0472f, static_cast<float>(options.width) / options.height, 0.1f, 1000.0f, projection);
+		const culling::Frustum frustum = culling::ExtractFrustum(projection);
+		const char *const CPU_PATH_NAMES[] = { "cpu_scalar", "cpu_sse", "cpu_avx" };
+		const char *const GPU_PATH_NAMES[] = { "none", "gpu_compute", "gpu_transform_feedback" };
+		Options step_options = options;
+		step_options.frames = std::min(options.frames, 50);
+		step_options.warmup_frames = std::min(options.warmup_frames, 5);
+		bool passed = true;
+		writer.BeginArray("steps");
+		for (size_t object_count = 10000; object_count <= 1000000; object_count *= 10)
+		{
+			std::vector<culling::Sphere> spheres(object_count);
+			unsigned int random_state = 1;
+			for (size_t i = 0; i < object_count; ++i)
+			{
+				spheres[i].x = NextRandom(random_state) * 1000.0f - 500.0f;
+				spheres[i].y = NextRandom(random_state) * 1000.0f - 500.0f;
+				spheres[i].z = NextRandom(random_state) * -1000.0f;
+				spheres[i].radius = 0.5f + NextRandom(random_state) * 1.5f;
+			}
+			std::vector<unsigned int> reference(object_count);
+			reference.resize(culling::CullSpheres(culling::CPU_SCALAR, frustum, &spheres[0], object_count, &reference[0]));
+			std::vector<unsigned int> visible(object_count);
+			for (int path = culling::CPU_SCALAR; path <= culling::CPU_AVX; ++path)
+			{
+				if (!culling::IsSupported(static_cast<culling::CpuPath>(path)))
+					continue;
+				std::vector<double> cull_ms;
+				size_t visible_count = 0;
+				for (int i = 0; i < step_options.frames; ++i)
+				{
+					const Clock::time_point begin = Clock::now();
+					visible_count = culling::CullSpheres(static_cast<culling::CpuPath>(path), frustum, &spheres[0], object_count, &visible[0]);
+					cull_ms.push_back(Milliseconds(begin, Clock::now()));
+				}
+				const bool matches = visible_count == reference.size() && std::equal(reference.begin(), reference.end(), visible.begin());
+				passed = passed && matches;
+				writer.BeginObject();
+				writer.Value("objects", static_cast<long long>(object_count));
+				writer.Value("path", std::string(CPU_PATH_NAMES[path]));
+				writer.Value("visible", static_cast<long long>(visible_count));
+				writer.Value("matches_scalar", matches);
+				writer.Value("cull_ms", Summarize(cull_ms));
+				writer.EndObject();
+			}
+			for (int path = culling::GPU_COMPUTE; path <= culling::GPU_TRANSFORM_FEEDBACK; ++path)
+			{
+				culling::GpuCuller culler;
+				// Without compute shaders both requests get the transform feedback path; measure it once.
+				if (!culler.Create(object_count, static_cast<culling::GpuPath>(path)) || culler.GetPath() != path)
+				{
+					culler.Destroy();
+					continue;
+				}
+				culler.SetSpheres(&spheres[0], object_count);
+				FrameSamples samples;
+				RunFrames(step_options, target, [&]() { culler.Cull(frustum, 6); }, samples);
+				const size_t visible_count = culler.CountVisible();
+				// The GPU may evaluate the distances with fused multiply-adds, which moves spheres that
+				// touch a plane to the other side.
+				const size_t difference = visible_count > reference.size() ? visible_count - reference.size() : reference.size() - visible_count;
+				const bool matches = difference <= object_count / 1000;
+				passed = passed && matches;
+				writer.BeginObject();
+				writer.Value("objects", static_cast<long long>(object_count));
+				writer.Value("path", std::string(GPU_PATH_NAMES[path]));
+				writer.Value("visible", static_cast<long long>(visible_count));
+				writer.Value("matches_scalar", matches);
+				writer.Value("cpu_ms", Summarize(samples.cpu));
+				writer.Value("gpu_ms", Summarize(samples.gpu));
+				writer.EndObject();
+				culler.Destroy();
+			}
+		}
+		writer.EndArray();
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// Writes a grid of side x side vertices as an OBJ file: positions, texture coordinates, one shared
+	// normal and a quad per cell, about 100 bytes per vertex.
+	bool WriteGridObj(const char *file_name, int side)
+	{
+		FILE *file = std::fopen(file_name, "w");
+		if (0 == file)
+			return false;
+		for (int row = 0; row < side; ++row)
+		{
+			for (int column = 0; column < side; ++column)
+				std::fprintf(file, "v %.6f %.6f %.6f\n", column * 0.01f, row * 0.01f, std::sin(column * 0.1f) * std::cos(row * 0.1f));
+		}
+		for (int row = 0; row < side; ++row)
+		{
+			for (int column = 0; column < side; ++column)
+				std::fprintf(file, "vt %.6f %.6f\n", static_cast<float>(column) / side, static_cast<float>(row) / side);
+		}
+		std::fprintf(file, "vn 0 0 1\n");
+		for (int row = 0; row + 1 < side; ++row)
+		{
+			for (int column = 0; column + 1 < side; ++column)
+			{
+				const int corner = row * side + column + 1;
+				std::fprintf(file, "f %d/%d/1 %d/%d/1 %d/%d/1 %d/%d/1\n", corner, corner, corner + 1, corner + 1,
+					corner + side + 1, corner + side + 1, corner + side, corner + side);
+			}
+		}
+		return 0 == std::fclose(file);
+	}
+	// Compares loading a scene from OBJ text (parse, then upload) with loading the converted mesh file
+	// (map, then upload straight from the mapping). The scene is a grid of about --scene-size megabytes
+	// of OBJ text, 64 by default; pass 1024 for a 1 GB scene. Each load runs min(frames, 5) times and
+	// ends with glFinish, so the upload is included. The OS file cache is warm after the first run;
+	// cold loads need the cache dropped between runs, which only an administrator can do.
+	int RunMeshLoadScenario(const Options &options, offscreen::RenderTarget *, JsonWriter &writer)
+	{
+		const char *const OBJ_FILE_NAME = "benchmark_scene.obj";
+		const char *const MESH_FILE_NAME = "benchmark_scene.mesh";
+		const int side = std::max(2, static_cast<int>(std::sqrt(options.scene_megabytes * 1000000.0 / 100.0)));
+		if (!WriteGridObj(OBJ_FILE_NAME, side))
+		{
+			std::cerr << "File " << OBJ_FILE_NAME << " could not be written." << std::endl;
+			return EXIT_FAILURE;
+		}
+		Clock::time_point begin = Clock::now();
+		const bool converted = mesh::ConvertObj(OBJ_FILE_NAME, MESH_FILE_NAME);
+		const double convert_ms = Milliseconds(begin, Clock::now());
+		if (!converted)
+		{
+			std::remove(OBJ_FILE_NAME);
+			return EXIT_FAILURE;
+		}
+		const int runs = std::max(1, std::min(options.frames, 5));
+		std::vector<double> text_ms;
+		std::vector<double> binary_ms;
+		GLsizei text_index_count = 0;
+		GLsizei binary_index_count = 0;
+		for (int i = 0; i < runs; ++i)
+		{
+			begin = Clock::now();
+			{
+				mesh::MeshData data;
+				mesh::Mesh loaded;
+				if (mesh::LoadObj(OBJ_FILE_NAME, data))
+					mesh::UploadMeshData(data, loaded);
+				glFinish();
+				text_ms.push_back(Milliseconds(begin, Clock::now()));
+				text_index_count = loaded.index_count;
+				mesh::DestroyMesh(loaded);
+			}
+			begin = Clock::now();
+			{
+				mesh::MeshFile file;
+				mesh::Mesh loaded;
+				if (file.Open(MESH_FILE_NAME))
+					file.Upload(loaded);
+				glFinish();
+				binary_ms.push_back(Milliseconds(begin, Clock::now()));
+				binary_index_count = loaded.index_count;
+				mesh::DestroyMesh(loaded);
+			}
+		}
+		std::ifstream obj_file(OBJ_FILE_NAME, std::ios::in | std::ios::binary | std::ios::ate);
+		std::ifstream mesh_file(MESH_FILE_NAME, std::ios::in | std::ios::binary | std::ios::ate);
+		const long long obj_bytes = static_cast<long long>(obj_file.tellg());
+		const long long mesh_bytes = static_cast<long long>(mesh_file.tellg());
+		obj_file.close();
+		mesh_file.close();
+		std::remove(OBJ_FILE_NAME);
+		std::remove(MESH_FILE_NAME);
+		const Statistics text = Summarize(text_ms);
+		const Statistics binary = Summarize(binary_ms);
+		writer.Value("vertices", static_cast<long long>(side) * side);
+		writer.Value("triangles", static_cast<long long>(binary_index_count / 3));
+		writer.Value("obj_bytes", obj_bytes);
+		writer.Value("mesh_bytes", mesh_bytes);
+		writer.Value("convert_ms", convert_ms);
+		writer.Value("obj_load_ms", text);
+		writer.Value("mesh_load_ms", binary);
+		writer.Value("obj_megabytes_per_second", text.mean > 0.0 ? obj_bytes / (text.mean * 1000.0) : 0.0);
+		writer.Value("mesh_megabytes_per_second", binary.mean > 0.0 ? mesh_bytes / (binary.mean * 1000.0) : 0.0);
+		writer.Value("speedup", binary.mean > 0.0 ? text.mean / binary.mean : 0.0);
+		return (text_index_count == binary_index_count && binary_index_count > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// Writes count copies of a mesh file of a side x side grid, called prefix_0.mesh and up, and puts
+	// their names in file_names. Removes what it wrote if any file fails.
+	bool WriteGridMeshes(const std::string &prefix, int count, int side, std::vector<std::string> &file_names)
+	{
+		const std::string obj_file_name = prefix + ".obj";
+		file_names.clear();
+		for (int i = 0; i < count; ++i)
+			file_names.push_back(prefix + "_" + std::to_string(static_cast<long long>(i)) + ".mesh");
+		bool written = WriteGridObj(obj_file_name.c_str(), side) && mesh::ConvertObj(obj_file_name.c_str(), file_names[0].c_str());
+		for (int i = 1; i < count && written; ++i)
+		{
+			std::ifstream source(file_names[0].c_str(), std::ios::in | std::ios::binary);
+			std::ofstream copy(file_names[i].c_str(), std::ios::out | std::ios::binary);
+			copy << source.rdbuf();
+			written = static_cast<bool>(copy);
+		}
+		std::remove(obj_file_name.c_str());
+		if (!written)
+		{
+			for (size_t i = 0; i < file_names.size(); ++i)
+				std::remove(file_names[i].c_str());
+		}
+		return written;
+	}
+	// Streams ASSET_COUNT mesh files of about 7 MB each, more than the upload budget, while
+	// program::Program renders, once with the budget and once without, and compares the frame times
+	// with rendering alone. Every frame time statistic covers at least MIN_FRAMES frames, so the p99
+	// is not simply the slowest frame. Fails if a budgeted frame (p99) is more than SPIKE_TARGET_MS
+	// slower than the baseline, if the budgeted run uploads more than the budget in a frame or the
+	// unbudgeted run never does, or if an asset never became resident.
+	int RunStreamingScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		const int ASSET_COUNT = 12;
+		const GLsizeiptr UPLOAD_BUDGET = 4 * 1024 * 1024;
+		const double SPIKE_TARGET_MS = 2.0;
+		const int MIN_FRAMES = 200;
+		// A grid vertex takes 20 bytes and its two triangles 24 bytes of indices: 3.2 MB of vertices
+		// and 3.8 MB of indices. Each store fits in the budget, so the budgeted run never has to create
+		// one in a frame of its own, while without a budget a whole asset, more than the budget, is
+		// uploaded in one frame.
+		const int SIDE = 400;
+		std::vector<std::string> file_names;
+		if (!WriteGridMeshes("benchmark_streaming", ASSET_COUNT, SIDE, file_names))
+		{
+			std::cerr << "The streaming scene could not be written." << std::endl;
+			return EXIT_FAILURE;
+		}
+		long long asset_bytes = 0;
+		{
+			mesh::MeshFile file;
+			if (file.Open(file_names[0]))
+				asset_bytes = static_cast<long long>(file.GetHeader().file_size);
+		}
+		program::Program program;
+		program.Init();
+		FrameSamples baseline;
+		Options baseline_options = options;
+		baseline_options.frames = std::max(options.frames, MIN_FRAMES);
+		RunFrames(baseline_options, target, [&program]() { program.Render(); }, baseline);
+		const Statistics baseline_frame = Summarize(baseline.frame);
+		writer.Value("assets", ASSET_COUNT);
+		writer.Value("asset_bytes", asset_bytes);
+		writer.Value("upload_budget_bytes", static_cast<long long>(UPLOAD_BUDGET));
+		writer.Value("spike_target_ms", SPIKE_TARGET_MS);
+		writer.Value("min_frames", MIN_FRAMES);
+		writer.Value("baseline_frame_ms", baseline_frame);
+		jobs::ThreadPool pool;
+		pool.Create();
+		bool passed = true;
+		const GLsizeiptr budgets[] = { UPLOAD_BUDGET, 0 };
+		writer.BeginArray("runs");
+		for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); ++b)
+		{
+			streaming::Streamer streamer;
+			streamer.Create(&pool, budgets[b]);
+			// Visible assets alternate with invisible ones, so the priorities actually reorder them.
+			for (int i = 0; i < ASSET_COUNT; ++i)
+				streamer.Request(file_names[i], static_cast<float>(ASSET_COUNT - i), 0 == i % 2);
+			// Enough frames to upload everything within the budget, plus some for the disk.
+			Options run_options = options;
+			run_options.warmup_frames = 0;
+			run_options.frames = 60;
+			if (budgets[b] > 0)
+				run_options.frames += static_cast<int>(asset_bytes * ASSET_COUNT / budgets[b]);
+			run_options.frames = std::max(run_options.frames, MIN_FRAMES);
+			GLsizeiptr max_uploaded = 0;
+			int frames_until_resident = -1;
+			int frame = 0;
+			FrameSamples samples;
+			RunFrames(run_options, target, [&]()
+			{
+				program.Render();
+				streamer.Update();
+				max_uploaded = std::max(max_uploaded, streamer.GetUploadedBytes());
+				++frame;
+				if (frames_until_resident < 0 && 0 == streamer.GetPendingCount())
+					frames_until_resident = frame;
+			}, samples);
+			int resident = 0;
+			for (int i = 0; i < ASSET_COUNT; ++i)
+				resident += streaming::ASSET_RESIDENT == streamer.GetState(static_cast<streaming::AssetId>(i)) ? 1 : 0;
+			streamer.Destroy();
+			const Statistics frame_ms = Summarize(samples.frame);
+			const bool within_target = frame_ms.p99 <= baseline_frame.p99 + SPIKE_TARGET_MS;
+			// The budget must be what keeps the uploads down: without it a frame uploads more.
+			const bool uploads_as_expected = budgets[b] > 0 ? max_uploaded <= budgets[b] : max_uploaded > UPLOAD_BUDGET;
+			if (resident != ASSET_COUNT || !uploads_as_expected || (budgets[b] > 0 && !within_target))
+				passed = false;
+			writer.BeginObject();
+			writer.Value("upload_budget_bytes", static_cast<long long>(budgets[b]));
+			writer.Value("resident_assets", resident);
+			writer.Value("frames_until_resident", frames_until_resident);
+			writer.Value("max_uploaded_bytes_per_frame", static_cast<long long>(max_uploaded));
+			writer.Value("frame_ms", frame_ms);
+			writer.Value("within_spike_target", within_target);
+			writer.Value("uploads_as_expected", uploads_as_expected);
+			writer.EndObject();
+		}
+		writer.EndArray();
+		pool.Destroy();
+		program.Destroy();
+		for (size_t i = 0; i < file_names.size(); ++i)
+			std::remove(file_names[i].c_str());
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// Counts the heap allocations of program::Program::Render once the warm-up frames are over and
+	// fails unless there are none, and does the same for an ErrorHandler flooded with errors. Also
+	// compares the frame arena and an ObjectPool with the heap.
+	int RunAllocationsScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		const int SCRATCH_ALLOCATIONS = 100000;
+		const size_t SCRATCH_SIZE = 64;
+		program::Program program;
+		program.Init();
+		unsigned long long render_allocations = 0;
+		int frame = 0;
+		FrameSamples samples;
+		RunFrames(options, target, [&]()
+		{
+			const unsigned long long before = memory::GetThreadAllocationCount();
+			program.Render();
+			if (frame++ >= options.warmup_frames)
+				render_allocations += memory::GetThreadAllocationCount() - before;
+		}, samples);
+		program.Destroy();
+		// Errors as the render thread reports them: far more than the error ring holds, with a second
+		// handler created and destroyed first. Recording must neither allocate nor wait for the writer,
+		// and the first handler must keep receiving debug messages after the second is gone.
+		const int ERROR_REPORTS = 4096;
+		error::ErrorHandler error_handler;
+		error_handler.Create();
+		error::ErrorHandler nested_error_handler;
+		nested_error_handler.Create();
+		nested_error_handler.Destroy();
+		const bool debug_output = error_handler.HasDebugOutput();
+		const unsigned long long error_allocations_before = memory::GetThreadAllocationCount();
+		double slowest_report_ms = 0.0;
+		for (int i = 0; i < ERROR_REPORTS; ++i)
+		{
+			const Clock::time_point report_begin = Clock::now();
+			if (debug_output)
+			{
+				// >> glDebugMessageInsert inserts a user-supplied message into the debug output queue.
+				glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_TYPE_OTHER, i, GL_DEBUG_SEVERITY_LOW, -1,
+					"Allocations Scenario: an application message long enough that the error handler has to cut it off "
+					"before it fits into the fixed-size message array of an error record.");
+			}
+			else
+			{
+				// 0 is not a capability, so this records GL_INVALID_ENUM.
+				glEnable(0);
+				error_handler.Check(false, "Allocations Scenario: ");
+			}
+			slowest_report_ms = std::max(slowest_report_ms, Milliseconds(report_begin, Clock::now()));
+		}
+		const unsigned long long error_allocations = memory::GetThreadAllocationCount() - error_allocations_before;
+		const unsigned long long errors_recorded = error_handler.GetErrorCount();
+		const unsigned long long errors_dropped = error_handler.GetDroppedCount();
+		error_handler.Destroy();
+		// Scratch allocations as a frame makes them: many small blocks, all freed at the end.
+		std::vector<void*> blocks(SCRATCH_ALLOCATIONS);
+		Clock::time_point begin = Clock::now();
+		for (int i = 0; i < SCRATCH_ALLOCATIONS; ++i)
+			blocks[i] = std::malloc(SCRATCH_SIZE);
+		for (int i = 0; i < SCRATCH_ALLOCATIONS; ++i)
+			std::free(blocks[i]);
+		const double heap_ms = Milliseconds(begin, Clock::now());
+		memory::Arena arena;
+		arena.Create(SCRATCH_ALLOCATIONS * SCRATCH_SIZE);
+		begin = Clock::now();
+		for (int i = 0; i < SCRATCH_ALLOCATIONS; ++i)
+			blocks[i] = arena.Allocate(SCRATCH_SIZE);
+		arena.Reset();
+		const double arena_ms = Milliseconds(begin, Clock::now());
+		arena.Destroy();
+		// Long-lived wrappers: created and deleted in an interleaved order, once warm.
+		struct Wrapper
+		{
+			GLuint name;
+			unsigned char payload[60];
+		};
+		std::vector<Wrapper*> wrappers(SCRATCH_ALLOCATIONS);
+		begin = Clock::now();
+		for (int i = 0; i < SCRATCH_ALLOCATIONS; ++i)
+			wrappers[i] = new Wrapper();
+		for (int i = 0; i < SCRATCH_ALLOCATIONS; i += 2)
+			delete wrappers[i];
+		for (int i = 1; i < SCRATCH_ALLOCATIONS; i += 2)
+			delete wrappers[i];
+		const double new_ms = Milliseconds(begin, Clock::now());
+		memory::ObjectPool<Wrapper> pool(1024);
+		begin = Clock::now();
+		for (int i = 0; i < SCRATCH_ALLOCATIONS; ++i)
+			wrappers[i] = pool.New();
+		for (int i = 0; i < SCRATCH_ALLOCATIONS; i += 2)
+			pool.Delete(wrappers[i]);
+		for (int i = 1; i < SCRATCH_ALLOCATIONS; i += 2)
+			pool.Delete(wrappers[i]);
+		const double pool_ms = Milliseconds(begin, Clock::now());
+		pool.Destroy();
+		const memory::Arena &frame_arena = memory::GetFrameArena();
+		// Without the counting build option every count is 0, so the allocation checks cannot fail.
+		if (!memory::COUNTS_ALLOCATIONS)
+			std::cerr << "Allocations Scenario: built without OPENGL_GLFW_COUNT_ALLOCATIONS, so allocations are not counted." << std::endl;
+		writer.Value("allocations_counted", memory::COUNTS_ALLOCATIONS);
+		writer.Value("render_allocations", static_cast<long long>(render_allocations));
+		writer.Value("render_allocations_per_frame", options.frames > 0 ? static_cast<double>(render_allocations) / options.frames : 0.0);
+		writer.Value("frame_arena_capacity_bytes", static_cast<long long>(frame_arena.GetCapacity()));
+		writer.Value("frame_arena_peak_bytes", static_cast<long long>(frame_arena.GetPeak()));
+		writer.Value("frame_arena_overflows", static_cast<long long>(frame_arena.GetOverflowCount()));
+		writer.Value("error_reports", ERROR_REPORTS);
+		writer.Value("error_debug_output", debug_output);
+		writer.Value("errors_recorded", static_cast<long long>(errors_recorded));
+		writer.Value("errors_dropped", static_cast<long long>(errors_dropped));
+		writer.Value("error_allocations", static_cast<long long>(error_allocations));
+		writer.Value("slowest_error_report_ms", slowest_report_ms);
+		writer.Value("scratch_allocations", SCRATCH_ALLOCATIONS);
+		writer.Value("heap_scratch_ms", heap_ms);
+		writer.Value("arena_scratch_ms", arena_ms);
+		writer.Value("new_delete_ms", new_ms);
+		writer.Value("object_pool_ms", pool_ms);
+		WriteFrameSamples(writer, samples);
+		if (render_allocations > 0)
+			std::cerr << "Program::Render allocated " << render_allocations << " times in " << options.frames << " frames." << std::endl;
+		if (error_allocations > 0)
+			std::cerr << "ErrorHandler allocated " << error_allocations << " times for " << ERROR_REPORTS << " errors." << std::endl;
+		// Every report reached the handler, whether it was written or dropped because the ring was full.
+		const bool errors_received = errors_recorded >= static_cast<unsigned long long>(ERROR_REPORTS);
+		if (!errors_received)
+			std::cerr << "ErrorHandler received " << errors_recorded << " of " << ERROR_REPORTS << " errors." << std::endl;
+		return 0 == render_allocations && 0 == error_allocations && errors_received ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// ObjectUniforms is the Object block of object.vert.
+	struct ObjectUniforms
+	{
+		uniform::Mat4 transform;
+		uniform::Vec4 colour;
+	};
+	typedef uniform::Block<uniform::STD140, uniform::Member<uniform::Mat4>, uniform::Member<uniform::Vec4> > ObjectBlock;
+	UNIFORM_CHECK_OFFSET(ObjectUniforms, transform, ObjectBlock, 0);
+	UNIFORM_CHECK_OFFSET(ObjectUniforms, colour, ObjectBlock, 1);
+	UNIFORM_CHECK_SIZE(ObjectUniforms, ObjectBlock);
+	// The uniform block binding point object.vert's Object block is connected to.
+	const GLuint OBJECT_BINDING = 0;
+	// Draws 10k quads, each with its own transform and colour, once with two glUniform* calls per
+	// draw and once from a uniform::UniformArena uploaded once per frame and bound per draw with
+	// glBindBufferRange through a render::CommandQueue. Headless runs also check both give the same image.
+	int RunUniformsScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		const int OBJECT_COUNT = 10000;
+		render::StateCache &state = render::GetStateCache();
+		shader::ShaderProgram default_block_program;
+		default_block_program.CreateFromFiles("object_uniforms.vert", "shader.frag");
+		shader::ShaderProgram uniform_block_program;
+		uniform_block_program.CreateFromFiles("object.vert", "shader.frag");
+		uniform_block_program.BindUniformBlock("Object", OBJECT_BINDING);
+		const bool all_linked = default_block_program.IsLinked() && uniform_block_program.IsLinked();
+		const GLuint default_block_id = default_block_program.GetOpenGLID();
+		const GLuint uniform_block_id = uniform_block_program.GetOpenGLID();
+		const GLint transform_location = glGetUniformLocation(default_block_id, "transform");
+		const GLint colour_location = glGetUniformLocation(default_block_id, "colour");
+		// A unit quad; the colour attribute is a constant white.
+		const GLfloat positions[] = { -1.0f, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f };
+		const GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
+		GLuint vao;
+		GLuint buffers[2];
+		glGenVertexArrays(1, &vao);
+		state.BindVertexArray(vao);
+		glGenBuffers(2, buffers);
+		state.BindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
+		state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+		vertex::SetAttributePointer(0, 2, GL_FLOAT, false, 0, 0);
+		glVertexAttrib4f(1, 1.0f, 1.0f, 1.0f, 1.0f);
+		std::vector<ObjectUniforms> objects(OBJECT_COUNT);
+		unsigned int random = 7;
+		for (int i = 0; i < OBJECT_COUNT; ++i)
+		{
+			const float scale = 0.005f + 0.02f * NextRandom(random);
+			objects[i].transform = uniform::Identity();
+			objects[i].transform.columns[0].v[0] = scale;
+			objects[i].transform.columns[1].v[1] = scale;
+			objects[i].transform.columns[3].v[0] = NextRandom(random) * 2.0f - 1.0f;
+			objects[i].transform.columns[3].v[1] = NextRandom(random) * 2.0f - 1.0f;
+			for (int component = 0; component < 4; ++component)
+				objects[i].colour.v[component] = component == 3 ? 1.0f : NextRandom(random);
+		}
+		std::vector<unsigned char> default_block_image;
+		std::vector<unsigned char> uniform_block_image;
+		// glUniform*: every draw sets its values, which the driver copies into its own buffers.
+		FrameSamples default_block_samples;
+		RunFrames(options, target, [&]()
+		{
+			glClear(GL_COLOR_BUFFER_BIT);
+			state.UseProgram(default_block_id);
+			state.BindVertexArray(vao);
+			for (int i = 0; i < OBJECT_COUNT; ++i)
+			{
+				glUniformMatrix4fv(transform_location, 1, GL_FALSE, objects[i].transform.columns[0].v);
+				glUniform4fv(colour_location, 1, objects[i].colour.v);
+				glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+			}
+		}, default_block_samples);
+		if (0 != target)
+			target->ReadPixels(default_block_image);
+		// Uniform arena: every block is written into one mapping, uploaded with one flush, and each
+		// draw binds its range.
+		uniform::UniformArena arena;
+		// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT is at most 256, so every block fits in 256 bytes.
+		arena.Create(OBJECT_COUNT * 256);
+		render::CommandQueue queue;
+		queue.Create(1);
+		queue.SetUniformBuffer(arena.GetRingBuffer().GetOpenGLID(), OBJECT_BINDING);
+		FrameSamples uniform_block_samples;
+		RunFrames(options, target, [&]()
+		{
+			glClear(GL_COLOR_BUFFER_BIT);
+			arena.Begin();
+			render::CommandBuffer &commands = queue.GetBuffer(0);
+			for (int i = 0; i < OBJECT_COUNT; ++i)
+			{
+				const uniform::Range range = arena.Push(objects[i]);
+				// The depth keeps the recorded order, so the image matches the glUniform* one.
+				commands.Draw(uniform_block_id, vao, 0, static_cast<float>(i) / OBJECT_COUNT, GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, 1,
+					range.offset, range.size);
+			}
+			arena.Flush();
+			queue.Sort();
+			queue.Submit();
+			arena.EndFrame();
+			state.EndFrame();
+		}, uniform_block_samples);
+		const render::StateStatistics state_changes = state.GetFrameStatistics();
+		if (0 != target)
+			target->ReadPixels(uniform_block_image);
+		queue.Destroy();
+		arena.Destroy();
+		state.BindVertexArray(0);
+		state.DeleteVertexArrays(1, &vao);
+		state.DeleteBuffers(2, buffers);
+		state.UseProgram(0);
+		default_block_program.Destroy();
+		uniform_block_program.Destroy();
+		const bool images_match = default_block_image == uniform_block_image;
+		// Matching images prove nothing if neither drew anything over the black clear colour.
+		bool image_drawn = false;
+		for (size_t i = 0; i < default_block_image.size() && !image_drawn; i += 4)
+			image_drawn = 0 != default_block_image[i] || 0 != default_block_image[i + 1] || 0 != default_block_image[i + 2];
+		writer.Value("objects", OBJECT_COUNT);
+		writer.Value("all_linked", all_linked);
+		writer.Value("uniform_offset_alignment", arena.GetOffsetAlignment());
+		writer.Value("uniform_bytes_per_frame", static_cast<long long>(arena.GetUsed()));
+		writer.Value("uniform_arena_overflows", static_cast<long long>(arena.GetOverflowCount()));
+		writer.Value("images_compared", 0 != target);
+		writer.Value("images_match", images_match);
+		writer.Value("image_drawn", image_drawn);
+		writer.BeginObject("default_block");
+		writer.Value("uniform_calls_per_frame", static_cast<long long>(OBJECT_COUNT) * 2);
+		WriteFrameSamples(writer, default_block_samples);
+		writer.EndObject();
+		writer.BeginObject("uniform_block");
+		writer.Value("uploads_per_frame", 1);
+		writer.Value("state_calls_issued_per_frame", static_cast<long long>(state_changes.issued));
+		WriteFrameSamples(writer, uniform_block_samples);
+		writer.EndObject();
+		return (all_linked && images_match && (0 == target || image_drawn) && 0 == arena.GetOverflowCount()) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// Draws 200k round sprites, uploaded every frame, once as one point per sprite that shader.geom
+	// expands into a quad and once as four corners per sprite built on the CPU. Headless runs also
+	// check both give the same image, up to CHANNEL_TOLERANCE per channel: the geometry shader's
+	// outputs may be interpolated with slightly different rounding.
+	int RunSpritesScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		const int SPRITE_COUNT = 200000;
+		const int CHANNEL_TOLERANCE = 2;
+		struct SpriteValues
+		{
+			GLfloat x, y, half_width, half_height;
+			GLubyte colour[4];
+		};
+		std::vector<SpriteValues> sprites(SPRITE_COUNT);
+		unsigned int random_state = 1;
+		for (int i = 0; i < SPRITE_COUNT; ++i)
+		{
+			SpriteValues &values = sprites[i];
+			values.x = NextRandom(random_state) * 2.0f - 1.0f;
+			values.y = NextRandom(random_state) * 2.0f - 1.0f;
+			values.half_width = 0.002f + NextRandom(random_state) * 0.01f;
+			values.half_height = values.half_width;
+			values.colour[0] = static_cast<GLubyte>(NextRandom(random_state) * 255.0f);
+			values.colour[1] = static_cast<GLubyte>(NextRandom(random_state) * 255.0f);
+			values.colour[2] = 255;
+			values.colour[3] = 255;
+		}
+		const sprite::Expansion expansions[2] = { sprite::EXPAND_ON_GPU, sprite::EXPAND_ON_CPU };
+		const char *names[2] = { "expand_on_gpu", "expand_on_cpu" };
+		std::vector<unsigned char> images[2];
+		size_t bytes_per_sprite[2];
+		bool all_linked = true;
+		GLsizei dropped_sprites = 0;
+		writer.Value("sprites", SPRITE_COUNT);
+		writer.BeginArray("expansions");
+		for (int i = 0; i < 2; ++i)
+		{
+			sprite::SpriteBatch batch;
+			batch.Create(16384, expansions[i]);
+			all_linked = batch.GetShaderProgram().IsLinked() && all_linked;
+			FrameSamples samples;
+			RunFrames(options, target, [&]() {
+				glClear(GL_COLOR_BUFFER_BIT);
+				for (int index = 0; index < SPRITE_COUNT; ++index)
+				{
+					const SpriteValues &values = sprites[index];
+					batch.Add(values.x, values.y, values.half_width, values.half_height, values.colour[0], values.colour[1], values.colour[2], values.colour[3]);
+				}
+				batch.Flush();
+				batch.EndFrame();
+			}, samples);
+			if (0 != target)
+				target->ReadPixels(images[i]);
+			const int frames = options.frames + options.warmup_frames;
+			bytes_per_sprite[i] = batch.GetBytesPerSprite();
+			writer.BeginObject();
+			writer.Value("expansion", std::string(names[i]));
+			writer.Value("bytes_per_sprite", static_cast<int>(bytes_per_sprite[i]));
+			writer.Value("upload_megabytes_per_frame", batch.GetUploadedBytes() / (1024.0 * 1024.0) / frames);
+			writer.Value("draw_calls_per_frame", batch.GetDrawCallCount() / frames);
+			writer.Value("dropped_sprites", static_cast<int>(batch.GetDroppedCount()));
+			dropped_sprites += batch.GetDroppedCount();
+			WriteFrameSamples(writer, samples);
+			writer.EndObject();
+			batch.Destroy();
+		}
+		writer.EndArray();
+		bool images_match = images[0].size() == images[1].size();
+		int max_channel_difference = 0;
+		for (size_t byte = 0; images_match && byte < images[0].size(); ++byte)
+			max_channel_difference = std::max(max_channel_difference, std::abs(images[0][byte] - images[1][byte]));
+		images_match = images_match && max_channel_difference <= CHANNEL_TOLERANCE;
+		writer.Value("upload_reduction", static_cast<double>(bytes_per_sprite[1]) / bytes_per_sprite[0]);
+		writer.Value("all_linked", all_linked);
+		writer.Value("images_compared", 0 != target);
+		writer.Value("max_channel_difference", max_channel_difference);
+		writer.Value("images_match", images_match);
+		return (all_linked && images_match && 0 == dropped_sprites) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// Measures frame pacing and latency with the program's scene. First PRESENT_CAPPED at 120 fps,
+	// pacing by sleeping alone and by sleeping and spinning, reporting how far frame intervals stray
+	// from 8.33 ms. Then, uncapped with 100k quads per frame to load the GPU, the input-to-photon
+	// latency (input read at the start of every frame) with 1 and 2 frames in flight and with no limit.
+	int RunFramePacingScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		const double CAPPED_FPS = 120.0;
+		const int LOAD_QUADS = 100000;
+		const int frames = std::min(options.frames, 600);
+		program::Program program;
+		program.Init();
+		if (0 != target)
+			target->Bind();
+		program::Scene scene;
+		writer.BeginArray("pacing");
+		for (int spin = 0; spin < 2; ++spin)
+		{
+			frame::FramePacer pacer;
+			pacer.Create(frame::PRESENT_CAPPED, CAPPED_FPS, spin ? std::chrono::microseconds(2000) : Clock::duration(0));
+			if (0 == target)
+				glfwSwapInterval(pacer.GetSwapInterval());
+			std::vector<double> deviations;
+			Clock::time_point previous = Clock::now();
+			for (int i = 0; i < frames + options.warmup_frames; ++i)
+			{
+				program.Render(&scene);
+				pacer.Wait();
+				if (0 == target)
+					glfwSwapBuffers();
+				memory::GetFrameArena().Reset();
+				const Clock::time_point now = Clock::now();
+				if (i >= options.warmup_frames)
+					deviations.push_back(std::fabs(Milliseconds(previous, now) - 1000.0 / CAPPED_FPS));
+				previous = now;
+			}
+			writer.BeginObject();
+			writer.Value("pacing", std::string(spin ? "sleep_and_spin" : "sleep"));
+			writer.Value("interval_deviation_ms", Summarize(deviations));
+			writer.Value("missed_deadlines", static_cast<int>(pacer.GetMissedCount()));
+			writer.EndObject();
+		}
+		writer.EndArray();
+		glFinish();
+		program::QuadBatch &batch = program.GetBatch();
+		const unsigned int limits[3] = { 1, 2, 0 };
+		writer.BeginArray("frames_in_flight");
+		for (int i = 0; i < 3; ++i)
+		{
+			frame::FramePipeline pipeline;
+			pipeline.Create(limits[i]);
+			unsigned int random_state = 1;
+			const Clock::time_point begin = Clock::now();
+			for (int frame_index = 0; frame_index < frames; ++frame_index)
+			{
+				pipeline.BeginFrame();
+				const Clock::time_point input_time = Clock::now();
+				for (int quad = 0; quad < LOAD_QUADS; ++quad)
+					batch.Add(NextRandom(random_state) * 2.0f - 1.0f, NextRandom(random_state) * 2.0f - 1.0f, 0.05f, 0.05f, 255, 255, 255, 255);
+				program.Render(&scene);
+				if (0 == target)
+					glfwSwapBuffers();
+				pipeline.EndFrame(input_time);
+				memory::GetFrameArena().Reset();
+			}
+			// Retire the frames still in flight, so every frame is measured.
+			glFinish();
+			pipeline.BeginFrame();
+			const double elapsed_ms = Milliseconds(begin, Clock::now());
+			writer.BeginObject();
+			writer.Value("max_frames_in_flight", static_cast<int>(limits[i]));
+			writer.Value("latency_ms", Summarize(pipeline.GetLatencies()));
+			writer.Value("wait_ms_per_frame", pipeline.GetWaitMilliseconds() / frames);
+			writer.Value("frames_per_second", frames / (elapsed_ms / 1000.0));
+			writer.EndObject();
+			pipeline.Destroy();
+		}
+		writer.EndArray();
+		if (0 != target)
+			target->Unbind();
+		program.Destroy();
+		return EXIT_SUCCESS;
+	}
+	// Runs the batch math kernels over 100001 objects (an odd count, so the scalar remainder runs
+	// too) with every path the processor supports, min(frames, 50) times each: composing model
+	// matrices, multiplying them by a view-projection matrix straight into a mapped instance buffer
+	// and transforming their bounding boxes. Fails if a SIMD path's output differs from the scalar
+	// one in a single bit.
+	int RunMathScenario(const Options &options, offscreen::RenderTarget *, JsonWriter &writer)
+	{
+		const size_t OBJECT_COUNT = 100001;
+		const int runs = std::min(options.frames, 50);
+		std::vector<float> placement(10 * OBJECT_COUNT);
+		std::vector<float> local_boxes(6 * OBJECT_COUNT);
+		unsigned int random_state = 1;
+		for (size_t i = 0; i < placement.size(); ++i)
+			placement[i] = NextRandom(random_state) * 2.0f - 1.0f;
+		for (size_t i = 0; i < local_boxes.size(); ++i)
+			local_boxes[i] = NextRandom(random_state);
+		float *const columns = &placement[0];
+		for (size_t i = 0; i < OBJECT_COUNT; ++i)
+		{
+			// Scale the quaternions (columns 3 to 6) to unit length.
+			float length = 0.0f;
+			for (int component = 3; component < 7; ++component)
+				length += columns[component * OBJECT_COUNT + i] * columns[component * OBJECT_COUNT + i];
+			length = std::sqrt(length);
+			for (int component = 3; component < 7; ++component)
+				columns[component * OBJECT_COUNT + i] /= length;
+		}
+		math::Transforms transforms;
+		transforms.translation_x = columns;
+		transforms.translation_y = columns + OBJECT_COUNT;
+		transforms.translation_z = columns + 2 * OBJECT_COUNT;
+		transforms.rotation_x = columns + 3 * OBJECT_COUNT;
+		transforms.rotation_y = columns + 4 * OBJECT_COUNT;
+		transforms.rotation_z = columns + 5 * OBJECT_COUNT;
+		transforms.rotation_w = columns + 6 * OBJECT_COUNT;
+		transforms.scale_x = columns + 7 * OBJECT_COUNT;
+		transforms.scale_y = columns + 8 * OBJECT_COUNT;
+		transforms.scale_z = columns + 9 * OBJECT_COUNT;
+		math::Boxes boxes = { &local_boxes[0], &local_boxes[OBJECT_COUNT], &local_boxes[2 * OBJECT_COUNT],
+			&local_boxes[3 * OBJECT_COUNT], &local_boxes[4 * OBJECT_COUNT], &local_boxes[5 * OBJECT_COUNT] };
+		float projection[16];
+		Perspective(1.0472f, static_cast<float>(options.width) / options.height, 0.1f, 1000.0f, projection);
+		uniform::Mat4 view_projection;
+		std::memcpy(&view_projection, projection, sizeof(projection));
+		// The scalar results every other path is compared with.
+		std::vector<uniform::Mat4> reference_models(OBJECT_COUNT);
+		std::vector<uniform::Mat4> reference_instances(OBJECT_COUNT);
+		std::vector<float> reference_boxes(6 * OBJECT_COUNT);
+		math::Boxes reference_world = { &reference_boxes[0], &reference_boxes[OBJECT_COUNT], &reference_boxes[2 * OBJECT_COUNT],
+			&reference_boxes[3 * OBJECT_COUNT], &reference_boxes[4 * OBJECT_COUNT], &reference_boxes[5 * OBJECT_COUNT] };
+		math::ComposeMatrices(math::PATH_SCALAR, transforms, OBJECT_COUNT, &reference_models[0]);
+		math::MultiplyMatrices(math::PATH_SCALAR, view_projection, &reference_models[0], OBJECT_COUNT, &reference_instances[0]);
+		math::TransformBoxes(math::PATH_SCALAR, boxes, &reference_models[0], OBJECT_COUNT, reference_world);
+		const GLsizeiptr instance_size = static_cast<GLsizeiptr>(OBJECT_COUNT * sizeof(uniform::Mat4));
+		stream::RingBuffer instances;
+		instances.Create(GL_ARRAY_BUFFER, 3 * instance_size);
+		std::vector<uniform::Mat4> models(OBJECT_COUNT);
+		std::vector<uniform::Mat4> results(OBJECT_COUNT);
+		std::vector<float> world_boxes(6 * OBJECT_COUNT);
+		math::Boxes world = { &world_boxes[0], &world_boxes[OBJECT_COUNT], &world_boxes[2 * OBJECT_COUNT],
+			&world_boxes[3 * OBJECT_COUNT], &world_boxes[4 * OBJECT_COUNT], &world_boxes[5 * OBJECT_COUNT] };
+		bool passed = true;
+		writer.Value("objects", static_cast<long long>(OBJECT_COUNT));
+		writer.BeginArray("paths");
+		for (int path_index = math::PATH_SCALAR; path_index <= math::PATH_AVX2; ++path_index)
+		{
+			const math::Path path = static_cast<math::Path>(path_index);
+			if (!math::IsSupported(path))
+				continue;
+			std::vector<double> compose_ms;
+			std::vector<double> multiply_ms;
+			std::vector<double> mapped_multiply_ms;
+			std::vector<double> boxes_ms;
+			for (int run = 0; run < runs; ++run)
+			{
+				Clock::time_point begin = Clock::now();
+				math::ComposeMatrices(path, transforms, OBJECT_COUNT, &models[0]);
+				compose_ms.push_back(Milliseconds(begin, Clock::now()));
+				begin = Clock::now();
+				math::MultiplyMatrices(path, view_projection, &models[0], OBJECT_COUNT, &results[0]);
+				multiply_ms.push_back(Milliseconds(begin, Clock::now()));
+				// The same product written straight into the instance buffer, as a renderer would.
+				stream::Allocation allocation = instances.Allocate(instance_size, 64);
+				begin = Clock::now();
+				math::MultiplyMatrices(path, view_projection, &models[0], OBJECT_COUNT, static_cast<uniform::Mat4*>(allocation.pointer));
+				mapped_multiply_ms.push_back(Milliseconds(begin, Clock::now()));
+				instances.Commit(allocation, instance_size);
+				instances.Fence();
+				begin = Clock::now();
+				math::TransformBoxes(path, boxes, &models[0], OBJECT_COUNT, world);
+				boxes_ms.push_back(Milliseconds(begin, Clock::now()));
+			}
+			const bool models_match = 0 == std::memcmp(&models[0], &reference_models[0], OBJECT_COUNT * sizeof(uniform::Mat4));
+			const bool instances_match = 0 == std::memcmp(&results[0], &reference_instances[0], OBJECT_COUNT * sizeof(uniform::Mat4));
+			const bool boxes_match = 0 == std::memcmp(&world_boxes[0], &reference_boxes[0], world_boxes.size() * sizeof(float));
+			const bool matches = models_match && instances_match && boxes_match;
+			passed = passed && matches;
+			const Statistics compose = Summarize(compose_ms);
+			const Statistics multiply = Summarize(multiply_ms);
+			const Statistics boxes_statistics = Summarize(boxes_ms);
+			writer.BeginObject();
+			writer.Value("path", std::string(math::GetPathName(path)));
+			writer.Value("matches_scalar", matches);
+			writer.Value("compose_ms", compose);
+			writer.Value("compose_millions_per_second", OBJECT_COUNT / (compose.p50 * 1000.0));
+			writer.Value("multiply_ms", multiply);
+			writer.Value("multiply_millions_per_second", OBJECT_COUNT / (multiply.p50 * 1000.0));
+			writer.Value("multiply_into_mapped_buffer_ms", Summarize(mapped_multiply_ms));
+			writer.Value("transform_boxes_ms", boxes_statistics);
+			writer.Value("transform_boxes_millions_per_second", OBJECT_COUNT / (boxes_statistics.p50 * 1000.0));
+			writer.EndObject();
+		}
+		writer.EndArray();
+		writer.Value("persistent_instance_buffer", instances.IsPersistent());
+		glFinish();
+		instances.Destroy();
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// Streams ASSET_COUNT meshes under a video memory budget that holds RESIDENT_TARGET of them, while
+	// a window of DRAWN_COUNT assets is drawn and slides over all of them (and prefetches the next one).
+	// The window takes STEPS steps; each waits until the whole window is resident and then draws it
+	// for FRAMES_PER_STEP frames. So every run makes the same assets resident in the same order,
+	// however fast the disk and the frames are. The resource registry has to evict the least recently
+	// drawn meshes to make room, and the streamer loads them again when the window comes back. Fails if
+	// nothing was evicted, a window never became resident, a frame ended over the budget, a drawn asset
+	// was evicted, or the scenario leaked objects.
+	int RunResourcesScenario(const Options &, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		const int ASSET_COUNT = 12;
+		const int RESIDENT_TARGET = 5;
+		const int DRAWN_COUNT = 3;
+		// Twice around, so the first assets are evicted and then loaded again.
+		const int STEPS = ASSET_COUNT * 2;
+		const int FRAMES_PER_STEP = 10;
+		// The most frames a step waits for its window to become resident.
+		const int MAX_LOAD_FRAMES = 10000;
+		const int SIDE = 150;
+		std::vector<std::string> file_names;
+		if (!WriteGridMeshes("benchmark_resources", ASSET_COUNT, SIDE, file_names))
+		{
+			std::cerr << "The resources scene could not be written." << std::endl;
+			return EXIT_FAILURE;
+		}
+		long long asset_bytes = 0;
+		{
+			mesh::MeshFile file;
+			if (file.Open(file_names[0]))
+			{
+				const mesh::FileHeader &header = file.GetHeader();
+				asset_bytes = static_cast<long long>(header.vertex_count * header.vertex_stride
+					+ header.index_count * (header.index_type == GL_UNSIGNED_SHORT ? 2 : 4));
+			}
+		}
+		resource::Registry &registry = resource::GetRegistry();
+		const size_t live_before = registry.GetLiveCount();
+		const long long previous_budget = registry.GetBudget();
+		const resource::Statistics before = registry.GetStatistics();
+		program::Program program;
+		program.Init();
+		jobs::ThreadPool pool;
+		pool.Create();
+		streaming::Streamer streamer;
+		streamer.Create(&pool, 0);
+		// Everything that is not a streamed mesh stays resident; the budget adds room for the meshes.
+		const long long budget = registry.GetStatistics().total_bytes + RESIDENT_TARGET * asset_bytes;
+		registry.SetBudget(budget);
+		// The assets are requested when the window first reaches them.
+		const streaming::AssetId NOT_REQUESTED = static_cast<streaming::AssetId>(-1);
+		std::vector<streaming::AssetId> assets(ASSET_COUNT, NOT_REQUESTED);
+		int frames = 0;
+		long long max_bytes = 0;
+		int drawn_evictions = 0;
+		int draws = 0;
+		int stalled_steps = 0;
+		// Renders one frame of the window that starts at asset first. Returns true if every asset of
+		// the window, the prefetched one included, is resident at its end.
+		const auto render_frame = [&](int first) -> bool
+		{
+			// Evicted assets are queued again here, so priorities are refreshed every frame.
+			for (int distance = 0; distance <= DRAWN_COUNT; ++distance)
+			{
+				const int i = (first + distance) % ASSET_COUNT;
+				if (NOT_REQUESTED == assets[i])
+					assets[i] = streamer.Request(file_names[i], static_cast<float>(distance), distance < DRAWN_COUNT);
+				else
+					streamer.SetPriority(assets[i], static_cast<float>(distance), distance < DRAWN_COUNT);
+			}
+			streamer.Update();
+			for (int distance = 0; distance < DRAWN_COUNT; ++distance)
+			{
+				const streaming::AssetId asset = assets[(first + distance) % ASSET_COUNT];
+				if (streaming::ASSET_RESIDENT == streamer.GetState(asset))
+				{
+					// Drawing the mesh with program's shader would show nothing sensible; touch it the
+					// way mesh::DrawMesh does instead.
+					streamer.GetMesh(asset).vertex_buffer.Touch();
+					streamer.GetMesh(asset).index_buffer.Touch();
+					++draws;
+				}
+			}
+			// Ends the registry's frame, which evicts.
+			program.Render();
+			bool resident = true;
+			for (int distance = 0; distance <= DRAWN_COUNT; ++distance)
+			{
+				const streaming::AssetState state = streamer.GetState(assets[(first + distance) % ASSET_COUNT]);
+				if (distance < DRAWN_COUNT && streaming::ASSET_EVICTED == state)
+					++drawn_evictions;
+				resident = resident && streaming::ASSET_RESIDENT == state;
+			}
+			max_bytes = std::max(max_bytes, registry.GetStatistics().total_bytes);
+			if (0 != target)
+				glFinish();
+			memory::GetFrameArena().Reset();
+			++frames;
+			return resident;
+		};
+		for (int step = 0; step < STEPS; ++step)
+		{
+			const int first = step % ASSET_COUNT;
+			int load_frames = 0;
+			while (!render_frame(first))
+			{
+				if (++load_frames == MAX_LOAD_FRAMES)
+				{
+					++stalled_steps;
+					break;
+				}
+			}
+			for (int i = 0; i < FRAMES_PER_STEP; ++i)
+				render_frame(first);
+		}
+		const resource::Statistics &after = registry.GetStatistics();
+		const unsigned long long evicted = after.evicted - before.evicted;
+		const unsigned long long over_budget_frames = after.over_budget_frames - before.over_budget_frames;
+		writer.Value("assets", ASSET_COUNT);
+		writer.Value("asset_bytes", asset_bytes);
+		writer.Value("budget_bytes", budget);
+		writer.Value("steps", STEPS);
+		writer.Value("frames", frames);
+		writer.Value("stalled_steps", stalled_steps);
+		writer.Value("draws", draws);
+		writer.Value("max_bytes_at_frame_end", max_bytes);
+		writer.Value("evicted_objects", static_cast<long long>(evicted));
+		writer.Value("over_budget_frames", static_cast<long long>(over_budget_frames));
+		writer.Value("drawn_assets_evicted", drawn_evictions);
+		writer.Value("peak_bytes", after.peak_bytes);
+		writer.BeginObject("live_objects_by_kind");
+		for (int kind = 0; kind < resource::KIND_COUNT; ++kind)
+			writer.Value(resource::GetKindName(static_cast<resource::Kind>(kind)), static_cast<long long>(after.live[kind]));
+		writer.EndObject();
+		streamer.Destroy();
+		pool.Destroy();
+		program.Destroy();
+		registry.SetBudget(previous_budget);
+		for (size_t i = 0; i < file_names.size(); ++i)
+			std::remove(file_names[i].c_str());
+		const long long leaked = static_cast<long long>(registry.GetLiveCount()) - static_cast<long long>(live_before);
+		writer.Value("leaked_objects", leaked);
+		return (evicted > 0 && 0 == stalled_steps && 0 == over_budget_frames && 0 == drawn_evictions && max_bytes <= budget && leaked <= 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// Renders frames of six passes through graph::RenderGraph: sprites into a colour and a depth
+	// texture, a bright pass and two blur passes at half size, a debug view nothing reads and the
+	// composite of the scene and its bloom into the target. Measures the frames with
+	// glInvalidateFramebuffer and without, and reports the render target memory with aliasing and
+	// without. Fails unless exactly the debug view is culled, aliasing saves a texture and (headless)
+	// both runs give the same image.
+	int RunRenderGraphScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		const int SPRITE_COUNT = 20000;
+		const GLsizei width = 0 != target ? target->GetWidth() : options.width;
+		const GLsizei height = 0 != target ? target->GetHeight() : options.height;
+		render::StateCache &state = render::GetStateCache();
+		sprite::SpriteBatch sprites;
+		sprites.Create(SPRITE_COUNT, sprite::EXPAND_ON_GPU);
+		shader::ShaderProgram composite_program;
+		composite_program.CreateFromFiles("fullscreen.vert", "composite.frag");
+		const GLuint composite_id = composite_program.GetOpenGLID();
+		const GLint second_location = glGetUniformLocation(composite_id, "second");
+		const GLint weights_location = glGetUniformLocation(composite_id, "weights");
+		const GLint blur_step_location = glGetUniformLocation(composite_id, "blur_step");
+		state.UseProgram(composite_id);
+		glUniform1i(glGetUniformLocation(composite_id, "first"), 0);
+		// The fullscreen triangle needs no attributes, but the core profile wants a VAO bound.
+		resource::VertexArray empty_vao;
+		empty_vao.Create(RESOURCE_SITE);
+		// Draws the fullscreen triangle with the composite program. A pass with one input samples it
+		// through both samplers; the weight of the second is then 0.
+		auto composite = [&](int inputs, GLfloat first_weight, GLfloat second_weight, GLfloat step_x, GLfloat step_y)
+		{
+			state.UseProgram(composite_id);
+			state.BindVertexArray(empty_vao.Get());
+			glUniform1i(second_location, inputs > 1 ? 1 : 0);
+			glUniform2f(weights_location, first_weight, second_weight);
+			glUniform2f(blur_step_location, step_x, step_y);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		};
+		graph::RenderGraph render_graph;
+		const graph::TextureDescription full_colour = { width, height, GL_RGBA8 };
+		const graph::TextureDescription full_depth = { width, height, GL_DEPTH24_STENCIL8 };
+		const graph::TextureDescription half_colour = { std::max(width / 2, 1), std::max(height / 2, 1), GL_RGBA8 };
+		const graph::TextureId scene_colour = render_graph.CreateTexture("scene_colour", full_colour);
+		const graph::TextureId scene_depth = render_graph.CreateTexture("scene_depth", full_depth);
+		const graph::TextureId bright = render_graph.CreateTexture("bright", half_colour);
+		const graph::TextureId blur_x = render_graph.CreateTexture("blur_x", half_colour);
+		const graph::TextureId blur_y = render_graph.CreateTexture("blur_y", half_colour);
+		const graph::TextureId debug = render_graph.CreateTexture("debug", full_colour);
+		const graph::TextureId output = render_graph.ImportFramebuffer("output", 0 != target ? target->GetFramebuffer() : 0, width, height);
+		std::vector<float> sprite_values;
+		unsigned int random_state = 3;
+		for (int i = 0; i < SPRITE_COUNT * 4; ++i)
+			sprite_values.push_back(NextRandom(random_state));
+		const graph::PassId scene_pass = render_graph.AddPass("scene", [&]()
+		{
+			for (int i = 0; i < SPRITE_COUNT; ++i)
+			{
+				const float *values = &sprite_values[i * 4];
+				sprites.Add(values[0] * 2.0f - 1.0f, values[1] * 2.0f - 1.0f, 0.002f + values[2] * 0.01f, 0.002f + values[2] * 0.01f,
+					static_cast<GLubyte>(values[3] * 255.0f), 128, 255, 255);
+			}
+			sprites.Flush();
+			sprites.EndFrame();
+		});
+		const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		const float far_depth = 1.0f;
+		render_graph.Write(scene_pass, scene_colour, graph::LOAD_CLEAR, black);
+		render_graph.Write(scene_pass, scene_depth, graph::LOAD_CLEAR, &far_depth);
+		const graph::PassId bright_pass = render_graph.AddPass("bright", [&]() { composite(1, 1.0f, 0.0f, 0.0f, 0.0f); });
+		render_graph.Read(bright_pass, scene_colour);
+		render_graph.Write(bright_pass, bright, graph::LOAD_DONT_CARE);
+		const graph::PassId blur_x_pass = render_graph.AddPass("blur_x", [&]() { composite(1, 1.0f, 0.0f, 2.0f / half_colour.width, 0.0f); });
+		render_graph.Read(blur_x_pass, bright);
+		render_graph.Write(blur_x_pass, blur_x, graph::LOAD_DONT_CARE);
+		const graph::PassId blur_y_pass = render_graph.AddPass("blur_y", [&]() { composite(1, 1.0f, 0.0f, 0.0f, 2.0f / half_colour.height); });
+		render_graph.Read(blur_y_pass, blur_x);
+		render_graph.Write(blur_y_pass, blur_y, graph::LOAD_DONT_CARE);
+		const graph::PassId debug_pass = render_graph.AddPass("debug", [&]() { composite(1, 0.5f, 0.0f, 0.0f, 0.0f); });
+		render_graph.Read(debug_pass, scene_colour);
+		render_graph.Write(debug_pass, debug, graph::LOAD_DONT_CARE);
+		const graph::PassId composite_pass = render_graph.AddPass("composite", [&]() { composite(2, 1.0f, 0.5f, 0.0f, 0.0f); });
+		render_graph.Read(composite_pass, scene_colour);
+		render_graph.Read(composite_pass, blur_y);
+		render_graph.Write(composite_pass, output, graph::LOAD_DONT_CARE);
+		const Clock::time_point compile_begin = Clock::now();
+		const bool compiled = render_graph.Compile();
+		const double compile_ms = Milliseconds(compile_begin, Clock::now());
+		const graph::CompileStatistics compile_statistics = render_graph.GetCompileStatistics();
+		writer.Value("compiled", compiled);
+		writer.Value("compile_ms", compile_ms);
+		writer.Value("passes", static_cast<int>(compile_statistics.passes));
+		writer.Value("culled_passes", static_cast<int>(compile_statistics.culled_passes));
+		writer.Value("transient_textures", static_cast<int>(compile_statistics.transient_textures));
+		writer.Value("physical_textures", static_cast<int>(compile_statistics.physical_textures));
+		writer.Value("framebuffers", static_cast<int>(compile_statistics.framebuffers));
+		writer.Value("peak_render_target_bytes", compile_statistics.peak_bytes);
+		writer.Value("unaliased_render_target_bytes", compile_statistics.unaliased_bytes);
+		std::vector<unsigned char> images[2];
+		if (compiled)
+		{
+			writer.BeginArray("runs");
+			for (int run = 0; run < 2; ++run)
+			{
+				const bool invalidation = 0 == run;
+				render_graph.SetInvalidation(invalidation);
+				FrameSamples samples;
+				RunFrames(options, target, [&]() { render_graph.Execute(); }, samples);
+				if (0 != target)
+					target->ReadPixels(images[run]);
+				const graph::ExecuteStatistics &execute_statistics = render_graph.GetExecuteStatistics();
+				writer.BeginObject();
+				writer.Value("invalidation", invalidation);
+				writer.Value("passes_per_frame", static_cast<int>(execute_statistics.passes));
+				writer.Value("framebuffer_binds_per_frame", static_cast<int>(execute_statistics.framebuffer_binds));
+				writer.Value("clears_per_frame", static_cast<int>(execute_statistics.clears));
+				writer.Value("invalidated_attachments_per_frame", static_cast<int>(execute_statistics.invalidated_attachments));
+				WriteFrameSamples(writer, samples);
+				writer.EndObject();
+			}
+			writer.EndArray();
+		}
+		const bool culled_debug_only = compiled && render_graph.IsCulled(debug_pass) && 1 == compile_statistics.culled_passes;
+		const bool aliased = compiled && compile_statistics.physical_textures < compile_statistics.transient_textures
+			&& compile_statistics.peak_bytes < compile_statistics.unaliased_bytes;
+		const bool images_match = images[0] == images[1];
+		writer.Value("images_compared", 0 != target);
+		writer.Value("images_match", images_match);
+		render_graph.Destroy();
+		empty_vao.Reset();
+		composite_program.Destroy();
+		sprites.Destroy();
+		return (culled_debug_only && aliased && images_match) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	// Returns the median frame time an earlier report of the replay scenario holds, or a negative value if
+	// the file has none.
+	double ReadBaselineMilliseconds(const std::string &file_name)
+	{
+		std::ifstream file(file_name.c_str());
+		if (!file)
+		{
+			std::cerr << "File " << file_name << " could not be opened." << std::endl;
+			return -1.0;
+		}
+		const std::string report((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		const std::string key = "\"replay_frame_ms_p50\":";
+		const size_t position = report.find(key);
+		if (std::string::npos == position)
+		{
+			std::cerr << file_name << " is not a report of the replay scenario." << std::endl;
+			return -1.0;
+		}
+		return std::strtod(report.c_str() + position + key.size(), NULL);
+	}
+	int RunReplayScenario(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer)
+	{
+		// The changed pixels (of more than a rounding step in some channel) a replay may have and
+		// still match the golden image.
+		const int CHANNEL_TOLERANCE = 2;
+		const double MAX_CHANGED_PIXELS_PERCENT = 0.1;
+		writer.Value("trace", options.trace_file_name);
+		trace::Replayer replayer;
+		if (options.trace_file_name.empty() || !replayer.Open(options.trace_file_name))
+		{
+			if (options.trace_file_name.empty())
+				std::cerr << "The replay scenario needs a trace (--replay file)." << std::endl;
+			return EXIT_FAILURE;
+		}
+		const int width = replayer.GetWidth();
+		const int height = replayer.GetHeight();
+		writer.Value("trace_width", width);
+		writer.Value("trace_height", height);
+		writer.Value("trace_frames", replayer.GetFrameCount());
+		// The trace renders into a target of its own size, whatever the benchmark was started with.
+		offscreen::RenderTarget replay_target;
+		if (!replay_target.Create(width, height))
+			return EXIT_FAILURE;
+		// The first loop times every call, which slows it down; the others measure the frames. Their
+		// first frame creates the trace's objects, so it is left out.
+		const int loops = 1 + std::max(1, std::min(20, options.frames / std::max(1, replayer.GetFrameCount())));
+		std::vector<double> frame_milliseconds;
+		std::vector<double> loop_milliseconds;
+		std::vector<unsigned char> last_frame;
+		bool played = true;
+		for (int loop = 0; loop < loops && played; ++loop)
+		{
+			loop_milliseconds.clear();
+			played = replayer.Play(replay_target.GetFramebuffer(), 0 == loop, loop_milliseconds, last_frame);
+			if (0 != loop && loop_milliseconds.size() > 1)
+				frame_milliseconds.insert(frame_milliseconds.end(), loop_milliseconds.begin() + 1, loop_milliseconds.end());
+			if (0 == loop)
+			{
+				std::vector<trace::Call> calls;
+				for (int call = 0; call < trace::CALL_COUNT; ++call)
+				{
+					if (0 != replayer.GetTiming(static_cast<trace::Call>(call)).count)
+						calls.push_back(static_cast<trace::Call>(call));
+				}
+				std::sort(calls.begin(), calls.end(), [&](trace::Call a, trace::Call b)
+				{
+					return replayer.GetTiming(a).milliseconds > replayer.GetTiming(b).milliseconds;
+				});
+				writer.BeginArray("calls");
+				for (size_t i = 0; i < calls.size(); ++i)
+				{
+					const trace::CallTiming &timing = replayer.GetTiming(calls[i]);
+					writer.BeginObject();
+					writer.Value("call", std::string(trace::GetCallName(calls[i])));
+					writer.Value("count", static_cast<long long>(timing.count));
+					writer.Value("total_ms", timing.milliseconds);
+					writer.Value("mean_us", timing.milliseconds * 1000.0 / timing.count);
+					writer.EndObject();
+				}
+				writer.EndArray();
+			}
+		}
+		replay_target.Destroy();
+		if (0 != target)
+			target->Bind();
+		writer.Value("played", played);
+		const Statistics statistics = Summarize(frame_milliseconds);
+		writer.Value("replay_frame_ms", statistics);
+		writer.Value("replay_frame_ms_p50", statistics.p50);
+		bool passed = played;
+		if (played && !options.golden_file_name.empty() && !last_frame.empty())
+		{
+			int golden_width = 0;
+			int golden_height = 0;
+			std::vector<unsigned char> golden;
+			if (!std::ifstream(options.golden_file_name.c_str()))
+			{
+				const bool written = offscreen::WritePPM(options.golden_file_name, width, height, last_frame);
+				writer.Value("golden_written", written);
+				passed = passed && written;
+			}
+			else if (!offscreen::ReadPPM(options.golden_file_name, golden_width, golden_height, golden))
+				passed = false;
+			else if (golden_width != width || golden_height != height)
+			{
+				std::cerr << "The golden image is " << golden_width << 'x' << golden_height << ", the trace "
+					<< width << 'x' << height << '.' << std::endl;
+				passed = false;
+			}
+			else
+			{
+				// The golden image has no alpha, so only the colour channels count.
+				long long changed = 0;
+				for (size_t pixel = 0; pixel < golden.size(); pixel += 4)
+				{
+					for (size_t channel = 0; channel < 3; ++channel)
+					{
+						if (std::abs(golden[pixel + channel] - last_frame[pixel + channel]) > CHANNEL_TOLERANCE)
+						{
+							++changed;
+							break;
+						}
+					}
+				}
+				const double changed_percent = 100.0 * changed / (static_cast<double>(width) * height);
+				const bool matches = changed_percent <= MAX_CHANGED_PIXELS_PERCENT;
+				writer.Value("golden_changed_pixels", changed);
+				writer.Value("golden_matches", matches);
+				if (!matches)
+					std::cerr << changed_percent << "% of the pixels differ from " << options.golden_file_name << '.' << std::endl;
+				passed = passed && matches;
+			}
+		}
+		if (played && !options.baseline_file_name.empty())
+		{
+			const double baseline = ReadBaselineMilliseconds(options.baseline_file_name);
+			const double limit = baseline * (1.0 + options.max_regression_percent / 100.0);
+			const bool within = baseline >= 0.0 && statistics.p50 <= limit;
+			writer.Value("baseline_frame_ms_p50", baseline);
+			writer.Value("max_regression_percent", options.max_regression_percent);
+			writer.Value("within_baseline", within);
+			if (baseline >= 0.0 && !within)
+			{
+				std::cerr << "The median frame took " << statistics.p50 << " ms, more than " << options.max_regression_percent
+					<< "% over the baseline of " << baseline << " ms." << std::endl;
+			}
+			passed = passed && within;
+		}
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	typedef int (*Scenario)(const Options &options, offscreen::RenderTarget *target, JsonWriter &writer);
+	struct ScenarioEntry
+	{
+		const char *name;
+		Scenario function;
+	};
+	const ScenarioEntry SCENARIOS[] = {
+		{ "program", RunProgramScenario },
+		{ "quads", RunQuadsScenario },
+		{ "stream-upload", RunStreamUploadScenario },
+		{ "shader-startup", RunShaderStartupScenario },
+		{ "shader-permutations", RunShaderPermutationsScenario },
+		{ "shader-reload", RunShaderReloadScenario },
+		{ "vertex-layouts", RunVertexLayoutsScenario },
+		{ "command-queue", RunCommandQueueScenario },
+		{ "culling", RunCullingScenario },
+		{ "mesh-load", RunMeshLoadScenario },
+		{ "streaming", RunStreamingScenario },
+		{ "allocations", RunAllocationsScenario },
+		{ "uniforms", RunUniformsScenario },
+		{ "sprites", RunSpritesScenario },
+		{ "frame-pacing", RunFramePacingScenario },
+		{ "math", RunMathScenario },
+		{ "resources", RunResourcesScenario },
+		{ "render-graph", RunRenderGraphScenario },
+		{ "replay", RunReplayScenario },
+	};
+	int Run(const Options &options, offscreen::RenderTarget *target)
+	{
+		Scenario scenario = 0;
+		for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); ++i)
+		{
+			if (options.scenario == SCENARIOS[i].name)
+				scenario = SCENARIOS[i].function;
+		}
+		if (0 == scenario)
+		{
+			std::cerr << "Unknown benchmark scenario \"" << options.scenario << "\". Available:";
+			for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); ++i)
+				std::cerr << ' ' << SCENARIOS[i].name;
+			std::cerr << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::ofstream file;
+		if (!options.output_file_name.empty())
+		{
+			file.open(options.output_file_name.c_str());
+			if (!file)
+			{
+				std::cerr << "File " << options.output_file_name << " could not be opened." << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		JsonWriter writer(options.output_file_name.empty() ? std::cout : file);
+		// Scenarios may bind objects directly; start each one with nothing shadowed.
+		render::GetStateCache().Invalidate();
+		writer.BeginObject();
+		WriteHeader(writer, options);
+		// Every object a scenario creates through a resource handle must be gone when it returns.
+		resource::Registry &registry = resource::GetRegistry();
+		const size_t live_before = registry.GetLiveCount();
+		int result = scenario(options, target, writer);
+		const size_t live_after = registry.GetLiveCount();
+		writer.Value("leaked_gl_objects", static_cast<long long>(live_after > live_before ? live_after - live_before : 0));
+		if (live_after > live_before)
+		{
+			std::cerr << "The scenario leaked OpenGL objects:" << std::endl;
+			registry.ReportLiveObjects(std::cerr);
+			result = EXIT_FAILURE;
+		}
+		writer.Value("passed", result == EXIT_SUCCESS);
+		writer.EndObject();
+		return result;
+	}
+}
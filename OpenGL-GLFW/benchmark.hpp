@@ -0,0 +1,111 @@
+#ifndef OPENGL_GLFW_TCU_BENCHMARK_H_
+#define OPENGL_GLFW_TCU_BENCHMARK_H_
+
+#include "standard.h"
+typedef unsigned int GLuint;
+
+namespace offscreen
+{
+	class RenderTarget;
+}
+
+namespace benchmark
+{
+	// Options collects the command line settings of a benchmark run.
+	struct Options
+	{
+		Options();
+		// The name of the scenario to run, e.g. "program".
+		std::string scenario;
+		// The number of measured frames.
+		int frames;
+		// The number of frames rendered before measuring starts (shader warm-up, driver caches).
+		int warmup_frames;
+		int width;
+		int height;
+		// True if rendering goes into an offscreen RenderTarget instead of a window.
+		bool headless;
+		// The file the JSON report is written to. Empty means standard output.
+		std::string output_file_name;
+		// The approximate size of the OBJ file the mesh-load scenario generates.
+		int scene_megabytes;
+		// The trace the replay scenario plays back.
+		std::string trace_file_name;
+		// The PPM image the last frame of the replay must match. It is written if it does not exist yet.
+		std::string golden_file_name;
+		// An earlier report of the replay scenario, whose median frame time the replay must stay within
+		// max_regression_percent of.
+		std::string baseline_file_name;
+		double max_regression_percent;
+	};
+	// Statistics summarizes a set of samples (all in milliseconds).
+	struct Statistics
+	{
+		Statistics();
+		size_t count;
+		double mean;
+		double min;
+		double max;
+		double p50;
+		double p95;
+		double p99;
+	};
+	// Summarize computes the statistics of samples using nearest-rank percentiles.
+	Statistics Summarize(std::vector<double> samples);
+	// JsonWriter writes a JSON document to a stream without building it in memory.
+	class JsonWriter
+	{
+	public:
+		explicit JsonWriter(std::ostream &stream);
+		// Begins an object. Pass a key when the object is a member of another object.
+		void BeginObject(const char *key = 0);
+		void EndObject();
+		// Begins an array. Pass a key when the array is a member of an object.
+		void BeginArray(const char *key = 0);
+		void EndArray();
+		void Value(const char *key, double value);
+		void Value(const char *key, long long value);
+		void Value(const char *key, int value);
+		void Value(const char *key, bool value);
+		void Value(const char *key, const std::string &value);
+		// Writes the members of statistics as an object called key.
+		void Value(const char *key, const Statistics &statistics);
+		// Writes an array element.
+		void Element(double value);
+	private:
+		void Separator(const char *key);
+		void String(const std::string &value);
+		std::ostream &m_stream;
+		// One entry per open object/array, true while it has no members yet.
+		std::vector<bool> m_first;
+	};
+	// GpuTimer measures GPU time with GL_TIME_ELAPSED queries. A ring of queries is kept
+	// so results are read a few frames late instead of stalling on the current frame.
+	class GpuTimer
+	{
+	public:
+		GpuTimer();
+		~GpuTimer();
+		// Creates the queries. Returns false if timer queries are not supported.
+		bool Create();
+		void Destroy();
+		void Begin();
+		void End();
+		// Appends every available result to samples (in milliseconds).
+		// If wait is true, blocks until all outstanding queries have finished.
+		void Collect(std::vector<double> &samples, bool wait);
+		bool IsSupported() const { return m_supported; }
+	private:
+		static const int QUERY_COUNT = 8;
+		GLuint m_queries[QUERY_COUNT];
+		// The index of the next query to begin, and the index of the oldest unread query.
+		int m_next;
+		int m_oldest;
+		bool m_supported;
+	};
+	// Runs the scenario named in options. target is NULL when rendering to a window.
+	// Returns EXIT_SUCCESS or EXIT_FAILURE.
+	int Run(const Options &options, offscreen::RenderTarget *target);
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include "command_queue.hpp"
+#include "opengl.h"
+#include "state_cache.hpp"
+#include <algorithm>
+
+namespace render
+{
+	const unsigned int COMMAND_INDEX_BITS = 56;
+	SortKey MakeSortKey(GLuint program, GLuint vao, GLuint texture, float depth)
+	{
+		if (!(depth > 0.0f))
+			depth = 0.0f;
+		else if (depth > 1.0f)
+			depth = 1.0f;
+		const SortKey quantized_depth = static_cast<SortKey>(depth * 16777215.0f);
+		return (static_cast<SortKey>(program & 0xfff) << 52) | (static_cast<SortKey>(vao & 0xfff) << 40)
+			| (static_cast<SortKey>(texture & 0xffff) << 24) | quantized_depth;
+	}
+	void CommandBuffer::Draw(GLuint program, GLuint vao, GLuint texture, float depth, GLenum mode, GLsizei count,
+		GLenum index_type, GLintptr index_offset, GLsizei instance_count, GLintptr uniform_offset, GLsizeiptr uniform_size)
+	{
+		const DrawCommand command = {
+			MakeSortKey(program, vao, texture, depth), program, vao, texture, mode, count, index_type, index_offset, instance_count,
+			uniform_offset, uniform_size
+		};
+		m_commands.push_back(command);
+	}
+	void CommandQueue::Create(size_t buffer_count)
+	{
+		// The buffer index has to fit in the top bits of Entry::command.
+		if (buffer_count > 256)
+			buffer_count = 256;
+		m_buffers.resize(buffer_count);
+	}
+	void CommandQueue::Destroy()
+	{
+		m_buffers.clear();
+		m_entries.clear();
+	}
+	bool CommandQueue::EntryLess(const Entry &left, const Entry &right)
+	{
+		if (left.key != right.key)
+			return left.key < right.key;
+		return left.command < right.command;
+	}
+	void CommandQueue::Sort()
+	{
+		m_entries.clear();
+		for (size_t buffer = 0; buffer < m_buffers.size(); ++buffer)
+		{
+			const CommandBuffer &commands = m_buffers[buffer];
+			for (size_t i = 0; i < commands.GetSize(); ++i)
+			{
+				const Entry entry = { commands[i].key, (static_cast<unsigned long long>(buffer) << COMMAND_INDEX_BITS) | i };
+				m_entries.push_back(entry);
+			}
+		}
+		std::sort(m_entries.begin(), m_entries.end(), EntryLess);
+	}
+	void CommandQueue::Submit()
+	{
+		m_statistics = SubmitStatistics();
+		render::StateCache &state = GetStateCache();
+		// ~0 is never a valid name, so the first command passes everything it needs to the state cache,
+		// which still skips what is bound already. Later commands only change what differs.
+		GLuint program = ~0u;
+		GLuint vao = ~0u;
+		GLuint texture = ~0u;
+		for (size_t i = 0; i < m_entries.size(); ++i)
+		{
+			const unsigned long long index = m_entries[i].command;
+			const DrawCommand &command = m_buffers[index >> COMMAND_INDEX_BITS][index & ((1ull << COMMAND_INDEX_BITS) - 1)];
+			if (command.program != program)
+			{
+				program = command.program;
+				state.UseProgram(program);
+				++m_statistics.program_changes;
+			}
+			if (command.vao != vao)
+			{
+				vao = command.vao;
+				state.BindVertexArray(vao);
+				++m_statistics.vao_changes;
+			}
+			if (command.texture != 0 && command.texture != texture)
+			{
+				texture = command.texture;
+				state.BindTexture(0, GL_TEXTURE_2D, texture);
+				++m_statistics.texture_changes;
+			}
+			// Every draw usually has its own range, so the state cache only skips repeats.
+			if (command.uniform_size > 0)
+				state.BindBufferRange(GL_UNIFORM_BUFFER, m_uniform_binding, m_uniform_buffer, command.uniform_offset, command.uniform_size);
+			const GLvoid *indices = reinterpret_cast<const GLvoid*>(command.index_offset);
+			if (command.instance_count == 1)
+				glDrawElements(command.mode, command.count, command.index_type, indices);
+			else
+				glDrawElementsInstanced(command.mode, command.count, command.index_type, indices, command.instance_count);
+		}
+		m_statistics.draw_count = m_entries.size();
+		m_entries.clear();
+		for (size_t buffer = 0; buffer < m_buffers.size(); ++buffer)
+			m_buffers[buffer].Clear();
+	}
+}
@@ -0,0 +1,109 @@
+#ifndef OPENGL_GLFW_TCU_COMMAND_QUEUE_H_
+#define OPENGL_GLFW_TCU_COMMAND_QUEUE_H_
+
+#include "standard.h"
+#include <cstddef>
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+typedef int GLsizei;
+typedef ptrdiff_t GLintptr;
+typedef ptrdiff_t GLsizeiptr;
+
+namespace render
+{
+	// SortKey orders draw commands so the most expensive state changes happen least often:
+	// program (bits 63-52), then VAO (51-40), then texture (39-24), then depth (23-0, front to back).
+	// Only the low bits of each name go into the key, so two objects may share a slot; that costs a
+	// state change, never correctness, because Submit compares the real names.
+	typedef unsigned long long SortKey;
+	// Returns the key of a draw. depth is clamped to [0, 1].
+	SortKey MakeSortKey(GLuint program, GLuint vao, GLuint texture, float depth);
+	// DrawCommand is one indexed draw together with the state it needs. It is plain data, so
+	// recording a command is a copy and no OpenGL call is made until the render thread submits it.
+	struct DrawCommand
+	{
+		SortKey key;
+		GLuint program;
+		GLuint vao;
+		// The texture bound to GL_TEXTURE_2D on unit 0. 0 leaves the binding alone.
+		GLuint texture;
+		GLenum mode;
+		GLsizei count;
+		GLenum index_type;
+		// The byte offset of the first index in the VAO's element buffer.
+		GLintptr index_offset;
+		// 1 draws with glDrawElements, more with glDrawElementsInstanced.
+		GLsizei instance_count;
+		// The draw's uniform block in the queue's uniform buffer (see CommandQueue::SetUniformBuffer).
+		// A size of 0 leaves the binding alone.
+		GLintptr uniform_offset;
+		GLsizeiptr uniform_size;
+	};
+	// CommandBuffer records the draws of one thread. A buffer must only be written by one thread at
+	// a time; give every recording thread its own (see jobs::ThreadPool::ParallelFor).
+	class CommandBuffer
+	{
+	public:
+		void Reserve(size_t count) { m_commands.reserve(count); }
+		void Draw(GLuint program, GLuint vao, GLuint texture, float depth, GLenum mode, GLsizei count,
+			GLenum index_type, GLintptr index_offset, GLsizei instance_count = 1, GLintptr uniform_offset = 0, GLsizeiptr uniform_size = 0);
+		// Forgets the recorded commands but keeps the memory for the next frame.
+		void Clear() { m_commands.clear(); }
+		size_t GetSize() const { return m_commands.size(); }
+		const DrawCommand &operator[](size_t index) const { return m_commands[index]; }
+	private:
+		std::vector<DrawCommand> m_commands;
+		// Keeps the vectors of neighbouring buffers on separate cache lines, so recording threads
+		// don't slow each other down by updating their end pointers.
+		char m_padding[64];
+	};
+	// SubmitStatistics counts what the last CommandQueue::Submit did.
+	struct SubmitStatistics
+	{
+		SubmitStatistics() : draw_count(0), program_changes(0), vao_changes(0), texture_changes(0) {}
+		size_t draw_count;
+		size_t program_changes;
+		size_t vao_changes;
+		size_t texture_changes;
+	};
+	// CommandQueue collects the command buffers of all recording threads and submits them on the
+	// render thread, the only thread with a current OpenGL context. A frame looks like:
+	//   queue.GetBuffer(i).Draw(...) on thread i, for every i, in parallel
+	//   queue.Sort() and queue.Submit() on the render thread, after the recording threads finished
+	class CommandQueue
+	{
+	public:
+		CommandQueue() : m_uniform_buffer(0), m_uniform_binding(0) {}
+		// Creates buffer_count command buffers, one per recording thread.
+		void Create(size_t buffer_count);
+		void Destroy();
+		CommandBuffer &GetBuffer(size_t index) { return m_buffers[index]; }
+		// Sets the buffer the uniform ranges of the commands refer to (e.g. the ring buffer of a
+		// uniform::UniformArena) and the uniform block binding point they are bound to.
+		void SetUniformBuffer(GLuint buffer, GLuint binding) { m_uniform_buffer = buffer; m_uniform_binding = binding; }
+		size_t GetBufferCount() const { return m_buffers.size(); }
+		// Merges the buffers and sorts the commands by key. Makes no OpenGL calls.
+		void Sort();
+		// Issues the sorted commands, skipping state that is already bound, and clears the buffers.
+		// The state of the last command is left bound.
+		void Submit();
+		const SubmitStatistics &GetStatistics() const { return m_statistics; }
+	private:
+		// Entry refers to a recorded command. Sorting these moves 16 bytes instead of a whole command.
+		struct Entry
+		{
+			SortKey key;
+			// The buffer index in the top 8 bits, the command index in the rest; this also keeps
+			// the order of commands with equal keys deterministic.
+			unsigned long long command;
+		};
+		static bool EntryLess(const Entry &left, const Entry &right);
+		std::vector<CommandBuffer> m_buffers;
+		std::vector<Entry> m_entries;
+		SubmitStatistics m_statistics;
+		GLuint m_uniform_buffer;
+		GLuint m_uniform_binding;
+	};
+}
+
+#endif
@@ -0,0 +1,19 @@
+#version 150 core
+
+// Adds two textures, each scaled by its weight, e.g. a scene and its bloom. The first is blurred
+// along blur_step (in texture coordinates) with a three tap filter; a step of 0 leaves it sharp.
+uniform sampler2D first;
+uniform sampler2D second;
+uniform vec2 weights;
+uniform vec2 blur_step;
+
+smooth in vec2 fragment_coordinates;
+
+out vec4 output_colour;
+
+void main()
+{
+    vec4 first_colour = (texture(first, fragment_coordinates - blur_step) + texture(first, fragment_coordinates) * 2.0
+        + texture(first, fragment_coordinates + blur_step)) * 0.25;
+    output_colour = first_colour * weights.x + texture(second, fragment_coordinates) * weights.y;
+}
@@ -0,0 +1,75 @@
+#include "cpu.hpp"
+#ifdef OPENGL_GLFW_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace cpu
+{
+	Features::Features()
+		: sse2(false), sse41(false), avx(false), avx2(false), fma(false)
+	{
+
+	}
+#ifdef OPENGL_GLFW_X86
+	// Runs the cpuid instruction for leaf and subleaf and stores eax, ebx, ecx and edx in registers.
+	inline void CpuId(unsigned int leaf, unsigned int subleaf, unsigned int registers[4])
+	{
+#ifdef _MSC_VER
+		int values[4];
+		__cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+		for (int i = 0; i < 4; ++i)
+			registers[i] = static_cast<unsigned int>(values[i]);
+#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+	// Returns the low half of extended control register 0, which tells which registers the OS saves.
+	inline unsigned int ReadXcr0()
+	{
+#ifdef _MSC_VER
+		return static_cast<unsigned int>(_xgetbv(0));
+#else
+		unsigned int eax, edx;
+		__asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+		return eax;
+#endif
+	}
+	Features Detect()
+	{
+		Features features;
+		unsigned int registers[4];
+		CpuId(0, 0, registers);
+		const unsigned int max_leaf = registers[0];
+		if (max_leaf < 1)
+			return features;
+		CpuId(1, 0, registers);
+		features.sse2 = (registers[3] & (1u << 26)) != 0;
+		features.sse41 = (registers[2] & (1u << 19)) != 0;
+		// AVX is only usable if the OS uses xsave and saves the XMM and YMM state (XCR0 bits 1 and 2).
+		const bool osxsave = (registers[2] & (1u << 27)) != 0;
+		const bool ymm_saved = osxsave && (ReadXcr0() & 0x6) == 0x6;
+		features.avx = ymm_saved && (registers[2] & (1u << 28)) != 0;
+		features.fma = features.avx && (registers[2] & (1u << 12)) != 0;
+		if (max_leaf >= 7)
+		{
+			CpuId(7, 0, registers);
+			features.avx2 = features.avx && (registers[1] & (1u << 5)) != 0;
+		}
+		return features;
+	}
+#else
+	Features Detect()
+	{
+		return Features();
+	}
+#endif
+	const Features &GetFeatures()
+	{
+		static const Features features = Detect();
+		return features;
+	}
+}
@@ -0,0 +1,35 @@
+#ifndef OPENGL_GLFW_TCU_CPU_H_
+#define OPENGL_GLFW_TCU_CPU_H_
+
+// OPENGL_GLFW_X86 is defined when compiling for x86 or x64, the only targets with SSE and AVX paths.
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define OPENGL_GLFW_X86
+#endif
+// OPENGL_GLFW_TARGET_AVX and OPENGL_GLFW_TARGET_AVX2 mark functions that use AVX or AVX2 intrinsics in
+// a file compiled for plain SSE2, so they can be selected at run time. MSVC needs no marker.
+#if defined(OPENGL_GLFW_X86) && defined(__GNUC__)
+#define OPENGL_GLFW_TARGET_AVX __attribute__((target("avx")))
+#define OPENGL_GLFW_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define OPENGL_GLFW_TARGET_AVX
+#define OPENGL_GLFW_TARGET_AVX2
+#endif
+
+namespace cpu
+{
+	// Features lists the instruction set extensions both the processor and the operating system
+	// support (AVX needs the OS to save the YMM registers). All false on processors other than x86.
+	struct Features
+	{
+		Features();
+		bool sse2;
+		bool sse41;
+		bool avx;
+		bool avx2;
+		bool fma;
+	};
+	// Returns the features of the processor the program runs on. Detected once, on the first call.
+	const Features &GetFeatures();
+}
+
+#endif
@@ -0,0 +1,26 @@
+#version 330
+
+// Tests the bounding sphere of one object against the frustum planes. Runs with the rasterizer
+// disabled; transform feedback captures the outputs, which form a DrawElementsIndirectCommand.
+layout(location = 0) in vec4 sphere;
+
+uniform vec4 planes[6];
+uniform uint index_count;
+
+flat out uint count;
+flat out uint instance_count;
+flat out uint first_index;
+flat out int base_vertex;
+flat out uint base_instance;
+
+void main()
+{
+	bool inside = true;
+	for (int i = 0; i < 6; ++i)
+		inside = inside && dot(planes[i].xyz, sphere.xyz) + planes[i].w > -sphere.w;
+	count = index_count;
+	instance_count = inside ? 1u : 0u;
+	first_index = 0u;
+	base_vertex = 0;
+	base_instance = uint(gl_VertexID);
+}
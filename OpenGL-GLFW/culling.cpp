@@ -0,0 +1,308 @@
+#include "culling.hpp"
+#include "cpu.hpp"
+#include "opengl.h"
+#include "shader.hpp"
+#include "state_cache.hpp"
+#include <cmath>
+#ifdef OPENGL_GLFW_X86
+#include <immintrin.h>
+#endif
+
+namespace culling
+{
+	// The outputs of cull_feedback.vert, in the order of the members of DrawElementsIndirectCommand.
+	const char *const FEEDBACK_VARYINGS[] = { "count", "instance_count", "first_index", "base_vertex", "base_instance" };
+	// The work group size of cull.comp.
+	const size_t COMPUTE_GROUP_SIZE = 64;
+	Frustum ExtractFrustum(const float matrix[16])
+	{
+		// Row i of the matrix is (matrix[i], matrix[4 + i], matrix[8 + i], matrix[12 + i]).
+		// Each plane is the fourth row plus or minus one of the others.
+		Frustum frustum;
+		for (int i = 0; i < 6; ++i)
+		{
+			const int row = i / 2;
+			const float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+			Plane &plane = frustum.planes[i];
+			plane.x = matrix[3] + sign * matrix[row];
+			plane.y = matrix[7] + sign * matrix[4 + row];
+			plane.z = matrix[11] + sign * matrix[8 + row];
+			plane.w = matrix[15] + sign * matrix[12 + row];
+			const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+			plane.x /= length;
+			plane.y /= length;
+			plane.z /= length;
+			plane.w /= length;
+		}
+		return frustum;
+	}
+	bool IsSupported(CpuPath path)
+	{
+		switch (path)
+		{
+		case CPU_SCALAR:
+			return true;
+		case CPU_SSE:
+			return cpu::GetFeatures().sse2;
+		case CPU_AVX:
+			return cpu::GetFeatures().avx;
+		}
+		return false;
+	}
+	CpuPath GetBestCpuPath()
+	{
+		if (IsSupported(CPU_AVX))
+			return CPU_AVX;
+		if (IsSupported(CPU_SSE))
+			return CPU_SSE;
+		return CPU_SCALAR;
+	}
+	// Culls spheres [begin, count) one at a time. Also handles the remainders of the SIMD paths.
+	size_t CullScalar(const Frustum &frustum, const Sphere *spheres, size_t begin, size_t count, unsigned int *visible)
+	{
+		size_t visible_count = 0;
+		for (size_t i = begin; i < count; ++i)
+		{
+			const Sphere &sphere = spheres[i];
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; ++p)
+			{
+				const Plane &plane = frustum.planes[p];
+				const float distance = ((sphere.x * plane.x + sphere.y * plane.y) + sphere.z * plane.z) + plane.w;
+				inside = distance > -sphere.radius;
+			}
+			// Write unconditionally and only advance when visible: no branch to mispredict.
+			visible[visible_count] = static_cast<unsigned int>(i);
+			visible_count += inside ? 1 : 0;
+		}
+		return visible_count;
+	}
+#ifdef OPENGL_GLFW_X86
+	size_t CullSse(const Frustum &frustum, const Sphere *spheres, size_t count, unsigned int *visible)
+	{
+		__m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			plane_x[p] = _mm_set1_ps(frustum.planes[p].x);
+			plane_y[p] = _mm_set1_ps(frustum.planes[p].y);
+			plane_z[p] = _mm_set1_ps(frustum.planes[p].z);
+			plane_w[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+		size_t visible_count = 0;
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			// Load four spheres and transpose them: x holds the four x coordinates, and so on.
+			__m128 x = _mm_loadu_ps(&spheres[i].x);
+			__m128 y = _mm_loadu_ps(&spheres[i + 1].x);
+			__m128 z = _mm_loadu_ps(&spheres[i + 2].x);
+			__m128 radius = _mm_loadu_ps(&spheres[i + 3].x);
+			_MM_TRANSPOSE4_PS(x, y, z, radius);
+			const __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), radius);
+			__m128 inside = _mm_cmpeq_ps(x, x);
+			for (int p = 0; p < 6; ++p)
+			{
+				const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, plane_x[p]), _mm_mul_ps(y, plane_y[p])),
+					_mm_mul_ps(z, plane_z[p])), plane_w[p]);
+				inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negative_radius));
+			}
+			// cmpeq(x, x) is false for a NaN coordinate, which the scalar path rejects as well.
+			const int mask = _mm_movemask_ps(inside);
+			for (int j = 0; j < 4; ++j)
+			{
+				visible[visible_count] = static_cast<unsigned int>(i + j);
+				visible_count += (mask >> j) & 1;
+			}
+		}
+		return visible_count + CullScalar(frustum, spheres, i, count, visible + visible_count);
+	}
+	OPENGL_GLFW_TARGET_AVX size_t CullAvx(const Frustum &frustum, const Sphere *spheres, size_t count, unsigned int *visible)
+	{
+		__m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			plane_x[p] = _mm256_set1_ps(frustum.planes[p].x);
+			plane_y[p] = _mm256_set1_ps(frustum.planes[p].y);
+			plane_z[p] = _mm256_set1_ps(frustum.planes[p].z);
+			plane_w[p] = _mm256_set1_ps(frustum.planes[p].w);
+		}
+		size_t visible_count = 0;
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			// Sphere i + j goes to the low half of row j, sphere i + 4 + j to the high half. AVX shuffles
+			// work within each half, so transposing the rows like four SSE registers puts the eight
+			// x coordinates, in order, into x, and so on.
+			__m256 rows[4];
+			for (int j = 0; j < 4; ++j)
+				rows[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&spheres[i + j].x)), _mm_loadu_ps(&spheres[i + 4 + j].x), 1);
+			const __m256 low_01 = _mm256_unpacklo_ps(rows[0], rows[1]);
+			const __m256 low_23 = _mm256_unpacklo_ps(rows[2], rows[3]);
+			const __m256 high_01 = _mm256_unpackhi_ps(rows[0], rows[1]);
+			const __m256 high_23 = _mm256_unpackhi_ps(rows[2], rows[3]);
+			const __m256 x = _mm256_shuffle_ps(low_01, low_23, _MM_SHUFFLE(1, 0, 1, 0));
+			const __m256 y = _mm256_shuffle_ps(low_01, low_23, _MM_SHUFFLE(3, 2, 3, 2));
+			const __m256 z = _mm256_shuffle_ps(high_01, high_23, _MM_SHUFFLE(1, 0, 1, 0));
+			const __m256 radius = _mm256_shuffle_ps(high_01, high_23, _MM_SHUFFLE(3, 2, 3, 2));
+			const __m256 negative_radius = _mm256_sub_ps(_mm256_setzero_ps(), radius);
+			__m256 inside = _mm256_cmp_ps(x, x, _CMP_EQ_OQ);
+			for (int p = 0; p < 6; ++p)
+			{
+				// Separate multiplies and adds, no FMA: the result must match the scalar path bit for bit.
+				const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, plane_x[p]), _mm256_mul_ps(y, plane_y[p])),
+					_mm256_mul_ps(z, plane_z[p])), plane_w[p]);
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negative_radius, _CMP_GT_OQ));
+			}
+			const int mask = _mm256_movemask_ps(inside);
+			for (int j = 0; j < 8; ++j)
+			{
+				visible[visible_count] = static_cast<unsigned int>(i + j);
+				visible_count += (mask >> j) & 1;
+			}
+		}
+		return visible_count + CullScalar(frustum, spheres, i, count, visible + visible_count);
+	}
+#endif
+	size_t CullSpheres(CpuPath path, const Frustum &frustum, const Sphere *spheres, size_t count, unsigned int *visible)
+	{
+#ifdef OPENGL_GLFW_X86
+		if (path == CPU_AVX && IsSupported(CPU_AVX))
+			return CullAvx(frustum, spheres, count, visible);
+		if (path == CPU_SSE && IsSupported(CPU_SSE))
+			return CullSse(frustum, spheres, count, visible);
+#endif
+		return CullScalar(frustum, spheres, 0, count, visible);
+	}
+	GpuCuller::GpuCuller()
+		: m_path(GPU_NONE),
+		m_planes_location(-1), m_object_count_location(-1), m_index_count_location(-1), m_capacity(0), m_count(0)
+	{
+
+	}
+	GpuCuller::~GpuCuller()
+	{
+
+	}
+	bool GpuCuller::Create(size_t capacity, GpuPath path)
+	{
+		if (!(GLEW_VERSION_4_2 || (GLEW_ARB_draw_indirect && GLEW_ARB_base_instance)) || path == GPU_NONE)
+			return false;
+		m_path = (path == GPU_COMPUTE && GLEW_VERSION_4_3) ? GPU_COMPUTE : GPU_TRANSFORM_FEEDBACK;
+		m_capacity = capacity;
+		m_count = 0;
+		// The culling program.
+		const bool compute = m_path == GPU_COMPUTE;
+		const GLuint shader = shader::CreateShaderFromFile(compute ? "cull.comp" : "cull_feedback.vert", compute ? GL_COMPUTE_SHADER : GL_VERTEX_SHADER);
+		m_program.Create(RESOURCE_SITE);
+		glAttachShader(m_program.Get(), shader);
+		// >> glTransformFeedbackVaryings specifies the varyings to record when in transform feedback mode.
+		// >> The changes take effect the next time the program is linked.
+		if (!compute)
+			glTransformFeedbackVaryings(m_program.Get(), 5, FEEDBACK_VARYINGS, GL_INTERLEAVED_ATTRIBS);
+		glLinkProgram(m_program.Get());
+		const bool linked = shader::ReportProgramErrors(m_program.Get());
+		if (!linked)
+			shader::ReportShaderErrors(shader);
+		// The shader is only flagged for deletion while it is attached.
+		glDeleteShader(shader);
+		if (!linked)
+		{
+			Destroy();
+			return false;
+		}
+		m_planes_location = glGetUniformLocation(m_program.Get(), "planes");
+		m_object_count_location = glGetUniformLocation(m_program.Get(), "object_count");
+		m_index_count_location = glGetUniformLocation(m_program.Get(), "index_count");
+		// The buffers. Commands are written by the GPU and read by the GPU.
+		render::StateCache &state = render::GetStateCache();
+		m_sphere_buffer.Create(RESOURCE_SITE);
+		m_command_buffer.Create(RESOURCE_SITE);
+		state.BindBuffer(GL_ARRAY_BUFFER, m_sphere_buffer.Get());
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Sphere), NULL, GL_DYNAMIC_DRAW);
+		m_sphere_buffer.SetBytes(capacity * sizeof(Sphere));
+		state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_command_buffer.Get());
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_COPY);
+		m_command_buffer.SetBytes(capacity * sizeof(DrawElementsIndirectCommand));
+		if (!compute)
+		{
+			// One vertex per sphere, the vec4 in location 0 of cull_feedback.vert.
+			m_vao.Create(RESOURCE_SITE);
+			state.BindVertexArray(m_vao.Get());
+			state.BindBuffer(GL_ARRAY_BUFFER, m_sphere_buffer.Get());
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Sphere), 0);
+		}
+		return true;
+	}
+	void GpuCuller::Destroy()
+	{
+		m_vao.Reset();
+		m_sphere_buffer.Reset();
+		m_command_buffer.Reset();
+		m_program.Reset();
+		m_path = GPU_NONE;
+	}
+	void GpuCuller::SetSpheres(const Sphere *spheres, size_t count)
+	{
+		m_count = count < m_capacity ? count : m_capacity;
+		render::GetStateCache().BindBuffer(GL_ARRAY_BUFFER, m_sphere_buffer.Get());
+		glBufferSubData(GL_ARRAY_BUFFER, 0, m_count * sizeof(Sphere), spheres);
+	}
+	void GpuCuller::Cull(const Frustum &frustum, GLuint index_count)
+	{
+		if (0 == m_count)
+			return;
+		render::StateCache &state = render::GetStateCache();
+		state.UseProgram(m_program.Get());
+		glUniform4fv(m_planes_location, 6, &frustum.planes[0].x);
+		glUniform1ui(m_object_count_location, static_cast<GLuint>(m_count));
+		glUniform1ui(m_index_count_location, index_count);
+		if (m_path == GPU_COMPUTE)
+		{
+			state.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_sphere_buffer.Get());
+			state.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_command_buffer.Get());
+			glDispatchCompute(static_cast<GLuint>((m_count + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE), 1, 1);
+			// >> GL_COMMAND_BARRIER_BIT: Command data sourced from buffer objects by Draw*Indirect commands
+			// >> after the barrier will reflect data written by shaders prior to the barrier.
+			glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+		}
+		else
+		{
+			state.BindVertexArray(m_vao.Get());
+			state.BindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_command_buffer.Get());
+			// Nothing is drawn: every vertex only writes its command.
+			glEnable(GL_RASTERIZER_DISCARD);
+			glBeginTransformFeedback(GL_POINTS);
+			glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_count));
+			glEndTransformFeedback();
+			glDisable(GL_RASTERIZER_DISCARD);
+		}
+	}
+	void GpuCuller::Draw(GLenum mode, GLenum index_type)
+	{
+		render::GetStateCache().BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_command_buffer.Get());
+		// >> glMultiDrawElementsIndirect specifies multiple indexed geometric primitives with very few
+		// >> subroutine calls. Without it every command still saves the CPU from knowing the result.
+		if (GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect)
+		{
+			glMultiDrawElementsIndirect(mode, index_type, 0, static_cast<GLsizei>(m_count), 0);
+			return;
+		}
+		for (size_t i = 0; i < m_count; ++i)
+			glDrawElementsIndirect(mode, index_type, reinterpret_cast<const GLvoid*>(i * sizeof(DrawElementsIndirectCommand)));
+	}
+	size_t GpuCuller::CountVisible()
+	{
+		if (m_path == GPU_COMPUTE)
+			glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		std::vector<DrawElementsIndirectCommand> commands(m_count);
+		if (commands.empty())
+			return 0;
+		render::GetStateCache().BindBuffer(GL_COPY_READ_BUFFER, m_command_buffer.Get());
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), &commands[0]);
+		size_t visible_count = 0;
+		for (size_t i = 0; i < commands.size(); ++i)
+			visible_count += commands[i].instance_count;
+		return visible_count;
+	}
+}
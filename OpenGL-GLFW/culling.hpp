@@ -0,0 +1,111 @@
+#ifndef OPENGL_GLFW_TCU_CULLING_H_
+#define OPENGL_GLFW_TCU_CULLING_H_
+
+#include "standard.h"
+#include "resource.hpp"
+#include <cstddef>
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+typedef int GLint;
+
+namespace culling
+{
+	// Plane is a normalized plane: a point p is on its inside if dot(p, (x, y, z)) + w >= 0.
+	struct Plane
+	{
+		float x;
+		float y;
+		float z;
+		float w;
+	};
+	// Frustum is the left, right, bottom, top, near and far plane of a camera, facing inwards.
+	struct Frustum
+	{
+		Plane planes[6];
+	};
+	// Extracts the frustum of a column-major (OpenGL) view-projection matrix, in world space.
+	// >> Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+	Frustum ExtractFrustum(const float matrix[16]);
+	// Sphere bounds an object. It is laid out like a vec4, so the GPU culler can upload it as it is.
+	struct Sphere
+	{
+		float x;
+		float y;
+		float z;
+		float radius;
+	};
+	// The CPU implementations of CullSpheres. They return exactly the same result: the SIMD paths
+	// do the same float operations in the same order, just four or eight spheres at a time.
+	enum CpuPath
+	{
+		CPU_SCALAR, CPU_SSE, CPU_AVX
+	};
+	// Returns true if the processor supports path.
+	bool IsSupported(CpuPath path);
+	// Returns the fastest path the processor supports.
+	CpuPath GetBestCpuPath();
+	// Tests count spheres against frustum and writes the indices of the ones that are at least partly
+	// inside to visible, which must have room for count indices. Returns the number written.
+	size_t CullSpheres(CpuPath path, const Frustum &frustum, const Sphere *spheres, size_t count, unsigned int *visible);
+	// DrawElementsIndirectCommand is one draw of glMultiDrawElementsIndirect, as OpenGL reads it
+	// from the GL_DRAW_INDIRECT_BUFFER.
+	struct DrawElementsIndirectCommand
+	{
+		GLuint count;
+		GLuint instance_count;
+		GLuint first_index;
+		GLint base_vertex;
+		GLuint base_instance;
+	};
+	// The GPU implementations of GpuCuller.
+	enum GpuPath
+	{
+		GPU_NONE, GPU_COMPUTE, GPU_TRANSFORM_FEEDBACK
+	};
+	// GpuCuller culls bounding spheres on the GPU and writes a draw command per object into a
+	// GL_DRAW_INDIRECT_BUFFER, so the result never travels back to the CPU. Object i is drawn as
+	// instance i (base instance i) of the mesh all objects share; its per-instance attributes are
+	// element i of the caller's instance buffers. Culled objects get an instance count of 0.
+	//
+	// With OpenGL 4.3 a compute shader (cull.comp) does the work. Otherwise a vertex shader
+	// (cull_feedback.vert) runs once per sphere with the rasterizer disabled, and transform feedback
+	// captures the commands. Both need indirect draws with a base instance (OpenGL 4.2, or
+	// ARB_draw_indirect and ARB_base_instance); without them Create fails, and the CPU paths remain.
+	class GpuCuller
+	{
+	public:
+		GpuCuller();
+		~GpuCuller();
+		// Creates the buffers for up to capacity objects and the culling program. path selects the
+		// implementation: GPU_COMPUTE falls back to transform feedback if compute shaders are missing.
+		// Returns false if the GPU cannot cull.
+		bool Create(size_t capacity, GpuPath path = GPU_COMPUTE);
+		void Destroy();
+		// Uploads the bounding spheres of count objects (at most the capacity).
+		void SetSpheres(const Sphere *spheres, size_t count);
+		// Culls the spheres against frustum and writes the commands. Every command draws index_count
+		// indices from the start of the element buffer.
+		void Cull(const Frustum &frustum, GLuint index_count);
+		// Draws the commands of the last Cull with the VAO bound.
+		void Draw(GLenum mode, GLenum index_type);
+		// Reads the commands back and counts the visible objects. Waits for the GPU: for checks only.
+		size_t CountVisible();
+		GpuPath GetPath() const { return m_path; }
+		GLuint GetCommandBuffer() const { return m_command_buffer.Get(); }
+	private:
+		GpuPath m_path;
+		resource::Program m_program;
+		// The spheres: a shader storage buffer for the compute shader, a vertex buffer for feedback.
+		resource::Buffer m_sphere_buffer;
+		resource::Buffer m_command_buffer;
+		// Feeds m_sphere_buffer to the feedback vertex shader.
+		resource::VertexArray m_vao;
+		GLint m_planes_location;
+		GLint m_object_count_location;
+		GLint m_index_count_location;
+		size_t m_capacity;
+		size_t m_count;
+	};
+}
+
+#endif
@@ -1,9 +1,40 @@
 #include "error.hpp"
 #include "opengl.h"
+#include <chrono>
 
 namespace error
 {
+	// The steady clock the record timestamps are taken from.
+	typedef std::chrono::steady_clock Clock;
+	// How long the writer thread sleeps between drains. Errors reach debug.txt at most this late.
+	const std::chrono::milliseconds WRITER_INTERVAL(20);
+	// Returns the text the original handler printed for code.
+	inline const char *ErrorCodeToString(ErrorCode code)
+	{
+		switch (code)
+		{
+		case NO_ERROR_CODE: return "No Error";
+		case INVALID_ENUM: return "Invalid Enum";
+		case INVALID_VALUE: return "Invalid Value";
+		case INVALID_OPERATION: return "Invalid Operation";
+		case INVALID_FRAMEBUFFER_OPERATION: return "Invalid Framebuffer Operation";
+		case OUT_OF_MEMORY: return "Out Of Memory";
+		case DEBUG_MESSAGE: return "Debug Message";
+		default: return "Unknown Error";
+		}
+	}
+	// The newest live handler with debug output, which receives the context's debug messages, or NULL
+	// if the callback is not installed. Older live handlers are chained through m_previous_debug_handler.
+	ErrorHandler *g_debug_handler = 0;
+	// >> glDebugMessageCallback sets the callback function that the GL calls whenever a debug message is generated.
+	void GLAPIENTRY DebugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *)
+	{
+		if (0 != g_debug_handler)
+			g_debug_handler->OnDebugMessage(source, type, id, severity, length, message);
+	}
 	ErrorHandler::ErrorHandler()
+		: m_file(0), m_head(0), m_tail(0), m_error_count(0), m_dropped_count(0), m_stopping(false), m_frame(0), m_created(0), m_debug_output(false),
+		m_debug_context(false), m_previous_debug_handler(0)
 	{
 
 	}
@@ -14,70 +45,171 @@ namespace error
 	void ErrorHandler::Create()
 	{
 		glGetError();
-		m_stream.open("debug.txt"); 
+		m_created = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+		m_file = std::fopen("debug.txt", "w");
+		m_stopping.store(false);
+		m_writer = std::thread(&ErrorHandler::WriterLoop, this);
+		m_debug_output = GLEW_VERSION_4_3 || GLEW_KHR_debug;
+		// >> GL_CONTEXT_FLAGS returns the flags with which the context was created. If
+		// >> GL_CONTEXT_FLAG_DEBUG_BIT is set, debug output is guaranteed to be generated.
+		GLint context_flags = 0;
+		glGetIntegerv(GL_CONTEXT_FLAGS, &context_flags);
+		m_debug_context = 0 != (context_flags & GL_CONTEXT_FLAG_DEBUG_BIT);
+		if (m_debug_output)
+		{
+			if (0 == g_debug_handler)
+			{
+				glEnable(GL_DEBUG_OUTPUT);
+				// Synchronous output calls the callback on the thread that caused the message, the render
+				// thread, which keeps the ring single-producer.
+				glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+				glDebugMessageCallback(DebugMessageCallback, NULL);
+				// KHR_debug leaves low severity messages disabled; enable them. Notifications are
+				// informational chatter (e.g. buffer placement hints); drop them in the driver.
+				glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_LOW, 0, NULL, GL_TRUE);
+				glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+			}
+			m_previous_debug_handler = g_debug_handler;
+			g_debug_handler = this;
+		}
 	}
 	void ErrorHandler::Destroy()
 	{
-		m_stream.close();
+		if (m_debug_output)
+		{
+			// Unlink this handler; handlers need not be destroyed in the reverse order of creation.
+			ErrorHandler **link = &g_debug_handler;
+			while (0 != *link && this != *link)
+				link = &(*link)->m_previous_debug_handler;
+			if (0 != *link)
+				*link = m_previous_debug_handler;
+			m_previous_debug_handler = 0;
+			if (0 == g_debug_handler)
+				glDebugMessageCallback(NULL, NULL);
+			m_debug_output = false;
+		}
+		if (m_writer.joinable())
+		{
+			m_stopping.store(true);
+			m_writer.join();
+		}
+		if (0 != m_file)
+		{
+			std::fclose(m_file);
+			m_file = 0;
+		}
 	}
-	void ErrorHandler::Check(bool print_if_no_error, std::string prefix)
+	void ErrorHandler::Check(bool print_if_no_error, const char *call_site)
 	{
+#ifdef NDEBUG
+		// Release builds rely on debug output, which reports errors as they happen, instead of
+		// making the driver synchronize for glGetError. Only a debug context is sure to report them.
+		if (m_debug_output && m_debug_context)
+			return;
+#endif
 		const GLenum err = glGetError();
 		if (GL_NO_ERROR == err)
 		{
 			if (print_if_no_error)
-			{
-				m_ss << prefix << "No Error";
-				m_errors.push_back(m_ss.str());
-				m_ss.str(std::string());
-				m_stream << prefix << "No Error" << std::endl;
-			}
+				Push(NO_ERROR_CODE, call_site, 0, 0, 0, 0);
 		}
 		else if (GL_INVALID_ENUM == err)
-		{
-			m_ss << prefix << "Invalid Enum";
-			m_errors.push_back(m_ss.str());
-			m_ss.str(std::string());
-			m_stream << prefix << "Invalid Enum" << std::endl;
-		}
+			Push(INVALID_ENUM, call_site, 0, 0, 0, 0);
 		else if (GL_INVALID_VALUE == err)
-		{
-			m_ss << prefix << "Invalid Value";
-			m_errors.push_back(m_ss.str());
-			m_ss.str(std::string());
-			m_stream << prefix << "Invalid Value" << std::endl;
-		}
+			Push(INVALID_VALUE, call_site, 0, 0, 0, 0);
 		else if (GL_INVALID_OPERATION == err)
+			Push(INVALID_OPERATION, call_site, 0, 0, 0, 0);
+		else if (GL_INVALID_FRAMEBUFFER_OPERATION == err)
+			Push(INVALID_FRAMEBUFFER_OPERATION, call_site, 0, 0, 0, 0);
+		else if (GL_OUT_OF_MEMORY == err)
+			Push(OUT_OF_MEMORY, call_site, 0, 0, 0, 0);
+		else
+			Push(UNKNOWN_ERROR, call_site, 0, 0, err, 0);
+	}
+	void ErrorHandler::OnDebugMessage(unsigned int source, unsigned int type, unsigned int id, unsigned int severity, int length, const char *message)
+	{
+		Push(DEBUG_MESSAGE, "Debug Output: ", source, type, id, severity, length, message);
+	}
+	void ErrorHandler::Push(ErrorCode code, const char *call_site, unsigned int source, unsigned int type, unsigned int id, unsigned int severity,
+		int length, const char *message)
+	{
+		if (NO_ERROR_CODE != code)
+			m_error_count.fetch_add(1, std::memory_order_relaxed);
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head - m_tail.load(std::memory_order_acquire) == RING_CAPACITY)
 		{
-			m_ss << prefix << "Invalid Operation";
-			m_errors.push_back(m_ss.str());
-			m_ss.str(std::string());
-			m_stream << prefix << "Invalid Operation" << std::endl;
+			// Never wait for the writer; losing a record is better than stalling a frame.
+			m_dropped_count.fetch_add(1, std::memory_order_relaxed);
+			return;
 		}
-		else if (GL_INVALID_FRAMEBUFFER_OPERATION == err)
+		ErrorRecord &record = m_ring[head & (RING_CAPACITY - 1)];
+		record.code = code;
+		record.call_site = call_site;
+		record.frame = m_frame;
+		record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+		record.source = source;
+		record.type = type;
+		record.id = id;
+		record.severity = severity;
+		// Copy at most what fits, stopping at the end of the text; a negative length means it is null-terminated.
+		size_t copied = 0;
+		if (0 != message)
 		{
-			m_ss << prefix << "Invalid Framebuffer Operation";
-			m_errors.push_back(m_ss.str());
-			m_ss.str(std::string());
-			m_stream << prefix << "Invalid Framebuffer Operation" << std::endl;
+			const size_t limit = length >= 0 && static_cast<size_t>(length) < ErrorRecord::MESSAGE_CAPACITY - 1
+				? static_cast<size_t>(length) : ErrorRecord::MESSAGE_CAPACITY - 1;
+			for (; copied < limit && '\0' != message[copied]; ++copied)
+				record.message[copied] = message[copied];
 		}
-		else if (GL_OUT_OF_MEMORY == err)
+		record.message[copied] = '\0';
+		m_head.store(head + 1, std::memory_order_release);
+	}
+	void ErrorHandler::Drain()
+	{
+		// Format the whole batch into one buffer and write it with a single call.
+		char buffer[16384];
+		size_t used = 0;
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		const size_t head = m_head.load(std::memory_order_acquire);
+		for (; tail != head; ++tail)
 		{
-			m_ss << prefix << "Out Of Memory";
-			m_errors.push_back(m_ss.str());
-			m_ss.str(std::string());
-			m_stream << prefix << "Out Of Memory" << std::endl;
+			const ErrorRecord &record = m_ring[tail & (RING_CAPACITY - 1)];
+			// Room for the longest line: the fixed text plus a full message.
+			if (sizeof(buffer) - used < 256 + ErrorRecord::MESSAGE_CAPACITY)
+			{
+				if (0 != m_file)
+					std::fwrite(buffer, 1, used, m_file);
+				used = 0;
+			}
+			char *const line = buffer + used;
+			const size_t room = sizeof(buffer) - used;
+			// The time is in milliseconds since Create.
+			const double milliseconds = (record.timestamp - m_created) / 1000000.0;
+			int written;
+			if (DEBUG_MESSAGE == record.code)
+				written = std::snprintf(line, room, "[frame %llu, %.3f ms] %ssource 0x%X, type 0x%X, id %u, severity 0x%X: %s\n",
+					record.frame, milliseconds, record.call_site, record.source, record.type, record.id, record.severity, record.message);
+			else if (UNKNOWN_ERROR == record.code)
+				written = std::snprintf(line, room, "[frame %llu, %.3f ms] %sUnknown Error (0x%X)\n", record.frame, milliseconds, record.call_site, record.id);
+			else
+				written = std::snprintf(line, room, "[frame %llu, %.3f ms] %s%s\n", record.frame, milliseconds, record.call_site,
+					ErrorCodeToString(record.code));
+			used += written > 0 ? (static_cast<size_t>(written) < room ? written : room - 1) : 0;
 		}
-		else
+		m_tail.store(tail, std::memory_order_release);
+		if (used > 0 && 0 != m_file)
 		{
-			m_ss << prefix << "Unkown Error";
-			m_errors.push_back(m_ss.str());
-			m_ss.str(std::string());
-			m_stream << "Unknown Error" << std::endl;
+			std::fwrite(buffer, 1, used, m_file);
+			std::fflush(m_file);
 		}
 	}
-	std::vector<std::string> ErrorHandler::GetErrors()
+	void ErrorHandler::WriterLoop()
 	{
-		return m_errors;
+		while (!m_stopping.load())
+		{
+			std::this_thread::sleep_for(WRITER_INTERVAL);
+			Drain();
+		}
+		// Write whatever the render thread recorded before Destroy.
+		Drain();
 	}
-}
\ No newline at end of file
+}
@@ -2,9 +2,47 @@
 #define OPENGL_GLFW_TCU_ERROR_H_
 
 #include "standard.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
 
 namespace error
 {
+	// ErrorCode is the compact form of what an ErrorRecord reports.
+	enum ErrorCode
+	{
+		NO_ERROR_CODE, INVALID_ENUM, INVALID_VALUE, INVALID_OPERATION, INVALID_FRAMEBUFFER_OPERATION,
+		OUT_OF_MEMORY, UNKNOWN_ERROR, DEBUG_MESSAGE
+	};
+	// ErrorRecord is one reported error. Its strings are literals or fixed arrays, so recording it
+	// never allocates.
+	struct ErrorRecord
+	{
+		// The longest debug message text kept, including the terminating null. Longer text is cut off.
+		static const size_t MESSAGE_CAPACITY = 160;
+		ErrorCode code;
+		// The prefix passed to Check. Must be a string with static storage, e.g. a literal.
+		const char *call_site;
+		// The frame number (see NextFrame) and the steady clock time in nanoseconds.
+		unsigned long long frame;
+		long long timestamp;
+		// For DEBUG_MESSAGE: the source, type, id and severity of the KHR_debug message.
+		// For UNKNOWN_ERROR: the error value in id.
+		unsigned int source;
+		unsigned int type;
+		unsigned int id;
+		unsigned int severity;
+		// For DEBUG_MESSAGE: the start of the message text. Empty otherwise.
+		char message[MESSAGE_CAPACITY];
+	};
+	// ErrorHandler records OpenGL errors without allocating or touching the disk on the render thread.
+	// Records go into a fixed-size single-producer/single-consumer ring; a background thread drains it
+	// and writes debug.txt in batches. With KHR_debug, driver messages are recorded as well, and release
+	// builds (NDEBUG) stop polling glGetError in debug contexts.
+	//
+	// The debug callback belongs to the context, not to a handler. The first handler created installs
+	// it, the last one destroyed removes it, and in between messages go to the newest live handler.
+	// All handlers must be created and destroyed on the thread of the one context.
 	class ErrorHandler
 	{
 	public:
@@ -12,14 +50,50 @@ namespace error
 		~ErrorHandler();
 		void Create();
 		void Destroy();
-		void Check(bool print_if_no_error, std::string prefix);
-		std::vector<std::string> GetErrors();
+		// Records the current OpenGL error, if any, under call_site (a string literal).
+		// Must be called from the render thread.
+		void Check(bool print_if_no_error, const char *call_site);
+		// Advances the frame number stored in subsequent records.
+		void NextFrame() { ++m_frame; }
+		// Returns the number of errors recorded (excluding "No Error" records) since Create.
+		unsigned long long GetErrorCount() const { return m_error_count.load(std::memory_order_relaxed); }
+		// Records a KHR_debug message and the first length characters of message (all of it if length is
+		// negative), cut to fit a record. Called by the debug callback, which GL_DEBUG_OUTPUT_SYNCHRONOUS
+		// keeps on the render thread.
+		void OnDebugMessage(unsigned int source, unsigned int type, unsigned int id, unsigned int severity, int length, const char *message);
+		// Returns true if KHR_debug messages reach this handler.
+		bool HasDebugOutput() const { return m_debug_output; }
+		// Returns the number of records lost because the ring was full.
+		unsigned long long GetDroppedCount() const { return m_dropped_count.load(std::memory_order_relaxed); }
 	private:
-		// The file output stream that will be used to write the errors to.
-		std::ofstream m_stream;
-		// A vector containing all the errors.
-		std::vector<std::string> m_errors;
-		std::stringstream m_ss;
+		// The number of records the ring holds. Must be a power of two.
+		static const size_t RING_CAPACITY = 1024;
+		// Pushes a record into the ring, or counts it as dropped if the ring is full.
+		void Push(ErrorCode code, const char *call_site, unsigned int source, unsigned int type, unsigned int id, unsigned int severity,
+			int length = 0, const char *message = 0);
+		// Writes every record currently in the ring to the file. Runs on the writer thread.
+		void Drain();
+		void WriterLoop();
+		// The file the errors are written to.
+		std::FILE *m_file;
+		ErrorRecord m_ring[RING_CAPACITY];
+		// m_head is only written by the render thread, m_tail only by the writer thread.
+		std::atomic<size_t> m_head;
+		std::atomic<size_t> m_tail;
+		std::atomic<unsigned long long> m_error_count;
+		std::atomic<unsigned long long> m_dropped_count;
+		std::atomic<bool> m_stopping;
+		std::thread m_writer;
+		unsigned long long m_frame;
+		// The steady clock time of Create in nanoseconds, which the written timestamps count from.
+		long long m_created;
+		// True if KHR_debug output is active.
+		bool m_debug_output;
+		// True if the context is a debug context. Other contexts may generate no messages at all,
+		// so Check keeps polling glGetError in them.
+		bool m_debug_context;
+		// The handler that received debug messages before this one was created.
+		ErrorHandler *m_previous_debug_handler;
 	};
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,159 @@
+#include "file_watcher.hpp"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace shader
+{
+	FileWatcher::FileWatcher()
+		: m_has_changes(false)
+#ifdef _WIN32
+		, m_directory_handle(INVALID_HANDLE_VALUE), m_stop_event(NULL)
+#else
+		, m_inotify_descriptor(-1)
+#endif
+	{
+#ifndef _WIN32
+		m_stop_pipe[0] = -1;
+		m_stop_pipe[1] = -1;
+#endif
+	}
+	FileWatcher::~FileWatcher()
+	{
+		Destroy();
+	}
+	bool FileWatcher::Create(const std::string directory)
+	{
+		m_directory = directory;
+#ifdef _WIN32
+		m_directory_handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+		if (INVALID_HANDLE_VALUE == m_directory_handle)
+			return false;
+		m_stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+#else
+		m_inotify_descriptor = inotify_init1(IN_CLOEXEC);
+		if (m_inotify_descriptor < 0)
+			return false;
+		// Editors either write the file in place (IN_CLOSE_WRITE) or write a copy and rename it (IN_MOVED_TO).
+		if (inotify_add_watch(m_inotify_descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0 || pipe(m_stop_pipe) != 0)
+		{
+			close(m_inotify_descriptor);
+			m_inotify_descriptor = -1;
+			return false;
+		}
+#endif
+		m_thread = std::thread(&FileWatcher::ThreadLoop, this);
+		return true;
+	}
+	void FileWatcher::Destroy()
+	{
+		if (!m_thread.joinable())
+			return;
+#ifdef _WIN32
+		SetEvent(m_stop_event);
+		m_thread.join();
+		CloseHandle(m_stop_event);
+		CloseHandle(m_directory_handle);
+		m_stop_event = NULL;
+		m_directory_handle = INVALID_HANDLE_VALUE;
+#else
+		const char stop = 0;
+		if (write(m_stop_pipe[1], &stop, 1) != 1)
+			std::cerr << "File watcher could not be stopped." << std::endl;
+		m_thread.join();
+		close(m_stop_pipe[0]);
+		close(m_stop_pipe[1]);
+		close(m_inotify_descriptor);
+		m_stop_pipe[0] = -1;
+		m_stop_pipe[1] = -1;
+		m_inotify_descriptor = -1;
+#endif
+	}
+	void FileWatcher::Watch(const std::string file_name)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_watched.insert(file_name);
+	}
+	void FileWatcher::TakeChanges(std::vector<std::string> &changed)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		changed.insert(changed.end(), m_changed.begin(), m_changed.end());
+		m_changed.clear();
+		m_has_changes.store(false, std::memory_order_release);
+	}
+	void FileWatcher::OnFileChanged(const std::string &file_name)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_watched.count(file_name) == 0)
+			return;
+		m_changed.insert(file_name);
+		m_has_changes.store(true, std::memory_order_release);
+	}
+	void FileWatcher::ThreadLoop()
+	{
+#ifdef _WIN32
+		DWORD buffer[4096];
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+		for (;;)
+		{
+			ResetEvent(overlapped.hEvent);
+			if (!ReadDirectoryChangesW(m_directory_handle, buffer, sizeof(buffer), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, NULL, &overlapped, NULL))
+				break;
+			HANDLE handles[2] = { overlapped.hEvent, m_stop_event };
+			if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+			{
+				CancelIo(m_directory_handle);
+				break;
+			}
+			DWORD size = 0;
+			if (!GetOverlappedResult(m_directory_handle, &overlapped, &size, FALSE) || size == 0)
+				continue;
+			const unsigned char *record = reinterpret_cast<const unsigned char*>(buffer);
+			for (;;)
+			{
+				const FILE_NOTIFY_INFORMATION *information = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(record);
+				if (FILE_ACTION_MODIFIED == information->Action || FILE_ACTION_RENAMED_NEW_NAME == information->Action || FILE_ACTION_ADDED == information->Action)
+				{
+					char name[MAX_PATH];
+					const int length = WideCharToMultiByte(CP_UTF8, 0, information->FileName, information->FileNameLength / sizeof(WCHAR), name, sizeof(name), NULL, NULL);
+					OnFileChanged(std::string(name, length));
+				}
+				if (0 == information->NextEntryOffset)
+					break;
+				record += information->NextEntryOffset;
+			}
+		}
+		CloseHandle(overlapped.hEvent);
+#else
+		// inotify_event records are variable-sized and must be read with their natural alignment.
+		union
+		{
+			inotify_event event;
+			char bytes[4096];
+		} buffer;
+		for (;;)
+		{
+			pollfd descriptors[2] = { { m_inotify_descriptor, POLLIN, 0 }, { m_stop_pipe[0], POLLIN, 0 } };
+			if (poll(descriptors, 2, -1) < 0)
+				continue;
+			if (0 != descriptors[1].revents)
+				break;
+			const ssize_t size = read(m_inotify_descriptor, buffer.bytes, sizeof(buffer.bytes));
+			for (ssize_t offset = 0; offset < size; )
+			{
+				const inotify_event *event = reinterpret_cast<const inotify_event*>(buffer.bytes + offset);
+				if (event->len > 0)
+					OnFileChanged(std::string(event->name));
+				offset += sizeof(inotify_event) + event->len;
+			}
+		}
+#endif
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef OPENGL_GLFW_TCU_FILE_WATCHER_H_
+#define OPENGL_GLFW_TCU_FILE_WATCHER_H_
+
+#include "standard.h"
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace shader
+{
+	// FileWatcher reports files in a directory that have been written to. The operating system
+	// (inotify on Linux, ReadDirectoryChangesW on Windows) wakes a background thread on changes, so
+	// the render thread never polls the file system: when nothing changed, HasChanges is a single
+	// atomic load.
+	class FileWatcher
+	{
+	public:
+		FileWatcher();
+		~FileWatcher();
+		// Starts watching directory. Returns false if the platform has no change notifications.
+		bool Create(const std::string directory);
+		void Destroy();
+		// Adds a file name (relative to the directory) to report changes of. Other files are ignored.
+		void Watch(const std::string file_name);
+		// Returns true if a watched file changed since the last TakeChanges.
+		bool HasChanges() const { return m_has_changes.load(std::memory_order_acquire); }
+		// Moves the names of the changed files (each once) into changed.
+		void TakeChanges(std::vector<std::string> &changed);
+	private:
+		void ThreadLoop();
+		// Called by the watcher thread with the name of every file the OS reports as written.
+		void OnFileChanged(const std::string &file_name);
+		std::string m_directory;
+		std::thread m_thread;
+		std::mutex m_mutex;
+		// The watched file names and the ones that changed, both guarded by m_mutex.
+		std::set<std::string> m_watched;
+		std::set<std::string> m_changed;
+		std::atomic<bool> m_has_changes;
+#ifdef _WIN32
+		void *m_directory_handle;
+		void *m_stop_event;
+#else
+		int m_inotify_descriptor;
+		// Writing to m_stop_pipe[1] wakes the thread up so it can exit.
+		int m_stop_pipe[2];
+#endif
+	};
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "frame.hpp"
+#include "opengl.h"
+
+namespace frame
+{
+	bool ParsePresentMode(const std::string &name, PresentMode &mode)
+	{
+		if (name == "vsync")
+			mode = PRESENT_VSYNC;
+		else if (name == "uncapped")
+			mode = PRESENT_UNCAPPED;
+		else if (name == "capped")
+			mode = PRESENT_CAPPED;
+		else
+			return false;
+		return true;
+	}
+	const char *GetPresentModeName(PresentMode mode)
+	{
+		switch (mode)
+		{
+		case PRESENT_VSYNC:
+			return "vsync";
+		case PRESENT_UNCAPPED:
+			return "uncapped";
+		case PRESENT_CAPPED:
+			return "capped";
+		default:
+			return "unknown";
+		}
+	}
+	FramePacer::FramePacer()
+		: m_mode(PRESENT_VSYNC), m_period(0), m_spin_margin(0), m_missed_count(0)
+	{
+
+	}
+	FramePacer::~FramePacer()
+	{
+
+	}
+	void FramePacer::Create(PresentMode mode, double frames_per_second, Clock::duration spin_margin)
+	{
+		m_mode = mode;
+		m_period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / (frames_per_second > 0.0 ? frames_per_second : 60.0)));
+		m_spin_margin = spin_margin;
+		m_deadline = Clock::time_point();
+		m_missed_count = 0;
+	}
+	void FramePacer::Wait()
+	{
+		if (m_mode != PRESENT_CAPPED)
+			return;
+		Clock::time_point now = Clock::now();
+		if (m_deadline == Clock::time_point())
+		{
+			m_deadline = now;
+			return;
+		}
+		m_deadline += m_period;
+		if (now > m_deadline)
+		{
+			// Late: present now and count the next period from here, so one slow frame is not
+			// followed by a burst of fast ones.
+			++m_missed_count;
+			m_deadline = now;
+			return;
+		}
+		if (m_deadline - now > m_spin_margin)
+			std::this_thread::sleep_until(m_deadline - m_spin_margin);
+		// The last stretch: yield rather than sleep, so the deadline is met to within microseconds.
+		while (Clock::now() < m_deadline)
+			std::this_thread::yield();
+	}
+	FramePipeline::FramePipeline()
+		: m_max_frames_in_flight(0), m_first(0), m_count(0), m_wait_milliseconds(0.0)
+	{
+
+	}
+	FramePipeline::~FramePipeline()
+	{
+
+	}
+	void FramePipeline::Create(unsigned int max_frames_in_flight)
+	{
+		m_max_frames_in_flight = max_frames_in_flight < MAX_FRAMES_IN_FLIGHT ? max_frames_in_flight : MAX_FRAMES_IN_FLIGHT;
+		m_first = 0;
+		m_count = 0;
+		m_latencies.clear();
+		m_wait_milliseconds = 0.0;
+	}
+	void FramePipeline::Destroy()
+	{
+		while (m_count > 0)
+		{
+			glDeleteSync(m_frames[m_first].fence);
+			m_first = (m_first + 1) % MAX_FRAMES_IN_FLIGHT;
+			--m_count;
+		}
+	}
+	void FramePipeline::BeginFrame()
+	{
+		// Collect every frame that already finished without waiting.
+		while (m_count > 0 && Retire(false))
+		{
+
+		}
+		// Then wait until this frame fits. Without a limit, only make room in the array.
+		const unsigned int limit = 0 == m_max_frames_in_flight ? MAX_FRAMES_IN_FLIGHT : m_max_frames_in_flight;
+		if (m_count < limit)
+			return;
+		const Clock::time_point begin = Clock::now();
+		while (m_count >= limit)
+			Retire(true);
+		m_wait_milliseconds += std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+	}
+	void FramePipeline::EndFrame(Clock::time_point input_time)
+	{
+		if (m_count == MAX_FRAMES_IN_FLIGHT)
+			Retire(true);
+		InFlight &frame = m_frames[(m_first + m_count) % MAX_FRAMES_IN_FLIGHT];
+		// >> glFenceSync creates a new fence sync object, inserts a fence command into the GL command
+		// >> stream and associates it with that sync object.
+		frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		frame.input_time = input_time;
+		++m_count;
+	}
+	bool FramePipeline::Retire(bool wait)
+	{
+		InFlight &frame = m_frames[m_first];
+		// >> glClientWaitSync causes the client to block and wait for a sync object to become signaled.
+		// A timeout of 0 only checks; GL_SYNC_FLUSH_COMMANDS_BIT makes sure the fence gets to the GPU at all.
+		const GLuint64 timeout = wait ? 1000000000ull : 0;
+		GLenum result;
+		do
+		{
+			result = glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+		} while (wait && GL_TIMEOUT_EXPIRED == result);
+		if (GL_TIMEOUT_EXPIRED == result)
+			return false;
+		if (frame.input_time != Clock::time_point())
+			m_latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frame.input_time).count());
+		glDeleteSync(frame.fence);
+		m_first = (m_first + 1) % MAX_FRAMES_IN_FLIGHT;
+		--m_count;
+		return true;
+	}
+}
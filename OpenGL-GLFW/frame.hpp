@@ -0,0 +1,219 @@
+#ifndef OPENGL_GLFW_TCU_FRAME_H_
+#define OPENGL_GLFW_TCU_FRAME_H_
+
+#include "standard.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+typedef struct __GLsync *GLsync;
+
+namespace frame
+{
+	typedef std::chrono::steady_clock Clock;
+	// PresentMode is how the frame rate is limited.
+	enum PresentMode
+	{
+		// Swap on the vertical blank (swap interval 1). Smooth, but a blocking swap queues whole frames.
+		PRESENT_VSYNC,
+		// Swap as soon as a frame is done (swap interval 0).
+		PRESENT_UNCAPPED,
+		// Swap interval 0, and FramePacer holds every frame back to a fixed rate.
+		PRESENT_CAPPED
+	};
+	// Parses "vsync", "uncapped" or "capped". Returns false for anything else.
+	bool ParsePresentMode(const std::string &name, PresentMode &mode);
+	const char *GetPresentModeName(PresentMode mode);
+	// FramePacer limits the frame rate of PRESENT_CAPPED. Sleeping alone overshoots by the
+	// scheduler's granularity (a millisecond or more, 15.6 ms on an untuned Windows), so it sleeps
+	// until spin_margin before the deadline and spins for the rest.
+	class FramePacer
+	{
+	public:
+		FramePacer();
+		~FramePacer();
+		// frames_per_second only matters for PRESENT_CAPPED. A spin_margin of 0 only sleeps.
+		void Create(PresentMode mode, double frames_per_second = 60.0, Clock::duration spin_margin = std::chrono::microseconds(2000));
+		// The value for glfwSwapInterval: 1 for PRESENT_VSYNC, otherwise 0.
+		int GetSwapInterval() const { return m_mode == PRESENT_VSYNC ? 1 : 0; }
+		PresentMode GetMode() const { return m_mode; }
+		// Call right before swapping. With PRESENT_CAPPED, returns at the frame's deadline; a frame
+		// that missed its deadline starts the schedule again instead of rushing the next frames.
+		void Wait();
+		// The number of frames that reached Wait after their deadline.
+		unsigned int GetMissedCount() const { return m_missed_count; }
+	private:
+		PresentMode m_mode;
+		Clock::duration m_period;
+		Clock::duration m_spin_margin;
+		// The time the current frame should be presented at, or the epoch before the first Wait.
+		Clock::time_point m_deadline;
+		unsigned int m_missed_count;
+	};
+	// FramePipeline bounds the number of frames the GPU lags behind the CPU. After every swap it
+	// fences the frame, and BeginFrame waits until at most max_frames_in_flight - 1 frames are
+	// unfinished, so input read after BeginFrame reaches the screen after at most max_frames_in_flight
+	// frames instead of however many the driver chooses to buffer (often three).
+	//
+	// It also measures input-to-photon latency: EndFrame takes the time of the newest input the frame
+	// reflects, and once the frame's fence has signalled the time between the two is recorded. The
+	// fence signals when the GPU has finished the frame, so this leaves out only the wait for
+	// scan-out, which OpenGL cannot observe. A frame is only checked when BeginFrame runs, so with
+	// max_frames_in_flight 0 (no limit) the latencies are rounded up to whole frames.
+	class FramePipeline
+	{
+	public:
+		FramePipeline();
+		~FramePipeline();
+		// max_frames_in_flight may be 0 to leave the limit to the driver, or at most MAX_FRAMES_IN_FLIGHT.
+		void Create(unsigned int max_frames_in_flight);
+		void Destroy();
+		// Waits until a new frame may begin, and records the latency of every finished frame.
+		void BeginFrame();
+		// Fences the frame just submitted. Call it after swapping. input_time is when the newest input
+		// the frame reflects was read, or the epoch if the frame reflects no new input.
+		void EndFrame(Clock::time_point input_time = Clock::time_point());
+		unsigned int GetMaxFramesInFlight() const { return m_max_frames_in_flight; }
+		// The input-to-photon latencies measured so far, in milliseconds.
+		const std::vector<double> &GetLatencies() const { return m_latencies; }
+		// The total time BeginFrame spent waiting, in milliseconds.
+		double GetWaitMilliseconds() const { return m_wait_milliseconds; }
+		// The most frames that can be tracked at once. Frames beyond it are waited for.
+		static const unsigned int MAX_FRAMES_IN_FLIGHT = 8;
+	private:
+		struct InFlight
+		{
+			GLsync fence;
+			Clock::time_point input_time;
+		};
+		// Waits for (or, if wait is false, checks) the oldest frame. Returns true if it finished.
+		bool Retire(bool wait);
+		unsigned int m_max_frames_in_flight;
+		// The unfinished frames, oldest first, in a circular array.
+		InFlight m_frames[MAX_FRAMES_IN_FLIGHT];
+		unsigned int m_first;
+		unsigned int m_count;
+		std::vector<double> m_latencies;
+		double m_wait_milliseconds;
+	};
+	// Input is what the render thread hands the update thread: which buttons are held, and when
+	// that last changed (the epoch if it never did).
+	struct Input
+	{
+		Input() : buttons(0) {}
+		unsigned int buttons;
+		Clock::time_point changed;
+	};
+	// Simulation runs update at a fixed timestep on its own thread, so the simulation advances at
+	// the same rate however fast frames are rendered, and a blocking swap never delays a tick.
+	// Every tick is published with the time it stands for; the render thread draws the state
+	// between the last two ticks (see Sample), one tick behind, so motion stays smooth at any frame
+	// rate. State must be copyable; it is copied once per tick and twice per Sample.
+	template <typename State>
+	class Simulation
+	{
+	public:
+		typedef std::function<void(State &state, const Input &input, double step_seconds)> UpdateFunction;
+		Simulation() : m_step(0), m_running(false), m_tick_count(0), m_skipped_count(0) {}
+		~Simulation() {}
+		// Starts the update thread with initial as the state before the first tick. The thread
+		// ticks every step_seconds; if it falls further behind than MAX_CATCH_UP ticks, it skips
+		// ahead rather than running a burst of ticks.
+		void Start(const State &initial, double step_seconds, const UpdateFunction &update)
+		{
+			m_step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(step_seconds));
+			m_update = update;
+			m_previous.state = initial;
+			m_previous.time = Clock::now();
+			m_current = m_previous;
+			m_running = true;
+			m_thread = std::thread(&Simulation::Run, this);
+		}
+		void Stop()
+		{
+			m_running = false;
+			if (m_thread.joinable())
+				m_thread.join();
+		}
+		// Hands input to the update thread; the next tick sees it.
+		void SetInput(const Input &input)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_input = input;
+		}
+		// Returns the last two ticks and where now falls between them: alpha is 0.0 while the
+		// latest tick is new and reaches 1.0 one step after it. input_time is the Input::changed
+		// the latest tick saw.
+		void Sample(Clock::time_point now, State &previous, State &current, float &alpha, Clock::time_point &input_time) const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			previous = m_previous.state;
+			current = m_current.state;
+			input_time = m_current.input_time;
+			const double elapsed = std::chrono::duration<double>(now - m_current.time).count();
+			const double step = std::chrono::duration<double>(m_step).count();
+			alpha = static_cast<float>(elapsed <= 0.0 ? 0.0 : (elapsed >= step ? 1.0 : elapsed / step));
+		}
+		unsigned long long GetTickCount() const { return m_tick_count.load(std::memory_order_relaxed); }
+		// The number of ticks skipped because the thread fell behind.
+		unsigned long long GetSkippedCount() const { return m_skipped_count.load(std::memory_order_relaxed); }
+		// The most ticks run back to back to catch up.
+		static const int MAX_CATCH_UP = 4;
+	private:
+		struct Tick
+		{
+			State state;
+			// The time the tick stands for.
+			Clock::time_point time;
+			Clock::time_point input_time;
+		};
+		void Run()
+		{
+			Clock::time_point next = m_current.time + m_step;
+			State state = m_current.state;
+			while (m_running)
+			{
+				std::this_thread::sleep_until(next);
+				const Clock::time_point now = Clock::now();
+				if (now - next > m_step * MAX_CATCH_UP)
+				{
+					const long long behind = (now - next) / m_step;
+					next += m_step * behind;
+					m_skipped_count.fetch_add(behind, std::memory_order_relaxed);
+				}
+				Input input;
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					input = m_input;
+				}
+				m_update(state, input, std::chrono::duration<double>(m_step).count());
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_previous = m_current;
+					m_current.state = state;
+					m_current.time = next;
+					m_current.input_time = input.changed;
+				}
+				m_tick_count.fetch_add(1, std::memory_order_relaxed);
+				next += m_step;
+			}
+		}
+		Clock::duration m_step;
+		UpdateFunction m_update;
+		std::thread m_thread;
+		std::atomic<bool> m_running;
+		// Guards m_input, m_previous and m_current.
+		mutable std::mutex m_mutex;
+		Input m_input;
+		Tick m_previous;
+		Tick m_current;
+		std::atomic<unsigned long long> m_tick_count;
+		std::atomic<unsigned long long> m_skipped_count;
+	};
+	// The duration operator* takes MAX_CATCH_UP by reference, which needs a definition.
+	template <typename State>
+	const int Simulation<State>::MAX_CATCH_UP;
+}
+
+#endif
@@ -0,0 +1,12 @@
+#version 150 core
+
+// A triangle that covers the whole viewport, made from gl_VertexID alone: draw three vertices with
+// no attributes. fragment_coordinates runs from 0 to 1 across the viewport.
+smooth out vec2 fragment_coordinates;
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    fragment_coordinates = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
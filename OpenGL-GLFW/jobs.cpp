@@ -0,0 +1,144 @@
+#include "jobs.hpp"
+#include <cassert>
+
+namespace jobs
+{
+	// The pool and worker index of the calling thread, so Submit from a worker uses its own deque.
+	thread_local ThreadPool *t_pool = 0;
+	thread_local size_t t_worker_index = 0;
+	ThreadPool::ThreadPool()
+		: m_queued(0), m_pending(0), m_next_worker(0), m_steal_count(0), m_stopping(false)
+	{
+
+	}
+	ThreadPool::~ThreadPool()
+	{
+		Destroy();
+	}
+	void ThreadPool::Create(unsigned int thread_count)
+	{
+		if (0 == thread_count)
+		{
+			// hardware_concurrency may return 0 if it cannot tell.
+			const unsigned int hardware_threads = std::thread::hardware_concurrency();
+			thread_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+		}
+		m_stopping = false;
+		for (unsigned int i = 0; i < thread_count; ++i)
+			m_workers.push_back(std::unique_ptr<Worker>(new Worker()));
+		for (unsigned int i = 0; i < thread_count; ++i)
+			m_threads.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+	}
+	void ThreadPool::Destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_task_available.notify_all();
+		for (size_t i = 0; i < m_threads.size(); ++i)
+			m_threads[i].join();
+		m_threads.clear();
+		m_workers.clear();
+	}
+	void ThreadPool::Submit(const std::function<void()> &task)
+	{
+		// Without workers (e.g. before Create) the task simply runs on the calling thread.
+		if (m_workers.empty())
+		{
+			task();
+			return;
+		}
+		size_t index;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			++m_pending;
+			index = (t_pool == this) ? t_worker_index : m_next_worker++ % m_workers.size();
+		}
+		// Count the task before publishing it, under the same lock TakeTask holds, so a worker that
+		// takes it never decrements m_queued below zero.
+		{
+			std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+			m_queued.fetch_add(1);
+			m_workers[index]->tasks.push_back(task);
+		}
+		// A worker checks m_queued and goes to sleep while holding m_mutex, so taking it here means the
+		// worker either sees the task or is already waiting for the notification.
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+		}
+		m_task_available.notify_one();
+	}
+	void ThreadPool::Wait()
+	{
+		// m_pending counts the calling task itself, so it would never reach 0.
+		assert(t_pool != this && "ThreadPool::Wait called from one of its own tasks");
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (m_pending != 0)
+			m_idle.wait(lock);
+	}
+	void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t, size_t, size_t)> &function)
+	{
+		const size_t range_count = m_workers.empty() ? 1 : m_workers.size();
+		for (size_t range = 0; range < range_count; ++range)
+		{
+			const size_t begin = count * range / range_count;
+			const size_t end = count * (range + 1) / range_count;
+			Submit([&function, range, begin, end]() { function(range, begin, end); });
+		}
+		Wait();
+	}
+	bool ThreadPool::TakeTask(size_t index, std::function<void()> &task)
+	{
+		{
+			// Own deque: newest first, its data is most likely still in this core's cache.
+			Worker &own = *m_workers[index];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.tasks.empty())
+			{
+				task = own.tasks.back();
+				own.tasks.pop_back();
+				m_queued.fetch_sub(1);
+				return true;
+			}
+		}
+		for (size_t i = 1; i < m_workers.size(); ++i)
+		{
+			// Other deques: oldest first, which tends to be the largest remaining piece of work.
+			Worker &victim = *m_workers[(index + i) % m_workers.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty())
+			{
+				task = victim.tasks.front();
+				victim.tasks.pop_front();
+				m_queued.fetch_sub(1);
+				m_steal_count.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+	void ThreadPool::WorkerLoop(size_t index)
+	{
+		t_pool = this;
+		t_worker_index = index;
+		for (;;)
+		{
+			std::function<void()> task;
+			if (!TakeTask(index, task))
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while (m_queued.load() == 0 && !m_stopping)
+					m_task_available.wait(lock);
+				// Drain the deques before stopping, so Destroy never drops submitted work.
+				if (m_queued.load() == 0 && m_stopping)
+					return;
+				continue;
+			}
+			task();
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_pending == 0)
+				m_idle.notify_all();
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef OPENGL_GLFW_TCU_JOBS_H_
+#define OPENGL_GLFW_TCU_JOBS_H_
+
+#include "standard.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace jobs
+{
+	// ThreadPool runs tasks on a fixed set of worker threads. Every worker has its own task deque:
+	// tasks submitted from a worker go to the back of its own deque, which it works through newest
+	// first, and idle workers steal the oldest tasks from the others. Tasks must not touch OpenGL:
+	// the context is only current on the render thread.
+	class ThreadPool
+	{
+	public:
+		ThreadPool();
+		~ThreadPool();
+		// Starts thread_count workers. 0 means one per hardware thread, minus the render thread.
+		void Create(unsigned int thread_count = 0);
+		// Finishes the queued tasks and joins the workers.
+		void Destroy();
+		// Queues task to run on a worker.
+		void Submit(const std::function<void()> &task);
+		// Blocks until every submitted task has finished. Must not be called from a task of this pool,
+		// which would wait for itself and deadlock.
+		void Wait();
+		// Splits [0, count) into one range per worker and calls function(range_index, begin, end) for
+		// each on the workers, then waits. range_index is below GetThreadCount() (or 0 without workers),
+		// so callers can give every range its own output, e.g. a render::CommandBuffer. Like Wait, it
+		// must not be called from a task of this pool.
+		void ParallelFor(size_t count, const std::function<void(size_t, size_t, size_t)> &function);
+		unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_threads.size()); }
+		// The number of tasks a worker took from another worker's deque.
+		unsigned long long GetStealCount() const { return m_steal_count.load(std::memory_order_relaxed); }
+	private:
+		// Worker is the deque of one worker thread.
+		struct Worker
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()> > tasks;
+		};
+		void WorkerLoop(size_t index);
+		// Takes a task from worker index's own deque, or steals one. Returns false if there is none.
+		bool TakeTask(size_t index, std::function<void()> &task);
+		std::vector<std::thread> m_threads;
+		std::vector<std::unique_ptr<Worker> > m_workers;
+		// Guards sleeping and waking up, m_pending and m_stopping.
+		std::mutex m_mutex;
+		// Signalled when a task is queued or the pool shuts down.
+		std::condition_variable m_task_available;
+		// Signalled when the last running task finishes.
+		std::condition_variable m_idle;
+		// The number of tasks in the deques, not taken by a worker yet.
+		std::atomic<size_t> m_queued;
+		// The number of tasks queued or running.
+		size_t m_pending;
+		// The worker the next task from outside the pool goes to.
+		size_t m_next_worker;
+		std::atomic<unsigned long long> m_steal_count;
+		bool m_stopping;
+	};
+}
+
+#endif
@@ -77,10 +77,23 @@
 #include "opengl.h"
 #include "standard.h"
 #include "program.hpp"
+#include "offscreen.hpp"
+#include "benchmark.hpp"
+#include "profiler.hpp"
+#include "memory.hpp"
+#include "mesh_converter.hpp"
+#include "frame.hpp"
+#include "resource.hpp"
+#include "trace.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 // Creates an instance of tcu::program::Program, the class containing our OpenGL code
 program::Program g_program;
 bool g_is_program_destroyed = false;
+// The initial size of the frame arena. It grows by itself if a frame needs more.
+const size_t FRAME_ARENA_SIZE = 1024 * 1024;
 
 // A method which is executed after the user presses the exit button on the window
 int GLFWCALL WindowCloseCallback()
@@ -92,8 +105,237 @@ int GLFWCALL WindowCloseCallback()
 
 	return GL_TRUE;
 }
-int main(void)
+// Command line settings. Without arguments the program opens a vsynced window like it always did.
+struct CommandLine
 {
+	CommandLine() : benchmark(false), present_mode(frame::PRESENT_VSYNC), frames_per_second(60.0), max_frames_in_flight(2), tick_rate(120.0),
+		gpu_budget_megabytes(0), validate_state(false) {}
+	// The settings shared with the benchmark harness (size, frame count, headless, output file).
+	benchmark::Options options;
+	// True if a benchmark scenario should be run instead of the interactive loop.
+	bool benchmark;
+	// How the frame rate is limited, and the rate of PRESENT_CAPPED.
+	frame::PresentMode present_mode;
+	double frames_per_second;
+	// The most frames the GPU may lag behind (see frame::FramePipeline). 0 leaves it to the driver.
+	unsigned int max_frames_in_flight;
+	// The number of simulation ticks per second.
+	double tick_rate;
+	// The video memory budget of the resource registry. 0 means no limit.
+	int gpu_budget_megabytes;
+	// True if every frame of the program should check the state cache against OpenGL (see
+	// program::Program::SetStateValidation).
+	bool validate_state;
+	// The file the last headless frame is written to (PPM). Empty means no screenshot.
+	std::string screenshot_file_name;
+	// The file a Chrome trace of the run is written to (builds with OPENGL_GLFW_PROFILE only).
+	std::string trace_file_name;
+	// The file the OpenGL calls of the frames are recorded to (see trace::StartCapture). Empty means no capture.
+	std::string capture_file_name;
+	// The OBJ file --convert turns into the mesh file convert_output_file_name. Empty means no conversion.
+	std::string convert_input_file_name;
+	std::string convert_output_file_name;
+};
+// Parses argv into command_line. Returns false (and prints the usage) on bad arguments.
+bool ParseCommandLine(int argc, char *argv[], CommandLine &command_line)
+{
+	// A headless run without --frames renders a single frame.
+	command_line.options.frames = 1;
+	command_line.options.warmup_frames = 0;
+	bool frames_set = false;
+	bool warmup_set = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		const char *argument = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (0 == std::strcmp(argument, "--headless"))
+			command_line.options.headless = true;
+		else if (0 == std::strcmp(argument, "--no-vsync"))
+			command_line.present_mode = frame::PRESENT_UNCAPPED;
+		else if (0 == std::strcmp(argument, "--present") && has_value)
+		{
+			if (!frame::ParsePresentMode(argv[++i], command_line.present_mode))
+				return false;
+		}
+		else if (0 == std::strcmp(argument, "--fps") && has_value)
+			command_line.frames_per_second = std::atof(argv[++i]);
+		else if (0 == std::strcmp(argument, "--frames-in-flight") && has_value)
+			command_line.max_frames_in_flight = static_cast<unsigned int>(std::atoi(argv[++i]));
+		else if (0 == std::strcmp(argument, "--tick-rate") && has_value)
+			command_line.tick_rate = std::atof(argv[++i]);
+		else if (0 == std::strcmp(argument, "--benchmark"))
+		{
+			command_line.benchmark = true;
+			// The scenario name is optional.
+			if (has_value && argv[i + 1][0] != '-')
+				command_line.options.scenario = argv[++i];
+		}
+		else if (0 == std::strcmp(argument, "--frames") && has_value)
+		{
+			command_line.options.frames = std::atoi(argv[++i]);
+			frames_set = true;
+		}
+		else if (0 == std::strcmp(argument, "--warmup") && has_value)
+		{
+			command_line.options.warmup_frames = std::atoi(argv[++i]);
+			warmup_set = true;
+		}
+		else if (0 == std::strcmp(argument, "--size") && has_value)
+		{
+			if (2 != std::sscanf(argv[++i], "%dx%d", &command_line.options.width, &command_line.options.height))
+				return false;
+		}
+		else if (0 == std::strcmp(argument, "--output") && has_value)
+			command_line.options.output_file_name = argv[++i];
+		else if (0 == std::strcmp(argument, "--screenshot") && has_value)
+			command_line.screenshot_file_name = argv[++i];
+		else if (0 == std::strcmp(argument, "--trace") && has_value)
+			command_line.trace_file_name = argv[++i];
+		else if (0 == std::strcmp(argument, "--validate-state"))
+			command_line.validate_state = true;
+		else if (0 == std::strcmp(argument, "--capture") && has_value)
+			command_line.capture_file_name = argv[++i];
+		else if (0 == std::strcmp(argument, "--replay") && has_value)
+		{
+			// Replaying is the headless benchmark scenario "replay".
+			command_line.benchmark = true;
+			command_line.options.scenario = "replay";
+			command_line.options.headless = true;
+			command_line.options.trace_file_name = argv[++i];
+		}
+		else if (0 == std::strcmp(argument, "--golden") && has_value)
+			command_line.options.golden_file_name = argv[++i];
+		else if (0 == std::strcmp(argument, "--baseline") && has_value)
+			command_line.options.baseline_file_name = argv[++i];
+		else if (0 == std::strcmp(argument, "--max-regression") && has_value)
+			command_line.options.max_regression_percent = std::atof(argv[++i]);
+		else if (0 == std::strcmp(argument, "--gpu-budget") && has_value)
+			command_line.gpu_budget_megabytes = std::atoi(argv[++i]);
+		else if (0 == std::strcmp(argument, "--scene-size") && has_value)
+			command_line.options.scene_megabytes = std::atoi(argv[++i]);
+		else if (0 == std::strcmp(argument, "--convert") && i + 2 < argc)
+		{
+			command_line.convert_input_file_name = argv[++i];
+			command_line.convert_output_file_name = argv[++i];
+		}
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--headless] [--no-vsync] [--present vsync|uncapped|capped] [--fps n]"
+				" [--frames-in-flight n] [--tick-rate hz] [--benchmark [scenario]] [--frames n]"
+				" [--warmup n] [--size WxH] [--output report.json] [--screenshot frame.ppm] [--trace trace.json]"
+				" [--scene-size megabytes] [--gpu-budget megabytes] [--convert model.obj model.mesh] [--capture frames.gltrace]"
+				" [--replay frames.gltrace] [--golden frame.ppm] [--baseline report.json] [--max-regression percent]"
+				" [--validate-state]" << std::endl;
+			return false;
+		}
+	}
+	if (command_line.benchmark)
+	{
+		// Benchmarks always run uncapped; vsync would only measure the display's refresh rate.
+		command_line.present_mode = frame::PRESENT_UNCAPPED;
+		if (!frames_set)
+			command_line.options.frames = benchmark::Options().frames;
+		if (!warmup_set)
+			command_line.options.warmup_frames = benchmark::Options().warmup_frames;
+	}
+	// A capture records the frames of the program, not benchmark scenarios.
+	if (command_line.benchmark && !command_line.capture_file_name.empty())
+	{
+		std::cerr << "--capture cannot be combined with --benchmark or --replay." << std::endl;
+		return false;
+	}
+	return command_line.options.frames > 0 && command_line.options.width > 0 && command_line.options.height > 0
+		&& command_line.frames_per_second > 0.0 && command_line.tick_rate > 0.0 && command_line.gpu_budget_megabytes >= 0
+		&& command_line.options.max_regression_percent >= 0.0;
+}
+// Prints the peak video memory the tracked objects used, and every object still alive. Call it once
+// everything has been destroyed, so whatever is left is a leak. Goes to standard error, since benchmark
+// reports go to standard output.
+void ReportResources()
+{
+	resource::Registry &registry = resource::GetRegistry();
+	const resource::Statistics &statistics = registry.GetStatistics();
+	std::cerr << "OpenGL objects: " << statistics.created << " created, peak " << statistics.peak_bytes / (1024.0 * 1024.0) << " MB";
+	if (registry.GetBudget() > 0)
+		std::cerr << ", " << statistics.evicted << " evicted, " << statistics.over_budget_frames << " frames over budget";
+	std::cerr << "." << std::endl;
+	if (registry.GetLiveCount() > 0)
+	{
+		std::cerr << registry.GetLiveCount() << " OpenGL objects leaked:" << std::endl;
+		registry.ReportLiveObjects(std::cerr);
+	}
+}
+// Renders without a window: creates a headless context, points Program at an offscreen
+// framebuffer and either runs a benchmark or renders the requested number of frames.
+int RunHeadless(const CommandLine &command_line)
+{
+	offscreen::HeadlessContext context;
+	if (!context.Create())
+		return EXIT_FAILURE;
+	// Core profile contexts need glewExperimental, GLEW would otherwise skip most entry points.
+	glewExperimental = GL_TRUE;
+	if (GLEW_OK != glewInit())
+	{
+		std::cout << "GLEW failed." << std::endl;
+		context.Destroy();
+		return EXIT_FAILURE;
+	}
+	// The capture has to see every object created, the render target included.
+	if (!command_line.capture_file_name.empty() && !trace::StartCapture(command_line.capture_file_name, command_line.options.width, command_line.options.height))
+	{
+		context.Destroy();
+		return EXIT_FAILURE;
+	}
+	offscreen::RenderTarget target;
+	int result = EXIT_FAILURE;
+	if (target.Create(command_line.options.width, command_line.options.height))
+	{
+		if (command_line.benchmark)
+			result = benchmark::Run(command_line.options, &target);
+		else
+		{
+			g_program.SetStateValidation(command_line.validate_state);
+			g_program.Init();
+			target.Bind();
+			for (int i = 0; i < command_line.options.frames; ++i)
+			{
+				g_program.Render();
+				memory::GetFrameArena().Reset();
+				trace::EndFrame();
+			}
+			if (!command_line.screenshot_file_name.empty())
+			{
+				std::vector<unsigned char> pixels;
+				target.ReadPixels(pixels);
+				offscreen::WritePPM(command_line.screenshot_file_name, target.GetWidth(), target.GetHeight(), pixels);
+			}
+			target.Unbind();
+			// Frames drawn without a linked shader program are blank, and ones drawn from a state cache
+			// that disagreed with OpenGL may be wrong.
+			result = g_program.IsLinked() && 0 == g_program.GetStateMismatchCount() ? EXIT_SUCCESS : EXIT_FAILURE;
+			g_program.Destroy();
+		}
+	}
+	target.Destroy();
+	if (trace::IsCapturing() && !trace::StopCapture())
+		result = EXIT_FAILURE;
+	ReportResources();
+	context.Destroy();
+	return result;
+}
+int main(int argc, char *argv[])
+{
+	CommandLine command_line;
+	if (!ParseCommandLine(argc, argv, command_line))
+		return EXIT_FAILURE;
+	// Converting needs no OpenGL context.
+	if (!command_line.convert_input_file_name.empty())
+		return mesh::ConvertObj(command_line.convert_input_file_name, command_line.convert_output_file_name) ? EXIT_SUCCESS : EXIT_FAILURE;
+	// Per-frame data is allocated from the frame arena, which is reset after every frame.
+	memory::GetFrameArena().Create(FRAME_ARENA_SIZE);
+	resource::GetRegistry().SetBudget(command_line.gpu_budget_megabytes * 1024LL * 1024LL);
+	if (command_line.options.headless)
+		return RunHeadless(command_line);
 	// >> glfwInit initializes GLFW. No other function of GLFW may be called before 
 	// >> it has been invoked. If glfwInit returns GL_FALSE if it has failed. 
 	if (glfwInit() == GL_FALSE)
@@ -120,17 +362,34 @@ int main(void)
 	// >> int mode = whether to go fullscreen (GLFW_FULLSCREEN) or windowed (GLFW_WINDOW) 
 	// >> glfwOpenWindow returns GL_TRUE if the window was opened correctly, or GL_FALSE if GLFW
 	// >> failed to open the window. 
-	if (glfwOpenWindow(640, 480, 8, 8, 8, 8, 24, 8, GLFW_WINDOW) == GL_FALSE)
+	if (glfwOpenWindow(command_line.options.width, command_line.options.height, 8, 8, 8, 8, 24, 8, GLFW_WINDOW) == GL_FALSE)
 		// Quit the program if GLFW fails to open a window.
 		glfwTerminate();
-	// Enable Vsync (improves visual quality, caps frame-rate to 60fps).
-	glfwSwapInterval(1);
+	// Vsync (improves visual quality, caps frame-rate to the display's) unless another present mode was asked for.
+	frame::FramePacer pacer;
+	pacer.Create(command_line.present_mode, command_line.frames_per_second);
+	glfwSwapInterval(pacer.GetSwapInterval());
 	// Intitialize GLEW so we can use modern OpenGL functions.
 	GLenum err = glewInit();
 	if (GLEW_OK != err)
 	{
 		std::cout << "GLEW failed." << std::endl;
 	}
+	// Record the OpenGL calls from before the program creates anything. A capture that cannot be
+	// written fails the run, as in RunHeadless, instead of silently running without it.
+	if (!command_line.capture_file_name.empty() && !trace::StartCapture(command_line.capture_file_name, command_line.options.width, command_line.options.height))
+	{
+		glfwTerminate();
+		return EXIT_FAILURE;
+	}
+	// Run a benchmark scenario in the window instead of the interactive loop.
+	if (command_line.benchmark)
+	{
+		const int result = benchmark::Run(command_line.options, NULL);
+		ReportResources();
+		glfwCloseWindow();
+		return result;
+	}
 	// >> glfwSetWindowCloseCallback selects which function should be called
 	// >> upon on a window close event. The function should have the following 
 	// >> prototype:
@@ -141,21 +400,91 @@ int main(void)
 	// been closed - cleaned up.
 	bool running = true;
 	// Initialize the OpenGL code.
+	g_program.SetStateValidation(command_line.validate_state);
 	g_program.Init();
+	// Start the profiler (does nothing unless built with OPENGL_GLFW_PROFILE).
+	PROFILE_CREATE();
+	if (!command_line.trace_file_name.empty())
+		PROFILE_BEGIN_CAPTURE();
+	// The scene is simulated on its own thread at a fixed rate; frames draw it interpolated.
+	frame::Simulation<program::Scene> simulation;
+	simulation.Start(program::Scene(), 1.0 / command_line.tick_rate, program::UpdateScene);
+	frame::FramePipeline pipeline;
+	pipeline.Create(command_line.max_frames_in_flight);
+	// >> glfwSwapBuffers implicitly calls glfwPollEvents unless GLFW_AUTO_POLL_EVENTS is disabled.
+	// Events are polled explicitly instead, as late as possible: after waiting for the GPU, right
+	// before the input goes to the simulation.
+	glfwDisable(GLFW_AUTO_POLL_EVENTS);
+	frame::Input input;
+	frame::Clock::time_point measured_input_time;
 	while (running)
 	{
-		// Render graphics to the display
-		g_program.Render();
-		// Updates the screen (with double buffering)
-		glfwSwapBuffers();
-		// If we press escape and if the window has not been closed, keep running.
-		running = !glfwGetKey(GLFW_KEY_ESC) && glfwGetWindowParam(GLFW_OPENED);
+		{
+			PROFILE_SCOPE("Wait For GPU");
+			pipeline.BeginFrame();
+		}
+		glfwPollEvents();
+		// If we press escape or the window has been closed (and the program destroyed), stop.
+		running = !glfwGetKey(GLFW_KEY_ESC) && glfwGetWindowParam(GLFW_OPENED) && !g_is_program_destroyed;
+		if (!running)
+			break;
+		const unsigned int buttons = (glfwGetKey(GLFW_KEY_LEFT) ? program::BUTTON_LEFT : 0) | (glfwGetKey(GLFW_KEY_RIGHT) ? program::BUTTON_RIGHT : 0)
+			| (glfwGetKey(GLFW_KEY_UP) ? program::BUTTON_UP : 0) | (glfwGetKey(GLFW_KEY_DOWN) ? program::BUTTON_DOWN : 0);
+		if (buttons != input.buttons)
+		{
+			input.buttons = buttons;
+			input.changed = frame::Clock::now();
+			simulation.SetInput(input);
+		}
+		// The frame measures the latency of an input change the first time it shows it.
+		program::Scene previous;
+		program::Scene current;
+		float alpha;
+		frame::Clock::time_point input_time;
+		simulation.Sample(frame::Clock::now(), previous, current, alpha, input_time);
+		if (input_time == measured_input_time)
+			input_time = frame::Clock::time_point();
+		else
+			measured_input_time = input_time;
+		{
+			PROFILE_SCOPE("Render");
+			// Render graphics to the display
+			const program::Scene scene = program::InterpolateScene(previous, current, alpha);
+			g_program.Render(&scene);
+		}
+		{
+			PROFILE_SCOPE("Swap Buffers");
+			pacer.Wait();
+			// Updates the screen (with double buffering)
+			glfwSwapBuffers();
+		}
+		pipeline.EndFrame(input_time);
+		// Nothing allocated for this frame is in use any more.
+		memory::GetFrameArena().Reset();
+		trace::EndFrame();
+		PROFILE_END_FRAME();
+	}
+	simulation.Stop();
+	if (!pipeline.GetLatencies().empty())
+	{
+		const benchmark::Statistics latency = benchmark::Summarize(pipeline.GetLatencies());
+		std::cout << "Input to photon latency (" << frame::GetPresentModeName(pacer.GetMode()) << ", " << pipeline.GetMaxFramesInFlight()
+			<< " frames in flight): mean " << latency.mean << " ms, p95 " << latency.p95 << " ms, max " << latency.max << " ms over "
+			<< latency.count << " inputs." << std::endl;
 	}
+	pipeline.Destroy();
+	// Write the trace and stop the profiler.
+	if (!command_line.trace_file_name.empty())
+		PROFILE_END_CAPTURE(command_line.trace_file_name);
+	PROFILE_DESTROY();
 	// Clean up the OpenGL code.
 	if (!g_is_program_destroyed)
 	{
 		g_program.Destroy();
 	}
+	if (trace::IsCapturing())
+		trace::StopCapture();
+	ReportResources();
 	// >> glfwCloseWindow closes the OpenGL window
 	glfwCloseWindow();
 	// Quit the program.
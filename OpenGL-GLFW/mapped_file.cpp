@@ -0,0 +1,109 @@
+#include "mapped_file.hpp"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mesh
+{
+#ifdef _WIN32
+	MappedFile::MappedFile()
+		: m_file(INVALID_HANDLE_VALUE), m_mapping(NULL), m_data(0), m_size(0)
+	{
+
+	}
+#else
+	MappedFile::MappedFile()
+		: m_descriptor(-1), m_data(0), m_size(0)
+	{
+
+	}
+#endif
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+#ifdef _WIN32
+	bool MappedFile::Open(const std::string &file_name)
+	{
+		Close();
+		m_file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		LARGE_INTEGER size;
+		if (INVALID_HANDLE_VALUE == m_file || !GetFileSizeEx(m_file, &size) || 0 == size.QuadPart)
+		{
+			Close();
+			return false;
+		}
+		m_size = static_cast<size_t>(size.QuadPart);
+		m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (NULL != m_mapping)
+			m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+		if (0 == m_data)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+	void MappedFile::Close()
+	{
+		if (0 != m_data)
+			UnmapViewOfFile(m_data);
+		if (NULL != m_mapping)
+			CloseHandle(m_mapping);
+		if (INVALID_HANDLE_VALUE != m_file)
+			CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+		m_mapping = NULL;
+		m_data = 0;
+		m_size = 0;
+	}
+	void MappedFile::Prefetch()
+	{
+		// FILE_FLAG_SEQUENTIAL_SCAN already asked the cache manager to read ahead aggressively.
+	}
+#else
+	bool MappedFile::Open(const std::string &file_name)
+	{
+		Close();
+		m_descriptor = open(file_name.c_str(), O_RDONLY);
+		struct stat status;
+		if (m_descriptor < 0 || fstat(m_descriptor, &status) != 0 || 0 == status.st_size)
+		{
+			Close();
+			return false;
+		}
+		m_size = static_cast<size_t>(status.st_size);
+		void *data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_descriptor, 0);
+		if (MAP_FAILED == data)
+		{
+			Close();
+			return false;
+		}
+		m_data = static_cast<const unsigned char*>(data);
+		return true;
+	}
+	void MappedFile::Close()
+	{
+		if (0 != m_data)
+			munmap(const_cast<unsigned char*>(m_data), m_size);
+		if (m_descriptor >= 0)
+			close(m_descriptor);
+		m_descriptor = -1;
+		m_data = 0;
+		m_size = 0;
+	}
+	void MappedFile::Prefetch()
+	{
+		if (0 == m_data)
+			return;
+		madvise(const_cast<unsigned char*>(m_data), m_size, MADV_SEQUENTIAL);
+		madvise(const_cast<unsigned char*>(m_data), m_size, MADV_WILLNEED);
+	}
+#endif
+}
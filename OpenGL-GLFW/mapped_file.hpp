@@ -0,0 +1,39 @@
+#ifndef OPENGL_GLFW_TCU_MAPPED_FILE_H_
+#define OPENGL_GLFW_TCU_MAPPED_FILE_H_
+
+#include "standard.h"
+#include <cstddef>
+
+namespace mesh
+{
+	// MappedFile maps a whole file read-only into the address space, so its contents can be used (and
+	// handed to glBufferData) without reading them into a buffer first. Pages are loaded on first access.
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		// Unmaps the file if it is still open.
+		~MappedFile();
+		// Maps the file called file_name. Returns false if it cannot be opened or is empty.
+		bool Open(const std::string &file_name);
+		void Close();
+		// Tells the OS the file will be read soon, front to back, so it can start reading ahead.
+		void Prefetch();
+		const unsigned char *GetData() const { return m_data; }
+		size_t GetSize() const { return m_size; }
+	private:
+		// Copying would unmap the file twice.
+		MappedFile(const MappedFile&);
+		MappedFile &operator=(const MappedFile&);
+#ifdef _WIN32
+		void *m_file;
+		void *m_mapping;
+#else
+		int m_descriptor;
+#endif
+		const unsigned char *m_data;
+		size_t m_size;
+	};
+}
+
+#endif
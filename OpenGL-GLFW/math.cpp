@@ -0,0 +1,391 @@
+#include "math.hpp"
+#include "cpu.hpp"
+#include <cmath>
+#ifdef OPENGL_GLFW_X86
+#include <immintrin.h>
+#endif
+// The AVX2 kernels are compiled for FMA too, and GCC would fuse their multiplies and adds, which
+// rounds once instead of twice and breaks bit-exactness with the scalar path.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace math
+{
+	bool IsSupported(Path path)
+	{
+		switch (path)
+		{
+		case PATH_SCALAR:
+			return true;
+		case PATH_SSE2:
+			return cpu::GetFeatures().sse2;
+		case PATH_AVX2:
+			return cpu::GetFeatures().avx2;
+		}
+		return false;
+	}
+	Path GetBestPath()
+	{
+		if (IsSupported(PATH_AVX2))
+			return PATH_AVX2;
+		if (IsSupported(PATH_SSE2))
+			return PATH_SSE2;
+		return PATH_SCALAR;
+	}
+	const char *GetPathName(Path path)
+	{
+		switch (path)
+		{
+		case PATH_SCALAR:
+			return "scalar";
+		case PATH_SSE2:
+			return "sse2";
+		case PATH_AVX2:
+			return "avx2";
+		}
+		return "unknown";
+	}
+	// The scalar kernels handle [begin, count), so they also finish the remainders of the SIMD paths.
+	// They are the reference: every SIMD path must do these operations in this order.
+	void ComposeMatricesScalar(const Transforms &transforms, size_t begin, size_t count, uniform::Mat4 *out)
+	{
+		for (size_t i = begin; i < count; ++i)
+		{
+			const float x = transforms.rotation_x[i];
+			const float y = transforms.rotation_y[i];
+			const float z = transforms.rotation_z[i];
+			const float w = transforms.rotation_w[i];
+			const float x2 = x + x;
+			const float y2 = y + y;
+			const float z2 = z + z;
+			const float xx = x * x2;
+			const float yy = y * y2;
+			const float zz = z * z2;
+			const float xy = x * y2;
+			const float xz = x * z2;
+			const float yz = y * z2;
+			const float wx = w * x2;
+			const float wy = w * y2;
+			const float wz = w * z2;
+			const float scale_x = transforms.scale_x[i];
+			const float scale_y = transforms.scale_y[i];
+			const float scale_z = transforms.scale_z[i];
+			float *columns[4] = { out[i].columns[0].v, out[i].columns[1].v, out[i].columns[2].v, out[i].columns[3].v };
+			columns[0][0] = (1.0f - (yy + zz)) * scale_x;
+			columns[0][1] = (xy + wz) * scale_x;
+			columns[0][2] = (xz - wy) * scale_x;
+			columns[0][3] = 0.0f;
+			columns[1][0] = (xy - wz) * scale_y;
+			columns[1][1] = (1.0f - (xx + zz)) * scale_y;
+			columns[1][2] = (yz + wx) * scale_y;
+			columns[1][3] = 0.0f;
+			columns[2][0] = (xz + wy) * scale_z;
+			columns[2][1] = (yz - wx) * scale_z;
+			columns[2][2] = (1.0f - (xx + yy)) * scale_z;
+			columns[2][3] = 0.0f;
+			columns[3][0] = transforms.translation_x[i];
+			columns[3][1] = transforms.translation_y[i];
+			columns[3][2] = transforms.translation_z[i];
+			columns[3][3] = 1.0f;
+		}
+	}
+	void MultiplyMatricesScalar(const uniform::Mat4 &left, const uniform::Mat4 *right, size_t begin, size_t count, uniform::Mat4 *out)
+	{
+		for (size_t i = begin; i < count; ++i)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				const float *r = right[i].columns[column].v;
+				const float x = r[0], y = r[1], z = r[2], w = r[3];
+				float *result = out[i].columns[column].v;
+				for (int row = 0; row < 4; ++row)
+				{
+					result[row] = ((left.columns[0].v[row] * x + left.columns[1].v[row] * y) + left.columns[2].v[row] * z)
+						+ left.columns[3].v[row] * w;
+				}
+			}
+		}
+	}
+	void TransformBoxesScalar(const Boxes &boxes, const uniform::Mat4 *matrices, size_t begin, size_t count, const Boxes &out)
+	{
+		for (size_t i = begin; i < count; ++i)
+		{
+			const float center[3] = { boxes.center_x[i], boxes.center_y[i], boxes.center_z[i] };
+			const float extent[3] = { boxes.extent_x[i], boxes.extent_y[i], boxes.extent_z[i] };
+			float new_center[3];
+			float new_extent[3];
+			const uniform::Mat4 &m = matrices[i];
+			for (int row = 0; row < 3; ++row)
+			{
+				new_center[row] = ((m.columns[0].v[row] * center[0] + m.columns[1].v[row] * center[1]) + m.columns[2].v[row] * center[2])
+					+ m.columns[3].v[row];
+				new_extent[row] = (std::fabs(m.columns[0].v[row]) * extent[0] + std::fabs(m.columns[1].v[row]) * extent[1])
+					+ std::fabs(m.columns[2].v[row]) * extent[2];
+			}
+			out.center_x[i] = new_center[0];
+			out.center_y[i] = new_center[1];
+			out.center_z[i] = new_center[2];
+			out.extent_x[i] = new_extent[0];
+			out.extent_y[i] = new_extent[1];
+			out.extent_z[i] = new_extent[2];
+		}
+	}
+#ifdef OPENGL_GLFW_X86
+	// Stores rows[0..3], component column * 4 + row of four matrices, as column column of out[0..3].
+	inline void StoreColumnSse(__m128 rows[4], uniform::Mat4 *out, int column)
+	{
+		_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+		for (int j = 0; j < 4; ++j)
+			_mm_storeu_ps(out[j].columns[column].v, rows[j]);
+	}
+	void ComposeMatricesSse2(const Transforms &transforms, size_t count, uniform::Mat4 *out)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 zero = _mm_setzero_ps();
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(transforms.rotation_x + i);
+			const __m128 y = _mm_loadu_ps(transforms.rotation_y + i);
+			const __m128 z = _mm_loadu_ps(transforms.rotation_z + i);
+			const __m128 w = _mm_loadu_ps(transforms.rotation_w + i);
+			const __m128 x2 = _mm_add_ps(x, x);
+			const __m128 y2 = _mm_add_ps(y, y);
+			const __m128 z2 = _mm_add_ps(z, z);
+			const __m128 xx = _mm_mul_ps(x, x2);
+			const __m128 yy = _mm_mul_ps(y, y2);
+			const __m128 zz = _mm_mul_ps(z, z2);
+			const __m128 xy = _mm_mul_ps(x, y2);
+			const __m128 xz = _mm_mul_ps(x, z2);
+			const __m128 yz = _mm_mul_ps(y, z2);
+			const __m128 wx = _mm_mul_ps(w, x2);
+			const __m128 wy = _mm_mul_ps(w, y2);
+			const __m128 wz = _mm_mul_ps(w, z2);
+			const __m128 scale_x = _mm_loadu_ps(transforms.scale_x + i);
+			const __m128 scale_y = _mm_loadu_ps(transforms.scale_y + i);
+			const __m128 scale_z = _mm_loadu_ps(transforms.scale_z + i);
+			__m128 column_0[4] = { _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), scale_x), _mm_mul_ps(_mm_add_ps(xy, wz), scale_x),
+				_mm_mul_ps(_mm_sub_ps(xz, wy), scale_x), zero };
+			__m128 column_1[4] = { _mm_mul_ps(_mm_sub_ps(xy, wz), scale_y), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), scale_y),
+				_mm_mul_ps(_mm_add_ps(yz, wx), scale_y), zero };
+			__m128 column_2[4] = { _mm_mul_ps(_mm_add_ps(xz, wy), scale_z), _mm_mul_ps(_mm_sub_ps(yz, wx), scale_z),
+				_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), scale_z), zero };
+			__m128 column_3[4] = { _mm_loadu_ps(transforms.translation_x + i), _mm_loadu_ps(transforms.translation_y + i),
+				_mm_loadu_ps(transforms.translation_z + i), one };
+			StoreColumnSse(column_0, out + i, 0);
+			StoreColumnSse(column_1, out + i, 1);
+			StoreColumnSse(column_2, out + i, 2);
+			StoreColumnSse(column_3, out + i, 3);
+		}
+		ComposeMatricesScalar(transforms, i, count, out);
+	}
+	void MultiplyMatricesSse2(const uniform::Mat4 &left, const uniform::Mat4 *right, size_t count, uniform::Mat4 *out)
+	{
+		const __m128 left_0 = _mm_loadu_ps(left.columns[0].v);
+		const __m128 left_1 = _mm_loadu_ps(left.columns[1].v);
+		const __m128 left_2 = _mm_loadu_ps(left.columns[2].v);
+		const __m128 left_3 = _mm_loadu_ps(left.columns[3].v);
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				const __m128 r = _mm_loadu_ps(right[i].columns[column].v);
+				const __m128 x = _mm_shuffle_ps(r, r, _MM_SHUFFLE(0, 0, 0, 0));
+				const __m128 y = _mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 1, 1, 1));
+				const __m128 z = _mm_shuffle_ps(r, r, _MM_SHUFFLE(2, 2, 2, 2));
+				const __m128 w = _mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3));
+				const __m128 result = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(left_0, x), _mm_mul_ps(left_1, y)), _mm_mul_ps(left_2, z)),
+					_mm_mul_ps(left_3, w));
+				_mm_storeu_ps(out[i].columns[column].v, result);
+			}
+		}
+	}
+	void TransformBoxesSse2(const Boxes &boxes, const uniform::Mat4 *matrices, size_t count, const Boxes &out)
+	{
+		// Clearing the sign bit is fabs.
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 center_x = _mm_loadu_ps(boxes.center_x + i);
+			const __m128 center_y = _mm_loadu_ps(boxes.center_y + i);
+			const __m128 center_z = _mm_loadu_ps(boxes.center_z + i);
+			const __m128 extent_x = _mm_loadu_ps(boxes.extent_x + i);
+			const __m128 extent_y = _mm_loadu_ps(boxes.extent_y + i);
+			const __m128 extent_z = _mm_loadu_ps(boxes.extent_z + i);
+			// m[column][row] holds component (column, row) of the four matrices.
+			__m128 m[4][4];
+			for (int column = 0; column < 4; ++column)
+			{
+				for (int j = 0; j < 4; ++j)
+					m[column][j] = _mm_loadu_ps(matrices[i + j].columns[column].v);
+				_MM_TRANSPOSE4_PS(m[column][0], m[column][1], m[column][2], m[column][3]);
+			}
+			__m128 new_center[3];
+			__m128 new_extent[3];
+			for (int row = 0; row < 3; ++row)
+			{
+				new_center[row] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][row], center_x), _mm_mul_ps(m[1][row], center_y)),
+					_mm_mul_ps(m[2][row], center_z)), m[3][row]);
+				new_extent[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, m[0][row]), extent_x), _mm_mul_ps(_mm_andnot_ps(sign, m[1][row]), extent_y)),
+					_mm_mul_ps(_mm_andnot_ps(sign, m[2][row]), extent_z));
+			}
+			_mm_storeu_ps(out.center_x + i, new_center[0]);
+			_mm_storeu_ps(out.center_y + i, new_center[1]);
+			_mm_storeu_ps(out.center_z + i, new_center[2]);
+			_mm_storeu_ps(out.extent_x + i, new_extent[0]);
+			_mm_storeu_ps(out.extent_y + i, new_extent[1]);
+			_mm_storeu_ps(out.extent_z + i, new_extent[2]);
+		}
+		TransformBoxesScalar(boxes, matrices, i, count, out);
+	}
+	// Stores rows[0..3], component column * 4 + row of eight matrices, as column column of out[0..7].
+	// The transpose works within each 128 bit lane: the low lanes hold out[0..3], the high lanes out[4..7].
+	OPENGL_GLFW_TARGET_AVX2 inline void StoreColumnAvx2(const __m256 rows[4], uniform::Mat4 *out, int column)
+	{
+		const __m256 low_01 = _mm256_unpacklo_ps(rows[0], rows[1]);
+		const __m256 high_01 = _mm256_unpackhi_ps(rows[0], rows[1]);
+		const __m256 low_23 = _mm256_unpacklo_ps(rows[2], rows[3]);
+		const __m256 high_23 = _mm256_unpackhi_ps(rows[2], rows[3]);
+		const __m256 columns[4] = {
+			_mm256_shuffle_ps(low_01, low_23, _MM_SHUFFLE(1, 0, 1, 0)), _mm256_shuffle_ps(low_01, low_23, _MM_SHUFFLE(3, 2, 3, 2)),
+			_mm256_shuffle_ps(high_01, high_23, _MM_SHUFFLE(1, 0, 1, 0)), _mm256_shuffle_ps(high_01, high_23, _MM_SHUFFLE(3, 2, 3, 2))
+		};
+		for (int j = 0; j < 4; ++j)
+		{
+			_mm_storeu_ps(out[j].columns[column].v, _mm256_castps256_ps128(columns[j]));
+			_mm_storeu_ps(out[j + 4].columns[column].v, _mm256_extractf128_ps(columns[j], 1));
+		}
+	}
+	OPENGL_GLFW_TARGET_AVX2 void ComposeMatricesAvx2(const Transforms &transforms, size_t count, uniform::Mat4 *out)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 zero = _mm256_setzero_ps();
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 x = _mm256_loadu_ps(transforms.rotation_x + i);
+			const __m256 y = _mm256_loadu_ps(transforms.rotation_y + i);
+			const __m256 z = _mm256_loadu_ps(transforms.rotation_z + i);
+			const __m256 w = _mm256_loadu_ps(transforms.rotation_w + i);
+			const __m256 x2 = _mm256_add_ps(x, x);
+			const __m256 y2 = _mm256_add_ps(y, y);
+			const __m256 z2 = _mm256_add_ps(z, z);
+			const __m256 xx = _mm256_mul_ps(x, x2);
+			const __m256 yy = _mm256_mul_ps(y, y2);
+			const __m256 zz = _mm256_mul_ps(z, z2);
+			const __m256 xy = _mm256_mul_ps(x, y2);
+			const __m256 xz = _mm256_mul_ps(x, z2);
+			const __m256 yz = _mm256_mul_ps(y, z2);
+			const __m256 wx = _mm256_mul_ps(w, x2);
+			const __m256 wy = _mm256_mul_ps(w, y2);
+			const __m256 wz = _mm256_mul_ps(w, z2);
+			const __m256 scale_x = _mm256_loadu_ps(transforms.scale_x + i);
+			const __m256 scale_y = _mm256_loadu_ps(transforms.scale_y + i);
+			const __m256 scale_z = _mm256_loadu_ps(transforms.scale_z + i);
+			const __m256 column_0[4] = { _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), scale_x), _mm256_mul_ps(_mm256_add_ps(xy, wz), scale_x),
+				_mm256_mul_ps(_mm256_sub_ps(xz, wy), scale_x), zero };
+			const __m256 column_1[4] = { _mm256_mul_ps(_mm256_sub_ps(xy, wz), scale_y), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), scale_y),
+				_mm256_mul_ps(_mm256_add_ps(yz, wx), scale_y), zero };
+			const __m256 column_2[4] = { _mm256_mul_ps(_mm256_add_ps(xz, wy), scale_z), _mm256_mul_ps(_mm256_sub_ps(yz, wx), scale_z),
+				_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), scale_z), zero };
+			const __m256 column_3[4] = { _mm256_loadu_ps(transforms.translation_x + i), _mm256_loadu_ps(transforms.translation_y + i),
+				_mm256_loadu_ps(transforms.translation_z + i), one };
+			StoreColumnAvx2(column_0, out + i, 0);
+			StoreColumnAvx2(column_1, out + i, 1);
+			StoreColumnAvx2(column_2, out + i, 2);
+			StoreColumnAvx2(column_3, out + i, 3);
+		}
+		ComposeMatricesScalar(transforms, i, count, out);
+	}
+	OPENGL_GLFW_TARGET_AVX2 void MultiplyMatricesAvx2(const uniform::Mat4 &left, const uniform::Mat4 *right, size_t count, uniform::Mat4 *out)
+	{
+		// Every column of left in both lanes, so two columns of a right matrix are done at once.
+		const __m256 left_0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left.columns[0].v));
+		const __m256 left_1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left.columns[1].v));
+		const __m256 left_2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left.columns[2].v));
+		const __m256 left_3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(left.columns[3].v));
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (int column = 0; column < 4; column += 2)
+			{
+				const __m256 r = _mm256_loadu_ps(right[i].columns[column].v);
+				const __m256 x = _mm256_permute_ps(r, _MM_SHUFFLE(0, 0, 0, 0));
+				const __m256 y = _mm256_permute_ps(r, _MM_SHUFFLE(1, 1, 1, 1));
+				const __m256 z = _mm256_permute_ps(r, _MM_SHUFFLE(2, 2, 2, 2));
+				const __m256 w = _mm256_permute_ps(r, _MM_SHUFFLE(3, 3, 3, 3));
+				const __m256 result = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(left_0, x), _mm256_mul_ps(left_1, y)),
+					_mm256_mul_ps(left_2, z)), _mm256_mul_ps(left_3, w));
+				_mm256_storeu_ps(out[i].columns[column].v, result);
+			}
+		}
+	}
+	OPENGL_GLFW_TARGET_AVX2 void TransformBoxesAvx2(const Boxes &boxes, const uniform::Mat4 *matrices, size_t count, const Boxes &out)
+	{
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		// The float offsets of the same component in eight consecutive matrices.
+		const __m256i stride = _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 center_x = _mm256_loadu_ps(boxes.center_x + i);
+			const __m256 center_y = _mm256_loadu_ps(boxes.center_y + i);
+			const __m256 center_z = _mm256_loadu_ps(boxes.center_z + i);
+			const __m256 extent_x = _mm256_loadu_ps(boxes.extent_x + i);
+			const __m256 extent_y = _mm256_loadu_ps(boxes.extent_y + i);
+			const __m256 extent_z = _mm256_loadu_ps(boxes.extent_z + i);
+			__m256 new_center[3];
+			__m256 new_extent[3];
+			for (int row = 0; row < 3; ++row)
+			{
+				// Gather row row of every column of the eight matrices; the bottom row is never needed.
+				__m256 m[4];
+				for (int column = 0; column < 4; ++column)
+					m[column] = _mm256_i32gather_ps(matrices[i].columns[column].v + row, stride, 4);
+				new_center[row] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0], center_x), _mm256_mul_ps(m[1], center_y)),
+					_mm256_mul_ps(m[2], center_z)), m[3]);
+				new_extent[row] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(sign, m[0]), extent_x),
+					_mm256_mul_ps(_mm256_andnot_ps(sign, m[1]), extent_y)), _mm256_mul_ps(_mm256_andnot_ps(sign, m[2]), extent_z));
+			}
+			_mm256_storeu_ps(out.center_x + i, new_center[0]);
+			_mm256_storeu_ps(out.center_y + i, new_center[1]);
+			_mm256_storeu_ps(out.center_z + i, new_center[2]);
+			_mm256_storeu_ps(out.extent_x + i, new_extent[0]);
+			_mm256_storeu_ps(out.extent_y + i, new_extent[1]);
+			_mm256_storeu_ps(out.extent_z + i, new_extent[2]);
+		}
+		TransformBoxesScalar(boxes, matrices, i, count, out);
+	}
+#endif
+	void ComposeMatrices(Path path, const Transforms &transforms, size_t count, uniform::Mat4 *out)
+	{
+#ifdef OPENGL_GLFW_X86
+		if (path == PATH_AVX2 && IsSupported(PATH_AVX2))
+			return ComposeMatricesAvx2(transforms, count, out);
+		if (path == PATH_SSE2 && IsSupported(PATH_SSE2))
+			return ComposeMatricesSse2(transforms, count, out);
+#endif
+		ComposeMatricesScalar(transforms, 0, count, out);
+	}
+	void MultiplyMatrices(Path path, const uniform::Mat4 &left, const uniform::Mat4 *right, size_t count, uniform::Mat4 *out)
+	{
+#ifdef OPENGL_GLFW_X86
+		if (path == PATH_AVX2 && IsSupported(PATH_AVX2))
+			return MultiplyMatricesAvx2(left, right, count, out);
+		if (path == PATH_SSE2 && IsSupported(PATH_SSE2))
+			return MultiplyMatricesSse2(left, right, count, out);
+#endif
+		MultiplyMatricesScalar(left, right, 0, count, out);
+	}
+	void TransformBoxes(Path path, const Boxes &boxes, const uniform::Mat4 *matrices, size_t count, const Boxes &out)
+	{
+#ifdef OPENGL_GLFW_X86
+		if (path == PATH_AVX2 && IsSupported(PATH_AVX2))
+			return TransformBoxesAvx2(boxes, matrices, count, out);
+		if (path == PATH_SSE2 && IsSupported(PATH_SSE2))
+			return TransformBoxesSse2(boxes, matrices, count, out);
+#endif
+		TransformBoxesScalar(boxes, matrices, 0, count, out);
+	}
+}
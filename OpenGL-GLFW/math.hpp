@@ -0,0 +1,66 @@
+#ifndef OPENGL_GLFW_TCU_MATH_H_
+#define OPENGL_GLFW_TCU_MATH_H_
+
+#include "standard.h"
+#include "uniform.hpp"
+#include <cstddef>
+
+namespace math
+{
+	// The implementations of the batch kernels. They return exactly the same bits: the SIMD paths
+	// do the same float operations in the same order as the scalar one (never fused), just four or
+	// eight values at a time.
+	enum Path
+	{
+		PATH_SCALAR, PATH_SSE2, PATH_AVX2
+	};
+	// Returns true if the processor supports path.
+	bool IsSupported(Path path);
+	// Returns the fastest path the processor supports.
+	Path GetBestPath();
+	const char *GetPathName(Path path);
+
+	// Transforms holds the placement of count objects as structure of arrays: every member points
+	// to count values, so a kernel loads one component of four or eight objects at once. The
+	// rotation is a unit quaternion (x, y, z, w); scale is applied before it, translation after it.
+	struct Transforms
+	{
+		const float *translation_x;
+		const float *translation_y;
+		const float *translation_z;
+		const float *rotation_x;
+		const float *rotation_y;
+		const float *rotation_z;
+		const float *rotation_w;
+		const float *scale_x;
+		const float *scale_y;
+		const float *scale_z;
+	};
+	// Boxes holds count axis aligned bounding boxes as structure of arrays: the centre and half the
+	// size along each axis.
+	struct Boxes
+	{
+		float *center_x;
+		float *center_y;
+		float *center_z;
+		float *extent_x;
+		float *extent_y;
+		float *extent_z;
+	};
+
+	// The kernels write whole matrices in the layout of uniform::Mat4 (column-major, 64 bytes), so out
+	// may point straight into a mapped instance or uniform buffer. Neither input nor output needs to
+	// be aligned.
+
+	// Writes the model matrix of each of the count transforms to out: translation * rotation * scale.
+	void ComposeMatrices(Path path, const Transforms &transforms, size_t count, uniform::Mat4 *out);
+	// Writes left * right[i] to out[i] for count matrices, e.g. the model-view-projection matrices of
+	// count objects from the view-projection matrix and their model matrices. out must not overlap right.
+	void MultiplyMatrices(Path path, const uniform::Mat4 &left, const uniform::Mat4 *right, size_t count, uniform::Mat4 *out);
+	// Writes to out the smallest axis aligned box around box i transformed by matrices[i] (which
+	// must be affine), for count boxes. out may be boxes itself.
+	// >> Arvo, "Transforming Axis-Aligned Bounding Boxes", Graphics Gems, 1990
+	void TransformBoxes(Path path, const Boxes &boxes, const uniform::Mat4 *matrices, size_t count, const Boxes &out);
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include "memory.hpp"
+#include <cstdint>
+#include <cstdlib>
+
+namespace memory
+{
+#ifdef OPENGL_GLFW_COUNT_ALLOCATIONS
+	// The heap allocations of the current thread. Plain thread-local data, so counting costs no
+	// synchronization and the worker threads do not disturb the render thread's count.
+	thread_local unsigned long long t_allocation_count = 0;
+#endif
+	// Rounds value up to a multiple of alignment, a power of two.
+	inline size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+	Arena::Arena()
+		: m_memory(0), m_capacity(0), m_used(0), m_overflow(0), m_overflow_bytes(0), m_overflow_count(0), m_peak(0)
+	{
+
+	}
+	Arena::~Arena()
+	{
+
+	}
+	void Arena::Create(size_t capacity)
+	{
+		m_memory = capacity > 0 ? static_cast<unsigned char*>(std::malloc(capacity)) : 0;
+		m_capacity = 0 != m_memory ? capacity : 0;
+		m_used = 0;
+	}
+	void Arena::Destroy()
+	{
+		Reset();
+		std::free(m_memory);
+		m_memory = 0;
+		m_capacity = 0;
+	}
+	void *Arena::Allocate(size_t size, size_t alignment)
+	{
+		// Align the address rather than the offset, so the block itself needs no special alignment.
+		const uintptr_t base = reinterpret_cast<uintptr_t>(m_memory);
+		const size_t offset = AlignUp(base + m_used, alignment) - base;
+		if (0 != m_memory && offset + size <= m_capacity)
+		{
+			m_used = offset + size;
+			return m_memory + offset;
+		}
+		// Out of memory: take a heap block for the rest of the frame. Reset grows the arena.
+		const size_t header = AlignUp(sizeof(OverflowBlock), alignment);
+		unsigned char *block = static_cast<unsigned char*>(std::malloc(header + size + alignment));
+		if (0 == block)
+			throw std::bad_alloc();
+		OverflowBlock *overflow = reinterpret_cast<OverflowBlock*>(block);
+		overflow->next = m_overflow;
+		m_overflow = overflow;
+		m_overflow_bytes += size + alignment;
+		++m_overflow_count;
+		return reinterpret_cast<void*>(AlignUp(reinterpret_cast<uintptr_t>(block) + header, alignment));
+	}
+	void Arena::Reset()
+	{
+		const size_t used = GetUsed();
+		if (used > m_peak)
+			m_peak = used;
+		if (0 != m_overflow)
+		{
+			while (0 != m_overflow)
+			{
+				OverflowBlock *next = m_overflow->next;
+				std::free(m_overflow);
+				m_overflow = next;
+			}
+			// Make room for the whole frame, with some slack so a slowly growing frame does not
+			// reallocate every time.
+			std::free(m_memory);
+			Create(used + used / 2);
+		}
+		m_used = 0;
+		m_overflow_bytes = 0;
+	}
+	Arena &GetFrameArena()
+	{
+		static Arena arena;
+		return arena;
+	}
+	unsigned long long GetThreadAllocationCount()
+	{
+#ifdef OPENGL_GLFW_COUNT_ALLOCATIONS
+		return t_allocation_count;
+#else
+		return 0;
+#endif
+	}
+}
+
+#ifdef OPENGL_GLFW_COUNT_ALLOCATIONS
+
+// The replacements of the global allocation functions count every allocation and otherwise behave
+// like the standard ones, minus the new handler.
+void *operator new(std::size_t size)
+{
+	++memory::t_allocation_count;
+	void *pointer = std::malloc(size > 0 ? size : 1);
+	if (0 == pointer)
+		throw std::bad_alloc();
+	return pointer;
+}
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+void *operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	++memory::t_allocation_count;
+	return std::malloc(size > 0 ? size : 1);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &nothrow) noexcept
+{
+	return operator new(size, nothrow);
+}
+void operator delete(void *pointer) noexcept
+{
+	std::free(pointer);
+}
+void operator delete[](void *pointer) noexcept
+{
+	std::free(pointer);
+}
+void operator delete(void *pointer, const std::nothrow_t&) noexcept
+{
+	std::free(pointer);
+}
+void operator delete[](void *pointer, const std::nothrow_t&) noexcept
+{
+	std::free(pointer);
+}
+#ifdef __cpp_sized_deallocation
+void operator delete(void *pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+#endif
+#endif
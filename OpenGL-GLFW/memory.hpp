@@ -0,0 +1,206 @@
+#ifndef OPENGL_GLFW_TCU_MEMORY_H_
+#define OPENGL_GLFW_TCU_MEMORY_H_
+
+#include "standard.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace memory
+{
+	// The alignment Arena::Allocate uses unless told otherwise. Enough for any scalar and for SSE.
+	const size_t DEFAULT_ALIGNMENT = 16;
+	// Arena hands out memory front to back and frees all of it at once with Reset. Allocating is a
+	// pointer bump; there is nothing to free, and destructors never run, so it suits trivially
+	// destructible data that lives for one frame (command lists, uniform data, scratch arrays).
+	//
+	// When the memory runs out, the arena falls back to the heap for the rest of the frame and grows
+	// to the frame's peak at the next Reset, so it settles at a size where frames never allocate.
+	// An Arena may only be used by one thread at a time.
+	class Arena
+	{
+	public:
+		Arena();
+		~Arena();
+		void Create(size_t capacity);
+		void Destroy();
+		// Returns size bytes aligned to alignment (a power of two). Never returns NULL.
+		void *Allocate(size_t size, size_t alignment = DEFAULT_ALIGNMENT);
+		// Returns count value-initialized objects of type T.
+		template <typename T>
+		T *NewArray(size_t count)
+		{
+			T *objects = static_cast<T*>(Allocate(sizeof(T) * count, std::alignment_of<T>::value));
+			for (size_t i = 0; i < count; ++i)
+				new (objects + i) T();
+			return objects;
+		}
+		// Frees everything allocated since the last Reset. Grows the arena if the heap had to help out.
+		void Reset();
+		size_t GetUsed() const { return m_used + m_overflow_bytes; }
+		size_t GetCapacity() const { return m_capacity; }
+		// The most bytes a frame used since Create.
+		size_t GetPeak() const { return m_peak; }
+		// The number of allocations that did not fit and came from the heap.
+		unsigned long long GetOverflowCount() const { return m_overflow_count; }
+	private:
+		// OverflowBlock starts every heap block of the current frame; they form a list.
+		struct OverflowBlock
+		{
+			OverflowBlock *next;
+		};
+		Arena(const Arena&);
+		Arena &operator=(const Arena&);
+		unsigned char *m_memory;
+		size_t m_capacity;
+		size_t m_used;
+		OverflowBlock *m_overflow;
+		size_t m_overflow_bytes;
+		unsigned long long m_overflow_count;
+		size_t m_peak;
+	};
+	// Returns the arena for data that lives until the end of the frame. It is reset after the
+	// buffers are swapped, so it may only be used on the render thread.
+	Arena &GetFrameArena();
+
+	// ArenaAllocator lets standard containers take their memory from an Arena. Deallocating does
+	// nothing; the memory comes back when the arena is reset, so the container must not outlive that.
+	template <typename T>
+	class ArenaAllocator
+	{
+	public:
+		typedef T value_type;
+		typedef T *pointer;
+		typedef const T *const_pointer;
+		typedef T &reference;
+		typedef const T &const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+		template <typename U>
+		struct rebind
+		{
+			typedef ArenaAllocator<U> other;
+		};
+		explicit ArenaAllocator(Arena &arena = GetFrameArena()) : m_arena(&arena) {}
+		template <typename U>
+		ArenaAllocator(const ArenaAllocator<U> &other) : m_arena(other.GetArena()) {}
+		T *allocate(size_t count, const void* = 0)
+		{
+			return static_cast<T*>(m_arena->Allocate(sizeof(T) * count, std::alignment_of<T>::value));
+		}
+		void deallocate(T*, size_t)
+		{
+
+		}
+		template <typename U, typename... Arguments>
+		void construct(U *object, Arguments&&... arguments)
+		{
+			new (object) U(std::forward<Arguments>(arguments)...);
+		}
+		template <typename U>
+		void destroy(U *object)
+		{
+			object->~U();
+		}
+		size_t max_size() const { return static_cast<size_t>(-1) / sizeof(T); }
+		Arena *GetArena() const { return m_arena; }
+	private:
+		Arena *m_arena;
+	};
+	template <typename T, typename U>
+	bool operator==(const ArenaAllocator<T> &left, const ArenaAllocator<U> &right) { return left.GetArena() == right.GetArena(); }
+	template <typename T, typename U>
+	bool operator!=(const ArenaAllocator<T> &left, const ArenaAllocator<U> &right) { return left.GetArena() != right.GetArena(); }
+	// FrameVector is a std::vector in the frame arena, for lists that are built and thrown away
+	// within one frame.
+	template <typename T>
+	using FrameVector = std::vector<T, ArenaAllocator<T> >;
+
+	// ObjectPool keeps objects of type T in blocks of objects_per_block and recycles the slots of
+	// deleted objects, so creating and deleting long-lived wrappers does not go to the heap each time
+	// and they stay close together in memory. Destroy frees the blocks; every object must have been
+	// deleted by then.
+	template <typename T>
+	class ObjectPool
+	{
+	public:
+		explicit ObjectPool(size_t objects_per_block = 64)
+			: m_objects_per_block(objects_per_block > 0 ? objects_per_block : 1), m_free(0), m_live_count(0)
+		{
+
+		}
+		~ObjectPool()
+		{
+
+		}
+		template <typename... Arguments>
+		T *New(Arguments&&... arguments)
+		{
+			if (0 == m_free)
+				AddBlock();
+			Slot *slot = m_free;
+			m_free = slot->next;
+			++m_live_count;
+			return new (&slot->storage) T(std::forward<Arguments>(arguments)...);
+		}
+		void Delete(T *object)
+		{
+			if (0 == object)
+				return;
+			object->~T();
+			Slot *slot = reinterpret_cast<Slot*>(object);
+			slot->next = m_free;
+			m_free = slot;
+			--m_live_count;
+		}
+		void Destroy()
+		{
+			for (size_t i = 0; i < m_blocks.size(); ++i)
+				delete[] m_blocks[i];
+			m_blocks.clear();
+			m_free = 0;
+			m_live_count = 0;
+		}
+		size_t GetLiveCount() const { return m_live_count; }
+		size_t GetCapacity() const { return m_blocks.size() * m_objects_per_block; }
+	private:
+		// A slot holds either an object or, while free, the next free slot.
+		union Slot
+		{
+			Slot *next;
+			typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+		};
+		ObjectPool(const ObjectPool&);
+		ObjectPool &operator=(const ObjectPool&);
+		void AddBlock()
+		{
+			Slot *block = new Slot[m_objects_per_block];
+			m_blocks.push_back(block);
+			// Chain the slots so they are handed out in address order.
+			for (size_t i = m_objects_per_block; i-- > 0;)
+			{
+				block[i].next = m_free;
+				m_free = block + i;
+			}
+		}
+		size_t m_objects_per_block;
+		std::vector<Slot*> m_blocks;
+		Slot *m_free;
+		size_t m_live_count;
+	};
+
+	// True in builds with OPENGL_GLFW_COUNT_ALLOCATIONS defined, which replace the global operator new
+	// and delete to count allocations. Benchmark builds define it; other builds keep the standard ones.
+#ifdef OPENGL_GLFW_COUNT_ALLOCATIONS
+	const bool COUNTS_ALLOCATIONS = true;
+#else
+	const bool COUNTS_ALLOCATIONS = false;
+#endif
+	// Returns the number of heap allocations (operator new and new[]) made by the calling thread
+	// since it started, or 0 without COUNTS_ALLOCATIONS. Differences between two calls show whether
+	// code in between allocates.
+	unsigned long long GetThreadAllocationCount();
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include "mesh.hpp"
+#include "opengl.h"
+#include "state_cache.hpp"
+#include "vertex_format.hpp"
+#include <cstring>
+
+namespace mesh
+{
+	// Returns true if the section of count elements of element_size bytes at offset lies inside the
+	// file and starts at a multiple of FILE_ALIGNMENT. Written to avoid overflows on hostile values.
+	inline bool IsValidSection(unsigned long long offset, unsigned long long count, unsigned long long element_size, unsigned long long file_size)
+	{
+		if (offset % FILE_ALIGNMENT != 0 || offset > file_size)
+			return false;
+		return element_size == 0 || count <= (file_size - offset) / element_size;
+	}
+	Mesh::Mesh()
+		: index_count(0), index_type(GL_UNSIGNED_INT)
+	{
+
+	}
+	void DrawMesh(const Mesh &mesh, size_t lod)
+	{
+		render::GetStateCache().BindVertexArray(mesh.vao.Get());
+		// The resource registry evicts the least recently drawn streamed meshes first.
+		mesh.vertex_buffer.Touch();
+		mesh.index_buffer.Touch();
+		if (lod >= mesh.lods.size())
+		{
+			glDrawElements(GL_TRIANGLES, mesh.index_count, mesh.index_type, 0);
+			return;
+		}
+		const size_t index_size = mesh.index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+		glDrawElements(GL_TRIANGLES, mesh.lods[lod].index_count, mesh.index_type, reinterpret_cast<const GLvoid*>(mesh.lods[lod].first_index * index_size));
+	}
+	void DestroyMesh(Mesh &mesh)
+	{
+		// Assigning deletes the objects.
+		mesh = Mesh();
+	}
+	MeshFile::MeshFile()
+		: m_header(0)
+	{
+
+	}
+	bool MeshFile::Open(const std::string &file_name)
+	{
+		Close();
+		if (!m_file.Open(file_name))
+		{
+			std::cerr << "Mesh file " << file_name << " could not be opened." << std::endl;
+			return false;
+		}
+		const FileHeader *header = reinterpret_cast<const FileHeader*>(m_file.GetData());
+		const unsigned long long file_size = m_file.GetSize();
+		const char *problem = 0;
+		if (file_size < sizeof(FileHeader) || 0 != std::memcmp(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)))
+			problem = "is not a mesh file";
+		else if (FILE_VERSION != header->version || header->header_size < sizeof(FileHeader))
+			problem = "has an unsupported version";
+		else if (header->file_size != file_size)
+			problem = "is truncated";
+		else if (header->index_type != GL_UNSIGNED_SHORT && header->index_type != GL_UNSIGNED_INT)
+			problem = "has an invalid index type";
+		else if (!IsValidSection(header->attribute_offset, header->attribute_count, sizeof(AttributeRecord), file_size)
+			|| !IsValidSection(header->vertex_offset, header->vertex_count, header->vertex_stride, file_size)
+			|| !IsValidSection(header->index_offset, header->index_count, header->index_type == GL_UNSIGNED_SHORT ? 2 : 4, file_size)
+			|| !IsValidSection(header->lod_offset, header->lod_count, sizeof(Lod), file_size)
+			|| !IsValidSection(header->meshlet_offset, header->meshlet_count, sizeof(Meshlet), file_size))
+			problem = "has a section outside the file";
+		if (0 != problem)
+		{
+			std::cerr << "Mesh file " << file_name << ' ' << problem << '.' << std::endl;
+			m_file.Close();
+			return false;
+		}
+		m_header = header;
+		// Upload reads all of it, front to back.
+		m_file.Prefetch();
+		for (unsigned int i = 0; i < header->attribute_count && 0 == problem; ++i)
+		{
+			if (GetAttributes()[i].offset >= header->vertex_stride)
+				problem = "has an attribute outside the vertex";
+		}
+		for (unsigned int i = 0; i < header->lod_count && 0 == problem; ++i)
+		{
+			const Lod &lod = GetLods()[i];
+			if (lod.first_index > header->index_count || lod.index_count > header->index_count - lod.first_index
+				|| lod.first_meshlet > header->meshlet_count || lod.meshlet_count > header->meshlet_count - lod.first_meshlet)
+				problem = "has a level of detail outside the mesh";
+		}
+		for (unsigned int i = 0; i < header->meshlet_count && 0 == problem; ++i)
+		{
+			const Meshlet &meshlet = GetMeshlets()[i];
+			if (meshlet.first_index > header->index_count || meshlet.index_count > header->index_count - meshlet.first_index)
+				problem = "has a meshlet outside the mesh";
+		}
+		if (0 != problem)
+		{
+			std::cerr << "Mesh file " << file_name << ' ' << problem << '.' << std::endl;
+			Close();
+			return false;
+		}
+		return true;
+	}
+	void MeshFile::Close()
+	{
+		m_file.Close();
+		m_header = 0;
+	}
+	const AttributeRecord *MeshFile::GetAttributes() const
+	{
+		return reinterpret_cast<const AttributeRecord*>(m_file.GetData() + m_header->attribute_offset);
+	}
+	const unsigned char *MeshFile::GetVertexData() const
+	{
+		return m_file.GetData() + m_header->vertex_offset;
+	}
+	const unsigned char *MeshFile::GetIndexData() const
+	{
+		return m_file.GetData() + m_header->index_offset;
+	}
+	const Lod *MeshFile::GetLods() const
+	{
+		return reinterpret_cast<const Lod*>(m_file.GetData() + m_header->lod_offset);
+	}
+	const Meshlet *MeshFile::GetMeshlets() const
+	{
+		return reinterpret_cast<const Meshlet*>(m_file.GetData() + m_header->meshlet_offset);
+	}
+	void MeshFile::Upload(Mesh &mesh) const
+	{
+		const FileHeader &header = *m_header;
+		render::StateCache &state = render::GetStateCache();
+		mesh.vao.Create(RESOURCE_SITE);
+		state.BindVertexArray(mesh.vao.Get());
+		mesh.vertex_buffer.Create(RESOURCE_SITE);
+		mesh.index_buffer.Create(RESOURCE_SITE);
+		// The pages of the mapping go straight to the driver; reading them is the only copy on the CPU.
+		const GLsizeiptr index_size = header.index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+		state.BindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer.Get());
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(header.vertex_count * header.vertex_stride), GetVertexData(), GL_STATIC_DRAW);
+		mesh.vertex_buffer.SetBytes(static_cast<long long>(header.vertex_count * header.vertex_stride));
+		state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer.Get());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(header.index_count * index_size), GetIndexData(), GL_STATIC_DRAW);
+		mesh.index_buffer.SetBytes(static_cast<long long>(header.index_count * index_size));
+		const AttributeRecord *attributes = GetAttributes();
+		for (unsigned int i = 0; i < header.attribute_count; ++i)
+			vertex::SetAttributePointer(attributes[i].location, attributes[i].size, attributes[i].type, attributes[i].normalized != 0, header.vertex_stride, attributes[i].offset);
+		mesh.index_count = static_cast<GLsizei>(header.index_count);
+		mesh.index_type = header.index_type;
+		mesh.lods.assign(GetLods(), GetLods() + header.lod_count);
+		mesh.meshlets.assign(GetMeshlets(), GetMeshlets() + header.meshlet_count);
+	}
+}
@@ -0,0 +1,119 @@
+#ifndef OPENGL_GLFW_TCU_MESH_H_
+#define OPENGL_GLFW_TCU_MESH_H_
+
+#include "standard.h"
+#include "mapped_file.hpp"
+#include "resource.hpp"
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+typedef int GLsizei;
+
+namespace mesh
+{
+	// A mesh file (.mesh) is laid out so it can be used straight from a mapping of the file:
+	//
+	//   FileHeader
+	//   AttributeRecord[attribute_count]   the vertex layout
+	//   vertex data                        vertex_count * vertex_stride bytes, interleaved
+	//   index data                         index_count indices of index_type
+	//   Lod[lod_count]                     index ranges, most detailed first
+	//   Meshlet[meshlet_count]             small index ranges with bounding spheres, for culling
+	//
+	// Every section starts at a multiple of FILE_ALIGNMENT. All values are little-endian, the byte
+	// order of every platform this runs on; a big-endian reader would reject the magic.
+	const char FILE_MAGIC[4] = { 'M', 'E', 'S', 'H' };
+	const unsigned int FILE_VERSION = 1;
+	const unsigned long long FILE_ALIGNMENT = 64;
+	struct FileHeader
+	{
+		char magic[4];
+		unsigned int version;
+		// sizeof(FileHeader) when the file was written, so later versions can append fields.
+		unsigned int header_size;
+		unsigned int attribute_count;
+		unsigned int vertex_stride;
+		// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+		unsigned int index_type;
+		unsigned int lod_count;
+		unsigned int meshlet_count;
+		unsigned long long vertex_count;
+		unsigned long long index_count;
+		// The byte offsets of the sections from the start of the file.
+		unsigned long long attribute_offset;
+		unsigned long long vertex_offset;
+		unsigned long long index_offset;
+		unsigned long long lod_offset;
+		unsigned long long meshlet_offset;
+		// The size of the whole file, to detect truncated files.
+		unsigned long long file_size;
+	};
+	// AttributeRecord describes one vertex attribute; the arguments of glVertexAttribPointer.
+	struct AttributeRecord
+	{
+		unsigned int location;
+		unsigned int size;
+		unsigned int type;
+		unsigned int normalized;
+		unsigned int offset;
+	};
+	// Lod is one level of detail: a range of the index data and of the meshlets that cover it.
+	struct Lod
+	{
+		unsigned int first_index;
+		unsigned int index_count;
+		unsigned int first_meshlet;
+		unsigned int meshlet_count;
+		// The largest distance (in object space) between this level and the full mesh.
+		float max_error;
+	};
+	// Meshlet is a small range of triangles, bounded by a sphere (laid out like culling::Sphere).
+	struct Meshlet
+	{
+		unsigned int first_index;
+		unsigned int index_count;
+		float center[3];
+		float radius;
+	};
+	// Mesh is a mesh in buffer objects, ready to draw. It owns the objects, so it can be moved but
+	// not copied.
+	struct Mesh
+	{
+		Mesh();
+		resource::VertexArray vao;
+		resource::Buffer vertex_buffer;
+		resource::Buffer index_buffer;
+		GLsizei index_count;
+		GLenum index_type;
+		std::vector<Lod> lods;
+		std::vector<Meshlet> meshlets;
+	};
+	// Draws level of detail lod of mesh (0 is the most detailed).
+	void DrawMesh(const Mesh &mesh, size_t lod = 0);
+	// Deletes the buffer objects and the VAO of mesh.
+	void DestroyMesh(Mesh &mesh);
+	// MeshFile reads a mesh file through a MappedFile. Nothing is parsed or copied: the accessors
+	// point into the mapping, and Upload hands the vertex and index data to OpenGL from there.
+	class MeshFile
+	{
+	public:
+		MeshFile();
+		// Maps file_name and checks that the header and the section offsets are valid, so the
+		// accessors never read outside the file. Prints the problem and returns false otherwise.
+		bool Open(const std::string &file_name);
+		void Close();
+		bool IsOpen() const { return 0 != m_header; }
+		const FileHeader &GetHeader() const { return *m_header; }
+		const AttributeRecord *GetAttributes() const;
+		const unsigned char *GetVertexData() const;
+		const unsigned char *GetIndexData() const;
+		const Lod *GetLods() const;
+		const Meshlet *GetMeshlets() const;
+		// Creates the VAO and buffers of mesh and uploads the data straight from the mapping.
+		void Upload(Mesh &mesh) const;
+	private:
+		MappedFile m_file;
+		const FileHeader *m_header;
+	};
+}
+
+#endif
@@ -0,0 +1,301 @@
+#include "mesh_converter.hpp"
+#include "mapped_file.hpp"
+#include "opengl.h"
+#include "state_cache.hpp"
+#include "vertex_format.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+namespace mesh
+{
+	// The vertex layout of converted meshes: 20 bytes per vertex.
+	typedef vertex::Format<
+		vertex::Attribute<MESH_POSITION, GLfloat, 3>,
+		vertex::Attribute<MESH_NORMAL, vertex::Int2101010Rev, 1, true>,
+		vertex::Attribute<MESH_TEXCOORD, vertex::Half, 2> > MeshVertexFormat;
+	// ObjCorner is a corner of an OBJ face: 0-based position, texture coordinate and normal indices
+	// (-1 if the face has none).
+	struct ObjCorner
+	{
+		int position;
+		int texcoord;
+		int normal;
+		bool operator==(const ObjCorner &other) const
+		{
+			return position == other.position && texcoord == other.texcoord && normal == other.normal;
+		}
+	};
+	struct ObjCornerHash
+	{
+		size_t operator()(const ObjCorner &corner) const
+		{
+			return static_cast<size_t>(corner.position * 73856093u ^ corner.texcoord * 19349663u ^ corner.normal * 83492791u);
+		}
+	};
+	// Rounds offset up to the next multiple of FILE_ALIGNMENT.
+	inline unsigned long long Align(unsigned long long offset)
+	{
+		return (offset + FILE_ALIGNMENT - 1) / FILE_ALIGNMENT * FILE_ALIGNMENT;
+	}
+	// Turns a 1-based (or negative, relative to count) OBJ index into a 0-based one. -1 if it is out of range.
+	inline int ResolveIndex(long index, size_t count)
+	{
+		const long resolved = index < 0 ? static_cast<long>(count) + index : index - 1;
+		return (resolved >= 0 && resolved < static_cast<long>(count)) ? static_cast<int>(resolved) : -1;
+	}
+	MeshData::MeshData()
+		: vertex_stride(0)
+	{
+
+	}
+	bool ParseObj(const char *text, size_t size, MeshData &data)
+	{
+		vertex::AttributeDescription descriptions[MeshVertexFormat::ATTRIBUTE_COUNT];
+		MeshVertexFormat::Describe(descriptions);
+		data = MeshData();
+		for (size_t i = 0; i < MeshVertexFormat::ATTRIBUTE_COUNT; ++i)
+		{
+			const AttributeRecord record = { descriptions[i].location, static_cast<unsigned int>(descriptions[i].size),
+				descriptions[i].type, descriptions[i].normalized ? 1u : 0u, static_cast<unsigned int>(descriptions[i].offset) };
+			data.attributes.push_back(record);
+		}
+		data.vertex_stride = static_cast<unsigned int>(MeshVertexFormat::STRIDE);
+		std::vector<float> positions;
+		std::vector<float> texcoords;
+		std::vector<float> normals;
+		std::unordered_map<ObjCorner, unsigned int, ObjCornerHash> vertex_indices;
+		std::vector<unsigned int> face;
+		// Every line is copied into line, so strtof and strtol stop at its end even though text,
+		// which may be a file mapping, is not null-terminated.
+		std::string line;
+		const char *end = text + size;
+		for (const char *begin = text; begin < end;)
+		{
+			const char *line_end = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+			if (0 == line_end)
+				line_end = end;
+			line.assign(begin, line_end);
+			begin = line_end + 1;
+			const char *cursor = line.c_str();
+			if (cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == 't' || cursor[1] == 'n'))
+			{
+				std::vector<float> &values = cursor[1] == ' ' ? positions : (cursor[1] == 't' ? texcoords : normals);
+				const int count = cursor[1] == 't' ? 2 : 3;
+				cursor += 2;
+				for (int i = 0; i < count; ++i)
+				{
+					char *next;
+					values.push_back(std::strtof(cursor, &next));
+					cursor = next;
+				}
+			}
+			else if (cursor[0] == 'f' && cursor[1] == ' ')
+			{
+				face.clear();
+				cursor += 2;
+				for (;;)
+				{
+					char *next;
+					const long position = std::strtol(cursor, &next, 10);
+					if (next == cursor)
+						break;
+					ObjCorner corner = { ResolveIndex(position, positions.size() / 3), -1, -1 };
+					if (corner.position < 0)
+						return false;
+					cursor = next;
+					// v/vt/vn, v//vn or v/vt.
+					if (*cursor == '/')
+					{
+						++cursor;
+						if (*cursor != '/')
+						{
+							corner.texcoord = ResolveIndex(std::strtol(cursor, &next, 10), texcoords.size() / 2);
+							cursor = next;
+						}
+						if (*cursor == '/')
+						{
+							corner.normal = ResolveIndex(std::strtol(cursor + 1, &next, 10), normals.size() / 3);
+							cursor = next;
+						}
+					}
+					std::unordered_map<ObjCorner, unsigned int, ObjCornerHash>::iterator found = vertex_indices.find(corner);
+					if (found == vertex_indices.end())
+					{
+						const unsigned int index = static_cast<unsigned int>(vertex_indices.size());
+						found = vertex_indices.insert(std::make_pair(corner, index)).first;
+						MeshVertexFormat::Vertex vertex;
+						const float *position_values = &positions[corner.position * 3];
+						vertex.Set<0>(position_values[0], position_values[1], position_values[2]);
+						if (corner.normal >= 0)
+						{
+							const float *normal = &normals[corner.normal * 3];
+							vertex.Set<1>(vertex::PackInt2101010Rev(normal[0], normal[1], normal[2]));
+						}
+						else
+							vertex.Set<1>(vertex::PackInt2101010Rev(0.0f, 0.0f, 1.0f));
+						const float *texcoord = corner.texcoord >= 0 ? &texcoords[corner.texcoord * 2] : 0;
+						vertex.Set<2>(vertex::ToHalf(texcoord ? texcoord[0] : 0.0f), vertex::ToHalf(texcoord ? texcoord[1] : 0.0f));
+						data.vertices.insert(data.vertices.end(), vertex.bytes, vertex.bytes + MeshVertexFormat::STRIDE);
+					}
+					face.push_back(found->second);
+				}
+				for (size_t i = 2; i < face.size(); ++i)
+				{
+					data.indices.push_back(face[0]);
+					data.indices.push_back(face[i - 1]);
+					data.indices.push_back(face[i]);
+				}
+			}
+		}
+		return true;
+	}
+	bool LoadObj(const std::string &file_name, MeshData &data)
+	{
+		MappedFile file;
+		if (!file.Open(file_name))
+		{
+			std::cerr << "File " << file_name << " could not be opened." << std::endl;
+			return false;
+		}
+		file.Prefetch();
+		if (!ParseObj(reinterpret_cast<const char*>(file.GetData()), file.GetSize(), data))
+		{
+			std::cerr << "File " << file_name << " has a face with an invalid index." << std::endl;
+			return false;
+		}
+		return true;
+	}
+	void BuildMeshlets(MeshData &data)
+	{
+		data.meshlets.clear();
+		data.lods.clear();
+		const size_t stride = data.vertex_stride;
+		for (size_t first = 0; first < data.indices.size(); first += MESHLET_MAX_TRIANGLES * 3)
+		{
+			const size_t count = std::min<size_t>(MESHLET_MAX_TRIANGLES * 3, data.indices.size() - first);
+			// The sphere around the centre of the bounding box: not minimal, but cheap and always enclosing.
+			float minimum[3] = { 1e30f, 1e30f, 1e30f };
+			float maximum[3] = { -1e30f, -1e30f, -1e30f };
+			for (size_t i = first; i < first + count; ++i)
+			{
+				float position[3];
+				std::memcpy(position, &data.vertices[data.indices[i] * stride], sizeof(position));
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					minimum[axis] = std::min(minimum[axis], position[axis]);
+					maximum[axis] = std::max(maximum[axis], position[axis]);
+				}
+			}
+			Meshlet meshlet;
+			meshlet.first_index = static_cast<unsigned int>(first);
+			meshlet.index_count = static_cast<unsigned int>(count);
+			float radius_squared = 0.0f;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				meshlet.center[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+				const float half_extent = (maximum[axis] - minimum[axis]) * 0.5f;
+				radius_squared += half_extent * half_extent;
+			}
+			meshlet.radius = std::sqrt(radius_squared);
+			data.meshlets.push_back(meshlet);
+		}
+		const Lod lod = { 0, static_cast<unsigned int>(data.indices.size()), 0, static_cast<unsigned int>(data.meshlets.size()), 0.0f };
+		data.lods.push_back(lod);
+	}
+	// Writes size bytes of data and pads the file up to offset, the start of the next section.
+	inline bool WriteSection(FILE *file, const void *data, size_t size, unsigned long long &position, unsigned long long offset)
+	{
+		static const char PADDING[FILE_ALIGNMENT] = { 0 };
+		if (size > 0 && std::fwrite(data, 1, size, file) != size)
+			return false;
+		position += size;
+		const size_t padding = static_cast<size_t>(offset - position);
+		if (padding > 0 && std::fwrite(PADDING, 1, padding, file) != padding)
+			return false;
+		position = offset;
+		return true;
+	}
+	bool WriteMeshFile(const std::string &file_name, const MeshData &data)
+	{
+		const size_t vertex_count = data.vertex_stride > 0 ? data.vertices.size() / data.vertex_stride : 0;
+		const bool short_indices = vertex_count < 65536;
+		const size_t index_size = short_indices ? 2 : 4;
+		FileHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+		header.version = FILE_VERSION;
+		header.header_size = sizeof(FileHeader);
+		header.attribute_count = static_cast<unsigned int>(data.attributes.size());
+		header.vertex_stride = data.vertex_stride;
+		header.index_type = short_indices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		header.lod_count = static_cast<unsigned int>(data.lods.size());
+		header.meshlet_count = static_cast<unsigned int>(data.meshlets.size());
+		header.vertex_count = vertex_count;
+		header.index_count = data.indices.size();
+		header.attribute_offset = Align(sizeof(FileHeader));
+		header.vertex_offset = Align(header.attribute_offset + data.attributes.size() * sizeof(AttributeRecord));
+		header.index_offset = Align(header.vertex_offset + data.vertices.size());
+		header.lod_offset = Align(header.index_offset + data.indices.size() * index_size);
+		header.meshlet_offset = Align(header.lod_offset + data.lods.size() * sizeof(Lod));
+		header.file_size = header.meshlet_offset + data.meshlets.size() * sizeof(Meshlet);
+		std::vector<unsigned short> short_index_data;
+		if (short_indices)
+			short_index_data.assign(data.indices.begin(), data.indices.end());
+		FILE *file = std::fopen(file_name.c_str(), "wb");
+		if (0 == file)
+		{
+			std::cerr << "File " << file_name << " could not be opened." << std::endl;
+			return false;
+		}
+		unsigned long long position = 0;
+		bool written = WriteSection(file, &header, sizeof(header), position, header.attribute_offset)
+			&& WriteSection(file, data.attributes.empty() ? 0 : &data.attributes[0], data.attributes.size() * sizeof(AttributeRecord), position, header.vertex_offset)
+			&& WriteSection(file, data.vertices.empty() ? 0 : &data.vertices[0], data.vertices.size(), position, header.index_offset)
+			&& WriteSection(file, data.indices.empty() ? 0 : (short_indices ? static_cast<const void*>(&short_index_data[0]) : &data.indices[0]),
+				data.indices.size() * index_size, position, header.lod_offset)
+			&& WriteSection(file, data.lods.empty() ? 0 : &data.lods[0], data.lods.size() * sizeof(Lod), position, header.meshlet_offset)
+			&& WriteSection(file, data.meshlets.empty() ? 0 : &data.meshlets[0], data.meshlets.size() * sizeof(Meshlet), position, header.file_size);
+		written = (0 == std::fclose(file)) && written;
+		if (!written)
+			std::cerr << "File " << file_name << " could not be written." << std::endl;
+		return written;
+	}
+	void UploadMeshData(const MeshData &data, Mesh &mesh)
+	{
+		render::StateCache &state = render::GetStateCache();
+		mesh.vao.Create(RESOURCE_SITE);
+		state.BindVertexArray(mesh.vao.Get());
+		mesh.vertex_buffer.Create(RESOURCE_SITE);
+		mesh.index_buffer.Create(RESOURCE_SITE);
+		state.BindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer.Get());
+		glBufferData(GL_ARRAY_BUFFER, data.vertices.size(), data.vertices.empty() ? NULL : &data.vertices[0], GL_STATIC_DRAW);
+		mesh.vertex_buffer.SetBytes(static_cast<long long>(data.vertices.size()));
+		state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer.Get());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(GLuint), data.indices.empty() ? NULL : &data.indices[0], GL_STATIC_DRAW);
+		mesh.index_buffer.SetBytes(static_cast<long long>(data.indices.size() * sizeof(GLuint)));
+		for (size_t i = 0; i < data.attributes.size(); ++i)
+		{
+			const AttributeRecord &attribute = data.attributes[i];
+			vertex::SetAttributePointer(attribute.location, attribute.size, attribute.type, attribute.normalized != 0, data.vertex_stride, attribute.offset);
+		}
+		mesh.index_count = static_cast<GLsizei>(data.indices.size());
+		mesh.index_type = GL_UNSIGNED_INT;
+		mesh.lods = data.lods;
+		mesh.meshlets = data.meshlets;
+	}
+	bool ConvertObj(const std::string &obj_file_name, const std::string &mesh_file_name)
+	{
+		MeshData data;
+		if (!LoadObj(obj_file_name, data))
+			return false;
+		BuildMeshlets(data);
+		if (!WriteMeshFile(mesh_file_name, data))
+			return false;
+		std::cout << "Converted " << obj_file_name << " to " << mesh_file_name << ": " << data.vertices.size() / data.vertex_stride << " vertices, "
+			<< data.indices.size() / 3 << " triangles, " << data.meshlets.size() << " meshlets." << std::endl;
+		return true;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef OPENGL_GLFW_TCU_MESH_CONVERTER_H_
+#define OPENGL_GLFW_TCU_MESH_CONVERTER_H_
+
+#include "standard.h"
+#include "mesh.hpp"
+
+namespace mesh
+{
+	// The attribute locations of converted meshes. They follow the instance attributes of program::QuadBatch.
+	enum MeshAttribute
+	{
+		MESH_POSITION = 0, MESH_NORMAL = 4, MESH_TEXCOORD = 5
+	};
+	// The most triangles BuildMeshlets puts in a meshlet.
+	const unsigned int MESHLET_MAX_TRIANGLES = 124;
+	// MeshData is a mesh in memory, in the layout of a mesh file. The converter writes float positions
+	// (always the first attribute), 2_10_10_10 normals and half float texture coordinates.
+	struct MeshData
+	{
+		MeshData();
+		std::vector<AttributeRecord> attributes;
+		unsigned int vertex_stride;
+		std::vector<unsigned char> vertices;
+		std::vector<unsigned int> indices;
+		std::vector<Lod> lods;
+		std::vector<Meshlet> meshlets;
+	};
+	// Parses size bytes of Wavefront OBJ text into data: v, vt, vn and f lines. Polygons become triangle
+	// fans, corners that share position, texture coordinate and normal are merged, and negative indices
+	// count from the end. Everything else (materials, groups, lines) is ignored. Returns false if a face
+	// refers to a position that does not exist; missing texture coordinates and normals are zero.
+	bool ParseObj(const char *text, size_t size, MeshData &data);
+	// Parses the OBJ file called file_name.
+	bool LoadObj(const std::string &file_name, MeshData &data);
+	// Splits the indices into meshlets of up to MESHLET_MAX_TRIANGLES consecutive triangles, computes
+	// their bounding spheres, and adds a single level of detail covering everything.
+	void BuildMeshlets(MeshData &data);
+	// Writes data as a mesh file. Uses 16 bit indices if there are fewer than 65536 vertices.
+	bool WriteMeshFile(const std::string &file_name, const MeshData &data);
+	// Creates the VAO and buffers of mesh from data, e.g. to draw an OBJ file without converting it.
+	void UploadMeshData(const MeshData &data, Mesh &mesh);
+	// Converts the OBJ file obj_file_name to the mesh file mesh_file_name.
+	bool ConvertObj(const std::string &obj_file_name, const std::string &mesh_file_name);
+}
+
+#endif
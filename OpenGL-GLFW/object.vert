@@ -0,0 +1,21 @@
+#version 150 core
+// Attribute locations in the shader need GLSL 3.30; Mesa's 3.2 core contexts only offer them as an extension.
+#extension GL_ARB_explicit_attrib_location : require
+
+layout(location = 0) in vec4 vertex_position;
+layout(location = 1) in vec4 vertex_colour;
+
+// The uniforms of one object, selected per draw with glBindBufferRange (see uniform::UniformArena).
+layout(std140) uniform Object
+{
+    mat4 transform;
+    vec4 colour;
+};
+
+smooth out vec4 fragment_colour;
+
+void main()
+{
+    fragment_colour = vertex_colour * colour;
+    gl_Position = transform * vertex_position;
+}
\ No newline at end of file
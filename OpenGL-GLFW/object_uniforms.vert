@@ -0,0 +1,18 @@
+#version 150 core
+// Attribute locations in the shader need GLSL 3.30; Mesa's 3.2 core contexts only offer them as an extension.
+#extension GL_ARB_explicit_attrib_location : require
+
+layout(location = 0) in vec4 vertex_position;
+layout(location = 1) in vec4 vertex_colour;
+
+// The same as object.vert, with default block uniforms set by glUniform* for every draw.
+uniform mat4 transform;
+uniform vec4 colour;
+
+smooth out vec4 fragment_colour;
+
+void main()
+{
+    fragment_colour = vertex_colour * colour;
+    gl_Position = transform * vertex_position;
+}
\ No newline at end of file
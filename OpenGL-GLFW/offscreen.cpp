@@ -0,0 +1,222 @@
+#include "offscreen.hpp"
+#include "opengl.h"
+#include "state_cache.hpp"
+#ifdef OPENGL_GLFW_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace offscreen
+{
+	HeadlessContext::HeadlessContext()
+		: m_display(0), m_context(0), m_surface(0)
+	{
+
+	}
+	HeadlessContext::~HeadlessContext()
+	{
+
+	}
+	bool HeadlessContext::Create()
+	{
+#ifdef OPENGL_GLFW_EGL
+		EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if (EGL_NO_DISPLAY == display || !eglInitialize(display, NULL, NULL))
+		{
+			std::cerr << "EGL display could not be initialized." << std::endl;
+			return false;
+		}
+		// We only need a tiny pbuffer config; everything is rendered into a RenderTarget.
+		const EGLint config_attributes[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint config_count = 0;
+		if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count == 0)
+		{
+			std::cerr << "No suitable EGL config found." << std::endl;
+			eglTerminate(display);
+			return false;
+		}
+		eglBindAPI(EGL_OPENGL_API);
+		// Request the same context the window path asks GLFW for: 3.2, core, forward compatible.
+		const EGLint context_attributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 2,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE, EGL_TRUE,
+			EGL_NONE
+		};
+		EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+		if (EGL_NO_CONTEXT == context)
+		{
+			std::cerr << "EGL context could not be created." << std::endl;
+			eglTerminate(display);
+			return false;
+		}
+		// Prefer a surfaceless context; fall back to a 1x1 pbuffer for drivers without
+		// EGL_KHR_surfaceless_context.
+		EGLSurface surface = EGL_NO_SURFACE;
+		if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		{
+			const EGLint pbuffer_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+			surface = eglCreatePbufferSurface(display, config, pbuffer_attributes);
+			if (EGL_NO_SURFACE == surface || !eglMakeCurrent(display, surface, surface, context))
+			{
+				std::cerr << "EGL context could not be made current." << std::endl;
+				eglDestroyContext(display, context);
+				eglTerminate(display);
+				return false;
+			}
+		}
+		m_display = display;
+		m_context = context;
+		m_surface = surface;
+		return true;
+#else
+		std::cerr << "Headless mode requires a build with OPENGL_GLFW_EGL defined." << std::endl;
+		return false;
+#endif
+	}
+	void HeadlessContext::Destroy()
+	{
+#ifdef OPENGL_GLFW_EGL
+		if (0 == m_display)
+			return;
+		eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (0 != m_surface)
+			eglDestroySurface(m_display, m_surface);
+		eglDestroyContext(m_display, m_context);
+		eglTerminate(m_display);
+		m_display = 0;
+		m_context = 0;
+		m_surface = 0;
+#endif
+	}
+	RenderTarget::RenderTarget()
+		: m_width(0), m_height(0)
+	{
+
+	}
+	RenderTarget::~RenderTarget()
+	{
+
+	}
+	bool RenderTarget::Create(int width, int height)
+	{
+		m_width = width;
+		m_height = height;
+		// >> glRenderbufferStorage establishes the data storage, format, and dimensions of a
+		// >> renderbuffer object's image.
+		m_colour_rbo.Create(RESOURCE_SITE);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_colour_rbo.Get());
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		m_colour_rbo.SetBytes(4LL * width * height);
+		// Match the 24 bit depth and 8 bit stencil buffer main.cpp asks GLFW for.
+		m_depth_rbo.Create(RESOURCE_SITE);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_depth_rbo.Get());
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		m_depth_rbo.SetBytes(4LL * width * height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		m_fbo.Create(RESOURCE_SITE);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo.Get());
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colour_rbo.Get());
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depth_rbo.Get());
+		const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (GL_FRAMEBUFFER_COMPLETE != status)
+		{
+			std::cerr << "Offscreen framebuffer is incomplete (0x" << std::hex << status << std::dec << ")." << std::endl;
+			return false;
+		}
+		return true;
+	}
+	void RenderTarget::Bind()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo.Get());
+		render::GetStateCache().Viewport(0, 0, m_width, m_height);
+	}
+	void RenderTarget::Unbind()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	void RenderTarget::ReadPixels(std::vector<unsigned char> &pixels)
+	{
+		pixels.resize(static_cast<size_t>(m_width) * m_height * 4);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo.Get());
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	}
+	void RenderTarget::Destroy()
+	{
+		m_fbo.Reset();
+		m_colour_rbo.Reset();
+		m_depth_rbo.Reset();
+	}
+	bool WritePPM(const std::string file_name, int width, int height, const std::vector<unsigned char> &pixels)
+	{
+		std::ofstream file(file_name.c_str(), std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "File " << file_name << " could not be opened." << std::endl;
+			return false;
+		}
+		file << "P6\n" << width << ' ' << height << "\n255\n";
+		// PPM stores the top row first and has no alpha channel.
+		std::vector<unsigned char> row(static_cast<size_t>(width) * 3);
+		for (int y = height - 1; y >= 0; --y)
+		{
+			const unsigned char *source = &pixels[static_cast<size_t>(y) * width * 4];
+			for (int x = 0; x < width; ++x)
+			{
+				row[x * 3 + 0] = source[x * 4 + 0];
+				row[x * 3 + 1] = source[x * 4 + 1];
+				row[x * 3 + 2] = source[x * 4 + 2];
+			}
+			file.write(reinterpret_cast<const char*>(&row[0]), row.size());
+		}
+		return true;
+	}
+	bool ReadPPM(const std::string file_name, int &width, int &height, std::vector<unsigned char> &pixels)
+	{
+		std::ifstream file(file_name.c_str(), std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "File " << file_name << " could not be opened." << std::endl;
+			return false;
+		}
+		std::string magic;
+		int maximum = 0;
+		file >> magic >> width >> height >> maximum;
+		// A single whitespace character separates the header from the pixels.
+		file.get();
+		if (!file || "P6" != magic || 255 != maximum || width <= 0 || height <= 0)
+		{
+			std::cerr << file_name << " is not a binary PPM file with 8 bit channels." << std::endl;
+			return false;
+		}
+		pixels.resize(static_cast<size_t>(width) * height * 4);
+		std::vector<unsigned char> row(static_cast<size_t>(width) * 3);
+		for (int y = height - 1; y >= 0; --y)
+		{
+			if (!file.read(reinterpret_cast<char*>(&row[0]), row.size()))
+			{
+				std::cerr << file_name << " is truncated." << std::endl;
+				return false;
+			}
+			unsigned char *target = &pixels[static_cast<size_t>(y) * width * 4];
+			for (int x = 0; x < width; ++x)
+			{
+				target[x * 4 + 0] = row[x * 3 + 0];
+				target[x * 4 + 1] = row[x * 3 + 1];
+				target[x * 4 + 2] = row[x * 3 + 2];
+				target[x * 4 + 3] = 255;
+			}
+		}
+		return true;
+	}
+}
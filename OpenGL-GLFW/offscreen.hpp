@@ -0,0 +1,60 @@
+#ifndef OPENGL_GLFW_TCU_OFFSCREEN_H_
+#define OPENGL_GLFW_TCU_OFFSCREEN_H_
+
+#include "standard.h"
+#include "resource.hpp"
+
+namespace offscreen
+{
+	// HeadlessContext creates an OpenGL 3.2 core context without a window, so the
+	// program can run on machines without a display (e.g. Mesa llvmpipe on a render node).
+	// It is only available when the project is built with OPENGL_GLFW_EGL defined and
+	// linked against libEGL; otherwise Create always fails.
+	class HeadlessContext
+	{
+	public:
+		HeadlessContext();
+		~HeadlessContext();
+		// Creates the context and makes it current on the calling thread. Returns false on failure.
+		bool Create();
+		// Releases and destroys the context.
+		void Destroy();
+	private:
+		void *m_display;
+		void *m_context;
+		void *m_surface;
+	};
+	// RenderTarget is a framebuffer object with a colour and depth/stencil renderbuffer.
+	// Anything drawn while it is bound ends up in the renderbuffers instead of a window.
+	class RenderTarget
+	{
+	public:
+		RenderTarget();
+		~RenderTarget();
+		// Creates the framebuffer. Returns false if it is incomplete.
+		bool Create(int width, int height);
+		// Binds the framebuffer and sets the viewport to cover it.
+		void Bind();
+		// Binds the default framebuffer again.
+		void Unbind();
+		// Reads the colour buffer back as tightly packed RGBA8 rows, bottom row first.
+		void ReadPixels(std::vector<unsigned char> &pixels);
+		void Destroy();
+		int GetWidth() const { return m_width; }
+		int GetHeight() const { return m_height; }
+		GLuint GetFramebuffer() const { return m_fbo.Get(); }
+	private:
+		resource::Framebuffer m_fbo;
+		resource::Renderbuffer m_colour_rbo;
+		resource::Renderbuffer m_depth_rbo;
+		int m_width;
+		int m_height;
+	};
+	// Writes RGBA8 pixels (bottom row first, as returned by RenderTarget::ReadPixels) to a binary PPM file.
+	bool WritePPM(const std::string file_name, int width, int height, const std::vector<unsigned char> &pixels);
+	// Reads a binary PPM file written by WritePPM back into RGBA8 pixels, bottom row first, with an alpha of
+	// 255. Returns false if the file cannot be read or is not such a file.
+	bool ReadPPM(const std::string file_name, int &width, int &height, std::vector<unsigned char> &pixels);
+}
+
+#endif
@@ -2,4 +2,56 @@
 #define OPENGL_H_
 #include <GL/glew.h>
 #include <GL/glfw.h>
-#endif
\ No newline at end of file
+
+// GLEW calls every entry point newer than OpenGL 1.1 through a function pointer (glBufferData is
+// __glewBufferData), but links the 1.1 entry points directly. The 1.1 entry points the program uses
+// go through pointers of their own here, so trace::StartCapture can swap all of them for functions
+// that record the call. trace.cpp defines the pointers, and defines OPENGL_GLFW_DIRECT_GL_1_1 to see
+// the functions themselves.
+#ifndef OPENGL_GLFW_DIRECT_GL_1_1
+extern decltype(&glClear) opengl_glfw_glClear;
+extern decltype(&glClearColor) opengl_glfw_glClearColor;
+extern decltype(&glEnable) opengl_glfw_glEnable;
+extern decltype(&glDisable) opengl_glfw_glDisable;
+extern decltype(&glViewport) opengl_glfw_glViewport;
+extern decltype(&glBlendFunc) opengl_glfw_glBlendFunc;
+extern decltype(&glCullFace) opengl_glfw_glCullFace;
+extern decltype(&glDepthFunc) opengl_glfw_glDepthFunc;
+extern decltype(&glDepthMask) opengl_glfw_glDepthMask;
+extern decltype(&glPixelStorei) opengl_glfw_glPixelStorei;
+extern decltype(&glReadPixels) opengl_glfw_glReadPixels;
+extern decltype(&glFinish) opengl_glfw_glFinish;
+extern decltype(&glGetError) opengl_glfw_glGetError;
+extern decltype(&glGenTextures) opengl_glfw_glGenTextures;
+extern decltype(&glDeleteTextures) opengl_glfw_glDeleteTextures;
+extern decltype(&glBindTexture) opengl_glfw_glBindTexture;
+extern decltype(&glTexImage2D) opengl_glfw_glTexImage2D;
+extern decltype(&glTexParameteri) opengl_glfw_glTexParameteri;
+extern decltype(&glDrawArrays) opengl_glfw_glDrawArrays;
+extern decltype(&glDrawElements) opengl_glfw_glDrawElements;
+extern decltype(&glDrawBuffer) opengl_glfw_glDrawBuffer;
+extern decltype(&glReadBuffer) opengl_glfw_glReadBuffer;
+#define glClear opengl_glfw_glClear
+#define glClearColor opengl_glfw_glClearColor
+#define glEnable opengl_glfw_glEnable
+#define glDisable opengl_glfw_glDisable
+#define glViewport opengl_glfw_glViewport
+#define glBlendFunc opengl_glfw_glBlendFunc
+#define glCullFace opengl_glfw_glCullFace
+#define glDepthFunc opengl_glfw_glDepthFunc
+#define glDepthMask opengl_glfw_glDepthMask
+#define glPixelStorei opengl_glfw_glPixelStorei
+#define glReadPixels opengl_glfw_glReadPixels
+#define glFinish opengl_glfw_glFinish
+#define glGetError opengl_glfw_glGetError
+#define glGenTextures opengl_glfw_glGenTextures
+#define glDeleteTextures opengl_glfw_glDeleteTextures
+#define glBindTexture opengl_glfw_glBindTexture
+#define glTexImage2D opengl_glfw_glTexImage2D
+#define glTexParameteri opengl_glfw_glTexParameteri
+#define glDrawArrays opengl_glfw_glDrawArrays
+#define glDrawElements opengl_glfw_glDrawElements
+#define glDrawBuffer opengl_glfw_glDrawBuffer
+#define glReadBuffer opengl_glfw_glReadBuffer
+#endif
+#endif
@@ -0,0 +1,244 @@
+#include "profiler.hpp"
+#ifdef OPENGL_GLFW_PROFILE
+#include "benchmark.hpp"
+#include "opengl.h"
+#include <chrono>
+#include <cstring>
+
+namespace profiler
+{
+	// Returns the steady clock time in nanoseconds.
+	inline long long Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+	Profiler &Get()
+	{
+		static Profiler profiler;
+		return profiler;
+	}
+	Profiler::Profiler()
+		: m_frame(0), m_depth(0), m_created(false), m_gpu_timers(false), m_debug_groups(false), m_gpu_to_cpu_offset(0), m_marker_count(0), m_capturing(false)
+	{
+		for (int i = 0; i < FRAME_SLOTS; ++i)
+		{
+			m_frames[i].event_count = 0;
+			m_frames[i].used_queries = 0;
+		}
+	}
+	Profiler::~Profiler()
+	{
+
+	}
+	void Profiler::Create()
+	{
+		// GL_TIMESTAMP queries are core in OpenGL 3.3 and available on 3.2 through ARB_timer_query.
+		m_gpu_timers = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+		m_debug_groups = GLEW_VERSION_4_3 || GLEW_KHR_debug;
+		for (int i = 0; i < FRAME_SLOTS; ++i)
+		{
+			m_frames[i].event_count = 0;
+			m_frames[i].used_queries = 0;
+			if (m_gpu_timers)
+				glGenQueries(QUERIES_PER_FRAME, m_frames[i].queries);
+		}
+		if (m_gpu_timers)
+		{
+			// >> glGetInteger64v(GL_TIMESTAMP) returns the current GL time without waiting for the
+			// >> commands in the pipeline. Comparing it with the CPU clock once lines both time lines up.
+			GLint64 gpu_now = 0;
+			glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+			m_gpu_to_cpu_offset = Now() - gpu_now;
+		}
+		m_created = true;
+	}
+	void Profiler::Destroy()
+	{
+		for (int i = 0; i < FRAME_SLOTS; ++i)
+		{
+			if (m_gpu_timers)
+				glDeleteQueries(QUERIES_PER_FRAME, m_frames[i].queries);
+			m_frames[i].event_count = 0;
+			m_frames[i].used_queries = 0;
+		}
+		m_created = false;
+		m_gpu_timers = false;
+		m_debug_groups = false;
+	}
+	size_t Profiler::BeginMarker(const char *name)
+	{
+		Frame &frame = m_frames[m_frame];
+		if (!m_created || frame.event_count == EVENTS_PER_FRAME)
+			return NO_EVENT;
+		Event &event = frame.events[frame.event_count];
+		event.name = name;
+		event.cpu_begin = Now();
+		event.cpu_end = event.cpu_begin;
+		event.depth = m_depth++;
+		event.query = -1;
+		event.marker = FindMarker(name);
+		// >> glQueryCounter records the GL time into a query object after all previous commands
+		// >> have reached the GL server but have not yet necessarily executed.
+		if (m_gpu_timers && frame.used_queries + 2 <= QUERIES_PER_FRAME)
+		{
+			event.query = static_cast<int>(frame.used_queries);
+			glQueryCounter(frame.queries[frame.used_queries], GL_TIMESTAMP);
+			frame.used_queries += 2;
+		}
+		if (m_debug_groups)
+			glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+		return frame.event_count++;
+	}
+	void Profiler::EndMarker(size_t index)
+	{
+		if (NO_EVENT == index)
+			return;
+		Frame &frame = m_frames[m_frame];
+		Event &event = frame.events[index];
+		if (event.query >= 0)
+			glQueryCounter(frame.queries[event.query + 1], GL_TIMESTAMP);
+		if (m_debug_groups)
+			glPopDebugGroup();
+		event.cpu_end = Now();
+		--m_depth;
+	}
+	int Profiler::FindMarker(const char *name)
+	{
+		for (size_t i = 0; i < m_marker_count; ++i)
+		{
+			if (m_marker_names[i] == name || 0 == std::strcmp(m_marker_names[i], name))
+				return static_cast<int>(i);
+		}
+		if (m_marker_count == MAX_MARKERS)
+			return -1;
+		m_marker_names[m_marker_count] = name;
+		return static_cast<int>(m_marker_count++);
+	}
+	void Profiler::EndFrame()
+	{
+		if (!m_created)
+			return;
+		m_frame = (m_frame + 1) % FRAME_SLOTS;
+		// This slot was recorded FRAME_LATENCY frames ago. Its GPU times are only read if the driver
+		// already has them, so reading never waits; otherwise the frame only adds CPU times.
+		Frame &frame = m_frames[m_frame];
+		for (size_t i = 0; i < frame.event_count; ++i)
+		{
+			const Event &event = frame.events[i];
+			const double cpu_ms = (event.cpu_end - event.cpu_begin) / 1.0e6;
+			double gpu_ms = 0.0;
+			GLuint64 gpu_begin = 0;
+			bool gpu_ready = false;
+			if (event.query >= 0)
+			{
+				// >> GL_QUERY_RESULT_AVAILABLE returns whether the result is available without waiting.
+				// >> Querying GL_QUERY_RESULT then does not wait either.
+				GLuint begin_available = GL_FALSE;
+				GLuint end_available = GL_FALSE;
+				glGetQueryObjectuiv(frame.queries[event.query], GL_QUERY_RESULT_AVAILABLE, &begin_available);
+				glGetQueryObjectuiv(frame.queries[event.query + 1], GL_QUERY_RESULT_AVAILABLE, &end_available);
+				gpu_ready = GL_TRUE == begin_available && GL_TRUE == end_available;
+			}
+			if (gpu_ready)
+			{
+				GLuint64 gpu_end = 0;
+				glGetQueryObjectui64v(frame.queries[event.query], GL_QUERY_RESULT, &gpu_begin);
+				glGetQueryObjectui64v(frame.queries[event.query + 1], GL_QUERY_RESULT, &gpu_end);
+				gpu_ms = (gpu_end - gpu_begin) / 1.0e6;
+			}
+			if (event.marker >= 0)
+			{
+				Histogram &histogram = m_histograms[event.marker];
+				histogram.cpu[histogram.next] = cpu_ms;
+				histogram.next = (histogram.next + 1) % WINDOW;
+				if (histogram.count < WINDOW)
+					++histogram.count;
+				if (gpu_ready)
+				{
+					histogram.gpu[histogram.gpu_next] = gpu_ms;
+					histogram.gpu_next = (histogram.gpu_next + 1) % WINDOW;
+					if (histogram.gpu_count < WINDOW)
+						++histogram.gpu_count;
+				}
+			}
+			if (m_capturing)
+			{
+				const TraceEvent cpu_event = { event.name, event.cpu_begin / 1.0e3, cpu_ms * 1.0e3, 1 };
+				m_trace.push_back(cpu_event);
+				if (gpu_ready)
+				{
+					const TraceEvent gpu_event = { event.name, (static_cast<long long>(gpu_begin) + m_gpu_to_cpu_offset) / 1.0e3, gpu_ms * 1.0e3, 2 };
+					m_trace.push_back(gpu_event);
+				}
+			}
+		}
+		frame.event_count = 0;
+		frame.used_queries = 0;
+	}
+	void Profiler::BeginCapture()
+	{
+		m_trace.clear();
+		m_capturing = true;
+	}
+	bool Profiler::EndCapture(const std::string file_name)
+	{
+		m_capturing = false;
+		std::ofstream file(file_name.c_str());
+		if (!file)
+		{
+			std::cerr << "File " << file_name << " could not be opened." << std::endl;
+			return false;
+		}
+		// >> The Trace Event Format: complete events ("ph": "X") carry a timestamp "ts" and a
+		// >> duration "dur", both in microseconds.
+		benchmark::JsonWriter writer(file);
+		writer.BeginObject();
+		writer.BeginArray("traceEvents");
+		for (size_t i = 0; i < m_trace.size(); ++i)
+		{
+			const TraceEvent &event = m_trace[i];
+			writer.BeginObject();
+			writer.Value("name", std::string(event.name));
+			writer.Value("cat", std::string(event.track == 1 ? "cpu" : "gpu"));
+			writer.Value("ph", std::string("X"));
+			writer.Value("ts", event.begin);
+			writer.Value("dur", event.duration);
+			writer.Value("pid", 1);
+			writer.Value("tid", event.track);
+			writer.EndObject();
+		}
+		writer.EndArray();
+		writer.EndObject();
+		m_trace.clear();
+		return true;
+	}
+	bool Profiler::GetStatistics(const std::string name, MarkerStatistics &statistics) const
+	{
+		for (size_t i = 0; i < m_marker_count; ++i)
+		{
+			if (name == m_marker_names[i])
+			{
+				FillStatistics(m_histograms[i], statistics);
+				return true;
+			}
+		}
+		return false;
+	}
+	void Profiler::FillStatistics(const Histogram &histogram, MarkerStatistics &statistics) const
+	{
+		const benchmark::Statistics cpu = benchmark::Summarize(std::vector<double>(histogram.cpu, histogram.cpu + histogram.count));
+		const benchmark::Statistics gpu = benchmark::Summarize(std::vector<double>(histogram.gpu, histogram.gpu + histogram.gpu_count));
+		statistics.count = histogram.count;
+		statistics.gpu_count = histogram.gpu_count;
+		statistics.cpu_mean = cpu.mean;
+		statistics.cpu_p50 = cpu.p50;
+		statistics.cpu_p95 = cpu.p95;
+		statistics.cpu_max = cpu.max;
+		statistics.gpu_mean = gpu.mean;
+		statistics.gpu_p50 = gpu.p50;
+		statistics.gpu_p95 = gpu.p95;
+		statistics.gpu_max = gpu.max;
+	}
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef OPENGL_GLFW_TCU_PROFILER_H_
+#define OPENGL_GLFW_TCU_PROFILER_H_
+
+// The profiler only exists in builds with OPENGL_GLFW_PROFILE defined. Otherwise every PROFILE_*
+// macro expands to nothing and none of the code below is compiled.
+#ifdef OPENGL_GLFW_PROFILE
+
+#include "standard.h"
+typedef unsigned int GLuint;
+
+namespace profiler
+{
+	// MarkerStatistics summarizes the last WINDOW frames of one marker, in milliseconds.
+	// gpu_count is lower than count when some frames' GPU times were not ready in time.
+	struct MarkerStatistics
+	{
+		size_t count;
+		size_t gpu_count;
+		double cpu_mean;
+		double cpu_p50;
+		double cpu_p95;
+		double cpu_max;
+		double gpu_mean;
+		double gpu_p50;
+		double gpu_p95;
+		double gpu_max;
+	};
+	// Profiler times named, nested scopes on the CPU (steady_clock) and the GPU (GL_TIMESTAMP queries),
+	// and wraps them in KHR_debug groups so they also show up in tools like RenderDoc and apitrace.
+	// GPU results are read FRAME_LATENCY frames late, and only if the driver reports them available,
+	// so the queries never stall the pipeline. Markers and histograms live in preallocated storage,
+	// keyed by the address of the marker's name, so profiling a frame does not allocate.
+	// It records nothing before Create. It may only be used on the render thread; use the PROFILE_*
+	// macros rather than the class.
+	class Profiler
+	{
+	public:
+		Profiler();
+		~Profiler();
+		void Create();
+		void Destroy();
+		// Starts a marker and returns its index for EndMarker. name must be a string literal.
+		// Returns NO_EVENT, which EndMarker ignores, before Create or once the frame is full.
+		size_t BeginMarker(const char *name);
+		void EndMarker(size_t index);
+		// Ends the frame: resolves the GPU times of the frame FRAME_LATENCY frames ago into the
+		// histograms (and the trace, while capturing). Call it after swapping buffers.
+		void EndFrame();
+		// Starts recording every resolved marker for a trace.
+		void BeginCapture();
+		// Stops recording and writes the markers as Chrome trace-event JSON (chrome://tracing, Perfetto).
+		bool EndCapture(const std::string file_name);
+		// Fills statistics with the rolling window of the marker called name. Returns false if unknown.
+		bool GetStatistics(const std::string name, MarkerStatistics &statistics) const;
+		// Calls function(name, statistics) for every marker seen so far, in the order they were first seen.
+		template <typename Function>
+		void ForEachMarker(Function function) const
+		{
+			for (size_t i = 0; i < m_marker_count; ++i)
+			{
+				MarkerStatistics statistics;
+				FillStatistics(m_histograms[i], statistics);
+				function(m_marker_names[i], statistics);
+			}
+		}
+		// Returned by BeginMarker for markers that are not recorded.
+		static const size_t NO_EVENT = static_cast<size_t>(-1);
+	private:
+		// The number of frames between recording a GPU query and reading it.
+		static const int FRAME_LATENCY = 3;
+		// The frames in flight: the one being recorded and the FRAME_LATENCY before it.
+		static const int FRAME_SLOTS = FRAME_LATENCY + 1;
+		// The number of frames the histograms cover.
+		static const size_t WINDOW = 240;
+		// The most queries one frame can use (two per marker).
+		static const size_t QUERIES_PER_FRAME = 512;
+		// The most markers one frame can record.
+		static const size_t EVENTS_PER_FRAME = QUERIES_PER_FRAME / 2;
+		// The most distinct marker names; later ones are timed and traced but get no histogram.
+		static const size_t MAX_MARKERS = 64;
+		// Event is one marker in one frame. Times are in nanoseconds.
+		struct Event
+		{
+			const char *name;
+			long long cpu_begin;
+			long long cpu_end;
+			int depth;
+			// The index of the begin query in the frame's pool (end is the next one), or -1.
+			int query;
+			// The index of the marker's histogram, or -1.
+			int marker;
+		};
+		// Frame holds the events and GPU queries of one frame in flight.
+		struct Frame
+		{
+			Event events[EVENTS_PER_FRAME];
+			size_t event_count;
+			GLuint queries[QUERIES_PER_FRAME];
+			size_t used_queries;
+		};
+		// Histogram is a rolling window of one marker's times in milliseconds. The GPU window has its
+		// own count, because frames whose queries were not ready only add a CPU time.
+		struct Histogram
+		{
+			Histogram() : count(0), next(0), gpu_count(0), gpu_next(0) {}
+			double cpu[WINDOW];
+			double gpu[WINDOW];
+			size_t count;
+			size_t next;
+			size_t gpu_count;
+			size_t gpu_next;
+		};
+		// TraceEvent is one marker kept for the trace, in microseconds.
+		struct TraceEvent
+		{
+			const char *name;
+			double begin;
+			double duration;
+			// 1 for the CPU track, 2 for the GPU track.
+			int track;
+		};
+		// Returns the index of the histogram for name, adding it if it is new, or -1 if the table is full.
+		// Names are compared by address first, so the same literal is found without comparing strings.
+		int FindMarker(const char *name);
+		// Fills statistics from the rolling windows of histogram.
+		void FillStatistics(const Histogram &histogram, MarkerStatistics &statistics) const;
+		Frame m_frames[FRAME_SLOTS];
+		int m_frame;
+		int m_depth;
+		bool m_created;
+		bool m_gpu_timers;
+		bool m_debug_groups;
+		// Added to GPU timestamps to move them into the CPU clock's time line.
+		long long m_gpu_to_cpu_offset;
+		const char *m_marker_names[MAX_MARKERS];
+		Histogram m_histograms[MAX_MARKERS];
+		size_t m_marker_count;
+		bool m_capturing;
+		std::vector<TraceEvent> m_trace;
+	};
+	// Returns the profiler used by the PROFILE_* macros.
+	Profiler &Get();
+	// ScopedMarker times the scope it lives in.
+	class ScopedMarker
+	{
+	public:
+		explicit ScopedMarker(const char *name) : m_index(Get().BeginMarker(name)) {}
+		~ScopedMarker() { Get().EndMarker(m_index); }
+	private:
+		ScopedMarker(const ScopedMarker &);
+		ScopedMarker &operator=(const ScopedMarker &);
+		size_t m_index;
+	};
+}
+
+#define PROFILE_CONCATENATE_(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+#define PROFILE_CREATE() profiler::Get().Create()
+#define PROFILE_DESTROY() profiler::Get().Destroy()
+#define PROFILE_SCOPE(name) profiler::ScopedMarker PROFILE_CONCATENATE(profile_marker_, __LINE__)(name)
+#define PROFILE_END_FRAME() profiler::Get().EndFrame()
+#define PROFILE_BEGIN_CAPTURE() profiler::Get().BeginCapture()
+#define PROFILE_END_CAPTURE(file_name) profiler::Get().EndCapture(file_name)
+
+#else
+
+#define PROFILE_CREATE() ((void) 0)
+#define PROFILE_DESTROY() ((void) 0)
+#define PROFILE_SCOPE(name) ((void) 0)
+#define PROFILE_END_FRAME() ((void) 0)
+#define PROFILE_BEGIN_CAPTURE() ((void) 0)
+#define PROFILE_END_CAPTURE(file_name) ((void) 0)
+
+#endif
+
+#endif
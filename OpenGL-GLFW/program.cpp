@@ -1,21 +1,20 @@
 #include "program.hpp"
 #include "opengl.h"
 #include "error.hpp" // *
+#include "profiler.hpp"
+#include "state_cache.hpp"
+#include "vertex_format.hpp"
+#include <algorithm>
 
 namespace program
 {	
-	// Array containing the vertex data for the two triangles
-	const GLfloat VERTEX_DATA[] = {
-		// Vertex Positions
-/* 0 */	-1.0f, -1.0f, // each vertex position has two components, x, and y
-/* 1 */	+1.0f, -1.0f,
-/* 2 */	+1.0f, +1.0f,
-/* 3 */	-1.0f, +1.0f,
-		// Colours
-/* 0 */	1.0f, 0.0f, 0.0f, // each colour has three components, red, green and blue
-/* 1 */	0.0f, 1.0f, 0.0f, // colours range from 0.0 to 1.0
-/* 2 */	0.0f, 0.0f, 1.0f,
-/* 3 */	1.0f, 1.0f, 1.0f,
+	// Array containing the vertex data for the two triangles, one vertex per row
+	const GLfloat VERTEX_DATA[][5] = {
+		// Position (x, y)	Colour (red, green, blue, from 0.0 to 1.0)
+/* 0 */	{ -1.0f, -1.0f,		1.0f, 0.0f, 0.0f },
+/* 1 */	{ +1.0f, -1.0f,		0.0f, 1.0f, 0.0f },
+/* 2 */	{ +1.0f, +1.0f,		0.0f, 0.0f, 1.0f },
+/* 3 */	{ -1.0f, +1.0f,		1.0f, 1.0f, 1.0f },
 	};
 	// Array containing the index data for the two triangles
 	const GLushort INDEX_DATA[] = { 
@@ -27,6 +26,13 @@ namespace program
 	{
 		VERTEX_POSITION = 0, VERTEX_COLOUR = 1
 	};
+	// The layout of the vertices in the VBO: interleaved half float positions and normalized byte colours,
+	// 8 bytes per vertex instead of the 20 that five floats take.
+	typedef vertex::Format<
+		vertex::Attribute<VERTEX_POSITION, vertex::Half, 2>,
+		vertex::Attribute<VERTEX_COLOUR, GLubyte, 4, true> > QuadVertexFormat;
+	// The number of quads uploaded per instanced draw call (20 bytes each). The batch's ring buffer holds three times as many.
+	const GLsizei QUAD_BATCH_CAPACITY = 65536;
 	// >> GLBooleanToString returns a string equivalent of a GLboolean.
 	// >> If the GLboolean equals GL_TRUE, the result will be "true".
 	// >> If the GLboolean equals GL_FALSE, the result will be "false".
@@ -41,7 +47,34 @@ namespace program
 	{
 		return (value == GL_TRUE && value != GL_FALSE) ? true : false;
 	}
+	// How far the arrow keys move the scene's quad per second, in normalized device coordinates.
+	const GLfloat SCENE_SPEED = 1.0f;
+	// Half the width and height of the scene's quad.
+	const GLfloat SCENE_QUAD_SIZE = 0.05f;
+	void UpdateScene(Scene &scene, const frame::Input &input, double step_seconds)
+	{
+		const GLfloat distance = static_cast<GLfloat>(SCENE_SPEED * step_seconds);
+		if (0 != (input.buttons & BUTTON_LEFT))
+			scene.x -= distance;
+		if (0 != (input.buttons & BUTTON_RIGHT))
+			scene.x += distance;
+		if (0 != (input.buttons & BUTTON_DOWN))
+			scene.y -= distance;
+		if (0 != (input.buttons & BUTTON_UP))
+			scene.y += distance;
+		const GLfloat limit = 1.0f - SCENE_QUAD_SIZE;
+		scene.x = std::max(-limit, std::min(limit, scene.x));
+		scene.y = std::max(-limit, std::min(limit, scene.y));
+	}
+	Scene InterpolateScene(const Scene &previous, const Scene &current, float alpha)
+	{
+		Scene scene;
+		scene.x = previous.x + (current.x - previous.x) * alpha;
+		scene.y = previous.y + (current.y - previous.y) * alpha;
+		return scene;
+	}
 	Program::Program()
+		: m_shader_program_in_use(false), m_validate_state(false), m_state_mismatch_count(0)
 	{
 		// Does nothing but construct the object.
 	}
@@ -52,95 +85,173 @@ namespace program
 	void Program::Init()
 	{
 		m_error_handler.Create();
+		// Every bind goes through the state cache, which skips the ones that would change nothing.
+		render::StateCache &state = render::GetStateCache();
+		state.Invalidate();
 		// >> Vertex Array Objects (VAO) are OpenGL Objects that store the 
 		// >> set of bindings between Vertex Attributes and the user's source 
 		// >> vertex data. (http://www.opengl.org/wiki/Vertex_Array_Object)
 		// >> glGenVertexArrays returns n vertex array object names in arrays.
-		// Create one VAO and store it in GLuint vao. 
-		glGenVertexArrays(1, &m_vao);
+		// Create one VAO, owned by m_vao and recorded in the resource registry.
+		m_vao.Create(RESOURCE_SITE);
 		// >> glBindVertexArray binds the vertex array object with name array.
 		// Bind the aforementioned VAO to OpenGL.
-		glBindVertexArray(m_vao);
+		state.BindVertexArray(m_vao.Get());
 		// >> glGenBuffers returns n buffer object names in buffers.
 		// >> No buffer objects are associated with the returned buffer object names
 		// >> until they are first bound by calling glBindBuffer.
-		glGenBuffers(1, &m_vbo);
-		glGenBuffers(1, &m_ibo);
+		m_vbo.Create(RESOURCE_SITE);
+		m_ibo.Create(RESOURCE_SITE);
 		// >> glBindBuffer binds a buffer object to the specified buffer binding point. 
 		// >> Vertex Buffer Objects (VBOs) are Buffer Objects that are used for
 		// >> vertex data. (VBO = GL_ARRAY_BUFFER)
 		// Bind our buffer object to GL_ARRAY_BUFFER, thus making it a VBO.
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+		state.BindBuffer(GL_ARRAY_BUFFER, m_vbo.Get());
+		state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo.Get());
 		// >> glBufferData creates a new data store for the buffer object currently bound
 		// >> to target. Any pre-existing data store is deleted. The new data store is created 
 		// >> with the specified size in bytes and usage. If data is not NULL, the data 
 		// >> store is initialized with data from this pointer. In its initial state, the
 		// >> new data store is not mapped, it has a NULL mapped pointer, and its mapped 
 		// >> access is GL_READ_WRITE.
-		// Store the vertex data (position and colour) in the VBO.
-		glBufferData(GL_ARRAY_BUFFER, sizeof(VERTEX_DATA), VERTEX_DATA, GL_STATIC_DRAW);
+		// Pack the vertex data (position and colour) into the layout of QuadVertexFormat and store it in the VBO.
+		QuadVertexFormat::Vertex vertices[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			vertices[i].Set<0>(vertex::ToHalf(VERTEX_DATA[i][0]), vertex::ToHalf(VERTEX_DATA[i][1]));
+			vertices[i].Set<1>(vertex::ToUnsignedByte(VERTEX_DATA[i][2]), vertex::ToUnsignedByte(VERTEX_DATA[i][3]), vertex::ToUnsignedByte(VERTEX_DATA[i][4]), 255);
+		}
+		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+		m_vbo.SetBytes(sizeof(vertices));
 		// Store the vertex index data in the IBO.
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(INDEX_DATA), INDEX_DATA, GL_STATIC_DRAW);
+		m_ibo.SetBytes(sizeof(INDEX_DATA));
 		// >> glEnableVertexAttribArray enables the generic vertex attribute array specified by index. 
-		// >> glDisableVertexAttribArray disables the generic vertex attribute array specified by 
-		// >> index. By default, all client-side capabilities are disabled, including all generic 
-		// >> vertex attribute arrays. If enabled, the values in the generic vertex attribute array
-		// >> will be accessed and used for rendering when calls are made to vertex array commands 
-		// >> such as glDrawArrays, glDrawElements, glDrawRangeElements, glMultiDrawElements, or glMultiDrawArrays.
-		// Enable the vertex position vertex attribute.
-		glEnableVertexAttribArray(VERTEX_POSITION);
-		// Enable the vertex colour vertex attribute.
-		glEnableVertexAttribArray(VERTEX_COLOUR);
 		// >> glVertexAttribPointer and glVertexAttribIPointer specify the location and data format of the 
 		// >> array of generic vertex attributes at index index to use when rendering. size specifies 
 		// >> the number of components per attribute and must be 1, 2, 3, 4, or GL_BGRA. type specifies
 		// >> the data type of each component, and stride specifies the byte stride from one attribute
 		// >> to the next, allowing vertices and attributes to be packed into a single array or stored
 		// >> in separate arrays.
-		// Tell OpenGL where to find the vertex position data (inside the VBO).
-		glVertexAttribPointer(VERTEX_POSITION, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		// Tell OpenGL where to find the vertex colour data (inside the VBO).
-		glVertexAttribPointer(VERTEX_COLOUR, 3, GL_FLOAT, GL_FALSE, 0, (void*) 32);
+		// Enable the vertex position and colour attributes and tell OpenGL where to find them (inside the VBO).
+		// QuadVertexFormat knows the types, the stride and the offsets.
+		QuadVertexFormat::Apply();
+		// Attach the per-instance attributes to the VAO.
+		m_batch.Create(m_vao.Get(), QUAD_BATCH_CAPACITY, 6, GL_UNSIGNED_SHORT);
+		// Keep linked shader programs in the shader_cache directory, so the next start skips compiling them.
+		m_program_cache.Create("shader_cache");
 		// Create a new shader program from the two files containing a vertex shader and a fragment shader.
-		m_shader_program.CreateFromFiles("shader.vert", "shader.frag");
-		// Binds the shader program to OpenGL.
-		glUseProgram(m_shader_program.GetOpenGLID());
+		// The compiler reads them on m_shader_jobs and submits the compile and link without waiting.
+		m_shader_jobs.Create(1);
+		shader::ShaderCompiler compiler;
+		compiler.Create(&m_shader_jobs, &m_program_cache);
+		compiler.Add(m_shader_program, "shader.vert", "shader.frag");
+		compiler.Submit();
+		// The program is bound by the first Render that finds it linked, so Init does not wait for the driver.
+		m_shader_program_in_use = false;
+		// Watch the shader files, and every file they include, in the working directory for edits.
+		if (m_shader_watcher.Create("."))
+		{
+			const std::vector<std::string> &dependencies = m_shader_program.GetDependencies();
+			for (size_t file = 0; file < dependencies.size(); ++file)
+				m_shader_watcher.Watch(dependencies[file]);
+		}
 		// Check for OpenGL errors. 
 		m_error_handler.Check(true, "Initialization Code: ");
 	}
-	void Program::Render()
+	void Program::Render(const Scene *scene)
 	{
+		PROFILE_SCOPE("Program::Render");
+		// Rebuild the shader program when a file it is built from was saved, and switch to it once it
+		// has linked. The files are read on m_shader_jobs. Without edits this is an atomic load and a
+		// pointer test.
+		if (m_shader_watcher.HasChanges())
+		{
+			std::vector<std::string> changed_files;
+			m_shader_watcher.TakeChanges(changed_files);
+			// Files an earlier version of the shaders included are still watched, but no longer matter.
+			const std::vector<std::string> &dependencies = m_shader_program.GetDependencies();
+			for (size_t file = 0; file < changed_files.size(); ++file)
+			{
+				if (std::find(dependencies.begin(), dependencies.end(), changed_files[file]) != dependencies.end())
+				{
+					m_shader_program.Reload(&m_shader_jobs);
+					break;
+				}
+			}
+		}
+		render::StateCache &state = render::GetStateCache();
+		// Binds the shader program to OpenGL once the driver has finished building it.
+		if (!m_shader_program_in_use && m_shader_program.IsReady())
+		{
+			state.UseProgram(m_shader_program.GetOpenGLID());
+			m_shader_program_in_use = true;
+		}
+		if (m_shader_program.Update())
+		{
+			state.UseProgram(m_shader_program.GetOpenGLID());
+			// Watch the files the edit included for the first time.
+			const std::vector<std::string> &dependencies = m_shader_program.GetDependencies();
+			for (size_t file = 0; file < dependencies.size(); ++file)
+				m_shader_watcher.Watch(dependencies[file]);
+		}
 		// >> glClear sets the bitplane area of the window to values previously selected by glClearColor.
 		// Clear the window of its contents.
 		glClear(GL_COLOR_BUFFER_BIT);
-		// Draw two triangles using the indices in m_ibo that point to the vertex data in m_vbo.
-		// >> When glDrawElements is called, it uses count sequential elements from an enabled array, starting at 
-		// >> indices to construct a sequence of geometric primitives. mode specifies what kind of primitives are
-		// >> constructed and how the array elements construct these primitives
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+		// Queue the quad, covering the whole window in its original colours, and draw it.
+		// The batch draws the two triangles using the indices in m_ibo that point to the vertex data in m_vbo,
+		// once per queued quad, with a single glDrawElementsInstanced call. Until the shader program is
+		// in use, frames are only cleared, and quads queued through GetBatch wait for the first frame that draws.
+		if (m_shader_program_in_use)
+		{
+			PROFILE_SCOPE("Draw Quads");
+			m_batch.Add(0.0f, 0.0f, 1.0f, 1.0f, 255, 255, 255, 255);
+			if (0 != scene)
+				m_batch.Add(scene->x, scene->y, SCENE_QUAD_SIZE, SCENE_QUAD_SIZE, 0, 0, 0, 255);
+			m_batch.Flush();
+			m_batch.EndFrame();
+		}
 		// Check for OpenGl errors.
 		m_error_handler.Check(false, "Update Code: ");
+		m_error_handler.NextFrame();
+		// Catch OpenGL calls that bypassed the state cache. The cache cannot tell which of its values
+		// are wrong, so it forgets them all and the next binds reach OpenGL again.
+		if (m_validate_state && !state.Validate())
+		{
+			++m_state_mismatch_count;
+			state.Invalidate();
+		}
+		state.EndFrame();
+		// Evict streamed resources if the frame ended over the video memory budget.
+		resource::GetRegistry().EndFrame();
 	}
 	void Program::Destroy()
 	{
+		render::StateCache &state = render::GetStateCache();
 		// Unbind the VBO.
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		state.BindBuffer(GL_ARRAY_BUFFER, 0);
 		// Unbind the IBO.
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 		// Unbind the VAO.
-		glBindVertexArray(0);
+		state.BindVertexArray(0);
 		// Unbind the shader program.
-		glUseProgram(0);
+		state.UseProgram(0);
+		m_shader_program_in_use = false;
 		// >> glDeleteVertexArrays deletes n vertex array objects whose names are stored in the array
 		// >> addressed by arrays.
 		// Delete the VAO.
-		glDeleteVertexArrays(1, &m_vao);
+		m_vao.Reset();
 		// >> glDeleteBuffers deletes n buffer objects named by the elements of the array buffers. 
-		// Delete the VBO.
-		glDeleteBuffers(1, &m_vbo);
-		// Destroy the shader program.
+		// Delete the VBO and the IBO.
+		m_vbo.Reset();
+		m_ibo.Reset();
+		// Delete the instance buffer.
+		m_batch.Destroy();
+		// Stop watching the shader files.
+		m_shader_watcher.Destroy();
+		// Destroy the shader program and stop the threads that loaded it.
 		m_shader_program.Destroy();
+		m_shader_jobs.Destroy();
 		// Check for OpenGL errors.
 		m_error_handler.Check(true, "Clean Up Code: ");
 		m_error_handler.Destroy();
@@ -2,10 +2,34 @@
 #define OPENGL_GLFW_TCU_PROGRAM_H_
 // Include the tcu::shader contents.
 #include "shader.hpp"
+#include "shader_cache.hpp"
+#include "shader_compiler.hpp"
+#include "jobs.hpp"
+#include "file_watcher.hpp"
 #include "error.hpp"
+#include "batch.hpp"
+#include "frame.hpp"
+#include "resource.hpp"
 
 namespace program
 {
+	// Scene is the state the update thread simulates (see frame::Simulation): the centre of a small
+	// quad the arrow keys move across the window.
+	struct Scene
+	{
+		Scene() : x(0.0f), y(0.0f) {}
+		GLfloat x;
+		GLfloat y;
+	};
+	// The bits of frame::Input::buttons the scene reacts to.
+	enum SceneButton
+	{
+		BUTTON_LEFT = 1, BUTTON_RIGHT = 2, BUTTON_UP = 4, BUTTON_DOWN = 8
+	};
+	// Advances scene by step_seconds: moves the quad while arrow buttons are held, and keeps it in the window.
+	void UpdateScene(Scene &scene, const frame::Input &input, double step_seconds);
+	// Returns the scene alpha of the way from previous to current.
+	Scene InterpolateScene(const Scene &previous, const Scene &current, float alpha);
 	// Program represents the OpenGL code that is to be executed in the application.
 	class Program
 	{
@@ -16,21 +40,42 @@ namespace program
 		~Program();
 		// Initializes the Program. Sets up rendering code.
 		void Init();
-		// Renders to the screen.
-		void Render();
+		// Renders to the screen, and scene on top of it unless scene is NULL.
+		void Render(const Scene *scene = NULL);
 		// Destroys the Program. Cleans up resources.
 		void Destroy();
+		// Returns the quad batch, so callers can queue more quads than the single one Render draws.
+		QuadBatch &GetBatch() { return m_batch; }
+		// Returns true if the shader program linked. Waits for the driver to finish linking.
+		bool IsLinked() { return m_shader_program.IsLinked(); }
+		// If validate is true, every Render ends by checking the state cache against OpenGL (see
+		// render::StateCache::Validate). The queries stall the pipeline, so it is off by default.
+		void SetStateValidation(bool validate) { m_validate_state = validate; }
+		// Returns the number of frames whose state cache disagreed with OpenGL.
+		unsigned int GetStateMismatchCount() const { return m_state_mismatch_count; }
 	private:
 		// The OpenGL shader program.
 		shader::ShaderProgram m_shader_program; // *
+		// True once Render has bound the shader program.
+		bool m_shader_program_in_use;
+		// The on-disk cache of linked shader programs.
+		shader::ProgramCache m_program_cache;
+		// Reads and preprocesses the shader files off the render thread.
+		jobs::ThreadPool m_shader_jobs;
+		// Reports edits to the shader files, so they can be reloaded while the program runs.
+		shader::FileWatcher m_shader_watcher;
 		// The OpenGL VAO (Vertex Array Object)
-		GLuint m_vao;
+		resource::VertexArray m_vao;
 		// The OpenGL VBO (Vertex Buffer Object)
-		GLuint m_vbo;
+		resource::Buffer m_vbo;
 		// The OpenGL IBO (Index Buffer Object)
-		GLuint m_ibo;
+		resource::Buffer m_ibo;
+		// Draws the quads with instancing.
+		QuadBatch m_batch;
 		// The OpenGL error handler.
 		error::ErrorHandler m_error_handler; // *
+		bool m_validate_state;
+		unsigned int m_state_mismatch_count;
 	};
 }
 
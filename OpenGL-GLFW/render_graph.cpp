@@ -0,0 +1,563 @@
+#include "render_graph.hpp"
+#include "opengl.h"
+#include "profiler.hpp"
+#include "state_cache.hpp"
+#include <algorithm>
+#include <iomanip>
+
+namespace graph
+{
+	// The texture formats the graph can create: the internal format, the format and type
+	// glTexImage2D wants with it, and the bytes per pixel.
+	struct Format
+	{
+		GLenum internal_format;
+		GLenum format;
+		GLenum type;
+		int bytes;
+	};
+	const Format FORMATS[] = {
+		{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+		{ GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8 },
+		{ GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, 4 },
+		{ GL_R32F, GL_RED, GL_FLOAT, 4 },
+		{ GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 4 },
+		{ GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, 4 },
+		{ GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 4 },
+	};
+	// The most colour attachments a pass may write; OpenGL 3.2 guarantees 8.
+	const unsigned int MAX_COLOUR_ATTACHMENTS = 8;
+	// Returns the entry of FORMATS for internal_format, or NULL.
+	const Format *FindFormat(GLenum internal_format)
+	{
+		for (size_t i = 0; i < sizeof(FORMATS) / sizeof(FORMATS[0]); ++i)
+		{
+			if (FORMATS[i].internal_format == internal_format)
+				return &FORMATS[i];
+		}
+		return NULL;
+	}
+	inline bool IsDepthFormat(GLenum internal_format)
+	{
+		return internal_format == GL_DEPTH_COMPONENT24 || internal_format == GL_DEPTH_COMPONENT32F || internal_format == GL_DEPTH24_STENCIL8;
+	}
+	inline bool IsSameDescription(const TextureDescription &left, const TextureDescription &right)
+	{
+		return left.width == right.width && left.height == right.height && left.format == right.format;
+	}
+	long long GetTextureBytes(const TextureDescription &description)
+	{
+		const Format *format = FindFormat(description.format);
+		return 0 != format ? static_cast<long long>(format->bytes) * description.width * description.height : 0;
+	}
+	CompileStatistics::CompileStatistics()
+		: passes(0), culled_passes(0), transient_textures(0), physical_textures(0), framebuffers(0), peak_bytes(0), unaliased_bytes(0)
+	{
+
+	}
+	ExecuteStatistics::ExecuteStatistics()
+		: passes(0), framebuffer_binds(0), clears(0), invalidated_attachments(0)
+	{
+
+	}
+	RenderGraph::RenderGraph()
+		: m_compiled(false), m_invalidation(true), m_can_invalidate(false)
+	{
+
+	}
+	RenderGraph::~RenderGraph()
+	{
+
+	}
+	void RenderGraph::Clear()
+	{
+		m_textures.clear();
+		m_passes.clear();
+		m_executed.clear();
+		m_compiled = false;
+	}
+	TextureId RenderGraph::CreateTexture(const std::string &name, const TextureDescription &description)
+	{
+		Texture texture;
+		texture.name = name;
+		texture.description = description;
+		texture.imported = false;
+		texture.framebuffer = 0;
+		texture.physical = -1;
+		texture.first_use = -1;
+		texture.last_use = -1;
+		m_textures.push_back(texture);
+		m_compiled = false;
+		return static_cast<TextureId>(m_textures.size() - 1);
+	}
+	TextureId RenderGraph::ImportFramebuffer(const std::string &name, GLuint framebuffer, GLsizei width, GLsizei height)
+	{
+		const TextureDescription description = { width, height, GL_RGBA8 };
+		const TextureId texture = CreateTexture(name, description);
+		m_textures[texture].imported = true;
+		m_textures[texture].framebuffer = framebuffer;
+		return texture;
+	}
+	PassId RenderGraph::AddPass(const std::string &name, const ExecuteFunction &execute)
+	{
+		Pass pass;
+		pass.name = name;
+		pass.execute = execute;
+		pass.culled = false;
+		pass.framebuffer = 0;
+		pass.width = 0;
+		pass.height = 0;
+		m_passes.push_back(pass);
+		m_compiled = false;
+		return static_cast<PassId>(m_passes.size() - 1);
+	}
+	void RenderGraph::Read(PassId pass, TextureId texture)
+	{
+		m_passes[pass].reads.push_back(texture);
+		m_compiled = false;
+	}
+	void RenderGraph::Write(PassId pass, TextureId texture, Load load, const float *clear)
+	{
+		Output write;
+		write.texture = texture;
+		write.load = load;
+		// A depth clear value is a single float; do not read past it.
+		const int clear_count = IsDepthFormat(m_textures[texture].description.format) ? 1 : 4;
+		for (int i = 0; i < 4; ++i)
+			write.clear[i] = (0 != clear && i < clear_count) ? clear[i] : 0.0f;
+		write.store = true;
+		m_passes[pass].writes.push_back(write);
+		m_compiled = false;
+	}
+	bool RenderGraph::Validate() const
+	{
+		for (size_t i = 0; i < m_textures.size(); ++i)
+		{
+			if (!m_textures[i].imported && 0 == GetTextureBytes(m_textures[i].description))
+			{
+				std::cerr << "Render graph texture " << m_textures[i].name << " has an unknown format or no pixels." << std::endl;
+				return false;
+			}
+		}
+		for (size_t i = 0; i < m_passes.size(); ++i)
+		{
+			const Pass &pass = m_passes[i];
+			unsigned int colour_count = 0;
+			unsigned int depth_count = 0;
+			bool imported = false;
+			for (size_t w = 0; w < pass.writes.size(); ++w)
+			{
+				const Texture &texture = m_textures[pass.writes[w].texture];
+				const Texture &first = m_textures[pass.writes[0].texture];
+				imported = imported || texture.imported;
+				if (IsDepthFormat(texture.description.format))
+					++depth_count;
+				else
+					++colour_count;
+				if (texture.description.width != first.description.width || texture.description.height != first.description.height)
+				{
+					std::cerr << "Render graph pass " << pass.name << " writes textures of different sizes." << std::endl;
+					return false;
+				}
+				if (std::find(pass.reads.begin(), pass.reads.end(), pass.writes[w].texture) != pass.reads.end())
+				{
+					std::cerr << "Render graph pass " << pass.name << " reads and writes " << texture.name << "." << std::endl;
+					return false;
+				}
+			}
+			if (imported && pass.writes.size() > 1)
+			{
+				std::cerr << "Render graph pass " << pass.name << " writes an imported framebuffer and more." << std::endl;
+				return false;
+			}
+			if (colour_count > MAX_COLOUR_ATTACHMENTS || depth_count > 1)
+			{
+				std::cerr << "Render graph pass " << pass.name << " writes too many attachments." << std::endl;
+				return false;
+			}
+			for (size_t r = 0; r < pass.reads.size(); ++r)
+			{
+				if (m_textures[pass.reads[r]].imported)
+				{
+					std::cerr << "Render graph pass " << pass.name << " reads imported framebuffer " << m_textures[pass.reads[r]].name << "." << std::endl;
+					return false;
+				}
+			}
+		}
+		// A texture must be written, in an earlier pass, before it is read or drawn on top of.
+		std::vector<bool> written(m_textures.size(), false);
+		for (size_t i = 0; i < m_passes.size(); ++i)
+		{
+			const Pass &pass = m_passes[i];
+			for (size_t r = 0; r < pass.reads.size(); ++r)
+			{
+				if (!written[pass.reads[r]])
+				{
+					std::cerr << "Render graph pass " << pass.name << " reads " << m_textures[pass.reads[r]].name << " before any pass writes it." << std::endl;
+					return false;
+				}
+			}
+			for (size_t w = 0; w < pass.writes.size(); ++w)
+			{
+				const Output &write = pass.writes[w];
+				if (LOAD_PRESERVE == write.load && !written[write.texture] && !m_textures[write.texture].imported)
+				{
+					std::cerr << "Render graph pass " << pass.name << " preserves " << m_textures[write.texture].name << " before any pass writes it." << std::endl;
+					return false;
+				}
+				written[write.texture] = true;
+			}
+		}
+		return true;
+	}
+	void RenderGraph::Cull()
+	{
+		// Walks back from the last pass, keeping track of the textures whose current contents a later
+		// pass that runs still needs. A pass runs if it writes one of those or an imported framebuffer;
+		// then what it writes is no longer needed from earlier passes (unless it draws on top), but
+		// what it reads is.
+		std::vector<bool> needed(m_textures.size(), false);
+		for (size_t i = m_passes.size(); i-- > 0;)
+		{
+			Pass &pass = m_passes[i];
+			pass.culled = true;
+			for (size_t w = 0; w < pass.writes.size(); ++w)
+			{
+				Output &write = pass.writes[w];
+				write.store = m_textures[write.texture].imported || needed[write.texture];
+				if (write.store)
+					pass.culled = false;
+			}
+			if (pass.culled)
+				continue;
+			for (size_t w = 0; w < pass.writes.size(); ++w)
+				needed[pass.writes[w].texture] = LOAD_PRESERVE == pass.writes[w].load;
+			for (size_t r = 0; r < pass.reads.size(); ++r)
+				needed[pass.reads[r]] = true;
+		}
+		m_executed.clear();
+		for (size_t i = 0; i < m_passes.size(); ++i)
+		{
+			if (!m_passes[i].culled)
+				m_executed.push_back(static_cast<PassId>(i));
+		}
+	}
+	void RenderGraph::Allocate()
+	{
+		for (size_t i = 0; i < m_textures.size(); ++i)
+		{
+			m_textures[i].physical = -1;
+			m_textures[i].first_use = -1;
+			m_textures[i].last_use = -1;
+		}
+		for (size_t e = 0; e < m_executed.size(); ++e)
+		{
+			const Pass &pass = m_passes[m_executed[e]];
+			std::vector<TextureId> used(pass.reads);
+			for (size_t w = 0; w < pass.writes.size(); ++w)
+				used.push_back(pass.writes[w].texture);
+			for (size_t u = 0; u < used.size(); ++u)
+			{
+				Texture &texture = m_textures[used[u]];
+				if (texture.first_use < 0)
+					texture.first_use = static_cast<int>(e);
+				texture.last_use = static_cast<int>(e);
+			}
+		}
+		// Textures in the order they come to life, so each can take over a physical texture whose
+		// earlier occupants are all dead by then.
+		std::vector<TextureId> order;
+		for (size_t i = 0; i < m_textures.size(); ++i)
+		{
+			if (!m_textures[i].imported && m_textures[i].first_use >= 0)
+				order.push_back(static_cast<TextureId>(i));
+		}
+		std::stable_sort(order.begin(), order.end(),
+			[this](TextureId left, TextureId right) { return m_textures[left].first_use < m_textures[right].first_use; });
+		for (size_t p = 0; p < m_physical.size(); ++p)
+			m_physical[p].busy_until = -1;
+		std::vector<bool> used(m_physical.size(), false);
+		render::StateCache &state = render::GetStateCache();
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			Texture &texture = m_textures[order[i]];
+			size_t physical = 0;
+			while (physical < m_physical.size() && !(IsSameDescription(m_physical[physical].description, texture.description)
+				&& m_physical[physical].busy_until < texture.first_use))
+			{
+				++physical;
+			}
+			if (physical == m_physical.size())
+			{
+				PhysicalTexture created;
+				created.description = texture.description;
+				created.busy_until = -1;
+				created.texture.Create(RESOURCE_SITE);
+				const Format &format = *FindFormat(texture.description.format);
+				state.BindTexture(0, GL_TEXTURE_2D, created.texture.Get());
+				// >> glTexImage2D specifies a two-dimensional texture image. If data is NULL, no pixel data
+				// >> is transferred.
+				glTexImage2D(GL_TEXTURE_2D, 0, format.internal_format, texture.description.width, texture.description.height,
+					0, format.format, format.type, NULL);
+				const GLint filter = IsDepthFormat(format.internal_format) ? GL_NEAREST : GL_LINEAR;
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				created.texture.SetBytes(GetTextureBytes(texture.description));
+				m_physical.push_back(std::move(created));
+				used.push_back(false);
+			}
+			texture.physical = static_cast<int>(physical);
+			m_physical[physical].busy_until = texture.last_use;
+			used[physical] = true;
+		}
+		// Delete the textures of an earlier Compile that this graph does not need, and renumber.
+		std::vector<int> renumbered(m_physical.size(), -1);
+		size_t kept = 0;
+		for (size_t p = 0; p < m_physical.size(); ++p)
+		{
+			if (!used[p])
+				continue;
+			if (kept != p)
+				m_physical[kept] = std::move(m_physical[p]);
+			renumbered[p] = static_cast<int>(kept++);
+		}
+		m_physical.resize(kept);
+		for (size_t i = 0; i < m_textures.size(); ++i)
+		{
+			if (m_textures[i].physical >= 0)
+				m_textures[i].physical = renumbered[m_textures[i].physical];
+		}
+	}
+	GLenum RenderGraph::GetAttachment(const Output &write, unsigned int &colour_index) const
+	{
+		const Texture &texture = m_textures[write.texture];
+		if (texture.imported)
+			return 0 == texture.framebuffer ? GL_COLOR : GL_COLOR_ATTACHMENT0;
+		if (GL_DEPTH24_STENCIL8 == texture.description.format)
+			return GL_DEPTH_STENCIL_ATTACHMENT;
+		if (IsDepthFormat(texture.description.format))
+			return GL_DEPTH_ATTACHMENT;
+		return GL_COLOR_ATTACHMENT0 + colour_index++;
+	}
+	bool RenderGraph::CreateFramebuffers()
+	{
+		m_framebuffers.clear();
+		for (size_t e = 0; e < m_executed.size(); ++e)
+		{
+			Pass &pass = m_passes[m_executed[e]];
+			pass.framebuffer = 0;
+			pass.width = 0;
+			pass.height = 0;
+			if (pass.writes.empty())
+				continue;
+			const Texture &first = m_textures[pass.writes[0].texture];
+			pass.width = first.description.width;
+			pass.height = first.description.height;
+			if (first.imported)
+			{
+				pass.framebuffer = first.framebuffer;
+				continue;
+			}
+			resource::Framebuffer framebuffer;
+			framebuffer.Create(RESOURCE_SITE);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.Get());
+			GLenum draw_buffers[MAX_COLOUR_ATTACHMENTS];
+			unsigned int colour_count = 0;
+			for (size_t w = 0; w < pass.writes.size(); ++w)
+			{
+				const GLenum attachment = GetAttachment(pass.writes[w], colour_count);
+				if (GL_DEPTH_ATTACHMENT != attachment && GL_DEPTH_STENCIL_ATTACHMENT != attachment)
+					draw_buffers[colour_count - 1] = attachment;
+				const GLuint texture = m_physical[m_textures[pass.writes[w].texture].physical].texture.Get();
+				glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+			}
+			// A depth only pass (a shadow map) has no colour buffer to draw to or read from.
+			if (0 == colour_count)
+			{
+				glDrawBuffer(GL_NONE);
+				glReadBuffer(GL_NONE);
+			}
+			else
+			{
+				glDrawBuffers(static_cast<GLsizei>(colour_count), draw_buffers);
+			}
+			const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+			if (GL_FRAMEBUFFER_COMPLETE != status)
+			{
+				std::cerr << "Render graph pass " << pass.name << " has an incomplete framebuffer (0x"
+					<< std::hex << status << std::dec << ")." << std::endl;
+				return false;
+			}
+			pass.framebuffer = framebuffer.Get();
+			m_framebuffers.push_back(std::move(framebuffer));
+		}
+		return true;
+	}
+	bool RenderGraph::Compile()
+	{
+		m_compiled = false;
+		if (!Validate())
+			return false;
+		// >> glInvalidateFramebuffer is available only if the GL version is 4.3 or greater.
+		m_can_invalidate = GLEW_VERSION_4_3 || GLEW_ARB_invalidate_subdata;
+		Cull();
+		// Creating the framebuffers binds them; put back what was bound.
+		GLint previous_framebuffer = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+		Allocate();
+		const bool complete = CreateFramebuffers();
+		glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previous_framebuffer));
+		if (!complete)
+			return false;
+		CompileStatistics &statistics = m_compile_statistics;
+		statistics = CompileStatistics();
+		statistics.passes = static_cast<unsigned int>(m_passes.size());
+		statistics.culled_passes = static_cast<unsigned int>(m_passes.size() - m_executed.size());
+		for (size_t i = 0; i < m_textures.size(); ++i)
+		{
+			if (m_textures[i].physical >= 0)
+			{
+				++statistics.transient_textures;
+				statistics.unaliased_bytes += GetTextureBytes(m_textures[i].description);
+			}
+		}
+		statistics.physical_textures = static_cast<unsigned int>(m_physical.size());
+		for (size_t p = 0; p < m_physical.size(); ++p)
+			statistics.peak_bytes += GetTextureBytes(m_physical[p].description);
+		statistics.framebuffers = static_cast<unsigned int>(m_framebuffers.size());
+		m_compiled = true;
+		return true;
+	}
+	void RenderGraph::Execute()
+	{
+		PROFILE_SCOPE("RenderGraph::Execute");
+		m_execute_statistics = ExecuteStatistics();
+		if (!m_compiled)
+			return;
+		render::StateCache &state = render::GetStateCache();
+		const bool invalidate = m_invalidation && m_can_invalidate;
+		// The framebuffer binding is not shadowed by the state cache, so the first pass always binds.
+		bool bound = false;
+		GLuint bound_framebuffer = 0;
+		for (size_t e = 0; e < m_executed.size(); ++e)
+		{
+			const Pass &pass = m_passes[m_executed[e]];
+			if (!pass.writes.empty())
+			{
+				if (!bound || bound_framebuffer != pass.framebuffer)
+				{
+					glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+					bound = true;
+					bound_framebuffer = pass.framebuffer;
+					++m_execute_statistics.framebuffer_binds;
+				}
+				state.Viewport(0, 0, pass.width, pass.height);
+				GLenum discarded[MAX_COLOUR_ATTACHMENTS + 1];
+				GLsizei discarded_count = 0;
+				unsigned int colour_index = 0;
+				for (size_t w = 0; w < pass.writes.size(); ++w)
+				{
+					const Output &write = pass.writes[w];
+					const unsigned int draw_buffer = colour_index;
+					const GLenum attachment = GetAttachment(write, colour_index);
+					if (LOAD_DONT_CARE == write.load)
+					{
+						discarded[discarded_count++] = attachment;
+					}
+					else if (LOAD_CLEAR == write.load)
+					{
+						// glClearBuffer obeys the write masks and the scissor test.
+						state.SetCapability(GL_SCISSOR_TEST, false);
+						if (GL_DEPTH_STENCIL_ATTACHMENT == attachment)
+						{
+							state.DepthMask(true);
+							glClearBufferfi(GL_DEPTH_STENCIL, 0, write.clear[0], 0);
+						}
+						else if (GL_DEPTH_ATTACHMENT == attachment)
+						{
+							state.DepthMask(true);
+							glClearBufferfv(GL_DEPTH, 0, write.clear);
+						}
+						else
+						{
+							glClearBufferfv(GL_COLOR, static_cast<GLint>(draw_buffer), write.clear);
+						}
+						++m_execute_statistics.clears;
+					}
+				}
+				// >> glInvalidateFramebuffer invalidates the contents of a specified set of attachments
+				// >> of a framebuffer.
+				if (invalidate && discarded_count > 0)
+				{
+					glInvalidateFramebuffer(GL_FRAMEBUFFER, discarded_count, discarded);
+					m_execute_statistics.invalidated_attachments += discarded_count;
+				}
+			}
+			for (size_t r = 0; r < pass.reads.size(); ++r)
+				state.BindTexture(static_cast<GLuint>(r), GL_TEXTURE_2D, GetTexture(pass.reads[r]));
+			pass.execute();
+			++m_execute_statistics.passes;
+			// Attachments no later pass reads need not be written back to memory.
+			if (invalidate && !pass.writes.empty())
+			{
+				GLenum discarded[MAX_COLOUR_ATTACHMENTS + 1];
+				GLsizei discarded_count = 0;
+				unsigned int colour_index = 0;
+				for (size_t w = 0; w < pass.writes.size(); ++w)
+				{
+					const GLenum attachment = GetAttachment(pass.writes[w], colour_index);
+					if (!pass.writes[w].store)
+						discarded[discarded_count++] = attachment;
+				}
+				if (discarded_count > 0)
+				{
+					glInvalidateFramebuffer(GL_FRAMEBUFFER, discarded_count, discarded);
+					m_execute_statistics.invalidated_attachments += discarded_count;
+				}
+			}
+		}
+	}
+	void RenderGraph::Destroy()
+	{
+		Clear();
+		m_framebuffers.clear();
+		m_physical.clear();
+	}
+	GLuint RenderGraph::GetTexture(TextureId texture) const
+	{
+		const int physical = m_textures[texture].physical;
+		return physical >= 0 ? m_physical[physical].texture.Get() : 0;
+	}
+	void RenderGraph::Report(std::ostream &out) const
+	{
+		const CompileStatistics &statistics = m_compile_statistics;
+		for (size_t i = 0; i < m_passes.size(); ++i)
+		{
+			const Pass &pass = m_passes[i];
+			out << "  " << std::left << std::setw(20) << pass.name << std::right;
+			if (pass.culled)
+			{
+				out << " culled" << std::endl;
+				continue;
+			}
+			for (size_t r = 0; r < pass.reads.size(); ++r)
+				out << " reads " << m_textures[pass.reads[r]].name;
+			for (size_t w = 0; w < pass.writes.size(); ++w)
+			{
+				const Texture &texture = m_textures[pass.writes[w].texture];
+				out << " writes " << texture.name;
+				if (!texture.imported)
+					out << " (texture " << texture.physical << ")";
+				if (!pass.writes[w].store)
+					out << " unstored";
+			}
+			out << std::endl;
+		}
+		out << "  " << statistics.passes - statistics.culled_passes << " of " << statistics.passes << " passes run; "
+			<< statistics.transient_textures << " transient textures share " << statistics.physical_textures << ", "
+			<< std::fixed << std::setprecision(2) << statistics.peak_bytes / (1024.0 * 1024.0) << " MB ("
+			<< statistics.unaliased_bytes / (1024.0 * 1024.0) << " MB without aliasing)" << std::endl;
+	}
+}
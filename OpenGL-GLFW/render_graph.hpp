@@ -0,0 +1,182 @@
+#ifndef OPENGL_GLFW_TCU_RENDER_GRAPH_H_
+#define OPENGL_GLFW_TCU_RENDER_GRAPH_H_
+
+#include "standard.h"
+#include "resource.hpp"
+#include <functional>
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+typedef int GLsizei;
+
+namespace graph
+{
+	// Identifies a texture of a RenderGraph.
+	typedef unsigned int TextureId;
+	// Identifies a pass of a RenderGraph.
+	typedef unsigned int PassId;
+	// What a pass does with the old contents of a texture it writes.
+	enum Load
+	{
+		// Keeps them: the pass draws on top of what an earlier pass wrote, so it counts as a read.
+		LOAD_PRESERVE,
+		// Clears them to the clear value of the write.
+		LOAD_CLEAR,
+		// The pass overwrites every pixel. The old contents are invalidated rather than loaded.
+		LOAD_DONT_CARE
+	};
+	// TextureDescription is the size and internal format of a transient texture. The graph knows
+	// GL_RGBA8, GL_RGBA16F, GL_R11F_G11F_B10F, GL_R32F, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT32F
+	// and GL_DEPTH24_STENCIL8.
+	struct TextureDescription
+	{
+		GLsizei width;
+		GLsizei height;
+		GLenum format;
+	};
+	// Returns the bytes of a texture of description, or 0 if the graph does not know its format.
+	long long GetTextureBytes(const TextureDescription &description);
+	// CompileStatistics describes the last compiled graph.
+	struct CompileStatistics
+	{
+		CompileStatistics();
+		unsigned int passes;
+		// Passes whose results nothing used, which never run.
+		unsigned int culled_passes;
+		// The transient textures the remaining passes use, and the textures they share.
+		unsigned int transient_textures;
+		unsigned int physical_textures;
+		unsigned int framebuffers;
+		// The render target memory the graph holds, i.e. the bytes of the physical textures, and what
+		// it would take without aliasing.
+		long long peak_bytes;
+		long long unaliased_bytes;
+	};
+	// ExecuteStatistics counts the work of the last Execute.
+	struct ExecuteStatistics
+	{
+		ExecuteStatistics();
+		unsigned int passes;
+		unsigned int framebuffer_binds;
+		unsigned int clears;
+		// Attachments whose contents were invalidated instead of loaded or stored.
+		unsigned int invalidated_attachments;
+	};
+	// RenderGraph runs the passes of a frame (shadow maps, a G-buffer, post-processing), which declare
+	// the textures they read and write instead of managing framebuffers themselves. From those
+	// declarations Compile works out:
+	//
+	// - which passes to cull: those whose results no pass that runs reads. Passes writing an imported
+	//   framebuffer (the window, say) always run.
+	// - how long each transient texture lives, from the first to the last pass that uses it. Textures
+	//   of the same size and format whose lifetimes do not overlap share one OpenGL texture.
+	// - which attachments need not be loaded (LOAD_DONT_CARE) or stored (no later pass reads them).
+	//   Those are passed to glInvalidateFramebuffer (OpenGL 4.3 or ARB_invalidate_subdata), which
+	//   spares tiled GPUs the memory traffic, and tells others the contents can go.
+	//
+	// Passes run in the order they are added; a pass can only read what earlier passes wrote. The
+	// usual frame builds the same graph every time, so compile it once and execute it every frame.
+	class RenderGraph
+	{
+	public:
+		// Runs a pass. Its framebuffer is bound, the viewport covers it, and the textures it reads are
+		// bound to the texture units 0 and up, in the order of the Read calls.
+		typedef std::function<void()> ExecuteFunction;
+		RenderGraph();
+		~RenderGraph();
+		// Forgets the passes and textures, to declare a new graph. The OpenGL textures stay for the
+		// next Compile to reuse.
+		void Clear();
+		// Declares a texture that only lives while the graph executes.
+		TextureId CreateTexture(const std::string &name, const TextureDescription &description);
+		// Declares a framebuffer the graph does not own (0 is the window's) as a colour target passes
+		// may write. A pass that writes it must write nothing else.
+		TextureId ImportFramebuffer(const std::string &name, GLuint framebuffer, GLsizei width, GLsizei height);
+		// Adds a pass, which runs after the passes added before it.
+		PassId AddPass(const std::string &name, const ExecuteFunction &execute);
+		// Declares that pass samples texture.
+		void Read(PassId pass, TextureId texture);
+		// Declares that pass renders to texture. Colour textures are attached to GL_COLOR_ATTACHMENT0
+		// and up in the order of the Write calls, depth textures to the depth (and stencil)
+		// attachment. For LOAD_CLEAR, clear holds the colour, or the depth in clear[0]; NULL is zero.
+		void Write(PassId pass, TextureId texture, Load load, const float *clear = NULL);
+		// Culls passes, places the textures and creates the framebuffers. Returns false, and prints
+		// why, if the graph is invalid or a framebuffer is incomplete.
+		bool Compile();
+		// Runs the passes of the last Compile.
+		void Execute();
+		// Deletes the textures and framebuffers.
+		void Destroy();
+		// Returns the OpenGL texture of texture in the compiled graph, or 0 if it has none.
+		GLuint GetTexture(TextureId texture) const;
+		bool IsCulled(PassId pass) const { return m_passes[pass].culled; }
+		// Turns glInvalidateFramebuffer off and on, e.g. to measure what it saves.
+		void SetInvalidation(bool enabled) { m_invalidation = enabled; }
+		const CompileStatistics &GetCompileStatistics() const { return m_compile_statistics; }
+		const ExecuteStatistics &GetExecuteStatistics() const { return m_execute_statistics; }
+		// Prints the passes that run, what they read and write, and where the textures went.
+		void Report(std::ostream &out) const;
+	private:
+		struct Texture
+		{
+			std::string name;
+			TextureDescription description;
+			bool imported;
+			GLuint framebuffer;
+			// The physical texture it was placed in, or -1; the executed passes that use it first
+			// and last.
+			int physical;
+			int first_use;
+			int last_use;
+		};
+		struct Output
+		{
+			TextureId texture;
+			Load load;
+			float clear[4];
+			// Set by Compile: whether a later pass needs what this pass writes.
+			bool store;
+		};
+		struct Pass
+		{
+			std::string name;
+			ExecuteFunction execute;
+			std::vector<TextureId> reads;
+			std::vector<Output> writes;
+			bool culled;
+			// The framebuffer it renders to, and its size; 0 by 0 if the pass writes nothing.
+			GLuint framebuffer;
+			GLsizei width;
+			GLsizei height;
+		};
+		struct PhysicalTexture
+		{
+			TextureDescription description;
+			resource::Texture texture;
+			// The last executed pass that uses it while compiling; -1 if none so far.
+			int busy_until;
+		};
+		// Checks the declarations. Returns false and prints the first problem.
+		bool Validate() const;
+		// Sets culled and store.
+		void Cull();
+		// Places the transient textures in physical textures, creating and deleting them as needed.
+		void Allocate();
+		// Creates the framebuffer of every pass that runs. Returns false if one is incomplete.
+		bool CreateFramebuffers();
+		// Returns the attachment point of write in its pass, counting colour attachments in colour_index.
+		GLenum GetAttachment(const Output &write, unsigned int &colour_index) const;
+		std::vector<Texture> m_textures;
+		std::vector<Pass> m_passes;
+		// The indices of the passes that run, in order.
+		std::vector<PassId> m_executed;
+		std::vector<PhysicalTexture> m_physical;
+		std::vector<resource::Framebuffer> m_framebuffers;
+		bool m_compiled;
+		bool m_invalidation;
+		bool m_can_invalidate;
+		CompileStatistics m_compile_statistics;
+		ExecuteStatistics m_execute_statistics;
+	};
+}
+
+#endif
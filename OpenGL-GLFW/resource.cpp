@@ -0,0 +1,259 @@
+#include "resource.hpp"
+#include "opengl.h"
+#include "state_cache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+namespace resource
+{
+	const char *GetKindName(Kind kind)
+	{
+		switch (kind)
+		{
+		case KIND_BUFFER:
+			return "buffer";
+		case KIND_VERTEX_ARRAY:
+			return "vertex array";
+		case KIND_TEXTURE:
+			return "texture";
+		case KIND_RENDERBUFFER:
+			return "renderbuffer";
+		case KIND_FRAMEBUFFER:
+			return "framebuffer";
+		case KIND_QUERY:
+			return "query";
+		case KIND_PROGRAM:
+			return "program";
+		case KIND_SHADER:
+			return "shader";
+		default:
+			return "unknown";
+		}
+	}
+	Statistics::Statistics()
+		: total_bytes(0), peak_bytes(0), created(0), destroyed(0), evicted(0), over_budget_frames(0)
+	{
+		for (int kind = 0; kind < KIND_COUNT; ++kind)
+		{
+			live[kind] = 0;
+			bytes[kind] = 0;
+		}
+	}
+	Registry::Registry()
+		: m_records(1), m_frame(1), m_budget(0)
+	{
+		m_records[0].live = false;
+	}
+	Registry::~Registry()
+	{
+
+	}
+	unsigned int Registry::Add(Kind kind, GLuint name, const Site &site)
+	{
+		unsigned int record;
+		if (m_free_records.empty())
+		{
+			record = static_cast<unsigned int>(m_records.size());
+			m_records.push_back(Record());
+		}
+		else
+		{
+			record = m_free_records.back();
+			m_free_records.pop_back();
+		}
+		Record &added = m_records[record];
+		added.kind = kind;
+		added.name = name;
+		added.site = site;
+		added.bytes = 0;
+		added.last_used = m_frame;
+		added.evict = EvictFunction();
+		added.live = true;
+		++m_statistics.live[kind];
+		++m_statistics.created;
+		return record;
+	}
+	void Registry::Remove(unsigned int record)
+	{
+		Record &removed = m_records[record];
+		SetBytes(record, 0);
+		--m_statistics.live[removed.kind];
+		++m_statistics.destroyed;
+		removed.evict = EvictFunction();
+		removed.live = false;
+		m_free_records.push_back(record);
+	}
+	void Registry::SetBytes(unsigned int record, long long bytes)
+	{
+		Record &changed = m_records[record];
+		m_statistics.bytes[changed.kind] += bytes - changed.bytes;
+		m_statistics.total_bytes += bytes - changed.bytes;
+		m_statistics.peak_bytes = std::max(m_statistics.peak_bytes, m_statistics.total_bytes);
+		changed.bytes = bytes;
+	}
+	void Registry::SetEvictFunction(unsigned int record, const EvictFunction &evict)
+	{
+		m_records[record].evict = evict;
+	}
+	void Registry::EndFrame()
+	{
+		if (m_budget > 0 && m_statistics.total_bytes > m_budget)
+		{
+			Evict();
+			if (m_statistics.total_bytes > m_budget)
+				++m_statistics.over_budget_frames;
+		}
+		++m_frame;
+	}
+	void Registry::Evict()
+	{
+		std::vector<unsigned int> candidates;
+		for (unsigned int record = 1; record < m_records.size(); ++record)
+		{
+			const Record &candidate = m_records[record];
+			if (candidate.live && candidate.evict && candidate.last_used != m_frame)
+				candidates.push_back(record);
+		}
+		std::sort(candidates.begin(), candidates.end(),
+			[this](unsigned int left, unsigned int right) { return m_records[left].last_used < m_records[right].last_used; });
+		for (size_t i = 0; i < candidates.size() && m_statistics.total_bytes > m_budget; ++i)
+		{
+			// Evicting one object often destroys its siblings (the other buffers of a mesh), which
+			// may be further down the list; a destroyed record lost its evict function.
+			Record &evicted = m_records[candidates[i]];
+			if (!evicted.live || !evicted.evict)
+				continue;
+			// The function destroys the object, which clears the record; call a copy.
+			const EvictFunction evict = evicted.evict;
+			evict();
+			++m_statistics.evicted;
+		}
+	}
+	size_t Registry::GetLiveCount() const
+	{
+		size_t count = 0;
+		for (int kind = 0; kind < KIND_COUNT; ++kind)
+			count += m_statistics.live[kind];
+		return count;
+	}
+	size_t Registry::ReportLiveObjects(std::ostream &out, size_t max_sites) const
+	{
+		struct Group
+		{
+			Kind kind;
+			Site site;
+			size_t count;
+			long long bytes;
+		};
+		std::vector<Group> groups;
+		for (size_t record = 1; record < m_records.size(); ++record)
+		{
+			const Record &live = m_records[record];
+			if (!live.live)
+				continue;
+			size_t i = 0;
+			while (i < groups.size() && !(groups[i].kind == live.kind && groups[i].site.line == live.site.line
+				&& 0 == std::strcmp(groups[i].site.file, live.site.file)))
+			{
+				++i;
+			}
+			if (i == groups.size())
+			{
+				Group group = { live.kind, live.site, 0, 0 };
+				groups.push_back(group);
+			}
+			++groups[i].count;
+			groups[i].bytes += live.bytes;
+		}
+		std::sort(groups.begin(), groups.end(), [](const Group &left, const Group &right)
+		{
+			return left.bytes != right.bytes ? left.bytes > right.bytes : left.count > right.count;
+		});
+		for (size_t i = 0; i < groups.size() && i < max_sites; ++i)
+		{
+			// Only the file name; __FILE__ may hold the whole path.
+			const char *file = groups[i].site.file;
+			for (const char *c = file; *c; ++c)
+			{
+				if ('/' == *c || '\\' == *c)
+					file = c + 1;
+			}
+			out << std::setw(6) << groups[i].count << ' ' << GetKindName(groups[i].kind) << "(s), "
+				<< std::fixed << std::setprecision(2) << groups[i].bytes / (1024.0 * 1024.0) << " MB, created at "
+				<< file << ':' << groups[i].site.line << std::endl;
+		}
+		if (groups.size() > max_sites)
+			out << "    and " << groups.size() - max_sites << " more call sites" << std::endl;
+		return GetLiveCount();
+	}
+	Registry &GetRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+	GLuint Generate(Kind kind)
+	{
+		GLuint name = 0;
+		switch (kind)
+		{
+		case KIND_BUFFER:
+			glGenBuffers(1, &name);
+			break;
+		case KIND_VERTEX_ARRAY:
+			glGenVertexArrays(1, &name);
+			break;
+		case KIND_TEXTURE:
+			glGenTextures(1, &name);
+			break;
+		case KIND_RENDERBUFFER:
+			glGenRenderbuffers(1, &name);
+			break;
+		case KIND_FRAMEBUFFER:
+			glGenFramebuffers(1, &name);
+			break;
+		case KIND_QUERY:
+			glGenQueries(1, &name);
+			break;
+		case KIND_PROGRAM:
+			name = glCreateProgram();
+			break;
+		default:
+			break;
+		}
+		return name;
+	}
+	void Delete(Kind kind, GLuint name)
+	{
+		render::StateCache &state = render::GetStateCache();
+		switch (kind)
+		{
+		case KIND_BUFFER:
+			state.DeleteBuffers(1, &name);
+			break;
+		case KIND_VERTEX_ARRAY:
+			state.DeleteVertexArrays(1, &name);
+			break;
+		case KIND_TEXTURE:
+			state.DeleteTextures(1, &name);
+			break;
+		case KIND_RENDERBUFFER:
+			glDeleteRenderbuffers(1, &name);
+			break;
+		case KIND_FRAMEBUFFER:
+			glDeleteFramebuffers(1, &name);
+			break;
+		case KIND_QUERY:
+			glDeleteQueries(1, &name);
+			break;
+		case KIND_PROGRAM:
+			glDeleteProgram(name);
+			break;
+		case KIND_SHADER:
+			glDeleteShader(name);
+			break;
+		default:
+			break;
+		}
+	}
+}
@@ -0,0 +1,194 @@
+#ifndef OPENGL_GLFW_TCU_RESOURCE_H_
+#define OPENGL_GLFW_TCU_RESOURCE_H_
+
+#include "standard.h"
+#include <functional>
+typedef unsigned int GLuint;
+
+// RESOURCE_SITE is the call site to pass to Handle::Create and Handle::Adopt.
+#define RESOURCE_SITE resource::Site(__FILE__, __LINE__)
+
+namespace resource
+{
+	// The kinds of OpenGL objects the registry tracks.
+	enum Kind
+	{
+		KIND_BUFFER, KIND_VERTEX_ARRAY, KIND_TEXTURE, KIND_RENDERBUFFER, KIND_FRAMEBUFFER, KIND_QUERY, KIND_PROGRAM, KIND_SHADER,
+		KIND_COUNT
+	};
+	const char *GetKindName(Kind kind);
+	// Site is the source line that created an object.
+	struct Site
+	{
+		Site() : file(""), line(0) {}
+		Site(const char *file_name, int line_number) : file(file_name), line(line_number) {}
+		const char *file;
+		int line;
+	};
+	// Statistics describes the objects of a Registry.
+	struct Statistics
+	{
+		Statistics();
+		// The live objects and the bytes they hold, per Kind.
+		size_t live[KIND_COUNT];
+		long long bytes[KIND_COUNT];
+		// The bytes of all live objects, and the most they ever held.
+		long long total_bytes;
+		long long peak_bytes;
+		unsigned long long created;
+		unsigned long long destroyed;
+		// The objects evicted to stay within the budget, and the frames that ended over it anyway
+		// because nothing evictable was left.
+		unsigned long long evicted;
+		unsigned long long over_budget_frames;
+	};
+	// Registry keeps a record of every live OpenGL object created through a Handle: its kind, the
+	// bytes of its data store (for the objects that have one) and where it was created. That is
+	// enough to answer where the video memory went, and which objects a shutdown leaked.
+	//
+	// A budget caps the bytes. Objects that can be rebuilt later (streamed meshes, say) get an evict
+	// function; when a frame ends over the budget, the registry calls those of the least recently
+	// used objects until the bytes fit again. Evicting must destroy the object. Objects touched in the
+	// frame that is ending are never evicted.
+	//
+	// Like the state cache, the registry belongs to the context, and only the render thread may use it.
+	class Registry
+	{
+	public:
+		typedef std::function<void()> EvictFunction;
+		Registry();
+		~Registry();
+		// Records a new object and returns its record, which is never 0.
+		unsigned int Add(Kind kind, GLuint name, const Site &site);
+		void Remove(unsigned int record);
+		// Sets the size of the object's data store, e.g. after glBufferData.
+		void SetBytes(unsigned int record, long long bytes);
+		// Makes the object evictable. An empty evict makes it permanent again.
+		void SetEvictFunction(unsigned int record, const EvictFunction &evict);
+		// Marks the object as used in this frame.
+		void Touch(unsigned int record) { m_records[record].last_used = m_frame; }
+		// The most bytes the objects may hold; 0 means no limit.
+		void SetBudget(long long bytes) { m_budget = bytes; }
+		long long GetBudget() const { return m_budget; }
+		// Evicts until the objects fit the budget, and starts a new frame. Call once per frame.
+		void EndFrame();
+		const Statistics &GetStatistics() const { return m_statistics; }
+		size_t GetLiveCount() const;
+		// Prints the live objects grouped by kind and call site, the most bytes first, at most
+		// max_sites lines. Returns the number of live objects.
+		size_t ReportLiveObjects(std::ostream &out, size_t max_sites = 20) const;
+	private:
+		struct Record
+		{
+			Kind kind;
+			GLuint name;
+			Site site;
+			long long bytes;
+			// The frame that last touched the object.
+			unsigned long long last_used;
+			EvictFunction evict;
+			bool live;
+		};
+		// Calls the evict functions of the least recently used objects until bytes fit in the budget.
+		void Evict();
+		// Index 0 is never used, so a record of 0 means none.
+		std::vector<Record> m_records;
+		std::vector<unsigned int> m_free_records;
+		unsigned long long m_frame;
+		long long m_budget;
+		Statistics m_statistics;
+	};
+	// Returns the registry of the OpenGL context.
+	Registry &GetRegistry();
+
+	// Creates an object of kind (not KIND_SHADER, which needs a type: create it and Adopt it).
+	GLuint Generate(Kind kind);
+	// Deletes an object of kind. Vertex arrays, buffers and textures go through the state cache.
+	void Delete(Kind kind, GLuint name);
+
+	// Handle owns one OpenGL object of kind K and deletes it when it is Reset, assigned to or
+	// destroyed. It can be moved but not copied, so every object has exactly one owner. Handles
+	// default to no object (0) and can be tested with IsValid.
+	//
+	// A handle destroyed after its context leaks nothing but calls OpenGL without a context; owners
+	// with a Destroy method Reset their handles there, while the context is still current.
+	template <Kind K>
+	class Handle
+	{
+	public:
+		Handle() : m_name(0), m_record(0) {}
+		~Handle() { Reset(); }
+		Handle(Handle &&other) : m_name(other.m_name), m_record(other.m_record)
+		{
+			other.m_name = 0;
+			other.m_record = 0;
+		}
+		Handle &operator=(Handle &&other)
+		{
+			if (this != &other)
+			{
+				Reset();
+				m_name = other.m_name;
+				m_record = other.m_record;
+				other.m_name = 0;
+				other.m_record = 0;
+			}
+			return *this;
+		}
+		// Deletes the current object and creates a new one.
+		void Create(const Site &site) { Adopt(Generate(K), site); }
+		// Deletes the current object and takes ownership of name, which was created elsewhere. A name
+		// of 0 leaves the handle empty.
+		void Adopt(GLuint name, const Site &site)
+		{
+			Reset();
+			if (0 == name)
+				return;
+			m_name = name;
+			m_record = GetRegistry().Add(K, name, site);
+		}
+		// Deletes the object, if there is one.
+		void Reset()
+		{
+			if (0 == m_name)
+				return;
+			GetRegistry().Remove(m_record);
+			Delete(K, m_name);
+			m_name = 0;
+			m_record = 0;
+		}
+		GLuint Get() const { return m_name; }
+		bool IsValid() const { return 0 != m_name; }
+		// See Registry. All of them do nothing on an empty handle.
+		void SetBytes(long long bytes)
+		{
+			if (0 != m_record)
+				GetRegistry().SetBytes(m_record, bytes);
+		}
+		void SetEvictFunction(const Registry::EvictFunction &evict)
+		{
+			if (0 != m_record)
+				GetRegistry().SetEvictFunction(m_record, evict);
+		}
+		void Touch() const
+		{
+			if (0 != m_record)
+				GetRegistry().Touch(m_record);
+		}
+	private:
+		Handle(const Handle &);
+		Handle &operator=(const Handle &);
+		GLuint m_name;
+		unsigned int m_record;
+	};
+	typedef Handle<KIND_BUFFER> Buffer;
+	typedef Handle<KIND_VERTEX_ARRAY> VertexArray;
+	typedef Handle<KIND_TEXTURE> Texture;
+	typedef Handle<KIND_RENDERBUFFER> Renderbuffer;
+	typedef Handle<KIND_FRAMEBUFFER> Framebuffer;
+	typedef Handle<KIND_QUERY> Query;
+	typedef Handle<KIND_PROGRAM> Program;
+	typedef Handle<KIND_SHADER> Shader;
+}
+
+#endif
@@ -1,49 +1,103 @@
 #include "shader.hpp"
 #include "opengl.h"
 #include "standard.h"
+#include "memory.hpp"
+#include "shader_cache.hpp"
+#include "jobs.hpp"
+#include <algorithm>
 
 namespace shader
 {
 	const std::string LoadFileContents(const std::string filename) 
 	{
-		std::ifstream file;
-		file.open(filename.c_str());		
+		// Read the file straight into the string: one copy, instead of through a stringstream and its buffer.
+		std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
 		if (!file) 
+		{
 			std::cerr << "File " << filename << " could not be opened."	<< std::endl;
-		std::stringstream stream;
-		stream << file.rdbuf();
-		file.close();
-		return stream.str();
+			return std::string();
+		}
+		file.seekg(0, std::ios::end);
+		const std::streamoff size = file.tellg();
+		file.seekg(0, std::ios::beg);
+		std::string contents(static_cast<size_t>(size > 0 ? size : 0), '\0');
+		if (!contents.empty())
+		{
+			file.read(&contents[0], size);
+			// An editor may be rewriting the file right now; keep what was actually read.
+			contents.resize(static_cast<size_t>(file.gcount()));
+		}
+		return contents;
 	}
-	const GLuint CreateShaderFromFile(const std::string file_name, const GLenum shader_type)
+	// Compiles a shader. The compile status is deliberately not queried here: that would wait for the
+	// driver to finish. Errors surface when the program fails to link (see ReportShaderErrors).
+	GLuint CreateShaderFromSource(const std::string shader_source, const GLenum shader_type)
 	{
-		const std::string shader_source = LoadFileContents(file_name);
 		const char *shader_source_cstr = shader_source.c_str();
 		const GLuint shader = glCreateShader(shader_type);
 		glShaderSource(shader, 1, &shader_source_cstr, NULL);
 		glCompileShader(shader);
+		return shader;
+	}
+	GLuint CreateShaderFromFile(const std::string file_name, const GLenum shader_type)
+	{
+		return CreateShaderFromSource(LoadFileContents(file_name), shader_type);
+	}
+	// Returns the name of a shader type for error messages.
+	const char *GetStageName(const GLint shader_type)
+	{
+		switch (shader_type)
+		{
+		case GL_VERTEX_SHADER:
+			return "vertex";
+		case GL_GEOMETRY_SHADER:
+			return "geometry";
+		case GL_FRAGMENT_SHADER:
+			return "fragment";
+		default:
+			return "unknown";
+		}
+	}
+	// Prints the stage and info log of shader if it failed to compile.
+	void ReportShaderErrors(const GLuint shader)
+	{
+		if (0 == shader)
+			return;
 		GLint status;
 		glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
 		if (status == GL_FALSE)
 		{
+			GLint shader_type;
+			glGetShaderiv(shader, GL_SHADER_TYPE, &shader_type);
 			GLint infoLogLength;
 			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLength);
-			GLchar *strInfoLog = new GLchar[infoLogLength + 1];
+			// The log only lives until it is printed; the frame arena takes it back at the end of the frame.
+			GLchar *strInfoLog = memory::GetFrameArena().NewArray<GLchar>(infoLogLength + 1);
 			glGetShaderInfoLog(shader, infoLogLength, NULL, strInfoLog);
-			fprintf(stderr, "Compile failure in shader:\n%s\n", strInfoLog);
-			delete[] strInfoLog;
+			fprintf(stderr, "Compile failure in %s shader:\n%s\n", GetStageName(shader_type), strInfoLog);
 		}
-		return shader;
 	}
-	const GLuint CreateShaderProgram(const GLuint vertex_shader, const GLuint fragment_shader, const GLuint geometry_shader = 0)
+	// Links a program. If retrievable is true, the driver is told the binary will be read back for a ProgramCache.
+	// Like CreateShaderFromSource it does not wait for the result.
+	GLuint CreateShaderProgram(const GLuint vertex_shader, const GLuint fragment_shader, const GLuint geometry_shader = 0, const bool retrievable = false)
 	{
 		GLuint program = glCreateProgram();
 		glAttachShader(program, vertex_shader);
 		glAttachShader(program, fragment_shader);
 		if (0 != geometry_shader)
 			glAttachShader(program, geometry_shader);
+		// >> GL_PROGRAM_BINARY_RETRIEVABLE_HINT indicates to the implementation the intention of the
+		// >> application to retrieve the program's binary representation with glGetProgramBinary.
+		if (retrievable)
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		// glValidateProgram is not called here: it checks the program against the current GL state,
+		// which means nothing at link time, and it costs a synchronous driver round-trip.
 		glLinkProgram(program);
-		glValidateProgram(program);
+		return program;
+	}
+	// Prints the info log of program if it failed to link. Returns true if it linked.
+	bool ReportProgramErrors(const GLuint program)
+	{
 		GLint status;
 		glGetProgramiv (program, GL_LINK_STATUS, &status);
 		if (status == GL_FALSE)
@@ -51,35 +105,341 @@ namespace shader
 			GLint infoLogLength;
 			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
 
-			GLchar *strInfoLog = new GLchar[infoLogLength + 1];
+			GLchar *strInfoLog = memory::GetFrameArena().NewArray<GLchar>(infoLogLength + 1);
 			glGetProgramInfoLog(program, infoLogLength, NULL, strInfoLog);
 			fprintf(stderr, "Linker failure: %s\n", strInfoLog);
-			delete[] strInfoLog;
+			return false;
 		}
-		return program;
+		return true;
 	}
-	void ShaderProgram::CreateFromFiles(const std::string vertex_shader_file_name, const std::string fragment_shader_file_name)
+	ShaderObjectCache::ShaderObjectCache()
+		: m_compile_count(0), m_hit_count(0)
 	{
-		m_opengl_vertex_shader = CreateShaderFromFile(vertex_shader_file_name, GL_VERTEX_SHADER);
-		m_opengl_fragment_shader = CreateShaderFromFile(fragment_shader_file_name, GL_FRAGMENT_SHADER);
-		m_opengl_shader_program = CreateShaderProgram(m_opengl_vertex_shader, m_opengl_fragment_shader);
+
+	}
+	ShaderObjectCache::~ShaderObjectCache()
+	{
+
+	}
+	GLuint ShaderObjectCache::Acquire(const GLenum shader_type, const std::string &source)
+	{
+		const unsigned long long key = HashString(source, shader_type);
+		std::unordered_map<unsigned long long, Entry>::iterator entry = m_entries.find(key);
+		if (entry != m_entries.end())
+		{
+			if (entry->second.type == shader_type && entry->second.source == source)
+			{
+				++entry->second.references;
+				++m_hit_count;
+				return entry->second.shader;
+			}
+			// A hash collision: compile, but leave the entry to the shader already there.
+			const GLuint shader = CreateShaderFromSource(source, shader_type);
+			Owned &owned = m_shaders[shader];
+			owned.key = 0;
+			owned.shader.Adopt(shader, RESOURCE_SITE);
+			++m_compile_count;
+			return shader;
+		}
+		Entry &created = m_entries[key];
+		created.type = shader_type;
+		created.source = source;
+		created.shader = CreateShaderFromSource(source, shader_type);
+		created.references = 1;
+		Owned &owned = m_shaders[created.shader];
+		owned.key = key;
+		owned.shader.Adopt(created.shader, RESOURCE_SITE);
+		++m_compile_count;
+		return created.shader;
+	}
+	void ShaderObjectCache::Release(const GLuint shader)
+	{
+		std::unordered_map<GLuint, Owned>::iterator found = m_shaders.find(shader);
+		if (found == m_shaders.end())
+			return;
+		std::unordered_map<unsigned long long, Entry>::iterator entry = m_entries.find(found->second.key);
+		if (entry != m_entries.end() && entry->second.shader == shader)
+		{
+			if (--entry->second.references > 0)
+				return;
+			m_entries.erase(entry);
+		}
+		// >> If a shader object is deleted while it is attached to a program object, it will be flagged
+		// >> for deletion, and deletion will not occur until glDetachShader is called to detach it from
+		// >> all program objects to which it is attached.
+		// Erasing the handle deletes the shader.
+		m_shaders.erase(found);
+	}
+	ShaderObjectCache &GetShaderObjectCache()
+	{
+		static ShaderObjectCache cache;
+		return cache;
+	}
+	void ShaderProgram::CreateFromFiles(const std::string vertex_shader_file_name, const std::string fragment_shader_file_name, ProgramCache *cache,
+		const Defines &defines)
+	{
+		CreateFromFiles(vertex_shader_file_name, fragment_shader_file_name, std::string(), cache, defines);
+	}
+	void ShaderProgram::CreateFromFiles(const std::string vertex_shader_file_name, const std::string fragment_shader_file_name,
+		const std::string geometry_shader_file_name, ProgramCache *cache, const Defines &defines)
+	{
+		m_vertex_shader_file_name = vertex_shader_file_name;
+		m_fragment_shader_file_name = fragment_shader_file_name;
+		m_geometry_shader_file_name = geometry_shader_file_name;
+		m_defines = defines;
+		// A file that cannot be read leaves its source empty or incomplete; the link then fails and says why.
+		// The geometry shader only joins the sources (and so the cache key) when there is one, so the
+		// keys of two stage programs stay the same.
+		std::vector<std::string> sources(geometry_shader_file_name.empty() ? 2 : 3);
+		std::vector<std::string> dependencies;
+		PreprocessFile(vertex_shader_file_name, defines, sources[0], &m_dependencies);
+		PreprocessFile(fragment_shader_file_name, defines, sources[1], &dependencies);
+		AddDependencies(dependencies);
+		if (!geometry_shader_file_name.empty())
+		{
+			PreprocessFile(geometry_shader_file_name, defines, sources[2], &dependencies);
+			AddDependencies(dependencies);
+		}
+		if (LoadFromCache(cache, sources))
+			return;
+		Compile(sources[0], sources[1], geometry_shader_file_name.empty() ? std::string() : sources[2]);
+		Link();
+	}
+	void ShaderProgram::CreateFromStrings(const std::string vertex_shader_source, const std::string fragment_shader_source, const Defines &defines)
+	{
+		CreateFromStrings(vertex_shader_source, fragment_shader_source, std::string(), defines);
+	}
+	void ShaderProgram::CreateFromStrings(const std::string vertex_shader_source, const std::string fragment_shader_source,
+		const std::string geometry_shader_source, const Defines &defines)
+	{
+		m_vertex_shader_file_name.clear();
+		m_fragment_shader_file_name.clear();
+		m_geometry_shader_file_name.clear();
+		m_defines = defines;
+		m_dependencies.clear();
+		std::string sources[3];
+		std::vector<std::string> dependencies;
+		PreprocessSource(vertex_shader_source, std::string(), defines, sources[0], &dependencies);
+		AddDependencies(dependencies);
+		PreprocessSource(fragment_shader_source, std::string(), defines, sources[1], &dependencies);
+		AddDependencies(dependencies);
+		if (!geometry_shader_source.empty())
+		{
+			PreprocessSource(geometry_shader_source, std::string(), defines, sources[2], &dependencies);
+			AddDependencies(dependencies);
+		}
+		m_cache = 0;
+		Compile(sources[0], sources[1], sources[2]);
+		Link();
+	}
+	void ShaderProgram::AddDependencies(const std::vector<std::string> &dependencies)
+	{
+		for (size_t i = 0; i < dependencies.size(); ++i)
+		{
+			if (std::find(m_dependencies.begin(), m_dependencies.end(), dependencies[i]) == m_dependencies.end())
+				m_dependencies.push_back(dependencies[i]);
+		}
+	}
+	bool ShaderProgram::LoadFromCache(ProgramCache *cache, const std::vector<std::string> &sources)
+	{
+		m_status_checked = false;
+		m_cache = (0 != cache && cache->IsEnabled()) ? cache : 0;
+		if (0 == m_cache)
+			return false;
+		m_cache_key = m_cache->MakeKey(sources, std::string());
+		m_opengl_shader_program.Adopt(m_cache->Load(m_cache_key), RESOURCE_SITE);
+		if (!m_opengl_shader_program.IsValid())
+			return false;
+		// A cache hit needs no shader objects at all, and ProgramCache::Load already checked it linked.
+		m_opengl_vertex_shader = 0;
+		m_opengl_fragment_shader = 0;
+		m_opengl_geometry_shader = 0;
+		m_cache = 0;
+		m_status_checked = true;
+		m_linked = true;
+		return true;
+	}
+	void ShaderProgram::Compile(const std::string &vertex_shader_source, const std::string &fragment_shader_source,
+		const std::string &geometry_shader_source)
+	{
+		ShaderObjectCache &shaders = GetShaderObjectCache();
+		m_opengl_vertex_shader = shaders.Acquire(GL_VERTEX_SHADER, vertex_shader_source);
+		m_opengl_fragment_shader = shaders.Acquire(GL_FRAGMENT_SHADER, fragment_shader_source);
+		m_opengl_geometry_shader = geometry_shader_source.empty() ? 0 : shaders.Acquire(GL_GEOMETRY_SHADER, geometry_shader_source);
+	}
+	void ShaderProgram::Link()
+	{
+		m_opengl_shader_program.Adopt(CreateShaderProgram(m_opengl_vertex_shader, m_opengl_fragment_shader, m_opengl_geometry_shader, 0 != m_cache),
+			RESOURCE_SITE);
+		m_status_checked = false;
+	}
+	void ShaderProgram::CheckStatus()
+	{
+		if (m_status_checked)
+			return;
+		m_status_checked = true;
+		m_linked = ReportProgramErrors(m_opengl_shader_program.Get());
+		if (!m_linked)
+		{
+			// The link failed, so now it is worth asking which shader did not compile.
+			ReportShaderErrors(m_opengl_vertex_shader);
+			ReportShaderErrors(m_opengl_fragment_shader);
+			ReportShaderErrors(m_opengl_geometry_shader);
+		}
+		else if (0 != m_cache)
+		{
+			m_cache->Store(m_cache_key, m_opengl_shader_program.Get());
+		}
+		m_cache = 0;
+	}
+	bool ShaderProgram::IsReady()
+	{
+		if (m_status_checked)
+			return true;
+		// >> GL_COMPLETION_STATUS_KHR returns GL_TRUE if the compile or link operation has completed,
+		// >> without blocking. Only available with KHR_parallel_shader_compile.
+		if (GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile)
+		{
+			GLint completed = GL_FALSE;
+			glGetProgramiv(m_opengl_shader_program.Get(), GL_COMPLETION_STATUS_KHR, &completed);
+			return GL_TRUE == completed;
+		}
+		return true;
+	}
+	bool ShaderProgram::IsLinked()
+	{
+		CheckStatus();
+		return m_linked;
+	}
+	void ShaderProgram::Reload(jobs::ThreadPool *pool)
+	{
+		if (m_vertex_shader_file_name.empty())
+			return;
+		// A load still in flight finishes into sources nobody reads any more.
+		const std::shared_ptr<ReloadSources> reload = std::make_shared<ReloadSources>();
+		reload->file_names[0] = m_vertex_shader_file_name;
+		reload->file_names[1] = m_fragment_shader_file_name;
+		reload->file_names[2] = m_geometry_shader_file_name;
+		reload->defines = m_defines;
+		m_reload = reload;
+		const std::function<void()> load = [reload]() {
+			for (int stage = 0; stage < 3; ++stage)
+			{
+				if (!reload->file_names[stage].empty())
+					PreprocessFile(reload->file_names[stage], reload->defines, reload->sources[stage], &reload->dependencies[stage]);
+			}
+			reload->loaded.store(true, std::memory_order_release);
+		};
+		if (0 != pool)
+			pool->Submit(load);
+		else
+			load();
+	}
+	bool ShaderProgram::Update()
+	{
+		if (m_reload && m_reload->loaded.load(std::memory_order_acquire))
+		{
+			// Build into a separate ShaderProgram, which leaves this one untouched if the edit does not
+			// compile. It replaces an older reload that is still compiling.
+			const std::shared_ptr<ReloadSources> reload(std::move(m_reload));
+			if (m_pending)
+				m_pending->Destroy();
+			m_pending.reset(new ShaderProgram());
+			ShaderProgram &pending = *m_pending;
+			pending.m_vertex_shader_file_name = reload->file_names[0];
+			pending.m_fragment_shader_file_name = reload->file_names[1];
+			pending.m_geometry_shader_file_name = reload->file_names[2];
+			pending.m_defines = reload->defines;
+			for (int stage = 0; stage < 3; ++stage)
+				pending.AddDependencies(reload->dependencies[stage]);
+			pending.Compile(reload->sources[0], reload->sources[1], reload->sources[2]);
+			pending.Link();
+		}
+		if (!m_pending || !m_pending->IsReady())
+			return false;
+		std::unique_ptr<ShaderProgram> pending(std::move(m_pending));
+		if (!pending->IsLinked())
+		{
+			std::cerr << "Reloading " << m_vertex_shader_file_name << ", " << m_fragment_shader_file_name;
+			if (!m_geometry_shader_file_name.empty())
+				std::cerr << ", " << m_geometry_shader_file_name;
+			std::cerr << " failed, the previous shader program stays in use." << std::endl;
+			// Give the shader objects of the failed build back to the cache.
+			pending->Destroy();
+			return false;
+		}
+		// Swap the objects, and delete the old ones with pending.
+		std::swap(m_opengl_shader_program, pending->m_opengl_shader_program);
+		std::swap(m_opengl_vertex_shader, pending->m_opengl_vertex_shader);
+		std::swap(m_opengl_fragment_shader, pending->m_opengl_fragment_shader);
+		std::swap(m_opengl_geometry_shader, pending->m_opengl_geometry_shader);
+		// The edit may have added or dropped includes.
+		m_dependencies.swap(pending->m_dependencies);
+		pending->Destroy();
+		m_status_checked = true;
+		m_linked = true;
+		ApplyUniformBlocks();
+		return true;
+	}
+	void ShaderProgram::BindUniformBlock(const std::string &block_name, GLuint binding)
+	{
+		size_t i = 0;
+		while (i < m_uniform_blocks.size() && m_uniform_blocks[i].first != block_name)
+			++i;
+		if (i == m_uniform_blocks.size())
+			m_uniform_blocks.push_back(std::make_pair(block_name, binding));
+		else
+			m_uniform_blocks[i].second = binding;
+		CheckStatus();
+		ApplyUniformBlocks();
+	}
+	void ShaderProgram::ApplyUniformBlocks()
+	{
+		if (!m_linked)
+			return;
+		for (size_t i = 0; i < m_uniform_blocks.size(); ++i)
+		{
+			// >> glGetUniformBlockIndex retrieves the index of a uniform block within program. If
+			// >> uniformBlockName does not identify an active uniform block of program, or an error
+			// >> occurred, GL_INVALID_INDEX is returned.
+			const GLuint index = glGetUniformBlockIndex(m_opengl_shader_program.Get(), m_uniform_blocks[i].first.c_str());
+			// A block the compiler optimized away needs no binding.
+			if (GL_INVALID_INDEX != index)
+				glUniformBlockBinding(m_opengl_shader_program.Get(), index, m_uniform_blocks[i].second);
+		}
 	}
 	void ShaderProgram::Destroy()
 	{
-		glDeleteProgram(m_opengl_shader_program);
-		glDeleteShader(m_opengl_vertex_shader);
-		glDeleteShader(m_opengl_fragment_shader);
+		m_reload.reset();
+		if (m_pending)
+			m_pending->Destroy();
+		m_pending.reset();
+		m_opengl_shader_program.Reset();
+		// The shaders may be shared with other programs; the cache deletes them with their last user.
+		// Zeroing the names makes a second Destroy harmless.
+		if (0 != m_opengl_vertex_shader)
+			GetShaderObjectCache().Release(m_opengl_vertex_shader);
+		if (0 != m_opengl_fragment_shader)
+			GetShaderObjectCache().Release(m_opengl_fragment_shader);
+		if (0 != m_opengl_geometry_shader)
+			GetShaderObjectCache().Release(m_opengl_geometry_shader);
+		m_opengl_vertex_shader = 0;
+		m_opengl_fragment_shader = 0;
+		m_opengl_geometry_shader = 0;
 	}
 	ShaderProgram::~ShaderProgram()
 	{
-		Destroy();
+
 	}
 	ShaderProgram::ShaderProgram()
+		: m_opengl_vertex_shader(0), m_opengl_fragment_shader(0), m_opengl_geometry_shader(0),
+		m_cache(0), m_cache_key(0), m_status_checked(true), m_linked(false)
 	{
 
 	}
 	GLuint ShaderProgram::GetOpenGLID()
 	{
-		return m_opengl_shader_program;
+		CheckStatus();
+		return m_opengl_shader_program.Get();
 	}
 }
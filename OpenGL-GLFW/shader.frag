@@ -2,7 +2,10 @@
 
 smooth in vec4 fragment_colour;
 
+// gl_FragColor does not exist in the core profile. The only output goes to draw buffer 0.
+out vec4 output_colour;
+
 void main()
 {
-    gl_FragColor = fragment_colour;
+    output_colour = fragment_colour;
 }
\ No newline at end of file
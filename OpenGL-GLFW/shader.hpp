@@ -1,25 +1,171 @@
 #ifndef OPENGL_GLFW_TCU_SHADER_H_
 #define OPENGL_GLFW_TCU_SHADER_H_
 #include "standard.h"
+#include "resource.hpp"
+#include "shader_preprocessor.hpp"
+#include <atomic>
+#include <memory>
+#include <unordered_map>
 typedef unsigned int GLuint;
 typedef unsigned int GLenum;
 
+namespace jobs
+{
+	class ThreadPool;
+}
+
 namespace shader
 {
+	class ProgramCache;
+	class ShaderCompiler;
+	// Returns the contents of the file called filename, or an empty string if it cannot be read.
+	const std::string LoadFileContents(const std::string filename);
+	// Compiles the shader of type shader_type in the file called file_name, without waiting for the result.
+	GLuint CreateShaderFromFile(const std::string file_name, const GLenum shader_type);
+	// Prints the stage and info log of shader if it failed to compile.
+	void ReportShaderErrors(const GLuint shader);
+	// Prints the info log of program if it failed to link. Returns true if it linked.
+	bool ReportProgramErrors(const GLuint program);
+	// ShaderObjectCache shares compiled shader objects between programs. Shaders are keyed by a hash
+	// of their type and their preprocessed source, so every distinct source compiles once however many
+	// permutations and programs use it. The objects are reference counted; every Acquire needs a
+	// Release, and the last Release deletes the object.
+	class ShaderObjectCache
+	{
+	public:
+		ShaderObjectCache();
+		~ShaderObjectCache();
+		// Returns a shader of shader_type compiled from source. Compiles (without waiting for the
+		// driver) only if no live shader has the same type and source.
+		GLuint Acquire(const GLenum shader_type, const std::string &source);
+		void Release(const GLuint shader);
+		// Returns the number of live shader objects.
+		size_t GetSize() const { return m_shaders.size(); }
+		// The number of Acquire calls that compiled, and that shared an existing object.
+		unsigned int GetCompileCount() const { return m_compile_count; }
+		unsigned int GetHitCount() const { return m_hit_count; }
+	private:
+		struct Entry
+		{
+			GLenum type;
+			// Compared on a hash match, so a collision compiles a second object instead of sharing a wrong one.
+			std::string source;
+			GLuint shader;
+			unsigned int references;
+		};
+		std::unordered_map<unsigned long long, Entry> m_entries;
+		// A live shader and its key in m_entries. Shaders compiled after a collision are not in
+		// m_entries and have a key of 0.
+		struct Owned
+		{
+			unsigned long long key;
+			resource::Shader shader;
+		};
+		// Owns every live shader; erasing one deletes it.
+		std::unordered_map<GLuint, Owned> m_shaders;
+		unsigned int m_compile_count;
+		unsigned int m_hit_count;
+	};
+	// Returns the shader object cache of the OpenGL context. Only the render thread may use it.
+	ShaderObjectCache &GetShaderObjectCache();
 	class ShaderProgram
 	{
 	public:
 		ShaderProgram();
+		// Does nothing; call Destroy, which also gives the shader objects back to the cache.
 		~ShaderProgram();
-		void CreateFromFiles(const std::string vertex_shader_file_name, const std::string fragment_shader_file_name);
-		void CreateFromStrings(const std::string vertex_shader_source, const std::string fragment_shader_source);
+		// Preprocesses (see PreprocessFile), compiles and links the two files, or loads the linked program
+		// from cache if it has it (cache may be NULL). The shader objects come from GetShaderObjectCache.
+		// Errors are not checked here but on the first GetOpenGLID, so the driver can work in the meantime.
+		void CreateFromFiles(const std::string vertex_shader_file_name, const std::string fragment_shader_file_name, ProgramCache *cache = NULL,
+			const Defines &defines = Defines());
+		// The same with a geometry shader between the vertex and the fragment shader (the order of the
+		// arguments follows CreateShaderProgram). An empty geometry_shader_file_name means none.
+		void CreateFromFiles(const std::string vertex_shader_file_name, const std::string fragment_shader_file_name,
+			const std::string geometry_shader_file_name, ProgramCache *cache = NULL, const Defines &defines = Defines());
+		// The same for sources in memory. Includes are looked up in the working directory. Cannot Reload.
+		void CreateFromStrings(const std::string vertex_shader_source, const std::string fragment_shader_source, const Defines &defines = Defines());
+		void CreateFromStrings(const std::string vertex_shader_source, const std::string fragment_shader_source,
+			const std::string geometry_shader_source, const Defines &defines = Defines());
+		// Returns the files the program was built from, includes and all, e.g. to watch them for Reload.
+		const std::vector<std::string> &GetDependencies() const { return m_dependencies; }
+		// Returns the program. The first call waits for the driver to finish linking and reports any errors.
 		GLuint GetOpenGLID();
+		// Returns true once the driver has finished compiling and linking. Never blocks when the driver
+		// supports KHR_parallel_shader_compile; otherwise it always returns true.
+		bool IsReady();
+		// Returns true if the program linked successfully. Waits for the driver like GetOpenGLID.
+		bool IsLinked();
+		// Starts rebuilding the program from the files it was created from. The files are read and
+		// preprocessed on pool (on the calling thread if pool is NULL); the next Update after that
+		// submits the compile and link. The current program stays in use until Update swaps the new
+		// one in. A second Reload before then replaces the first.
+		void Reload(jobs::ThreadPool *pool = NULL);
+		// Call between frames. Submits the compile and link of a reload whose files have been read, and
+		// once those have finished, swaps the new program in if it linked, or reports its errors and
+		// keeps the current one. Returns true if the OpenGL ID changed.
+		bool Update();
+		// Returns true from Reload until Update has swapped the new program in or kept the current one.
+		bool IsReloading() const { return m_reload || m_pending; }
+		// Connects the uniform block called block_name to uniform buffer binding point binding (see
+		// uniform::UniformArena::Bind). Waits for the link like GetOpenGLID. Reloads keep the connection.
+		void BindUniformBlock(const std::string &block_name, GLuint binding);
 		void Destroy();
 	private:
-		GLuint m_opengl_shader_program;
+		friend class ShaderCompiler;
+		// Remembers cache (may be NULL) for sources and tries to load the program from it. Returns true on a hit.
+		bool LoadFromCache(ProgramCache *cache, const std::vector<std::string> &sources);
+		// Creates and compiles the shader objects without waiting for the result. An empty
+		// geometry_shader_source means the program has no geometry shader.
+		void Compile(const std::string &vertex_shader_source, const std::string &fragment_shader_source,
+			const std::string &geometry_shader_source = std::string());
+		// Appends the files in dependencies that m_dependencies does not have yet.
+		void AddDependencies(const std::vector<std::string> &dependencies);
+		// Creates and links the program without waiting for the result.
+		void Link();
+		// Queries the link status once, reports errors and stores the binary in m_cache.
+		void CheckStatus();
+		// Connects the uniform blocks in m_uniform_blocks to their binding points. Bindings belong to
+		// the program object, so a reloaded program needs them again.
+		void ApplyUniformBlocks();
+		// The files and defines the program was created from, for Reload.
+		std::string m_vertex_shader_file_name;
+		std::string m_fragment_shader_file_name;
+		std::string m_geometry_shader_file_name;
+		Defines m_defines;
+		std::vector<std::string> m_dependencies;
+		// The uniform block names and their binding points, for BindUniformBlock.
+		std::vector<std::pair<std::string, GLuint> > m_uniform_blocks;
+		// ReloadSources is what Reload reads on the pool. The task shares it with the program, so a
+		// program destroyed while its files are being read leaves the task nothing dangling.
+		struct ReloadSources
+		{
+			ReloadSources() : loaded(false) {}
+			// Vertex, fragment and geometry shader, as in ShaderCompiler::Request.
+			std::string file_names[3];
+			Defines defines;
+			std::string sources[3];
+			std::vector<std::string> dependencies[3];
+			// Set by the task once the strings above are written.
+			std::atomic<bool> loaded;
+		};
+		// The files of the latest Reload, until Update submits them, or NULL.
+		std::shared_ptr<ReloadSources> m_reload;
+		// The program being rebuilt by Reload, or NULL.
+		std::unique_ptr<ShaderProgram> m_pending;
+		resource::Program m_opengl_shader_program;
+		// Owned by GetShaderObjectCache; Destroy releases them.
 		GLuint m_opengl_vertex_shader;
 		GLuint m_opengl_fragment_shader;
+		// 0 if the program has no geometry shader.
+		GLuint m_opengl_geometry_shader;
+		// The cache the linked binary is stored in once it is known to be good, or NULL.
+		ProgramCache *m_cache;
+		unsigned long long m_cache_key;
+		// True once CheckStatus ran.
+		bool m_status_checked;
+		bool m_linked;
 	};
 }
 
-#endif
\ No newline at end of file
+#endif
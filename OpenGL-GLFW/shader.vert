@@ -1,12 +1,17 @@
 #version 150 core
+// Attribute locations in the shader need GLSL 3.30; Mesa's 3.2 core contexts only offer them as an extension.
+#extension GL_ARB_explicit_attrib_location : require
 
 layout(location = 0) in vec4 vertex_position;
 layout(location = 1) in vec4 vertex_colour;
+// Per-instance attributes (see program::QuadBatch): xy is the offset, zw the scale.
+layout(location = 2) in vec4 instance_transform;
+layout(location = 3) in vec4 instance_colour;
 
 smooth out vec4 fragment_colour;
 
 void main()
 {
-    fragment_colour = vertex_colour;
-    gl_Position = vertex_position;
+    fragment_colour = vertex_colour * instance_colour;
+    gl_Position = vec4(vertex_position.xy * instance_transform.zw + instance_transform.xy, vertex_position.zw);
 }
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "shader_cache.hpp"
+#include "opengl.h"
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace shader
+{
+	// Identifies a cache file, followed by the format version of the file.
+	const char CACHE_FILE_MAGIC[4] = { 'G', 'L', 'P', 'B' };
+	const unsigned int CACHE_FILE_VERSION = 1;
+	// CacheFileHeader precedes the program binary in every cache file.
+	struct CacheFileHeader
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned long long key;
+		// The binaryFormat returned by glGetProgramBinary.
+		unsigned int binary_format;
+		unsigned int binary_length;
+	};
+	// Returns the 64 bit FNV-1a hash of size bytes at data, continuing from hash.
+	inline unsigned long long HashBytes(const void *data, size_t size, unsigned long long hash = 14695981039346656037ull)
+	{
+		const unsigned char *bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+	unsigned long long HashString(const std::string &value, unsigned long long hash)
+	{
+		const unsigned long long length = value.size();
+		hash = HashBytes(&length, sizeof(length), hash);
+		return HashBytes(value.data(), value.size(), hash);
+	}
+	// Returns glGetString(name) as a std::string, or an empty string if the driver returns NULL.
+	inline std::string GetGLString(GLenum name)
+	{
+		const GLubyte *value = glGetString(name);
+		return 0 == value ? std::string() : std::string(reinterpret_cast<const char*>(value));
+	}
+	ProgramCache::ProgramCache()
+		: m_driver_hash(0), m_enabled(false), m_hit_count(0), m_miss_count(0), m_reject_count(0)
+	{
+
+	}
+	ProgramCache::~ProgramCache()
+	{
+
+	}
+	bool ProgramCache::Create(const std::string directory)
+	{
+		m_directory = directory;
+		// >> GL_NUM_PROGRAM_BINARY_FORMATS returns the number of available program binary formats.
+		// Some drivers expose the entry points but no format, which makes the cache useless.
+		GLint format_count = 0;
+		if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+		m_enabled = format_count > 0;
+		if (!m_enabled)
+			return false;
+#ifdef _WIN32
+		_mkdir(m_directory.c_str());
+#else
+		mkdir(m_directory.c_str(), 0755);
+#endif
+		m_driver_hash = HashString(GetGLString(GL_VENDOR), 14695981039346656037ull);
+		m_driver_hash = HashString(GetGLString(GL_RENDERER), m_driver_hash);
+		m_driver_hash = HashString(GetGLString(GL_VERSION), m_driver_hash);
+		return true;
+	}
+	unsigned long long ProgramCache::MakeKey(const std::vector<std::string> &sources, const std::string defines) const
+	{
+		unsigned long long key = HashString(defines, m_driver_hash);
+		for (size_t i = 0; i < sources.size(); ++i)
+			key = HashString(sources[i], key);
+		return key;
+	}
+	GLuint ProgramCache::Load(unsigned long long key)
+	{
+		if (!m_enabled)
+			return 0;
+		std::ifstream file(GetFileName(key).c_str(), std::ios::binary);
+		CacheFileHeader header;
+		if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header))
+			|| 0 != std::memcmp(header.magic, CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC))
+			|| CACHE_FILE_VERSION != header.version || key != header.key)
+		{
+			++m_miss_count;
+			return 0;
+		}
+		std::vector<char> binary(header.binary_length);
+		if (binary.empty() || !file.read(&binary[0], binary.size()))
+		{
+			++m_miss_count;
+			return 0;
+		}
+		file.close();
+		// >> glProgramBinary loads a program object with a program binary previously returned from
+		// >> glGetProgramBinary. If the binary is rejected (e.g. after a driver update), the link
+		// >> status of the program is set to GL_FALSE.
+		const GLuint program = glCreateProgram();
+		glProgramBinary(program, header.binary_format, &binary[0], header.binary_length);
+		GLint status = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+		if (GL_FALSE == status)
+		{
+			glDeleteProgram(program);
+			Remove(key);
+			++m_reject_count;
+			++m_miss_count;
+			return 0;
+		}
+		++m_hit_count;
+		return program;
+	}
+	void ProgramCache::Store(unsigned long long key, GLuint program)
+	{
+		if (!m_enabled)
+			return;
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+		std::vector<char> binary(length);
+		CacheFileHeader header;
+		std::memcpy(header.magic, CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC));
+		header.version = CACHE_FILE_VERSION;
+		header.key = key;
+		GLenum binary_format = 0;
+		glGetProgramBinary(program, length, NULL, &binary_format, &binary[0]);
+		header.binary_format = binary_format;
+		header.binary_length = length;
+		// Write to a temporary file first, so a crash never leaves a truncated entry behind.
+		const std::string file_name = GetFileName(key);
+		const std::string temporary_file_name = file_name + ".tmp";
+		std::ofstream file(temporary_file_name.c_str(), std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "File " << temporary_file_name << " could not be opened." << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(&binary[0], binary.size());
+		file.close();
+		std::remove(file_name.c_str());
+		std::rename(temporary_file_name.c_str(), file_name.c_str());
+	}
+	void ProgramCache::Remove(unsigned long long key)
+	{
+		std::remove(GetFileName(key).c_str());
+	}
+	std::string ProgramCache::GetFileName(unsigned long long key) const
+	{
+		char name[32];
+		std::sprintf(name, "%016llx.bin", key);
+		return m_directory + "/" + name;
+	}
+}
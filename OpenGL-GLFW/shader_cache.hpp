@@ -0,0 +1,49 @@
+#ifndef OPENGL_GLFW_TCU_SHADER_CACHE_H_
+#define OPENGL_GLFW_TCU_SHADER_CACHE_H_
+
+#include "standard.h"
+typedef unsigned int GLuint;
+
+namespace shader
+{
+	// Returns the 64 bit FNV-1a hash of the length and the characters of value, continuing from hash.
+	unsigned long long HashString(const std::string &value, unsigned long long hash = 14695981039346656037ull);
+	// ProgramCache stores linked program binaries on disk (glGetProgramBinary) and recreates programs
+	// from them (glProgramBinary), so a warm start skips compiling and linking altogether.
+	// Entries are keyed by a hash of the shader sources, the defines and the driver's vendor, renderer
+	// and version strings; a driver update therefore misses instead of loading an incompatible binary.
+	class ProgramCache
+	{
+	public:
+		ProgramCache();
+		~ProgramCache();
+		// Uses directory (created if needed) for the cache files. Returns false, and leaves the cache
+		// disabled, if the driver cannot retrieve program binaries.
+		bool Create(const std::string directory);
+		bool IsEnabled() const { return m_enabled; }
+		// Returns the key of a program built from sources with defines, on the current driver.
+		unsigned long long MakeKey(const std::vector<std::string> &sources, const std::string defines) const;
+		// Creates a program from the binary cached for key. Returns 0 if there is none or the driver
+		// rejects it (the stale file is deleted then), in which case the caller compiles as usual.
+		GLuint Load(unsigned long long key);
+		// Writes the binary of a successfully linked program to the cache.
+		void Store(unsigned long long key, GLuint program);
+		// Deletes the cache file for key, if there is one.
+		void Remove(unsigned long long key);
+		unsigned int GetHitCount() const { return m_hit_count; }
+		unsigned int GetMissCount() const { return m_miss_count; }
+		// The number of cached binaries the driver refused to load (counted as misses as well).
+		unsigned int GetRejectCount() const { return m_reject_count; }
+	private:
+		std::string GetFileName(unsigned long long key) const;
+		std::string m_directory;
+		// The hash of the driver strings, folded into every key.
+		unsigned long long m_driver_hash;
+		bool m_enabled;
+		unsigned int m_hit_count;
+		unsigned int m_miss_count;
+		unsigned int m_reject_count;
+	};
+}
+
+#endif
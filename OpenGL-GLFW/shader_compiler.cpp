@@ -0,0 +1,91 @@
+#include "shader_compiler.hpp"
+#include "shader.hpp"
+#include "shader_cache.hpp"
+#include "jobs.hpp"
+#include "opengl.h"
+
+namespace shader
+{
+	ShaderCompiler::ShaderCompiler()
+		: m_pool(0), m_cache(0)
+	{
+
+	}
+	ShaderCompiler::~ShaderCompiler()
+	{
+
+	}
+	void ShaderCompiler::Create(jobs::ThreadPool *pool, ProgramCache *cache)
+	{
+		m_pool = pool;
+		m_cache = (0 != cache && cache->IsEnabled()) ? cache : 0;
+		// >> glMaxShaderCompilerThreadsKHR specifies the number of threads the implementation may use
+		// >> to compile shaders. 0xFFFFFFFF means an implementation-specific maximum.
+		if (GLEW_KHR_parallel_shader_compile)
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		else if (GLEW_ARB_parallel_shader_compile)
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	}
+	void ShaderCompiler::Add(ShaderProgram &program, const std::string vertex_shader_file_name, const std::string fragment_shader_file_name,
+		const Defines &defines)
+	{
+		Add(program, vertex_shader_file_name, fragment_shader_file_name, std::string(), defines);
+	}
+	void ShaderCompiler::Add(ShaderProgram &program, const std::string vertex_shader_file_name, const std::string fragment_shader_file_name,
+		const std::string geometry_shader_file_name, const Defines &defines)
+	{
+		Request request;
+		request.program = &program;
+		request.file_names[0] = vertex_shader_file_name;
+		request.file_names[1] = fragment_shader_file_name;
+		request.file_names[2] = geometry_shader_file_name;
+		request.defines = defines;
+		m_requests.push_back(request);
+	}
+	void ShaderCompiler::Submit()
+	{
+		// Read and preprocess every file on the pool. Each task writes only to its own strings.
+		for (size_t i = 0; i < m_requests.size(); ++i)
+		{
+			for (int stage = 0; stage < 3; ++stage)
+			{
+				Request *request = &m_requests[i];
+				if (request->file_names[stage].empty())
+					continue;
+				const std::function<void()> load = [request, stage]() {
+					PreprocessFile(request->file_names[stage], request->defines, request->sources[stage], &request->dependencies[stage]);
+				};
+				if (0 != m_pool)
+					m_pool->Submit(load);
+				else
+					load();
+			}
+		}
+		if (0 != m_pool)
+			m_pool->Wait();
+		// Compile everything that is not cached, then link; nothing here waits for the driver.
+		std::vector<ShaderProgram*> to_link;
+		for (size_t i = 0; i < m_requests.size(); ++i)
+		{
+			Request &request = m_requests[i];
+			ShaderProgram &program = *request.program;
+			// What CreateFromFiles would have remembered, so the program can Reload.
+			program.m_vertex_shader_file_name = request.file_names[0];
+			program.m_fragment_shader_file_name = request.file_names[1];
+			program.m_geometry_shader_file_name = request.file_names[2];
+			program.m_defines = request.defines;
+			program.m_dependencies.clear();
+			for (int stage = 0; stage < 3; ++stage)
+				program.AddDependencies(request.dependencies[stage]);
+			// Like CreateFromFiles, the key only includes a geometry shader if there is one.
+			const int stage_count = request.file_names[2].empty() ? 2 : 3;
+			if (program.LoadFromCache(m_cache, std::vector<std::string>(request.sources, request.sources + stage_count)))
+				continue;
+			program.Compile(request.sources[0], request.sources[1], request.sources[2]);
+			to_link.push_back(&program);
+		}
+		for (size_t i = 0; i < to_link.size(); ++i)
+			to_link[i]->Link();
+		m_requests.clear();
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef OPENGL_GLFW_TCU_SHADER_COMPILER_H_
+#define OPENGL_GLFW_TCU_SHADER_COMPILER_H_
+
+#include "standard.h"
+#include "shader_preprocessor.hpp"
+
+namespace jobs
+{
+	class ThreadPool;
+}
+
+namespace shader
+{
+	class ProgramCache;
+	class ShaderProgram;
+	// ShaderCompiler builds a whole set of shader programs at once. Source files are read and
+	// preprocessed on a thread pool, then every shader is compiled and every program linked before anything is asked of the
+	// driver, so drivers that compile in the background (KHR_parallel_shader_compile) can spread the
+	// work over their own threads. Errors are reported when a program is first used (GetOpenGLID).
+	class ShaderCompiler
+	{
+	public:
+		ShaderCompiler();
+		~ShaderCompiler();
+		// pool loads the sources; it may be NULL to load them on the calling thread. cache may be NULL.
+		void Create(jobs::ThreadPool *pool, ProgramCache *cache = NULL);
+		// Queues program to be built from the two files with defines. program must stay alive until Submit returns.
+		void Add(ShaderProgram &program, const std::string vertex_shader_file_name, const std::string fragment_shader_file_name,
+			const Defines &defines = Defines());
+		// The same with a geometry shader (see ShaderProgram::CreateFromFiles).
+		void Add(ShaderProgram &program, const std::string vertex_shader_file_name, const std::string fragment_shader_file_name,
+			const std::string geometry_shader_file_name, const Defines &defines = Defines());
+		// Loads the sources of every queued program and submits all compiles and links. Does not wait
+		// for the driver; use ShaderProgram::IsReady to find out when a program can be used without stalling.
+		void Submit();
+	private:
+		// Request is one queued program and, once loaded, its sources.
+		struct Request
+		{
+			ShaderProgram *program;
+			// Vertex, fragment and geometry shader; the geometry shader file name is empty without one.
+			std::string file_names[3];
+			Defines defines;
+			std::string sources[3];
+			std::vector<std::string> dependencies[3];
+		};
+		std::vector<Request> m_requests;
+		jobs::ThreadPool *m_pool;
+		ProgramCache *m_cache;
+	};
+}
+
+#endif
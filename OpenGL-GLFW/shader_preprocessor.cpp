@@ -0,0 +1,223 @@
+#include "shader_preprocessor.hpp"
+#include "shader.hpp"
+#include <algorithm>
+#include <cctype>
+
+namespace shader
+{
+	// How deeply includes may nest. Deeper nesting is taken to be a mistake.
+	const int MAX_INCLUDE_DEPTH = 16;
+	// Returns the directory part of file_name, including the trailing separator.
+	inline std::string GetDirectory(const std::string &file_name)
+	{
+		const size_t separator = file_name.find_last_of("/\\");
+		return separator == std::string::npos ? std::string() : file_name.substr(0, separator + 1);
+	}
+	inline bool IsIdentifierCharacter(char character)
+	{
+		return 0 != std::isalnum(static_cast<unsigned char>(character)) || '_' == character;
+	}
+	// Returns true if name occurs in source as a whole identifier.
+	bool IsReferenced(const std::string &source, const std::string &name)
+	{
+		for (size_t position = source.find(name); position != std::string::npos; position = source.find(name, position + 1))
+		{
+			const size_t end = position + name.size();
+			if ((0 == position || !IsIdentifierCharacter(source[position - 1])) && (end == source.size() || !IsIdentifierCharacter(source[end])))
+				return true;
+		}
+		return false;
+	}
+	// If line is an #include directive, stores the included name in name and returns true.
+	bool ParseInclude(const std::string &line, std::string &name)
+	{
+		size_t position = line.find_first_not_of(" \t");
+		if (position == std::string::npos || line[position] != '#')
+			return false;
+		position = line.find_first_not_of(" \t", position + 1);
+		if (position == std::string::npos || line.compare(position, 7, "include") != 0)
+			return false;
+		const size_t open = line.find_first_of("\"<", position + 7);
+		if (open == std::string::npos)
+			return false;
+		const size_t close = line.find_first_of("\">", open + 1);
+		if (close == std::string::npos)
+			return false;
+		name = line.substr(open + 1, close - open - 1);
+		return true;
+	}
+	// Appends source to output with its includes expanded. file_index is the index of source in
+	// files, which lists every file read so far.
+	bool ExpandIncludes(const std::string &source, const std::string &directory, size_t file_index, int depth,
+		std::vector<std::string> &files, std::string &output)
+	{
+		if (depth > MAX_INCLUDE_DEPTH)
+		{
+			std::cerr << "Shader includes nest deeper than " << MAX_INCLUDE_DEPTH << " files; is a file including itself?" << std::endl;
+			return false;
+		}
+		size_t line_number = 1;
+		for (size_t begin = 0; begin < source.size(); ++line_number)
+		{
+			size_t end = source.find('\n', begin);
+			end = end == std::string::npos ? source.size() : end + 1;
+			const std::string line = source.substr(begin, end - begin);
+			begin = end;
+			std::string name;
+			if (!ParseInclude(line, name))
+			{
+				output += line;
+				continue;
+			}
+			const std::string file_name = directory + name;
+			// Every file is included once, which also makes include guards unnecessary.
+			if (std::find(files.begin(), files.end(), file_name) != files.end())
+			{
+				output += '\n';
+				continue;
+			}
+			files.push_back(file_name);
+			const size_t included_index = files.size() - 1;
+			std::ifstream file(file_name.c_str());
+			if (!file)
+			{
+				std::cerr << "Shader include " << file_name << " could not be opened." << std::endl;
+				return false;
+			}
+			file.close();
+			std::string included = LoadFileContents(file_name);
+			if (!included.empty() && included[included.size() - 1] != '\n')
+				included += '\n';
+			std::ostringstream line_directive;
+			line_directive << "#line 1 " << included_index << '\n';
+			output += line_directive.str();
+			if (!ExpandIncludes(included, GetDirectory(file_name), included_index, depth + 1, files, output))
+				return false;
+			line_directive.str(std::string());
+			line_directive << "#line " << line_number + 1 << ' ' << file_index << '\n';
+			output += line_directive.str();
+		}
+		return true;
+	}
+	// Returns the offset just past the line that ends the #version directive of source, and stores the
+	// number of the line that follows in next_line. Only blank lines and comments may come before the
+	// directive; returns npos if something else does or there is none.
+	size_t FindVersionEnd(const std::string &source, size_t &next_line)
+	{
+		size_t line_number = 1;
+		size_t position = 0;
+		while (position < source.size())
+		{
+			if ('\n' == source[position])
+			{
+				++line_number;
+				++position;
+			}
+			else if (' ' == source[position] || '\t' == source[position] || '\r' == source[position])
+			{
+				++position;
+			}
+			else if (0 == source.compare(position, 2, "//"))
+			{
+				position = source.find('\n', position);
+				if (position == std::string::npos)
+					return std::string::npos;
+			}
+			else if (0 == source.compare(position, 2, "/*"))
+			{
+				const size_t close = source.find("*/", position + 2);
+				if (close == std::string::npos)
+					return std::string::npos;
+				line_number += std::count(source.begin() + position, source.begin() + close, '\n');
+				position = close + 2;
+			}
+			else
+			{
+				break;
+			}
+		}
+		if (position == source.size() || '#' != source[position])
+			return std::string::npos;
+		position = source.find_first_not_of(" \t", position + 1);
+		if (position == std::string::npos || 0 != source.compare(position, 7, "version"))
+			return std::string::npos;
+		// The directive ends with its line, unless a block comment starting on that line runs on.
+		for (;;)
+		{
+			const size_t end = source.find('\n', position);
+			const size_t line_comment = source.find("//", position);
+			const size_t block_comment = source.find("/*", position);
+			if (block_comment < end && block_comment < line_comment)
+			{
+				const size_t close = source.find("*/", block_comment + 2);
+				if (close == std::string::npos)
+					return std::string::npos;
+				line_number += std::count(source.begin() + block_comment, source.begin() + close, '\n');
+				position = close + 2;
+				continue;
+			}
+			next_line = line_number + 1;
+			return end == std::string::npos ? source.size() : end + 1;
+		}
+	}
+	// Inserts the referenced defines after the #version directive of source (or at the start without one),
+	// followed by a #line directive that keeps the line numbers of the rest of the file.
+	void InjectDefines(const Defines &defines, std::string &source)
+	{
+		Defines sorted = defines;
+		std::sort(sorted.begin(), sorted.end());
+		std::string text;
+		int count = 0;
+		for (size_t i = 0; i < sorted.size(); ++i)
+		{
+			if (!IsReferenced(source, sorted[i].first))
+				continue;
+			text += "#define " + sorted[i].first + ' ' + sorted[i].second + '\n';
+			++count;
+		}
+		if (0 == count)
+			return;
+		size_t next_line = 1;
+		size_t position = FindVersionEnd(source, next_line);
+		if (position == std::string::npos)
+			position = 0;
+		else if ('\n' != source[position - 1])
+			text.insert(0, 1, '\n');
+		std::ostringstream line_directive;
+		line_directive << "#line " << next_line << " 0\n";
+		source.insert(position, text + line_directive.str());
+	}
+	bool PreprocessFile(const std::string &file_name, const Defines &defines, std::string &output, std::vector<std::string> *dependencies)
+	{
+		std::vector<std::string> files;
+		files.push_back(file_name);
+		output.clear();
+		const bool expanded = ExpandIncludes(LoadFileContents(file_name), GetDirectory(file_name), 0, 0, files, output);
+		InjectDefines(defines, output);
+		if (0 != dependencies)
+			dependencies->swap(files);
+		return expanded;
+	}
+	bool PreprocessSource(const std::string &source, const std::string &directory, const Defines &defines, std::string &output,
+		std::vector<std::string> *dependencies)
+	{
+		// Index 0 is the source itself, which has no file name.
+		std::vector<std::string> files(1);
+		output.clear();
+		const bool expanded = ExpandIncludes(source, directory, 0, 0, files, output);
+		InjectDefines(defines, output);
+		if (0 != dependencies)
+			dependencies->assign(files.begin() + 1, files.end());
+		return expanded;
+	}
+	Defines GetPermutationDefines(const std::vector<std::string> &features, unsigned long long permutation)
+	{
+		Defines defines;
+		for (size_t i = 0; i < features.size() && i < 64; ++i)
+		{
+			if (0 != (permutation & (1ull << i)))
+				defines.push_back(std::make_pair(features[i], std::string("1")));
+		}
+		return defines;
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef OPENGL_GLFW_TCU_SHADER_PREPROCESSOR_H_
+#define OPENGL_GLFW_TCU_SHADER_PREPROCESSOR_H_
+
+#include "standard.h"
+#include <utility>
+
+namespace shader
+{
+	// Defines are preprocessor macros given to a shader, as (name, value) pairs.
+	typedef std::vector<std::pair<std::string, std::string> > Defines;
+	// Reads file_name and returns its source ready for glShaderSource in output:
+	//  - every #include "name" line is replaced by the file name (relative to the including file), once
+	//    per file, with #line directives so compile errors keep their line numbers. The source string
+	//    number of a #line is the index of the file in dependencies.
+	//  - defines are added after the #version line, sorted by name, but only those whose name occurs in
+	//    the source. A feature a stage does not use therefore leaves the stage's source unchanged, and
+	//    permutations that differ only in such features preprocess to identical text.
+	// dependencies (may be NULL) receives every file read, file_name first, e.g. to watch them.
+	// Prints the problem and returns false if a file cannot be read or includes nest too deeply.
+	bool PreprocessFile(const std::string &file_name, const Defines &defines, std::string &output, std::vector<std::string> *dependencies = NULL);
+	// The same for a source that did not come from a file. Includes are looked up in directory
+	// (empty for the working directory). source itself is source string 0, so the index of a file in
+	// dependencies is one less than its source string number.
+	bool PreprocessSource(const std::string &source, const std::string &directory, const Defines &defines, std::string &output,
+		std::vector<std::string> *dependencies = NULL);
+	// Returns the defines of one permutation of features: every feature whose bit is set in
+	// permutation is defined as 1. There are 1 << features.size() permutations.
+	Defines GetPermutationDefines(const std::vector<std::string> &features, unsigned long long permutation);
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "sprite.hpp"
+#include "opengl.h"
+#include "state_cache.hpp"
+#include <algorithm>
+
+namespace sprite
+{
+	// The number of full batches the ring buffer holds, so up to three flushes can be in flight.
+	const GLsizei RING_BUFFER_BATCHES = 3;
+	// The most sprites EXPAND_ON_CPU draws at once: 4 vertices each must be addressable by a GLushort.
+	const GLsizei MAX_CPU_CAPACITY = 65536 / 4;
+	SpriteBatch::SpriteBatch()
+		: m_expansion(EXPAND_ON_GPU), m_sprite_count(0), m_capacity(0), m_uploaded_bytes(0), m_draw_call_count(0), m_dropped_count(0)
+	{
+
+	}
+	SpriteBatch::~SpriteBatch()
+	{
+
+	}
+	void SpriteBatch::Create(GLsizei capacity, Expansion expansion)
+	{
+		m_expansion = expansion;
+		m_capacity = expansion == EXPAND_ON_CPU ? std::min(capacity, MAX_CPU_CAPACITY) : capacity;
+		render::StateCache &state = render::GetStateCache();
+		m_vao.Create(RESOURCE_SITE);
+		state.BindVertexArray(m_vao.Get());
+		// Creating the ring buffer binds it to GL_ARRAY_BUFFER, which is where the attribute pointers read from.
+		m_ring_buffer.Create(GL_ARRAY_BUFFER, RING_BUFFER_BATCHES * m_capacity * GetBytesPerSprite());
+		VertexFormat::Apply();
+		if (expansion == EXPAND_ON_CPU)
+		{
+			// Both triangles share the diagonal from corner 1 to corner 2, like the strip shader.geom emits.
+			std::vector<GLushort> indices(m_capacity * 6);
+			for (GLsizei quad = 0; quad < m_capacity; ++quad)
+			{
+				const GLushort first = static_cast<GLushort>(quad * 4);
+				const GLushort quad_indices[6] = { first, static_cast<GLushort>(first + 1), static_cast<GLushort>(first + 2),
+					static_cast<GLushort>(first + 2), static_cast<GLushort>(first + 1), static_cast<GLushort>(first + 3) };
+				std::copy(quad_indices, quad_indices + 6, indices.begin() + quad * 6);
+			}
+			// The element array binding is part of the VAO.
+			m_index_buffer.Create(RESOURCE_SITE);
+			state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer.Get());
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+			m_index_buffer.SetBytes(indices.size() * sizeof(GLushort));
+		}
+		shader::Defines defines;
+		if (expansion == EXPAND_ON_CPU)
+		{
+			defines.push_back(std::make_pair(std::string("EXPAND_ON_CPU"), std::string("1")));
+			m_shader_program.CreateFromFiles("sprite.vert", "sprite.frag", NULL, defines);
+		}
+		else
+		{
+			m_shader_program.CreateFromFiles("sprite.vert", "sprite.frag", "shader.geom", NULL, defines);
+		}
+	}
+	void SpriteBatch::Destroy()
+	{
+		if (0 != m_allocation.pointer)
+			m_ring_buffer.Commit(m_allocation, 0);
+		m_sprite_count = 0;
+		m_ring_buffer.Destroy();
+		m_shader_program.Destroy();
+		m_index_buffer.Reset();
+		m_vao.Reset();
+	}
+	void SpriteBatch::Add(GLfloat x, GLfloat y, GLfloat half_width, GLfloat half_height, GLubyte red, GLubyte green, GLubyte blue, GLubyte alpha)
+	{
+		if (m_sprite_count == m_capacity)
+			Flush();
+		if (0 == m_allocation.pointer)
+		{
+			m_allocation = m_ring_buffer.Allocate(m_capacity * GetBytesPerSprite(), VertexFormat::STRIDE);
+			if (0 == m_allocation.pointer)
+			{
+				m_ring_buffer.Fence();
+				m_allocation = m_ring_buffer.Allocate(m_capacity * GetBytesPerSprite(), VertexFormat::STRIDE);
+			}
+			if (0 == m_allocation.pointer)
+			{
+				++m_dropped_count;
+				return;
+			}
+		}
+		VertexFormat::Vertex *vertices = static_cast<VertexFormat::Vertex*>(m_allocation.pointer);
+		// Vertices are built on the stack and copied whole, so the (write combined) buffer is written in order.
+		VertexFormat::Vertex vertex;
+		vertex.Set<1>(red, green, blue, alpha);
+		if (m_expansion == EXPAND_ON_GPU)
+		{
+			vertex.Set<0>(x, y);
+			vertex.Set<2>(vertex::ToHalf(half_width), vertex::ToHalf(half_height));
+			vertices[m_sprite_count++] = vertex;
+			return;
+		}
+		// Round the size like the point would, so both expansions cover the same pixels.
+		half_width = vertex::FromHalf(vertex::ToHalf(half_width));
+		half_height = vertex::FromHalf(vertex::ToHalf(half_height));
+		const vertex::Half minus_one = vertex::ToHalf(-1.0f);
+		const vertex::Half one = vertex::ToHalf(1.0f);
+		VertexFormat::Vertex *corners = vertices + m_sprite_count * 4;
+		vertex.Set<0>(x - half_width, y - half_height);
+		vertex.Set<2>(minus_one, minus_one);
+		corners[0] = vertex;
+		vertex.Set<0>(x + half_width, y - half_height);
+		vertex.Set<2>(one, minus_one);
+		corners[1] = vertex;
+		vertex.Set<0>(x - half_width, y + half_height);
+		vertex.Set<2>(minus_one, one);
+		corners[2] = vertex;
+		vertex.Set<0>(x + half_width, y + half_height);
+		vertex.Set<2>(one, one);
+		corners[3] = vertex;
+		++m_sprite_count;
+	}
+	void SpriteBatch::Flush()
+	{
+		render::StateCache &state = render::GetStateCache();
+		state.BindVertexArray(m_vao.Get());
+		state.UseProgram(m_shader_program.GetOpenGLID());
+		if (0 == m_allocation.pointer)
+			return;
+		// Hand the written vertices to OpenGL; the rest of the allocation goes back to the ring.
+		const GLsizeiptr used_size = m_sprite_count * GetBytesPerSprite();
+		m_ring_buffer.Commit(m_allocation, used_size);
+		m_uploaded_bytes += used_size;
+		// Allocations are aligned to the stride, so the attribute pointers never move: the draw starts at
+		// the allocation's first vertex instead.
+		const GLint first_vertex = static_cast<GLint>(m_allocation.offset / VertexFormat::STRIDE);
+		if (m_expansion == EXPAND_ON_GPU)
+		{
+			glDrawArrays(GL_POINTS, first_vertex, m_sprite_count);
+		}
+		else
+		{
+			// >> glDrawElementsBaseVertex behaves identically to glDrawElements except that the ith element
+			// >> transferred by the corresponding draw call will be taken from element indices[i] + basevertex
+			// >> of each enabled array.
+			glDrawElementsBaseVertex(GL_TRIANGLES, m_sprite_count * 6, GL_UNSIGNED_SHORT, 0, first_vertex);
+		}
+		++m_draw_call_count;
+		m_allocation = stream::Allocation();
+		m_sprite_count = 0;
+	}
+	void SpriteBatch::EndFrame()
+	{
+		m_ring_buffer.Fence();
+	}
+	void SpriteBatch::ResetStatistics()
+	{
+		m_uploaded_bytes = 0;
+		m_draw_call_count = 0;
+		m_dropped_count = 0;
+	}
+}
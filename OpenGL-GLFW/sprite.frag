@@ -0,0 +1,13 @@
+#version 150 core
+
+smooth in vec4 fragment_colour;
+smooth in vec2 fragment_corner;
+
+out vec4 output_colour;
+
+void main()
+{
+    // Round sprites: darken towards the edge of the circle, and leave the corners black.
+    float fade = clamp(1.0 - dot(fragment_corner, fragment_corner), 0.0, 1.0);
+    output_colour = vec4(fragment_colour.rgb * fade, fragment_colour.a);
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef OPENGL_GLFW_TCU_SPRITE_H_
+#define OPENGL_GLFW_TCU_SPRITE_H_
+
+#include "standard.h"
+#include "resource.hpp"
+#include "shader.hpp"
+#include "stream.hpp"
+#include "vertex_format.hpp"
+typedef int GLsizei;
+
+namespace sprite
+{
+	// Expansion is where a sprite becomes the two triangles that are rasterized.
+	enum Expansion
+	{
+		// One point per sprite is uploaded; shader.geom turns it into a quad.
+		EXPAND_ON_GPU,
+		// Four corners per sprite are uploaded and drawn with a static index buffer.
+		EXPAND_ON_CPU
+	};
+	// The vertex of both expansions, 16 bytes: a position, the colour and an extent. With EXPAND_ON_GPU
+	// a sprite is one vertex, at its centre, and the extent is half its width and height. With
+	// EXPAND_ON_CPU a sprite is four, one at each corner, and the extent says which corner (-1 or 1 each).
+	typedef vertex::Format<vertex::Attribute<0, GLfloat, 2>, vertex::Attribute<1, GLubyte, 4, true>,
+		vertex::Attribute<2, vertex::Half, 2> > VertexFormat;
+	// SpriteBatch draws round, coloured, screen aligned sprites (particles) with its own VAO and
+	// shader program (sprite.vert, sprite.frag and, for EXPAND_ON_GPU, shader.geom). Like
+	// program::QuadBatch it writes straight into a stream::RingBuffer and splits batches larger than
+	// its capacity into several draws.
+	class SpriteBatch
+	{
+	public:
+		SpriteBatch();
+		~SpriteBatch();
+		// Creates the VAO, a ring buffer for three batches of capacity sprites and the shader program.
+		// EXPAND_ON_CPU limits capacity to 16384 sprites, so the indices fit in 16 bits.
+		void Create(GLsizei capacity, Expansion expansion);
+		void Destroy();
+		// Queues a sprite centred on (x, y) in normalized device coordinates. Draws the queued sprites
+		// first if the capacity is reached.
+		void Add(GLfloat x, GLfloat y, GLfloat half_width, GLfloat half_height, GLubyte red, GLubyte green, GLubyte blue, GLubyte alpha);
+		// Draws the queued sprites. The batch's VAO and program are left bound.
+		void Flush();
+		// Fences the vertices drawn this frame. Call it once per frame after the last Flush.
+		void EndFrame();
+		Expansion GetExpansion() const { return m_expansion; }
+		// Returns the number of vertex bytes uploaded per sprite.
+		size_t GetBytesPerSprite() const { return (m_expansion == EXPAND_ON_GPU ? 1 : 4) * VertexFormat::STRIDE; }
+		// Returns the vertex bytes uploaded, the draw calls issued and the sprites dropped because the
+		// ring buffer had no space (see QuadBatch::Add) since the last ResetStatistics.
+		long long GetUploadedBytes() const { return m_uploaded_bytes; }
+		GLsizei GetDrawCallCount() const { return m_draw_call_count; }
+		GLsizei GetDroppedCount() const { return m_dropped_count; }
+		void ResetStatistics();
+		shader::ShaderProgram &GetShaderProgram() { return m_shader_program; }
+	private:
+		Expansion m_expansion;
+		resource::VertexArray m_vao;
+		// The indices of EXPAND_ON_CPU: 0, 1, 2, 2, 1, 3 for every quad.
+		resource::Buffer m_index_buffer;
+		shader::ShaderProgram m_shader_program;
+		// The vertices of the queued sprites live in m_allocation inside m_ring_buffer.
+		stream::RingBuffer m_ring_buffer;
+		stream::Allocation m_allocation;
+		GLsizei m_sprite_count;
+		GLsizei m_capacity;
+		long long m_uploaded_bytes;
+		GLsizei m_draw_call_count;
+		GLsizei m_dropped_count;
+	};
+}
+
+#endif
@@ -0,0 +1,37 @@
+#version 150 core
+// Attribute locations in the shader need GLSL 3.30; Mesa's 3.2 core contexts only offer them as an extension.
+#extension GL_ARB_explicit_attrib_location : require
+
+// See sprite::PointFormat and sprite::CornerFormat.
+layout(location = 0) in vec2 sprite_position;
+layout(location = 1) in vec4 sprite_colour;
+layout(location = 2) in vec2 sprite_extent;
+
+#ifdef EXPAND_ON_CPU
+// A corner of a quad built on the CPU: the position is the corner's, the extent is the corner
+// itself (-1.0 or 1.0 each).
+smooth out vec4 fragment_colour;
+smooth out vec2 fragment_corner;
+
+void main()
+{
+    fragment_colour = sprite_colour;
+    fragment_corner = sprite_extent;
+    gl_Position = vec4(sprite_position, 0.0, 1.0);
+}
+#else
+// One point per sprite, expanded by shader.geom: the position is the centre, the extent half the
+// width and height.
+out VertexData
+{
+    vec2 half_size;
+    vec4 colour;
+} vertex_out;
+
+void main()
+{
+    vertex_out.half_size = sprite_extent;
+    vertex_out.colour = sprite_colour;
+    gl_Position = vec4(sprite_position, 0.0, 1.0);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "state_cache.hpp"
+#include "opengl.h"
+
+namespace render
+{
+	// Marks shadowed state as unknown. No object is called ~0, and it is no valid enum either.
+	const GLuint UNKNOWN = ~0u;
+	// The buffer targets and texture targets the cache shadows, in the order of its arrays.
+	const GLenum BUFFER_TARGETS[StateCache::BUFFER_TARGET_COUNT] = {
+		GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+		GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_TEXTURE_BUFFER, GL_TRANSFORM_FEEDBACK_BUFFER,
+		GL_UNIFORM_BUFFER, GL_DRAW_INDIRECT_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, GL_SHADER_STORAGE_BUFFER
+	};
+	const GLenum BUFFER_BINDINGS[StateCache::BUFFER_TARGET_COUNT] = {
+		GL_ARRAY_BUFFER_BINDING, GL_ELEMENT_ARRAY_BUFFER_BINDING, GL_COPY_READ_BUFFER_BINDING, GL_COPY_WRITE_BUFFER_BINDING,
+		GL_PIXEL_PACK_BUFFER_BINDING, GL_PIXEL_UNPACK_BUFFER_BINDING, GL_TEXTURE_BUFFER_BINDING, GL_TRANSFORM_FEEDBACK_BUFFER_BINDING,
+		GL_UNIFORM_BUFFER_BINDING, GL_DRAW_INDIRECT_BUFFER_BINDING, GL_DISPATCH_INDIRECT_BUFFER_BINDING, GL_SHADER_STORAGE_BUFFER_BINDING
+	};
+	const GLenum TEXTURE_TARGETS[StateCache::TEXTURE_TARGET_COUNT] = {
+		GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER
+	};
+	const GLenum CAPABILITIES[StateCache::CAPABILITY_COUNT] = {
+		GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST, GL_STENCIL_TEST
+	};
+	// Returns the index of value in values, or count if it is not there.
+	inline unsigned int IndexOf(const GLenum *values, unsigned int count, GLenum value)
+	{
+		unsigned int i = 0;
+		while (i < count && values[i] != value)
+			++i;
+		return i;
+	}
+	StateCache::StateCache()
+	{
+		Invalidate();
+	}
+	void StateCache::Invalidate()
+	{
+		m_program = UNKNOWN;
+		m_vao = UNKNOWN;
+		for (unsigned int i = 0; i < BUFFER_TARGET_COUNT; ++i)
+			m_buffers[i] = UNKNOWN;
+		for (unsigned int i = 0; i < UNIFORM_BINDING_COUNT; ++i)
+			m_uniform_ranges[i].buffer = UNKNOWN;
+		m_active_texture_unit = UNKNOWN;
+		for (unsigned int unit = 0; unit < TEXTURE_UNIT_COUNT; ++unit)
+		{
+			for (unsigned int target = 0; target < TEXTURE_TARGET_COUNT; ++target)
+				m_textures[unit][target] = UNKNOWN;
+		}
+		for (unsigned int i = 0; i < CAPABILITY_COUNT; ++i)
+			m_capabilities[i] = -1;
+		m_blend_source = UNKNOWN;
+		m_blend_destination = UNKNOWN;
+		m_depth_function = UNKNOWN;
+		m_depth_mask = -1;
+		m_cull_face = UNKNOWN;
+		// A negative width is invalid, so no viewport matches it.
+		m_viewport[0] = m_viewport[1] = 0;
+		m_viewport[2] = m_viewport[3] = -1;
+	}
+	template <typename T>
+	bool StateCache::Change(T &shadow, T value)
+	{
+		if (shadow == value)
+		{
+			Count(false);
+			return false;
+		}
+		shadow = value;
+		Count(true);
+		return true;
+	}
+	void StateCache::Count(bool issued)
+	{
+		if (issued)
+		{
+			++m_frame.issued;
+			++m_total.issued;
+		}
+		else
+		{
+			++m_frame.redundant;
+			++m_total.redundant;
+		}
+	}
+	void StateCache::UseProgram(GLuint program)
+	{
+		if (Change(m_program, program))
+			glUseProgram(program);
+	}
+	void StateCache::BindVertexArray(GLuint vao)
+	{
+		if (Change(m_vao, vao))
+		{
+			glBindVertexArray(vao);
+			// Every VAO has its own element buffer binding.
+			m_buffers[1] = UNKNOWN;
+		}
+	}
+	void StateCache::BindBuffer(GLenum target, GLuint buffer)
+	{
+		const unsigned int index = IndexOf(BUFFER_TARGETS, BUFFER_TARGET_COUNT, target);
+		GLuint unknown_target = UNKNOWN;
+		if (Change(index < BUFFER_TARGET_COUNT ? m_buffers[index] : unknown_target, buffer))
+			glBindBuffer(target, buffer);
+	}
+	void StateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+	{
+		const unsigned int target_index = IndexOf(BUFFER_TARGETS, BUFFER_TARGET_COUNT, target);
+		if (target_index < BUFFER_TARGET_COUNT)
+			m_buffers[target_index] = buffer;
+		if (GL_UNIFORM_BUFFER == target && index < UNIFORM_BINDING_COUNT)
+		{
+			const BufferRange range = { buffer, 0, -1 };
+			m_uniform_ranges[index] = range;
+		}
+		Count(true);
+		glBindBufferBase(target, index, buffer);
+	}
+	void StateCache::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		if (GL_UNIFORM_BUFFER == target && index < UNIFORM_BINDING_COUNT)
+		{
+			BufferRange &range = m_uniform_ranges[index];
+			if (range.buffer == buffer && range.offset == offset && range.size == size)
+			{
+				Count(false);
+				return;
+			}
+			range.buffer = buffer;
+			range.offset = offset;
+			range.size = size;
+		}
+		const unsigned int target_index = IndexOf(BUFFER_TARGETS, BUFFER_TARGET_COUNT, target);
+		if (target_index < BUFFER_TARGET_COUNT)
+			m_buffers[target_index] = buffer;
+		Count(true);
+		// >> glBindBufferRange binds a range the buffer object buffer represented by offset and size to
+		// >> the binding point at index index of the array of targets specified by target.
+		glBindBufferRange(target, index, buffer, offset, size);
+	}
+	void StateCache::BindTexture(GLuint unit, GLenum target, GLuint texture)
+	{
+		const unsigned int index = IndexOf(TEXTURE_TARGETS, TEXTURE_TARGET_COUNT, target);
+		const bool shadowed = unit < TEXTURE_UNIT_COUNT && index < TEXTURE_TARGET_COUNT;
+		if (shadowed && m_textures[unit][index] == texture)
+		{
+			Count(false);
+			return;
+		}
+		if (Change(m_active_texture_unit, unit))
+			glActiveTexture(GL_TEXTURE0 + unit);
+		if (shadowed)
+			m_textures[unit][index] = texture;
+		Count(true);
+		glBindTexture(target, texture);
+	}
+	void StateCache::SetCapability(GLenum capability, bool enabled)
+	{
+		const unsigned int index = IndexOf(CAPABILITIES, CAPABILITY_COUNT, capability);
+		int unknown_capability = -1;
+		if (!Change(index < CAPABILITY_COUNT ? m_capabilities[index] : unknown_capability, enabled ? 1 : 0))
+			return;
+		if (enabled)
+			glEnable(capability);
+		else
+			glDisable(capability);
+	}
+	void StateCache::BlendFunc(GLenum source_factor, GLenum destination_factor)
+	{
+		const bool same = m_blend_source == source_factor && m_blend_destination == destination_factor;
+		Count(!same);
+		if (same)
+			return;
+		m_blend_source = source_factor;
+		m_blend_destination = destination_factor;
+		glBlendFunc(source_factor, destination_factor);
+	}
+	void StateCache::DepthFunc(GLenum function)
+	{
+		if (Change(m_depth_function, function))
+			glDepthFunc(function);
+	}
+	void StateCache::DepthMask(bool write)
+	{
+		if (Change(m_depth_mask, write ? 1 : 0))
+			glDepthMask(write ? GL_TRUE : GL_FALSE);
+	}
+	void StateCache::CullFace(GLenum mode)
+	{
+		if (Change(m_cull_face, mode))
+			glCullFace(mode);
+	}
+	void StateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		const bool same = m_viewport[0] == x && m_viewport[1] == y && m_viewport[2] == width && m_viewport[3] == height;
+		Count(!same);
+		if (same)
+			return;
+		m_viewport[0] = x;
+		m_viewport[1] = y;
+		m_viewport[2] = width;
+		m_viewport[3] = height;
+		glViewport(x, y, width, height);
+	}
+	void StateCache::DeleteVertexArrays(GLsizei count, const GLuint *vaos)
+	{
+		for (GLsizei i = 0; i < count; ++i)
+		{
+			// >> If a vertex array object that is currently bound is deleted, the binding for that
+			// >> object reverts to zero and the default vertex array becomes current.
+			if (vaos[i] == m_vao)
+			{
+				m_vao = 0;
+				m_buffers[1] = UNKNOWN;
+			}
+		}
+		glDeleteVertexArrays(count, vaos);
+	}
+	void StateCache::DeleteBuffers(GLsizei count, const GLuint *buffers)
+	{
+		for (GLsizei i = 0; i < count; ++i)
+		{
+			// >> If a buffer object that is currently bound is deleted, the binding reverts to 0.
+			for (unsigned int target = 0; target < BUFFER_TARGET_COUNT; ++target)
+			{
+				if (buffers[i] == m_buffers[target])
+					m_buffers[target] = 0;
+			}
+			for (unsigned int index = 0; index < UNIFORM_BINDING_COUNT; ++index)
+			{
+				if (buffers[i] == m_uniform_ranges[index].buffer)
+				{
+					const BufferRange range = { 0, 0, -1 };
+					m_uniform_ranges[index] = range;
+				}
+			}
+		}
+		glDeleteBuffers(count, buffers);
+	}
+	void StateCache::DeleteTextures(GLsizei count, const GLuint *textures)
+	{
+		for (GLsizei i = 0; i < count; ++i)
+		{
+			// >> If a texture that is currently bound is deleted, the binding reverts to 0.
+			for (unsigned int unit = 0; unit < TEXTURE_UNIT_COUNT; ++unit)
+			{
+				for (unsigned int target = 0; target < TEXTURE_TARGET_COUNT; ++target)
+				{
+					if (textures[i] == m_textures[unit][target])
+						m_textures[unit][target] = 0;
+				}
+			}
+		}
+		glDeleteTextures(count, textures);
+	}
+	bool StateCache::Validate() const
+	{
+		bool valid = true;
+		GLint value = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+		if (m_program != UNKNOWN && static_cast<GLuint>(value) != m_program)
+		{
+			std::cerr << "State cache: program " << m_program << " is shadowed, " << value << " is current." << std::endl;
+			valid = false;
+		}
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+		if (m_vao != UNKNOWN && static_cast<GLuint>(value) != m_vao)
+		{
+			std::cerr << "State cache: VAO " << m_vao << " is shadowed, " << value << " is bound." << std::endl;
+			valid = false;
+		}
+		// The array and element buffers are the only bindings every supported context has.
+		for (unsigned int target = 0; target < 2; ++target)
+		{
+			glGetIntegerv(BUFFER_BINDINGS[target], &value);
+			if (m_buffers[target] != UNKNOWN && static_cast<GLuint>(value) != m_buffers[target])
+			{
+				std::cerr << "State cache: buffer " << m_buffers[target] << " is shadowed on target 0x" << std::hex
+					<< BUFFER_TARGETS[target] << std::dec << ", " << value << " is bound." << std::endl;
+				valid = false;
+			}
+		}
+		for (unsigned int index = 0; index < UNIFORM_BINDING_COUNT; ++index)
+		{
+			glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, index, &value);
+			if (m_uniform_ranges[index].buffer != UNKNOWN && static_cast<GLuint>(value) != m_uniform_ranges[index].buffer)
+			{
+				std::cerr << "State cache: buffer " << m_uniform_ranges[index].buffer << " is shadowed on uniform binding "
+					<< index << ", " << value << " is bound." << std::endl;
+				valid = false;
+			}
+		}
+		for (unsigned int i = 0; i < CAPABILITY_COUNT; ++i)
+		{
+			const int enabled = glIsEnabled(CAPABILITIES[i]) == GL_TRUE ? 1 : 0;
+			if (m_capabilities[i] != -1 && m_capabilities[i] != enabled)
+			{
+				std::cerr << "State cache: capability 0x" << std::hex << CAPABILITIES[i] << std::dec
+					<< " is shadowed as " << m_capabilities[i] << ", OpenGL reports " << enabled << "." << std::endl;
+				valid = false;
+			}
+		}
+		return valid;
+	}
+	void StateCache::EndFrame()
+	{
+		m_last_frame = m_frame;
+		m_frame = StateStatistics();
+	}
+	StateCache &GetStateCache()
+	{
+		static StateCache state_cache;
+		return state_cache;
+	}
+}
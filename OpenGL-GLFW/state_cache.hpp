@@ -0,0 +1,119 @@
+#ifndef OPENGL_GLFW_TCU_STATE_CACHE_H_
+#define OPENGL_GLFW_TCU_STATE_CACHE_H_
+
+#include "standard.h"
+#include <cstddef>
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+typedef int GLint;
+typedef int GLsizei;
+typedef unsigned char GLboolean;
+typedef ptrdiff_t GLintptr;
+typedef ptrdiff_t GLsizeiptr;
+
+namespace render
+{
+	// StateStatistics counts the state changes that went through a StateCache.
+	struct StateStatistics
+	{
+		StateStatistics() : issued(0), redundant(0) {}
+		// Calls that reached OpenGL.
+		unsigned long long issued;
+		// Calls that were skipped because the state was already set.
+		unsigned long long redundant;
+	};
+	// StateCache shadows the OpenGL state this program changes and skips the calls that would not
+	// change anything, which still cost a trip through the driver. It shadows the program, the VAO,
+	// the buffer bound to each target, the texture bound to each unit, blend, depth and cull state
+	// and the viewport.
+	//
+	// The shadow is only right if every change goes through the cache. Code that calls OpenGL
+	// directly (or a new context) must call Invalidate afterwards. Objects must be deleted through
+	// the cache too, because OpenGL reuses the names of deleted objects.
+	//
+	// The element buffer binding belongs to the VAO, so binding a VAO forgets it.
+	class StateCache
+	{
+	public:
+		StateCache();
+		// Forgets all shadowed state, so the next call of every kind reaches OpenGL.
+		void Invalidate();
+		void UseProgram(GLuint program);
+		void BindVertexArray(GLuint vao);
+		// Targets the cache does not know (see BUFFER_TARGETS in state_cache.cpp) are passed through.
+		void BindBuffer(GLenum target, GLuint buffer);
+		// Binds buffer to binding point index of target. Only the first UNIFORM_BINDING_COUNT uniform
+		// buffer binding points are shadowed, but like glBindBufferBase this also binds buffer to target
+		// itself, which is.
+		void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+		// Binds size bytes of buffer from offset to binding point index of target, like BindBufferBase.
+		// Skipped if the same range is bound to a shadowed uniform buffer binding point already.
+		void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+		// Binds texture to target on texture unit unit, selecting the unit first if needed.
+		void BindTexture(GLuint unit, GLenum target, GLuint texture);
+		// Enables or disables GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST or GL_STENCIL_TEST.
+		void SetCapability(GLenum capability, bool enabled);
+		void BlendFunc(GLenum source_factor, GLenum destination_factor);
+		void DepthFunc(GLenum function);
+		void DepthMask(bool write);
+		void CullFace(GLenum mode);
+		void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+		// Delete the objects and forget them wherever they are shadowed as bound. Programs need no
+		// such care: a current program is only flagged for deletion, so its name stays in use.
+		void DeleteVertexArrays(GLsizei count, const GLuint *vaos);
+		void DeleteBuffers(GLsizei count, const GLuint *buffers);
+		void DeleteTextures(GLsizei count, const GLuint *textures);
+		// Compares the shadowed bindings with what OpenGL reports and prints the differences.
+		// Queries stall the pipeline; use it while debugging, not every frame in a release build.
+		bool Validate() const;
+		// Starts counting a new frame.
+		void EndFrame();
+		// Returns the counts of the last finished frame.
+		const StateStatistics &GetFrameStatistics() const { return m_last_frame; }
+		// Returns the counts since the cache was created.
+		const StateStatistics &GetTotalStatistics() const { return m_total; }
+		// The number of texture units and buffer targets the cache shadows.
+		static const unsigned int TEXTURE_UNIT_COUNT = 32;
+		static const unsigned int TEXTURE_TARGET_COUNT = 5;
+		static const unsigned int BUFFER_TARGET_COUNT = 12;
+		static const unsigned int CAPABILITY_COUNT = 5;
+		// The number of GL_UNIFORM_BUFFER binding points the cache shadows.
+		static const unsigned int UNIFORM_BINDING_COUNT = 16;
+	private:
+		// The buffer range bound to an indexed binding point. A size of -1 means the whole buffer.
+		struct BufferRange
+		{
+			GLuint buffer;
+			GLintptr offset;
+			GLsizeiptr size;
+		};
+		// Counts a call and returns true if it has to be issued, i.e. if shadow differs from value.
+		// Updates shadow to value.
+		template <typename T>
+		bool Change(T &shadow, T value);
+		// Counts a call as issued or as redundant.
+		void Count(bool issued);
+		GLuint m_program;
+		GLuint m_vao;
+		GLuint m_buffers[BUFFER_TARGET_COUNT];
+		BufferRange m_uniform_ranges[UNIFORM_BINDING_COUNT];
+		GLenum m_active_texture_unit;
+		GLuint m_textures[TEXTURE_UNIT_COUNT][TEXTURE_TARGET_COUNT];
+		// 1 enabled, 0 disabled, -1 unknown.
+		int m_capabilities[CAPABILITY_COUNT];
+		GLenum m_blend_source;
+		GLenum m_blend_destination;
+		GLenum m_depth_function;
+		int m_depth_mask;
+		GLenum m_cull_face;
+		GLint m_viewport[4];
+		StateStatistics m_frame;
+		StateStatistics m_last_frame;
+		StateStatistics m_total;
+	};
+	// Returns the state cache of the OpenGL context. The program uses a single context (a window or a
+	// headless one), and only the render thread may touch it.
+	StateCache &GetStateCache();
+}
+
+#endif
@@ -0,0 +1,186 @@
+#include "stream.hpp"
+#include "opengl.h"
+#include "state_cache.hpp"
+
+namespace stream
+{
+	RingBuffer::RingBuffer()
+		: m_target(GL_ARRAY_BUFFER), m_size(0), m_head(0), m_free(0), m_unfenced(0),
+		m_first_fenced(0), m_fenced_count(0), m_persistent_pointer(0), m_stall_count(0), m_orphan_count(0)
+	{
+
+	}
+	RingBuffer::~RingBuffer()
+	{
+
+	}
+	void RingBuffer::Create(GLenum target, GLsizeiptr size)
+	{
+		m_target = target;
+		m_size = size;
+		m_head = 0;
+		m_free = size;
+		m_unfenced = 0;
+		m_buffer.Create(RESOURCE_SITE);
+		m_buffer.SetBytes(m_size);
+		render::GetStateCache().BindBuffer(m_target, m_buffer.Get());
+		if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+		{
+			// >> glBufferStorage creates an immutable data store. GL_MAP_PERSISTENT_BIT allows the buffer
+			// >> to remain mapped while it is used by the GL, GL_MAP_COHERENT_BIT makes writes through the
+			// >> mapping visible to the GL without an explicit flush.
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(m_target, m_size, NULL, flags);
+			m_persistent_pointer = static_cast<unsigned char*>(glMapBufferRange(m_target, 0, m_size, flags));
+		}
+		else
+		{
+			glBufferData(m_target, m_size, NULL, GL_STREAM_DRAW);
+		}
+	}
+	void RingBuffer::Destroy()
+	{
+		for (; m_fenced_count > 0; --m_fenced_count)
+			glDeleteSync(m_fenced[m_first_fenced++ % MAX_FENCED_RANGES].fence);
+		m_first_fenced = 0;
+		if (0 != m_persistent_pointer)
+		{
+			render::GetStateCache().BindBuffer(m_target, m_buffer.Get());
+			glUnmapBuffer(m_target);
+			m_persistent_pointer = 0;
+		}
+		m_buffer.Reset();
+	}
+	Allocation RingBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+	{
+		Allocation allocation;
+		if (size <= 0 || size > m_size)
+			return allocation;
+		GLintptr offset = (m_head + alignment - 1) / alignment * alignment;
+		// Allocations never straddle the end of the buffer; the bytes up to the end are skipped instead.
+		if (offset + size > m_size)
+			offset = 0;
+		GLsizeiptr needed = (offset >= m_head ? offset - m_head : m_size - m_head) + size;
+		while (needed > m_free)
+		{
+			if (0 == m_fenced_count)
+			{
+				// Only unfenced allocations are in the way. They have been committed and drawn already
+				// (see Allocate's contract), so fencing them now is safe.
+				Fence();
+				if (0 == m_fenced_count)
+				{
+					// The GPU is done with all of them, so the whole ring is free: start again at its
+					// beginning, where any size up to the buffer's fits.
+					m_head = 0;
+					offset = 0;
+					needed = size;
+					continue;
+				}
+			}
+			if (Retire(false))
+				continue;
+			if (0 == m_persistent_pointer)
+			{
+				Orphan();
+				return Allocate(size, alignment);
+			}
+			++m_stall_count;
+			Retire(true);
+		}
+		m_free -= needed;
+		m_unfenced += needed;
+		m_head = offset + size;
+		allocation.offset = offset;
+		allocation.size = size;
+		if (0 != m_persistent_pointer)
+		{
+			allocation.pointer = m_persistent_pointer + offset;
+		}
+		else
+		{
+			// >> GL_MAP_UNSYNCHRONIZED_BIT indicates that the GL should not attempt to synchronize
+			// >> pending operations on the buffer prior to returning from glMapBufferRange.
+			// The fences already guarantee the GPU is not reading this range any more.
+			render::GetStateCache().BindBuffer(m_target, m_buffer.Get());
+			allocation.pointer = glMapBufferRange(m_target, offset, size,
+				GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+		}
+		return allocation;
+	}
+	void RingBuffer::Commit(Allocation &allocation, GLsizeiptr used_size)
+	{
+		render::GetStateCache().BindBuffer(m_target, m_buffer.Get());
+		if (0 == m_persistent_pointer)
+		{
+			if (used_size > 0)
+				glFlushMappedBufferRange(m_target, 0, used_size);
+			glUnmapBuffer(m_target);
+		}
+		// Give back the unused tail if nothing has been allocated after it.
+		if (allocation.offset + allocation.size == m_head && used_size < allocation.size)
+		{
+			const GLsizeiptr unused = allocation.size - used_size;
+			m_head -= unused;
+			m_free += unused;
+			m_unfenced -= unused;
+		}
+		allocation.pointer = 0;
+		allocation.size = used_size;
+	}
+	void RingBuffer::Fence()
+	{
+		if (0 == m_unfenced)
+			return;
+		FencedRange range;
+		// >> glFenceSync creates a new fence sync object, inserts a fence command into the GL command
+		// >> stream and associates it with that sync object.
+		range.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		range.size = m_unfenced;
+		if (MAX_FENCED_RANGES == m_fenced_count)
+		{
+			++m_stall_count;
+			Retire(true);
+		}
+		m_fenced[(m_first_fenced + m_fenced_count++) % MAX_FENCED_RANGES] = range;
+		m_unfenced = 0;
+		// Free whatever the GPU already finished, so Allocate rarely has to look at a fence.
+		while (Retire(false))
+			continue;
+	}
+	bool RingBuffer::Retire(bool wait)
+	{
+		if (0 == m_fenced_count)
+			return false;
+		FencedRange &range = m_fenced[m_first_fenced];
+		// >> glClientWaitSync causes the client to block and wait for a sync object to become signaled.
+		// A timeout of 0 only polls. GL_SYNC_FLUSH_COMMANDS_BIT makes sure the fence is ever reached.
+		const GLuint64 timeout = wait ? 1000000000ull : 0;
+		GLenum result;
+		do
+		{
+			result = glClientWaitSync(range.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+		} while (wait && GL_TIMEOUT_EXPIRED == result);
+		if (GL_ALREADY_SIGNALED != result && GL_CONDITION_SATISFIED != result)
+			return false;
+		glDeleteSync(range.fence);
+		m_free += range.size;
+		m_first_fenced = (m_first_fenced + 1) % MAX_FENCED_RANGES;
+		--m_fenced_count;
+		return true;
+	}
+	void RingBuffer::Orphan()
+	{
+		// >> If data is NULL, a data store of the specified size is still created, but its contents
+		// >> remain uninitialized. The old store is kept alive by the driver for draws still using it.
+		render::GetStateCache().BindBuffer(m_target, m_buffer.Get());
+		glBufferData(m_target, m_size, NULL, GL_STREAM_DRAW);
+		for (; m_fenced_count > 0; --m_fenced_count)
+			glDeleteSync(m_fenced[m_first_fenced++ % MAX_FENCED_RANGES].fence);
+		m_first_fenced = 0;
+		m_head = 0;
+		m_free = m_size;
+		m_unfenced = 0;
+		++m_orphan_count;
+	}
+}
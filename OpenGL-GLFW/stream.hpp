@@ -0,0 +1,91 @@
+#ifndef OPENGL_GLFW_TCU_STREAM_H_
+#define OPENGL_GLFW_TCU_STREAM_H_
+
+#include "standard.h"
+#include "resource.hpp"
+#include <cstddef>
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+typedef ptrdiff_t GLintptr;
+typedef ptrdiff_t GLsizeiptr;
+typedef struct __GLsync *GLsync;
+
+namespace stream
+{
+	// Allocation is a range of a RingBuffer the CPU may write to until it is committed.
+	struct Allocation
+	{
+		Allocation() : pointer(0), offset(0), size(0) {}
+		// Where to write the data. NULL if the allocation failed.
+		void *pointer;
+		// The offset of the range inside the buffer, e.g. for glVertexAttribPointer.
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+	// RingBuffer streams dynamic data (vertices, instances, uniforms) to the GPU without stalling.
+	// Allocations are handed out front to back and wrap around; a fence after the draws that use
+	// them tells the ring when the GPU is done reading so the space can be reused.
+	//
+	// With OpenGL 4.4 or ARB_buffer_storage the buffer is mapped once, persistently and coherently,
+	// and an allocation is a pointer straight into it. On plain 3.2 contexts every allocation is
+	// mapped unsynchronized instead (the fences make that safe), and when the ring is full the
+	// buffer is orphaned rather than waited for.
+	class RingBuffer
+	{
+	public:
+		RingBuffer();
+		~RingBuffer();
+		// Creates a buffer of size bytes and binds it to target.
+		void Create(GLenum target, GLsizeiptr size);
+		void Destroy();
+		// Reserves size bytes at a multiple of alignment. If the ring is full, waits for (or, without
+		// persistent mapping, orphans) the oldest fenced range. Returns an allocation with a NULL
+		// pointer if size exceeds the whole buffer. The previous allocation must have been committed
+		// and its draws issued before the next one is made.
+		Allocation Allocate(GLsizeiptr size, GLsizeiptr alignment);
+		// Ends writing to allocation. Only the first used_size bytes are kept; the rest is given back.
+		// Must be called before any draw reads the allocation. Leaves the buffer bound to its target.
+		void Commit(Allocation &allocation, GLsizeiptr used_size);
+		// Inserts a fence covering everything committed since the previous fence. Call it after the
+		// draws that read the committed data, at the latest once per frame.
+		void Fence();
+		GLuint GetOpenGLID() const { return m_buffer.Get(); }
+		bool IsPersistent() const { return 0 != m_persistent_pointer; }
+		// The number of times Allocate had to wait for the GPU, and the number of orphaned buffers.
+		unsigned int GetStallCount() const { return m_stall_count; }
+		unsigned int GetOrphanCount() const { return m_orphan_count; }
+	private:
+		// A range of bytes the GPU may still read, and the fence that tells when it stops.
+		struct FencedRange
+		{
+			GLsync fence;
+			GLsizeiptr size;
+		};
+		// The most ranges waiting on fences. Fence waits for the oldest one when all are in use.
+		static const size_t MAX_FENCED_RANGES = 64;
+		// Frees the oldest fenced range. Waits for it if wait is true; otherwise only frees it if
+		// the GPU already finished with it. Returns true if the range was freed.
+		bool Retire(bool wait);
+		// Throws away the buffer's storage and starts again at offset 0 (non-persistent buffers only).
+		void Orphan();
+		GLenum m_target;
+		resource::Buffer m_buffer;
+		GLsizeiptr m_size;
+		// The next offset to allocate from.
+		GLintptr m_head;
+		// The number of bytes neither allocated nor waiting on a fence.
+		GLsizeiptr m_free;
+		// The bytes allocated since the last fence.
+		GLsizeiptr m_unfenced;
+		// The fenced ranges, oldest first, in a circular array: a queue that never allocates.
+		FencedRange m_fenced[MAX_FENCED_RANGES];
+		size_t m_first_fenced;
+		size_t m_fenced_count;
+		// The persistent mapping, or NULL if allocations are mapped one at a time.
+		unsigned char *m_persistent_pointer;
+		unsigned int m_stall_count;
+		unsigned int m_orphan_count;
+	};
+}
+
+#endif
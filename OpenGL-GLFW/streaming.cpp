@@ -0,0 +1,299 @@
+#include "streaming.hpp"
+#include "jobs.hpp"
+#include "opengl.h"
+#include "state_cache.hpp"
+#include "vertex_format.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace streaming
+{
+	// The staging ring holds this many frames of upload budget, so it never waits for the GPU.
+	const GLsizeiptr STAGING_FRAMES = 3;
+	// Without a budget, uploads still go through the staging ring in pieces of this size.
+	const GLsizeiptr UNBUDGETED_STAGING_SIZE = 16 * 1024 * 1024;
+	// Staging allocations start at multiples of this, which suits glCopyBufferSubData everywhere.
+	const GLsizeiptr STAGING_ALIGNMENT = 64;
+	// The distance between the pages touched while loading. Smaller than any page size in use.
+	const size_t PAGE_STRIDE = 4096;
+	Streamer::Asset::Asset()
+		: state(ASSET_QUEUED), distance(0.0f), visible(false), released(false), uploaded(0)
+	{
+
+	}
+	Streamer::Streamer()
+		: m_pool(0), m_upload_budget(0), m_uploaded_bytes(0), m_loads_in_flight(0), m_pending_count(0)
+	{
+
+	}
+	Streamer::~Streamer()
+	{
+
+	}
+	void Streamer::Create(jobs::ThreadPool *pool, GLsizeiptr upload_budget)
+	{
+		m_pool = pool;
+		m_upload_budget = upload_budget;
+		m_staging.Create(GL_COPY_READ_BUFFER, upload_budget > 0 ? STAGING_FRAMES * upload_budget : UNBUDGETED_STAGING_SIZE);
+	}
+	void Streamer::Destroy()
+	{
+		// Workers write to the assets; none may still be running.
+		m_pool->Wait();
+		for (size_t i = 0; i < m_assets.size(); ++i)
+		{
+			Free(*m_assets[i]);
+			m_asset_pool.Delete(m_assets[i]);
+		}
+		m_assets.clear();
+		m_asset_pool.Destroy();
+		m_queued.clear();
+		m_uploading.clear();
+		m_loaded.clear();
+		m_loads_in_flight = 0;
+		m_pending_count = 0;
+		m_staging.Destroy();
+	}
+	AssetId Streamer::Request(const std::string &file_name, float distance, bool visible)
+	{
+		Asset *asset = m_asset_pool.New();
+		asset->file_name = file_name;
+		asset->distance = distance;
+		asset->visible = visible;
+		const AssetId id = static_cast<AssetId>(m_assets.size());
+		m_assets.push_back(asset);
+		m_queued.push_back(id);
+		++m_pending_count;
+		return id;
+	}
+	void Streamer::SetPriority(AssetId asset, float distance, bool visible)
+	{
+		m_assets[asset]->distance = distance;
+		m_assets[asset]->visible = visible;
+		if (m_assets[asset]->state == ASSET_EVICTED && !m_assets[asset]->released)
+		{
+			m_assets[asset]->state = ASSET_QUEUED;
+			m_queued.push_back(asset);
+			++m_pending_count;
+		}
+	}
+	void Streamer::Release(AssetId asset_id)
+	{
+		Asset &asset = *m_assets[asset_id];
+		if (asset.released)
+			return;
+		asset.released = true;
+		if (asset.state != ASSET_RESIDENT && asset.state != ASSET_FAILED && asset.state != ASSET_EVICTED)
+			--m_pending_count;
+		// A worker may still be loading it; Update frees it when the load comes back.
+		if (asset.state == ASSET_LOADING)
+			return;
+		m_queued.erase(std::remove(m_queued.begin(), m_queued.end(), asset_id), m_queued.end());
+		m_uploading.erase(std::remove(m_uploading.begin(), m_uploading.end(), asset_id), m_uploading.end());
+		Free(asset);
+	}
+	bool Streamer::IsMoreImportant(AssetId left, AssetId right) const
+	{
+		const Asset &a = *m_assets[left];
+		const Asset &b = *m_assets[right];
+		if (a.visible != b.visible)
+			return a.visible;
+		return a.distance < b.distance;
+	}
+	void Streamer::Load(Asset &asset, AssetId asset_id)
+	{
+		if (asset.file.Open(asset.file_name))
+		{
+			// Fault every page in now, on this thread, instead of in glBufferData on the render thread.
+			const unsigned char *data = reinterpret_cast<const unsigned char*>(&asset.file.GetHeader());
+			const size_t size = static_cast<size_t>(asset.file.GetHeader().file_size);
+			volatile unsigned char sum = 0;
+			for (size_t offset = 0; offset < size; offset += PAGE_STRIDE)
+				sum += data[offset];
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_loaded.push_back(asset_id);
+	}
+	GLsizeiptr Streamer::BeginUpload(Asset &asset, GLsizeiptr budget, bool may_exceed)
+	{
+		// The buffers are created empty; the data follows in budgeted pieces. Creating a store costs
+		// about as much as writing it, so each is charged its size and made in a frame that can pay
+		// for it: the vertex store first, the index store in the same or a later frame.
+		const mesh::FileHeader &header = asset.file.GetHeader();
+		const GLsizeiptr vertex_bytes = static_cast<GLsizeiptr>(header.vertex_count * header.vertex_stride);
+		const GLsizeiptr index_bytes = static_cast<GLsizeiptr>(header.index_count * (header.index_type == GL_UNSIGNED_SHORT ? 2 : 4));
+		render::StateCache &state = render::GetStateCache();
+		mesh::Mesh &mesh = asset.mesh;
+		GLsizeiptr charged = 0;
+		if (!mesh.vertex_buffer.IsValid())
+		{
+			if (vertex_bytes > budget && !may_exceed)
+				return 0;
+			mesh.vao.Create(RESOURCE_SITE);
+			state.BindVertexArray(mesh.vao.Get());
+			mesh.vertex_buffer.Create(RESOURCE_SITE);
+			state.BindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer.Get());
+			glBufferData(GL_ARRAY_BUFFER, vertex_bytes, NULL, GL_STATIC_DRAW);
+			mesh.vertex_buffer.SetBytes(static_cast<long long>(vertex_bytes));
+			const mesh::AttributeRecord *attributes = asset.file.GetAttributes();
+			for (unsigned int i = 0; i < header.attribute_count; ++i)
+				vertex::SetAttributePointer(attributes[i].location, attributes[i].size, attributes[i].type, attributes[i].normalized != 0, header.vertex_stride, attributes[i].offset);
+			charged += vertex_bytes;
+		}
+		if (!mesh.index_buffer.IsValid())
+		{
+			if (charged + index_bytes > budget && (!may_exceed || charged > 0))
+				return charged;
+			mesh.index_buffer.Create(RESOURCE_SITE);
+			state.BindVertexArray(mesh.vao.Get());
+			state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer.Get());
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes, NULL, GL_STATIC_DRAW);
+			mesh.index_buffer.SetBytes(static_cast<long long>(index_bytes));
+			mesh.index_count = static_cast<GLsizei>(header.index_count);
+			mesh.index_type = header.index_type;
+			mesh.lods.assign(asset.file.GetLods(), asset.file.GetLods() + header.lod_count);
+			mesh.meshlets.assign(asset.file.GetMeshlets(), asset.file.GetMeshlets() + header.meshlet_count);
+			charged += index_bytes;
+		}
+		return charged;
+	}
+	GLsizeiptr Streamer::Upload(Asset &asset, GLsizeiptr budget)
+	{
+		const mesh::FileHeader &header = asset.file.GetHeader();
+		const GLsizeiptr vertex_bytes = static_cast<GLsizeiptr>(header.vertex_count * header.vertex_stride);
+		const GLsizeiptr index_bytes = static_cast<GLsizeiptr>(header.index_count * (header.index_type == GL_UNSIGNED_SHORT ? 2 : 4));
+		render::StateCache &state = render::GetStateCache();
+		GLsizeiptr uploaded = 0;
+		while (uploaded < budget && asset.uploaded < vertex_bytes + index_bytes)
+		{
+			// The vertex data first, then the indices; a piece never spans both.
+			const bool vertices = asset.uploaded < vertex_bytes;
+			const GLintptr offset = vertices ? asset.uploaded : asset.uploaded - vertex_bytes;
+			const GLsizeiptr remaining = (vertices ? vertex_bytes : index_bytes) - offset;
+			// A single allocation may take at most one frame's share of the ring.
+			GLsizeiptr size = std::min(remaining, budget - uploaded);
+			size = std::min(size, m_upload_budget > 0 ? m_upload_budget : UNBUDGETED_STAGING_SIZE / STAGING_FRAMES);
+			stream::Allocation allocation = m_staging.Allocate(size, STAGING_ALIGNMENT);
+			if (0 == allocation.pointer)
+				break;
+			const unsigned char *source = (vertices ? asset.file.GetVertexData() : asset.file.GetIndexData()) + offset;
+			std::memcpy(allocation.pointer, source, static_cast<size_t>(size));
+			m_staging.Commit(allocation, size);
+			// >> glCopyBufferSubData copies part of the data store attached to readtarget to the data
+			// >> store attached to writetarget. The GPU does the copy; the CPU is done after the memcpy.
+			state.BindBuffer(GL_COPY_READ_BUFFER, m_staging.GetOpenGLID());
+			state.BindBuffer(GL_COPY_WRITE_BUFFER, vertices ? asset.mesh.vertex_buffer.Get() : asset.mesh.index_buffer.Get());
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, offset, size);
+			// A fence per piece lets the ring reuse the space as soon as each copy is done, which
+			// matters when there is no budget and one frame uploads more than the ring holds.
+			m_staging.Fence();
+			asset.uploaded += size;
+			uploaded += size;
+		}
+		if (asset.uploaded == vertex_bytes + index_bytes)
+		{
+			asset.state = ASSET_RESIDENT;
+			asset.file.Close();
+			--m_pending_count;
+		}
+		return uploaded;
+	}
+	void Streamer::Free(Asset &asset)
+	{
+		if (asset.mesh.vao.IsValid())
+			mesh::DestroyMesh(asset.mesh);
+		asset.file.Close();
+	}
+	void Streamer::Evict(AssetId asset_id)
+	{
+		Asset &asset = *m_assets[asset_id];
+		Free(asset);
+		asset.state = ASSET_EVICTED;
+		asset.uploaded = 0;
+	}
+	void Streamer::Update()
+	{
+		// Collect the loads the workers finished. The copy lives in the frame arena, and m_loaded
+		// keeps its capacity for the workers.
+		memory::FrameVector<AssetId> loaded;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			loaded.assign(m_loaded.begin(), m_loaded.end());
+			m_loaded.clear();
+		}
+		for (size_t i = 0; i < loaded.size(); ++i)
+		{
+			Asset &asset = *m_assets[loaded[i]];
+			--m_loads_in_flight;
+			if (asset.released)
+			{
+				Free(asset);
+				continue;
+			}
+			if (!asset.file.IsOpen())
+			{
+				std::cerr << "Streaming " << asset.file_name << " failed." << std::endl;
+				asset.state = ASSET_FAILED;
+				--m_pending_count;
+				continue;
+			}
+			asset.state = ASSET_UPLOADING;
+			m_uploading.push_back(loaded[i]);
+		}
+		// Start the most important queued loads, one per worker. More would only compete for the disk.
+		const size_t slots = std::max<size_t>(1, m_pool->GetThreadCount());
+		if (m_loads_in_flight < slots && !m_queued.empty())
+		{
+			const size_t count = std::min(slots - m_loads_in_flight, m_queued.size());
+			std::partial_sort(m_queued.begin(), m_queued.begin() + count, m_queued.end(),
+				[this](AssetId left, AssetId right) { return IsMoreImportant(left, right); });
+			for (size_t i = 0; i < count; ++i)
+			{
+				const AssetId id = m_queued[i];
+				// Request may grow m_assets while the task runs, so the task gets the asset itself.
+				Asset *asset = m_assets[id];
+				asset->state = ASSET_LOADING;
+				++m_loads_in_flight;
+				m_pool->Submit([this, asset, id]() { Load(*asset, id); });
+			}
+			m_queued.erase(m_queued.begin(), m_queued.begin() + count);
+		}
+		// Upload, most important first, until the budget is spent. Creating an asset's buffers counts
+		// against the budget, and at most one asset starts per frame.
+		m_uploaded_bytes = 0;
+		bool started = false;
+		std::sort(m_uploading.begin(), m_uploading.end(), [this](AssetId left, AssetId right) { return IsMoreImportant(left, right); });
+		const GLsizeiptr budget = m_upload_budget > 0 ? m_upload_budget : std::numeric_limits<GLsizeiptr>::max();
+		size_t finished = 0;
+		for (size_t i = 0; i < m_uploading.size() && m_uploaded_bytes < budget; ++i)
+		{
+			Asset &asset = *m_assets[m_uploading[i]];
+			if (!asset.mesh.index_buffer.IsValid())
+			{
+				const bool new_asset = !asset.mesh.vertex_buffer.IsValid();
+				if (new_asset && started)
+					continue;
+				started = started || new_asset;
+				// A store larger than the whole budget is made in a frame of its own.
+				m_uploaded_bytes += BeginUpload(asset, budget - m_uploaded_bytes, 0 == m_uploaded_bytes);
+				if (!asset.mesh.index_buffer.IsValid())
+					continue;
+			}
+			m_uploaded_bytes += Upload(asset, budget - m_uploaded_bytes);
+			if (asset.state == ASSET_RESIDENT)
+			{
+				// Either buffer evicts the whole asset; the registry skips the other one then.
+				const AssetId id = m_uploading[i];
+				asset.mesh.vertex_buffer.SetEvictFunction([this, id]() { Evict(id); });
+				asset.mesh.index_buffer.SetEvictFunction([this, id]() { Evict(id); });
+				++finished;
+			}
+		}
+		if (finished > 0)
+		{
+			m_uploading.erase(std::remove_if(m_uploading.begin(), m_uploading.end(),
+				[this](AssetId asset) { return m_assets[asset]->state == ASSET_RESIDENT; }), m_uploading.end());
+		}
+	}
+}
@@ -0,0 +1,127 @@
+#ifndef OPENGL_GLFW_TCU_STREAMING_H_
+#define OPENGL_GLFW_TCU_STREAMING_H_
+
+#include "standard.h"
+#include "memory.hpp"
+#include "mesh.hpp"
+#include "stream.hpp"
+#include <mutex>
+
+namespace jobs
+{
+	class ThreadPool;
+}
+
+namespace streaming
+{
+	// Identifies an asset of a Streamer.
+	typedef unsigned int AssetId;
+	// The stages an asset goes through, in order.
+	enum AssetState
+	{
+		// Waiting for a worker.
+		ASSET_QUEUED,
+		// A worker is mapping the file and reading it into memory.
+		ASSET_LOADING,
+		// Loaded; the render thread copies it into its buffer objects, a budgeted amount per frame.
+		ASSET_UPLOADING,
+		// Ready to draw.
+		ASSET_RESIDENT,
+		// The file could not be loaded.
+		ASSET_FAILED,
+		// Was resident, but the resource registry evicted its buffers to stay within the video memory
+		// budget. SetPriority queues it again.
+		ASSET_EVICTED
+	};
+	// Streamer loads mesh files (see mesh::MeshFile) in the background while frames keep rendering.
+	//
+	// Workers of a jobs::ThreadPool map and read the files, most important first: visible assets
+	// before invisible ones, near before far. The render thread then copies the data through a
+	// staging stream::RingBuffer into the asset's buffer objects with glCopyBufferSubData, but never
+	// more than the upload budget per frame, so streaming cannot cause a frame time spike. Creating
+	// an asset's buffer stores is charged to the budget like the data written into them, and at most
+	// one asset starts per frame. An asset larger than the budget is spread over several frames.
+	//
+	// Resident meshes are evictable (see resource::Registry): when the budget is exceeded, the least
+	// recently drawn ones are freed first.
+	//
+	// The mesh format is uncompressed; decompression would go into the worker stage. Uploading from a
+	// second, shared context would take the copies off the render thread entirely, but GLFW 2 cannot
+	// create shared contexts.
+	class Streamer
+	{
+	public:
+		Streamer();
+		~Streamer();
+		// Streams with the workers of pool. upload_budget is the most bytes uploaded per frame
+		// (0 means no limit); the staging ring holds three frames of it.
+		void Create(jobs::ThreadPool *pool, GLsizeiptr upload_budget);
+		// Waits for the loads in flight and frees every asset.
+		void Destroy();
+		// Queues the mesh file file_name. distance and visible set its priority.
+		AssetId Request(const std::string &file_name, float distance, bool visible);
+		// Changes the priority of an asset that is not resident yet, e.g. because the camera moved.
+		// An evicted asset is queued again.
+		void SetPriority(AssetId asset, float distance, bool visible);
+		// Frees the asset. Its mesh must not be drawn anymore.
+		void Release(AssetId asset);
+		// Starts loads, collects finished ones and uploads within the budget. Call once per frame on
+		// the render thread.
+		void Update();
+		void SetUploadBudget(GLsizeiptr upload_budget) { m_upload_budget = upload_budget; }
+		AssetState GetState(AssetId asset) const { return m_assets[asset]->state; }
+		// Returns the mesh of a resident asset.
+		const mesh::Mesh &GetMesh(AssetId asset) const { return m_assets[asset]->mesh; }
+		// Returns the bytes uploaded by the last Update, buffer stores it created included.
+		GLsizeiptr GetUploadedBytes() const { return m_uploaded_bytes; }
+		// Returns the number of assets that are neither resident, failed nor released.
+		size_t GetPendingCount() const { return m_pending_count; }
+	private:
+		struct Asset
+		{
+			Asset();
+			std::string file_name;
+			AssetState state;
+			float distance;
+			bool visible;
+			bool released;
+			// Written by the worker while loading, read by the render thread while uploading.
+			mesh::MeshFile file;
+			mesh::Mesh mesh;
+			// The bytes of the vertex data and then the index data copied so far.
+			GLsizeiptr uploaded;
+		};
+		// Returns true if left should be streamed before right.
+		bool IsMoreImportant(AssetId left, AssetId right) const;
+		// Runs on a worker: maps the file of asset and touches every page, so the render thread never
+		// waits for the disk, then reports asset_id as loaded. Touches nothing but asset and m_loaded.
+		void Load(Asset &asset, AssetId asset_id);
+		// Creates the buffer objects of asset that budget pays for, each store charged its size. If
+		// may_exceed is true, the first missing store is created even if it is larger than budget.
+		// Returns the bytes charged; the asset can upload once both stores exist.
+		GLsizeiptr BeginUpload(Asset &asset, GLsizeiptr budget, bool may_exceed);
+		// Uploads up to budget bytes of asset. Returns the bytes uploaded.
+		GLsizeiptr Upload(Asset &asset, GLsizeiptr budget);
+		// Releases the mesh and the mapping of asset.
+		void Free(Asset &asset);
+		// Called by the resource registry: frees a resident asset to make room.
+		void Evict(AssetId asset);
+		jobs::ThreadPool *m_pool;
+		stream::RingBuffer m_staging;
+		GLsizeiptr m_upload_budget;
+		GLsizeiptr m_uploaded_bytes;
+		// The assets live in a pool; m_assets maps an AssetId to its slot.
+		memory::ObjectPool<Asset> m_asset_pool;
+		std::vector<Asset*> m_assets;
+		// Assets in ASSET_QUEUED and ASSET_UPLOADING, kept so Update does not scan every asset.
+		std::vector<AssetId> m_queued;
+		std::vector<AssetId> m_uploading;
+		size_t m_loads_in_flight;
+		size_t m_pending_count;
+		// Guards m_loaded, the assets workers finished since the last Update.
+		std::mutex m_mutex;
+		std::vector<AssetId> m_loaded;
+	};
+}
+
+#endif
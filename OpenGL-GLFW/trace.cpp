@@ -0,0 +1,1614 @@
+// This file defines the pointers opengl.h routes the OpenGL 1.1 entry points through, so it sees the
+// entry points themselves.
+#define OPENGL_GLFW_DIRECT_GL_1_1
+#include "trace.hpp"
+#include "opengl.h"
+#include "state_cache.hpp"
+#include <chrono>
+#include <cstring>
+
+decltype(&glClear) opengl_glfw_glClear = &glClear;
+decltype(&glClearColor) opengl_glfw_glClearColor = &glClearColor;
+decltype(&glEnable) opengl_glfw_glEnable = &glEnable;
+decltype(&glDisable) opengl_glfw_glDisable = &glDisable;
+decltype(&glViewport) opengl_glfw_glViewport = &glViewport;
+decltype(&glBlendFunc) opengl_glfw_glBlendFunc = &glBlendFunc;
+decltype(&glCullFace) opengl_glfw_glCullFace = &glCullFace;
+decltype(&glDepthFunc) opengl_glfw_glDepthFunc = &glDepthFunc;
+decltype(&glDepthMask) opengl_glfw_glDepthMask = &glDepthMask;
+decltype(&glPixelStorei) opengl_glfw_glPixelStorei = &glPixelStorei;
+decltype(&glReadPixels) opengl_glfw_glReadPixels = &glReadPixels;
+decltype(&glFinish) opengl_glfw_glFinish = &glFinish;
+decltype(&glGetError) opengl_glfw_glGetError = &glGetError;
+decltype(&glGenTextures) opengl_glfw_glGenTextures = &glGenTextures;
+decltype(&glDeleteTextures) opengl_glfw_glDeleteTextures = &glDeleteTextures;
+decltype(&glBindTexture) opengl_glfw_glBindTexture = &glBindTexture;
+decltype(&glTexImage2D) opengl_glfw_glTexImage2D = &glTexImage2D;
+decltype(&glTexParameteri) opengl_glfw_glTexParameteri = &glTexParameteri;
+decltype(&glDrawArrays) opengl_glfw_glDrawArrays = &glDrawArrays;
+decltype(&glDrawElements) opengl_glfw_glDrawElements = &glDrawElements;
+decltype(&glDrawBuffer) opengl_glfw_glDrawBuffer = &glDrawBuffer;
+decltype(&glReadBuffer) opengl_glfw_glReadBuffer = &glReadBuffer;
+
+// The entry points a capture wraps: the pointer OpenGL calls go through, and the name of the
+// function that records them (Capture followed by the name). glShaderSource is wrapped by hand,
+// since GLEW versions disagree on the constness of its strings.
+#define TRACE_ENTRY_POINTS(X) \
+	X(opengl_glfw_glClear, Clear) X(opengl_glfw_glClearColor, ClearColor) X(opengl_glfw_glEnable, Enable) \
+	X(opengl_glfw_glDisable, Disable) X(opengl_glfw_glViewport, Viewport) X(opengl_glfw_glBlendFunc, BlendFunc) \
+	X(opengl_glfw_glCullFace, CullFace) X(opengl_glfw_glDepthFunc, DepthFunc) X(opengl_glfw_glDepthMask, DepthMask) \
+	X(opengl_glfw_glPixelStorei, PixelStorei) X(opengl_glfw_glReadPixels, ReadPixels) X(opengl_glfw_glFinish, Finish) \
+	X(opengl_glfw_glGetError, GetError) X(opengl_glfw_glGenTextures, GenTextures) X(opengl_glfw_glDeleteTextures, DeleteTextures) \
+	X(opengl_glfw_glBindTexture, BindTexture) X(glActiveTexture, ActiveTexture) X(opengl_glfw_glTexImage2D, TexImage2D) \
+	X(opengl_glfw_glTexParameteri, TexParameteri) \
+	X(glGenBuffers, GenBuffers) X(glDeleteBuffers, DeleteBuffers) X(glBindBuffer, BindBuffer) X(glBindBufferBase, BindBufferBase) \
+	X(glBindBufferRange, BindBufferRange) X(glBufferData, BufferData) X(glBufferSubData, BufferSubData) \
+	X(glMapBufferRange, MapBufferRange) X(glFlushMappedBufferRange, FlushMappedBufferRange) X(glUnmapBuffer, UnmapBuffer) \
+	X(glGenVertexArrays, GenVertexArrays) X(glDeleteVertexArrays, DeleteVertexArrays) X(glBindVertexArray, BindVertexArray) \
+	X(glEnableVertexAttribArray, EnableVertexAttribArray) X(glDisableVertexAttribArray, DisableVertexAttribArray) \
+	X(glVertexAttribPointer, VertexAttribPointer) X(glVertexAttribIPointer, VertexAttribIPointer) \
+	X(glVertexAttribDivisor, VertexAttribDivisor) X(glVertexAttrib4f, VertexAttrib4f) \
+	X(opengl_glfw_glDrawArrays, DrawArrays) X(opengl_glfw_glDrawElements, DrawElements) \
+	X(glDrawArraysInstanced, DrawArraysInstanced) X(glDrawElementsInstanced, DrawElementsInstanced) \
+	X(glCreateShader, CreateShader) X(glCompileShader, CompileShader) X(glDeleteShader, DeleteShader) \
+	X(glCreateProgram, CreateProgram) X(glAttachShader, AttachShader) X(glDetachShader, DetachShader) X(glLinkProgram, LinkProgram) \
+	X(glValidateProgram, ValidateProgram) X(glDeleteProgram, DeleteProgram) X(glUseProgram, UseProgram) \
+	X(glProgramParameteri, ProgramParameteri) X(glGetUniformBlockIndex, GetUniformBlockIndex) X(glUniformBlockBinding, UniformBlockBinding) \
+	X(glGenFramebuffers, GenFramebuffers) X(glDeleteFramebuffers, DeleteFramebuffers) X(glBindFramebuffer, BindFramebuffer) \
+	X(glFramebufferTexture2D, FramebufferTexture2D) X(glFramebufferRenderbuffer, FramebufferRenderbuffer) \
+	X(glGenRenderbuffers, GenRenderbuffers) X(glDeleteRenderbuffers, DeleteRenderbuffers) X(glBindRenderbuffer, BindRenderbuffer) \
+	X(glRenderbufferStorage, RenderbufferStorage) X(opengl_glfw_glDrawBuffer, DrawBuffer) X(opengl_glfw_glReadBuffer, ReadBuffer) \
+	X(glDrawBuffers, DrawBuffers) X(glClearBufferfv, ClearBufferfv) X(glClearBufferfi, ClearBufferfi) \
+	X(glInvalidateFramebuffer, InvalidateFramebuffer) \
+	X(glFenceSync, FenceSync) X(glClientWaitSync, ClientWaitSync) X(glDeleteSync, DeleteSync)
+
+namespace trace
+{
+	const char *CALL_NAMES[CALL_COUNT] = {
+		"end of frame",
+		"glClear", "glClearColor", "glEnable", "glDisable", "glViewport", "glBlendFunc", "glCullFace",
+		"glDepthFunc", "glDepthMask", "glPixelStorei", "glReadPixels", "glFinish", "glGetError",
+		"glGenTextures", "glDeleteTextures", "glBindTexture", "glActiveTexture", "glTexImage2D", "glTexParameteri",
+		"glGenBuffers", "glDeleteBuffers", "glBindBuffer", "glBindBufferBase", "glBindBufferRange",
+		"glBufferData", "glBufferSubData", "glMapBufferRange", "glFlushMappedBufferRange", "glUnmapBuffer",
+		"glGenVertexArrays", "glDeleteVertexArrays", "glBindVertexArray", "glEnableVertexAttribArray",
+		"glDisableVertexAttribArray", "glVertexAttribPointer", "glVertexAttribIPointer", "glVertexAttribDivisor",
+		"glVertexAttrib4f",
+		"glDrawArrays", "glDrawElements", "glDrawArraysInstanced", "glDrawElementsInstanced",
+		"glCreateShader", "glShaderSource", "glCompileShader", "glDeleteShader", "glCreateProgram", "glAttachShader",
+		"glDetachShader", "glLinkProgram", "glValidateProgram", "glDeleteProgram", "glUseProgram", "glProgramParameteri",
+		"glGetUniformBlockIndex", "glUniformBlockBinding",
+		"glGenFramebuffers", "glDeleteFramebuffers", "glBindFramebuffer", "glFramebufferTexture2D",
+		"glFramebufferRenderbuffer", "glGenRenderbuffers", "glDeleteRenderbuffers", "glBindRenderbuffer",
+		"glRenderbufferStorage", "glDrawBuffer", "glReadBuffer", "glDrawBuffers", "glClearBufferfv", "glClearBufferfi",
+		"glInvalidateFramebuffer",
+		"glFenceSync", "glClientWaitSync", "glDeleteSync",
+	};
+	const char *GetCallName(Call call)
+	{
+		return call < CALL_COUNT ? CALL_NAMES[call] : "unknown";
+	}
+	// A trace starts with MAGIC, then the width, height and number of frames as 32 bit little endian
+	// numbers. Every call follows as its Call and its arguments: integers as variable length numbers
+	// (7 bits a byte, signed ones zigzag encoded, so small values take a byte), floats as 4 bytes,
+	// and data as its size plus one (0 for a NULL pointer) followed by the bytes.
+	const char MAGIC[8] = { 'G', 'L', 'T', 'R', 'A', 'C', 'E', '1' };
+	const size_t HEADER_SIZE = sizeof(MAGIC) + 3 * 4;
+	// The capture writes its buffer to the file when it grows beyond this.
+	const size_t CAPTURE_FLUSH_SIZE = 1024 * 1024;
+
+	// Returns the bytes of a width x height image of format and type in client memory, rows aligned
+	// to alignment, or 0 if the combination is unknown.
+	size_t GetImageSize(GLsizei width, GLsizei height, GLenum format, GLenum type, GLint alignment)
+	{
+		size_t components = 0;
+		switch (format)
+		{
+		case GL_RED: case GL_DEPTH_COMPONENT: case GL_DEPTH_STENCIL: components = 1; break;
+		case GL_RG: components = 2; break;
+		case GL_RGB: case GL_BGR: components = 3; break;
+		case GL_RGBA: case GL_BGRA: components = 4; break;
+		default: return 0;
+		}
+		size_t pixel = 0;
+		switch (type)
+		{
+		case GL_UNSIGNED_BYTE: case GL_BYTE: pixel = components; break;
+		case GL_HALF_FLOAT: case GL_UNSIGNED_SHORT: case GL_SHORT: pixel = components * 2; break;
+		case GL_FLOAT: case GL_UNSIGNED_INT: case GL_INT: pixel = components * 4; break;
+		// Packed types hold the whole pixel.
+		case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_10F_11F_11F_REV: case GL_UNSIGNED_INT_2_10_10_10_REV:
+		case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV: pixel = 4; break;
+		default: return 0;
+		}
+		const size_t row = (pixel * width + alignment - 1) / alignment * alignment;
+		return row * height;
+	}
+
+	// The original entry points while a capture runs.
+	struct EntryPoints
+	{
+#define TRACE_DECLARE(pointer, name) decltype(pointer) name;
+		TRACE_ENTRY_POINTS(TRACE_DECLARE)
+#undef TRACE_DECLARE
+		decltype(glShaderSource) ShaderSource;
+	};
+	// A range of a buffer the program has mapped.
+	struct Mapping
+	{
+		unsigned char *pointer;
+		GLintptr offset;
+		GLsizeiptr length;
+		GLbitfield access;
+	};
+	// Capture is the state of the running capture.
+	struct Capture
+	{
+		Capture() : running(false), frame_count(0), unpack_alignment(4) {}
+		bool running;
+		std::ofstream file;
+		std::vector<unsigned char> buffer;
+		unsigned int frame_count;
+		EntryPoints original;
+		std::unordered_map<GLenum, Mapping> mapped;
+		GLint unpack_alignment;
+		// The extension flags hidden while capturing, to put back afterwards.
+		GLboolean version_4_1;
+		GLboolean version_4_4;
+		GLboolean buffer_storage;
+		GLboolean get_program_binary;
+	};
+	Capture g_capture;
+
+	void PutUnsigned(unsigned long long value)
+	{
+		while (value >= 0x80)
+		{
+			g_capture.buffer.push_back(static_cast<unsigned char>(value | 0x80));
+			value >>= 7;
+		}
+		g_capture.buffer.push_back(static_cast<unsigned char>(value));
+	}
+	void PutSigned(long long value)
+	{
+		PutUnsigned((static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 63));
+	}
+	void PutFloat(float value)
+	{
+		unsigned char bytes[4];
+		std::memcpy(bytes, &value, 4);
+		g_capture.buffer.insert(g_capture.buffer.end(), bytes, bytes + 4);
+	}
+	void PutData(const void *data, size_t size)
+	{
+		if (0 == data)
+		{
+			PutUnsigned(0);
+			return;
+		}
+		PutUnsigned(size + 1);
+		const unsigned char *bytes = static_cast<const unsigned char*>(data);
+		g_capture.buffer.insert(g_capture.buffer.end(), bytes, bytes + size);
+	}
+	void PutCall(Call call)
+	{
+		PutUnsigned(call);
+	}
+	void PutNames(GLsizei count, const GLuint *names)
+	{
+		PutUnsigned(count);
+		for (GLsizei i = 0; i < count; ++i)
+			PutUnsigned(names[i]);
+	}
+	// Writes the buffer to the file once it is large.
+	void FlushCapture(bool force)
+	{
+		if (g_capture.buffer.empty() || (!force && g_capture.buffer.size() < CAPTURE_FLUSH_SIZE))
+			return;
+		g_capture.file.write(reinterpret_cast<const char*>(&g_capture.buffer[0]), g_capture.buffer.size());
+		g_capture.buffer.clear();
+	}
+
+	// The functions a capture puts in place of the entry points. Each records the call and its data,
+	// then makes it. Names the call generates are recorded after it returns.
+	void GLAPIENTRY CaptureClear(GLbitfield mask)
+	{
+		PutCall(CALL_CLEAR);
+		PutUnsigned(mask);
+		g_capture.original.Clear(mask);
+	}
+	void GLAPIENTRY CaptureClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+	{
+		PutCall(CALL_CLEAR_COLOR);
+		PutFloat(red);
+		PutFloat(green);
+		PutFloat(blue);
+		PutFloat(alpha);
+		g_capture.original.ClearColor(red, green, blue, alpha);
+	}
+	void GLAPIENTRY CaptureEnable(GLenum capability)
+	{
+		PutCall(CALL_ENABLE);
+		PutUnsigned(capability);
+		g_capture.original.Enable(capability);
+	}
+	void GLAPIENTRY CaptureDisable(GLenum capability)
+	{
+		PutCall(CALL_DISABLE);
+		PutUnsigned(capability);
+		g_capture.original.Disable(capability);
+	}
+	void GLAPIENTRY CaptureViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		PutCall(CALL_VIEWPORT);
+		PutSigned(x);
+		PutSigned(y);
+		PutSigned(width);
+		PutSigned(height);
+		g_capture.original.Viewport(x, y, width, height);
+	}
+	void GLAPIENTRY CaptureBlendFunc(GLenum source_factor, GLenum destination_factor)
+	{
+		PutCall(CALL_BLEND_FUNC);
+		PutUnsigned(source_factor);
+		PutUnsigned(destination_factor);
+		g_capture.original.BlendFunc(source_factor, destination_factor);
+	}
+	void GLAPIENTRY CaptureCullFace(GLenum mode)
+	{
+		PutCall(CALL_CULL_FACE);
+		PutUnsigned(mode);
+		g_capture.original.CullFace(mode);
+	}
+	void GLAPIENTRY CaptureDepthFunc(GLenum function)
+	{
+		PutCall(CALL_DEPTH_FUNC);
+		PutUnsigned(function);
+		g_capture.original.DepthFunc(function);
+	}
+	void GLAPIENTRY CaptureDepthMask(GLboolean flag)
+	{
+		PutCall(CALL_DEPTH_MASK);
+		PutUnsigned(flag);
+		g_capture.original.DepthMask(flag);
+	}
+	void GLAPIENTRY CapturePixelStorei(GLenum name, GLint value)
+	{
+		PutCall(CALL_PIXEL_STORE_I);
+		PutUnsigned(name);
+		PutSigned(value);
+		if (GL_UNPACK_ALIGNMENT == name)
+			g_capture.unpack_alignment = value;
+		g_capture.original.PixelStorei(name, value);
+	}
+	void GLAPIENTRY CaptureReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels)
+	{
+		// The pixels are the result; the replay reads them again into memory of its own.
+		PutCall(CALL_READ_PIXELS);
+		PutSigned(x);
+		PutSigned(y);
+		PutSigned(width);
+		PutSigned(height);
+		PutUnsigned(format);
+		PutUnsigned(type);
+		g_capture.original.ReadPixels(x, y, width, height, format, type, pixels);
+	}
+	void GLAPIENTRY CaptureFinish()
+	{
+		PutCall(CALL_FINISH);
+		g_capture.original.Finish();
+	}
+	GLenum GLAPIENTRY CaptureGetError()
+	{
+		// Recorded because it can cost a round trip to the driver; the result is not.
+		PutCall(CALL_GET_ERROR);
+		return g_capture.original.GetError();
+	}
+	void GLAPIENTRY CaptureGenTextures(GLsizei count, GLuint *textures)
+	{
+		g_capture.original.GenTextures(count, textures);
+		PutCall(CALL_GEN_TEXTURES);
+		PutNames(count, textures);
+	}
+	void GLAPIENTRY CaptureDeleteTextures(GLsizei count, const GLuint *textures)
+	{
+		PutCall(CALL_DELETE_TEXTURES);
+		PutNames(count, textures);
+		g_capture.original.DeleteTextures(count, textures);
+	}
+	void GLAPIENTRY CaptureBindTexture(GLenum target, GLuint texture)
+	{
+		PutCall(CALL_BIND_TEXTURE);
+		PutUnsigned(target);
+		PutUnsigned(texture);
+		g_capture.original.BindTexture(target, texture);
+	}
+	void GLAPIENTRY CaptureActiveTexture(GLenum unit)
+	{
+		PutCall(CALL_ACTIVE_TEXTURE);
+		PutUnsigned(unit);
+		g_capture.original.ActiveTexture(unit);
+	}
+	void GLAPIENTRY CaptureTexImage2D(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height, GLint border,
+		GLenum format, GLenum type, const void *pixels)
+	{
+		PutCall(CALL_TEX_IMAGE_2D);
+		PutUnsigned(target);
+		PutSigned(level);
+		PutSigned(internal_format);
+		PutSigned(width);
+		PutSigned(height);
+		PutSigned(border);
+		PutUnsigned(format);
+		PutUnsigned(type);
+		// Pixels from a pixel unpack buffer or in an unknown layout are not recorded.
+		const size_t size = GetImageSize(width, height, format, type, g_capture.unpack_alignment);
+		PutData(0 != size ? pixels : NULL, size);
+		g_capture.original.TexImage2D(target, level, internal_format, width, height, border, format, type, pixels);
+	}
+	void GLAPIENTRY CaptureTexParameteri(GLenum target, GLenum name, GLint value)
+	{
+		PutCall(CALL_TEX_PARAMETER_I);
+		PutUnsigned(target);
+		PutUnsigned(name);
+		PutSigned(value);
+		g_capture.original.TexParameteri(target, name, value);
+	}
+	void GLAPIENTRY CaptureGenBuffers(GLsizei count, GLuint *buffers)
+	{
+		g_capture.original.GenBuffers(count, buffers);
+		PutCall(CALL_GEN_BUFFERS);
+		PutNames(count, buffers);
+	}
+	void GLAPIENTRY CaptureDeleteBuffers(GLsizei count, const GLuint *buffers)
+	{
+		PutCall(CALL_DELETE_BUFFERS);
+		PutNames(count, buffers);
+		g_capture.original.DeleteBuffers(count, buffers);
+	}
+	void GLAPIENTRY CaptureBindBuffer(GLenum target, GLuint buffer)
+	{
+		PutCall(CALL_BIND_BUFFER);
+		PutUnsigned(target);
+		PutUnsigned(buffer);
+		g_capture.original.BindBuffer(target, buffer);
+	}
+	void GLAPIENTRY CaptureBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+	{
+		PutCall(CALL_BIND_BUFFER_BASE);
+		PutUnsigned(target);
+		PutUnsigned(index);
+		PutUnsigned(buffer);
+		g_capture.original.BindBufferBase(target, index, buffer);
+	}
+	void GLAPIENTRY CaptureBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		PutCall(CALL_BIND_BUFFER_RANGE);
+		PutUnsigned(target);
+		PutUnsigned(index);
+		PutUnsigned(buffer);
+		PutSigned(offset);
+		PutSigned(size);
+		g_capture.original.BindBufferRange(target, index, buffer, offset, size);
+	}
+	void GLAPIENTRY CaptureBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+	{
+		PutCall(CALL_BUFFER_DATA);
+		PutUnsigned(target);
+		PutSigned(size);
+		PutData(data, static_cast<size_t>(size));
+		PutUnsigned(usage);
+		g_capture.original.BufferData(target, size, data, usage);
+	}
+	void GLAPIENTRY CaptureBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+	{
+		PutCall(CALL_BUFFER_SUB_DATA);
+		PutUnsigned(target);
+		PutSigned(offset);
+		PutSigned(size);
+		PutData(data, static_cast<size_t>(size));
+		g_capture.original.BufferSubData(target, offset, size, data);
+	}
+	void *GLAPIENTRY CaptureMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+	{
+		// What the program writes to the mapping is recorded when it flushes or unmaps it.
+		PutCall(CALL_MAP_BUFFER_RANGE);
+		PutUnsigned(target);
+		PutSigned(offset);
+		PutSigned(length);
+		PutUnsigned(access);
+		void *pointer = g_capture.original.MapBufferRange(target, offset, length, access);
+		const Mapping mapping = { static_cast<unsigned char*>(pointer), offset, length, access };
+		g_capture.mapped[target] = mapping;
+		return pointer;
+	}
+	void GLAPIENTRY CaptureFlushMappedBufferRange(GLenum target, GLintptr offset, GLsizeiptr length)
+	{
+		// offset is relative to the mapped range.
+		const Mapping &mapping = g_capture.mapped[target];
+		PutCall(CALL_FLUSH_MAPPED_BUFFER_RANGE);
+		PutUnsigned(target);
+		PutSigned(offset);
+		PutSigned(length);
+		PutData(0 != mapping.pointer ? mapping.pointer + offset : NULL, static_cast<size_t>(length));
+		g_capture.original.FlushMappedBufferRange(target, offset, length);
+	}
+	GLboolean GLAPIENTRY CaptureUnmapBuffer(GLenum target)
+	{
+		// Without GL_MAP_FLUSH_EXPLICIT_BIT, unmapping makes the whole written range visible.
+		const Mapping mapping = g_capture.mapped[target];
+		const bool whole = 0 != mapping.pointer && 0 != (mapping.access & GL_MAP_WRITE_BIT) && 0 == (mapping.access & GL_MAP_FLUSH_EXPLICIT_BIT);
+		PutCall(CALL_UNMAP_BUFFER);
+		PutUnsigned(target);
+		PutData(whole ? mapping.pointer : NULL, static_cast<size_t>(mapping.length));
+		g_capture.mapped.erase(target);
+		return g_capture.original.UnmapBuffer(target);
+	}
+	void GLAPIENTRY CaptureGenVertexArrays(GLsizei count, GLuint *vaos)
+	{
+		g_capture.original.GenVertexArrays(count, vaos);
+		PutCall(CALL_GEN_VERTEX_ARRAYS);
+		PutNames(count, vaos);
+	}
+	void GLAPIENTRY CaptureDeleteVertexArrays(GLsizei count, const GLuint *vaos)
+	{
+		PutCall(CALL_DELETE_VERTEX_ARRAYS);
+		PutNames(count, vaos);
+		g_capture.original.DeleteVertexArrays(count, vaos);
+	}
+	void GLAPIENTRY CaptureBindVertexArray(GLuint vao)
+	{
+		PutCall(CALL_BIND_VERTEX_ARRAY);
+		PutUnsigned(vao);
+		g_capture.original.BindVertexArray(vao);
+	}
+	void GLAPIENTRY CaptureEnableVertexAttribArray(GLuint index)
+	{
+		PutCall(CALL_ENABLE_VERTEX_ATTRIB_ARRAY);
+		PutUnsigned(index);
+		g_capture.original.EnableVertexAttribArray(index);
+	}
+	void GLAPIENTRY CaptureDisableVertexAttribArray(GLuint index)
+	{
+		PutCall(CALL_DISABLE_VERTEX_ATTRIB_ARRAY);
+		PutUnsigned(index);
+		g_capture.original.DisableVertexAttribArray(index);
+	}
+	void GLAPIENTRY CaptureVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer)
+	{
+		// The program always sources attributes from buffers, so the pointer is an offset.
+		PutCall(CALL_VERTEX_ATTRIB_POINTER);
+		PutUnsigned(index);
+		PutSigned(size);
+		PutUnsigned(type);
+		PutUnsigned(normalized);
+		PutSigned(stride);
+		PutUnsigned(reinterpret_cast<size_t>(pointer));
+		g_capture.original.VertexAttribPointer(index, size, type, normalized, stride, pointer);
+	}
+	void GLAPIENTRY CaptureVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer)
+	{
+		PutCall(CALL_VERTEX_ATTRIB_I_POINTER);
+		PutUnsigned(index);
+		PutSigned(size);
+		PutUnsigned(type);
+		PutSigned(stride);
+		PutUnsigned(reinterpret_cast<size_t>(pointer));
+		g_capture.original.VertexAttribIPointer(index, size, type, stride, pointer);
+	}
+	void GLAPIENTRY CaptureVertexAttribDivisor(GLuint index, GLuint divisor)
+	{
+		PutCall(CALL_VERTEX_ATTRIB_DIVISOR);
+		PutUnsigned(index);
+		PutUnsigned(divisor);
+		g_capture.original.VertexAttribDivisor(index, divisor);
+	}
+	void GLAPIENTRY CaptureVertexAttrib4f(GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+	{
+		PutCall(CALL_VERTEX_ATTRIB_4F);
+		PutUnsigned(index);
+		PutFloat(x);
+		PutFloat(y);
+		PutFloat(z);
+		PutFloat(w);
+		g_capture.original.VertexAttrib4f(index, x, y, z, w);
+	}
+	void GLAPIENTRY CaptureDrawArrays(GLenum mode, GLint first, GLsizei count)
+	{
+		PutCall(CALL_DRAW_ARRAYS);
+		PutUnsigned(mode);
+		PutSigned(first);
+		PutSigned(count);
+		g_capture.original.DrawArrays(mode, first, count);
+	}
+	void GLAPIENTRY CaptureDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+	{
+		// Indices always come from the element buffer, so indices is an offset.
+		PutCall(CALL_DRAW_ELEMENTS);
+		PutUnsigned(mode);
+		PutSigned(count);
+		PutUnsigned(type);
+		PutUnsigned(reinterpret_cast<size_t>(indices));
+		g_capture.original.DrawElements(mode, count, type, indices);
+	}
+	void GLAPIENTRY CaptureDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count)
+	{
+		PutCall(CALL_DRAW_ARRAYS_INSTANCED);
+		PutUnsigned(mode);
+		PutSigned(first);
+		PutSigned(count);
+		PutSigned(instance_count);
+		g_capture.original.DrawArraysInstanced(mode, first, count, instance_count);
+	}
+	void GLAPIENTRY CaptureDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instance_count)
+	{
+		PutCall(CALL_DRAW_ELEMENTS_INSTANCED);
+		PutUnsigned(mode);
+		PutSigned(count);
+		PutUnsigned(type);
+		PutUnsigned(reinterpret_cast<size_t>(indices));
+		PutSigned(instance_count);
+		g_capture.original.DrawElementsInstanced(mode, count, type, indices, instance_count);
+	}
+	GLuint GLAPIENTRY CaptureCreateShader(GLenum type)
+	{
+		const GLuint shader = g_capture.original.CreateShader(type);
+		PutCall(CALL_CREATE_SHADER);
+		PutUnsigned(type);
+		PutUnsigned(shader);
+		return shader;
+	}
+	void GLAPIENTRY CaptureShaderSource(GLuint shader, GLsizei count, const GLchar *const *strings, const GLint *lengths)
+	{
+		PutCall(CALL_SHADER_SOURCE);
+		PutUnsigned(shader);
+		PutUnsigned(count);
+		for (GLsizei i = 0; i < count; ++i)
+		{
+			const size_t length = (0 != lengths && lengths[i] >= 0) ? static_cast<size_t>(lengths[i]) : std::strlen(strings[i]);
+			PutData(strings[i], length);
+		}
+		typedef void (GLAPIENTRY *ShaderSourceFunction)(GLuint, GLsizei, const GLchar *const *, const GLint *);
+		reinterpret_cast<ShaderSourceFunction>(g_capture.original.ShaderSource)(shader, count, strings, lengths);
+	}
+	void GLAPIENTRY CaptureCompileShader(GLuint shader)
+	{
+		PutCall(CALL_COMPILE_SHADER);
+		PutUnsigned(shader);
+		g_capture.original.CompileShader(shader);
+	}
+	void GLAPIENTRY CaptureDeleteShader(GLuint shader)
+	{
+		PutCall(CALL_DELETE_SHADER);
+		PutUnsigned(shader);
+		g_capture.original.DeleteShader(shader);
+	}
+	GLuint GLAPIENTRY CaptureCreateProgram()
+	{
+		const GLuint program = g_capture.original.CreateProgram();
+		PutCall(CALL_CREATE_PROGRAM);
+		PutUnsigned(program);
+		return program;
+	}
+	void GLAPIENTRY CaptureAttachShader(GLuint program, GLuint shader)
+	{
+		PutCall(CALL_ATTACH_SHADER);
+		PutUnsigned(program);
+		PutUnsigned(shader);
+		g_capture.original.AttachShader(program, shader);
+	}
+	void GLAPIENTRY CaptureDetachShader(GLuint program, GLuint shader)
+	{
+		PutCall(CALL_DETACH_SHADER);
+		PutUnsigned(program);
+		PutUnsigned(shader);
+		g_capture.original.DetachShader(program, shader);
+	}
+	void GLAPIENTRY CaptureLinkProgram(GLuint program)
+	{
+		PutCall(CALL_LINK_PROGRAM);
+		PutUnsigned(program);
+		g_capture.original.LinkProgram(program);
+	}
+	void GLAPIENTRY CaptureValidateProgram(GLuint program)
+	{
+		PutCall(CALL_VALIDATE_PROGRAM);
+		PutUnsigned(program);
+		g_capture.original.ValidateProgram(program);
+	}
+	void GLAPIENTRY CaptureDeleteProgram(GLuint program)
+	{
+		PutCall(CALL_DELETE_PROGRAM);
+		PutUnsigned(program);
+		g_capture.original.DeleteProgram(program);
+	}
+	void GLAPIENTRY CaptureUseProgram(GLuint program)
+	{
+		PutCall(CALL_USE_PROGRAM);
+		PutUnsigned(program);
+		g_capture.original.UseProgram(program);
+	}
+	void GLAPIENTRY CaptureProgramParameteri(GLuint program, GLenum name, GLint value)
+	{
+		PutCall(CALL_PROGRAM_PARAMETER_I);
+		PutUnsigned(program);
+		PutUnsigned(name);
+		PutSigned(value);
+		g_capture.original.ProgramParameteri(program, name, value);
+	}
+	GLuint GLAPIENTRY CaptureGetUniformBlockIndex(GLuint program, const GLchar *name)
+	{
+		// The index is recorded so later calls with it can be translated.
+		const GLuint index = g_capture.original.GetUniformBlockIndex(program, name);
+		PutCall(CALL_GET_UNIFORM_BLOCK_INDEX);
+		PutUnsigned(program);
+		PutData(name, std::strlen(name));
+		PutUnsigned(index);
+		return index;
+	}
+	void GLAPIENTRY CaptureUniformBlockBinding(GLuint program, GLuint index, GLuint binding)
+	{
+		PutCall(CALL_UNIFORM_BLOCK_BINDING);
+		PutUnsigned(program);
+		PutUnsigned(index);
+		PutUnsigned(binding);
+		g_capture.original.UniformBlockBinding(program, index, binding);
+	}
+	void GLAPIENTRY CaptureGenFramebuffers(GLsizei count, GLuint *framebuffers)
+	{
+		g_capture.original.GenFramebuffers(count, framebuffers);
+		PutCall(CALL_GEN_FRAMEBUFFERS);
+		PutNames(count, framebuffers);
+	}
+	void GLAPIENTRY CaptureDeleteFramebuffers(GLsizei count, const GLuint *framebuffers)
+	{
+		PutCall(CALL_DELETE_FRAMEBUFFERS);
+		PutNames(count, framebuffers);
+		g_capture.original.DeleteFramebuffers(count, framebuffers);
+	}
+	void GLAPIENTRY CaptureBindFramebuffer(GLenum target, GLuint framebuffer)
+	{
+		PutCall(CALL_BIND_FRAMEBUFFER);
+		PutUnsigned(target);
+		PutUnsigned(framebuffer);
+		g_capture.original.BindFramebuffer(target, framebuffer);
+	}
+	void GLAPIENTRY CaptureFramebufferTexture2D(GLenum target, GLenum attachment, GLenum texture_target, GLuint texture, GLint level)
+	{
+		PutCall(CALL_FRAMEBUFFER_TEXTURE_2D);
+		PutUnsigned(target);
+		PutUnsigned(attachment);
+		PutUnsigned(texture_target);
+		PutUnsigned(texture);
+		PutSigned(level);
+		g_capture.original.FramebufferTexture2D(target, attachment, texture_target, texture, level);
+	}
+	void GLAPIENTRY CaptureFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffer_target, GLuint renderbuffer)
+	{
+		PutCall(CALL_FRAMEBUFFER_RENDERBUFFER);
+		PutUnsigned(target);
+		PutUnsigned(attachment);
+		PutUnsigned(renderbuffer_target);
+		PutUnsigned(renderbuffer);
+		g_capture.original.FramebufferRenderbuffer(target, attachment, renderbuffer_target, renderbuffer);
+	}
+	void GLAPIENTRY CaptureGenRenderbuffers(GLsizei count, GLuint *renderbuffers)
+	{
+		g_capture.original.GenRenderbuffers(count, renderbuffers);
+		PutCall(CALL_GEN_RENDERBUFFERS);
+		PutNames(count, renderbuffers);
+	}
+	void GLAPIENTRY CaptureDeleteRenderbuffers(GLsizei count, const GLuint *renderbuffers)
+	{
+		PutCall(CALL_DELETE_RENDERBUFFERS);
+		PutNames(count, renderbuffers);
+		g_capture.original.DeleteRenderbuffers(count, renderbuffers);
+	}
+	void GLAPIENTRY CaptureBindRenderbuffer(GLenum target, GLuint renderbuffer)
+	{
+		PutCall(CALL_BIND_RENDERBUFFER);
+		PutUnsigned(target);
+		PutUnsigned(renderbuffer);
+		g_capture.original.BindRenderbuffer(target, renderbuffer);
+	}
+	void GLAPIENTRY CaptureRenderbufferStorage(GLenum target, GLenum internal_format, GLsizei width, GLsizei height)
+	{
+		PutCall(CALL_RENDERBUFFER_STORAGE);
+		PutUnsigned(target);
+		PutUnsigned(internal_format);
+		PutSigned(width);
+		PutSigned(height);
+		g_capture.original.RenderbufferStorage(target, internal_format, width, height);
+	}
+	void GLAPIENTRY CaptureDrawBuffer(GLenum buffer)
+	{
+		PutCall(CALL_DRAW_BUFFER);
+		PutUnsigned(buffer);
+		g_capture.original.DrawBuffer(buffer);
+	}
+	void GLAPIENTRY CaptureReadBuffer(GLenum buffer)
+	{
+		PutCall(CALL_READ_BUFFER);
+		PutUnsigned(buffer);
+		g_capture.original.ReadBuffer(buffer);
+	}
+	void GLAPIENTRY CaptureDrawBuffers(GLsizei count, const GLenum *buffers)
+	{
+		PutCall(CALL_DRAW_BUFFERS);
+		PutNames(count, buffers);
+		g_capture.original.DrawBuffers(count, buffers);
+	}
+	void GLAPIENTRY CaptureClearBufferfv(GLenum buffer, GLint draw_buffer, const GLfloat *value)
+	{
+		PutCall(CALL_CLEAR_BUFFER_FV);
+		PutUnsigned(buffer);
+		PutSigned(draw_buffer);
+		const int count = GL_COLOR == buffer ? 4 : 1;
+		for (int i = 0; i < count; ++i)
+			PutFloat(value[i]);
+		g_capture.original.ClearBufferfv(buffer, draw_buffer, value);
+	}
+	void GLAPIENTRY CaptureClearBufferfi(GLenum buffer, GLint draw_buffer, GLfloat depth, GLint stencil)
+	{
+		PutCall(CALL_CLEAR_BUFFER_FI);
+		PutUnsigned(buffer);
+		PutSigned(draw_buffer);
+		PutFloat(depth);
+		PutSigned(stencil);
+		g_capture.original.ClearBufferfi(buffer, draw_buffer, depth, stencil);
+	}
+	void GLAPIENTRY CaptureInvalidateFramebuffer(GLenum target, GLsizei count, const GLenum *attachments)
+	{
+		PutCall(CALL_INVALIDATE_FRAMEBUFFER);
+		PutUnsigned(target);
+		PutNames(count, attachments);
+		g_capture.original.InvalidateFramebuffer(target, count, attachments);
+	}
+	GLsync GLAPIENTRY CaptureFenceSync(GLenum condition, GLbitfield flags)
+	{
+		// A sync object is recorded by its address, which is unique while it lives.
+		const GLsync sync = g_capture.original.FenceSync(condition, flags);
+		PutCall(CALL_FENCE_SYNC);
+		PutUnsigned(condition);
+		PutUnsigned(flags);
+		PutUnsigned(reinterpret_cast<size_t>(sync));
+		return sync;
+	}
+	GLenum GLAPIENTRY CaptureClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout)
+	{
+		PutCall(CALL_CLIENT_WAIT_SYNC);
+		PutUnsigned(reinterpret_cast<size_t>(sync));
+		PutUnsigned(flags);
+		PutUnsigned(timeout);
+		return g_capture.original.ClientWaitSync(sync, flags, timeout);
+	}
+	void GLAPIENTRY CaptureDeleteSync(GLsync sync)
+	{
+		PutCall(CALL_DELETE_SYNC);
+		PutUnsigned(reinterpret_cast<size_t>(sync));
+		g_capture.original.DeleteSync(sync);
+	}
+
+	// Writes a 32 bit little endian number.
+	void WriteFixed(std::ostream &out, unsigned int value)
+	{
+		const char bytes[4] = { static_cast<char>(value), static_cast<char>(value >> 8), static_cast<char>(value >> 16), static_cast<char>(value >> 24) };
+		out.write(bytes, 4);
+	}
+	unsigned int ReadFixed(const unsigned char *bytes)
+	{
+		return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<unsigned int>(bytes[3]) << 24);
+	}
+	bool StartCapture(const std::string &file_name, int width, int height)
+	{
+		if (g_capture.running)
+			return false;
+		g_capture.file.open(file_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!g_capture.file)
+		{
+			std::cerr << "Trace file " << file_name << " could not be opened." << std::endl;
+			return false;
+		}
+		g_capture.file.write(MAGIC, sizeof(MAGIC));
+		WriteFixed(g_capture.file, static_cast<unsigned int>(width));
+		WriteFixed(g_capture.file, static_cast<unsigned int>(height));
+		// The number of frames is filled in by StopCapture.
+		WriteFixed(g_capture.file, 0);
+		g_capture.buffer.reserve(CAPTURE_FLUSH_SIZE * 2);
+		g_capture.frame_count = 0;
+		g_capture.unpack_alignment = 4;
+		g_capture.mapped.clear();
+		// Entry points the driver lacks stay NULL.
+#define TRACE_INSTALL(pointer, name) \
+		g_capture.original.name = pointer; \
+		if (0 != pointer) \
+			pointer = Capture##name;
+		TRACE_ENTRY_POINTS(TRACE_INSTALL)
+#undef TRACE_INSTALL
+		g_capture.original.ShaderSource = glShaderSource;
+		glShaderSource = reinterpret_cast<decltype(glShaderSource)>(&CaptureShaderSource);
+		g_capture.version_4_1 = GLEW_VERSION_4_1;
+		g_capture.version_4_4 = GLEW_VERSION_4_4;
+		g_capture.buffer_storage = GLEW_ARB_buffer_storage;
+		g_capture.get_program_binary = GLEW_ARB_get_program_binary;
+		GLEW_VERSION_4_1 = GL_FALSE;
+		GLEW_VERSION_4_4 = GL_FALSE;
+		GLEW_ARB_buffer_storage = GL_FALSE;
+		GLEW_ARB_get_program_binary = GL_FALSE;
+		g_capture.running = true;
+		return true;
+	}
+	void EndFrame()
+	{
+		if (!g_capture.running)
+			return;
+		PutCall(CALL_END_FRAME);
+		++g_capture.frame_count;
+		FlushCapture(false);
+	}
+	bool StopCapture()
+	{
+		if (!g_capture.running)
+			return false;
+#define TRACE_UNINSTALL(pointer, name) pointer = g_capture.original.name;
+		TRACE_ENTRY_POINTS(TRACE_UNINSTALL)
+#undef TRACE_UNINSTALL
+		glShaderSource = g_capture.original.ShaderSource;
+		GLEW_VERSION_4_1 = g_capture.version_4_1;
+		GLEW_VERSION_4_4 = g_capture.version_4_4;
+		GLEW_ARB_buffer_storage = g_capture.buffer_storage;
+		GLEW_ARB_get_program_binary = g_capture.get_program_binary;
+		FlushCapture(true);
+		g_capture.file.seekp(HEADER_SIZE - 4);
+		WriteFixed(g_capture.file, g_capture.frame_count);
+		const bool written = static_cast<bool>(g_capture.file);
+		g_capture.file.close();
+		g_capture.buffer = std::vector<unsigned char>();
+		g_capture.mapped.clear();
+		g_capture.running = false;
+		if (!written)
+			std::cerr << "The trace could not be written." << std::endl;
+		return written;
+	}
+	bool IsCapturing()
+	{
+		return g_capture.running;
+	}
+
+	// Reader decodes the calls of a trace. Reading past the end sets failed and returns zeros.
+	struct Reader
+	{
+		Reader(const unsigned char *begin, const unsigned char *end) : position(begin), end(end), failed(false) {}
+		unsigned long long Unsigned()
+		{
+			unsigned long long value = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				if (position == end)
+				{
+					failed = true;
+					return 0;
+				}
+				const unsigned char byte = *position++;
+				value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+				if (0 == (byte & 0x80))
+					return value;
+			}
+			failed = true;
+			return 0;
+		}
+		long long Signed()
+		{
+			const unsigned long long value = Unsigned();
+			return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+		}
+		float Float()
+		{
+			float value = 0.0f;
+			if (end - position < 4)
+			{
+				failed = true;
+				return value;
+			}
+			std::memcpy(&value, position, 4);
+			position += 4;
+			return value;
+		}
+		// Returns the data, or NULL for a NULL pointer, and its size.
+		const unsigned char *Data(size_t &size)
+		{
+			const unsigned long long stored = Unsigned();
+			size = 0;
+			if (0 == stored || failed)
+				return NULL;
+			if (stored - 1 > static_cast<unsigned long long>(end - position))
+			{
+				failed = true;
+				return NULL;
+			}
+			size = static_cast<size_t>(stored - 1);
+			const unsigned char *data = position;
+			position += size;
+			return data;
+		}
+		// Reads count names into names.
+		void Names(std::vector<GLuint> &names)
+		{
+			const unsigned long long count = Unsigned();
+			names.clear();
+			for (unsigned long long i = 0; i < count && !failed; ++i)
+				names.push_back(static_cast<GLuint>(Unsigned()));
+		}
+		const unsigned char *position;
+		const unsigned char *end;
+		bool failed;
+	};
+	typedef std::chrono::high_resolution_clock Clock;
+	inline double Milliseconds(Clock::time_point begin, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	}
+	Replayer::Replayer()
+		: m_width(0), m_height(0), m_frame_count(0)
+	{
+
+	}
+	Replayer::~Replayer()
+	{
+
+	}
+	bool Replayer::Open(const std::string &file_name)
+	{
+		Close();
+		if (!m_file.Open(file_name))
+		{
+			std::cerr << "Trace file " << file_name << " could not be opened." << std::endl;
+			return false;
+		}
+		const unsigned char *data = m_file.GetData();
+		if (m_file.GetSize() < HEADER_SIZE || 0 != std::memcmp(data, MAGIC, sizeof(MAGIC)))
+		{
+			std::cerr << file_name << " is not a trace." << std::endl;
+			m_file.Close();
+			return false;
+		}
+		m_width = static_cast<int>(ReadFixed(data + sizeof(MAGIC)));
+		m_height = static_cast<int>(ReadFixed(data + sizeof(MAGIC) + 4));
+		m_frame_count = static_cast<int>(ReadFixed(data + sizeof(MAGIC) + 8));
+		return true;
+	}
+	void Replayer::Close()
+	{
+		m_file.Close();
+		m_width = 0;
+		m_height = 0;
+		m_frame_count = 0;
+	}
+	GLuint Replayer::Map(const Names &names, GLuint name) const
+	{
+		const Names::const_iterator found = names.find(name);
+		return found != names.end() ? found->second : 0;
+	}
+	// Records the names a replayed glGen* call made for the captured names.
+	void AddNames(std::unordered_map<GLuint, GLuint> &names, const std::vector<GLuint> &captured, const std::vector<GLuint> &replayed)
+	{
+		for (size_t i = 0; i < captured.size(); ++i)
+			names[captured[i]] = replayed[i];
+	}
+	// Translates captured names for a glDelete* call and forgets them.
+	void RemoveNames(std::unordered_map<GLuint, GLuint> &names, std::vector<GLuint> &captured)
+	{
+		for (size_t i = 0; i < captured.size(); ++i)
+		{
+			const std::unordered_map<GLuint, GLuint>::iterator found = names.find(captured[i]);
+			captured[i] = found != names.end() ? found->second : 0;
+			if (found != names.end())
+				names.erase(found);
+		}
+	}
+	bool Replayer::Play(GLuint framebuffer, bool time_calls, std::vector<double> &frame_milliseconds, std::vector<unsigned char> &last_frame)
+	{
+		for (int call = 0; call < CALL_COUNT; ++call)
+			m_timing[call] = CallTiming();
+		Reader in(m_file.GetData() + HEADER_SIZE, m_file.GetData() + m_file.GetSize());
+		std::vector<GLuint> captured;
+		std::vector<GLuint> replayed;
+		std::vector<unsigned char> scratch;
+		std::vector<const GLchar*> strings;
+		std::vector<GLint> lengths;
+		int frame = 0;
+		// The default framebuffer of the capture started out bound, with a viewport covering it.
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, m_width, m_height);
+		Clock::time_point frame_begin = Clock::now();
+		while (in.position != in.end && !in.failed)
+		{
+			const unsigned long long call = in.Unsigned();
+			const Clock::time_point call_begin = time_calls ? Clock::now() : Clock::time_point();
+			switch (call)
+			{
+			case CALL_END_FRAME:
+			{
+				glFinish();
+				const Clock::time_point frame_end = Clock::now();
+				frame_milliseconds.push_back(Milliseconds(frame_begin, frame_end));
+				if (++frame == m_frame_count)
+				{
+					GLint draw_framebuffer = 0;
+					glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_framebuffer);
+					last_frame.resize(static_cast<size_t>(m_width) * m_height * 4);
+					glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(draw_framebuffer));
+					glPixelStorei(GL_PACK_ALIGNMENT, 1);
+					glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, &last_frame[0]);
+				}
+				// Reading the last frame back is not part of it.
+				frame_begin = Clock::now();
+				break;
+			}
+			case CALL_CLEAR:
+				glClear(static_cast<GLbitfield>(in.Unsigned()));
+				break;
+			case CALL_CLEAR_COLOR:
+			{
+				const GLfloat red = in.Float();
+				const GLfloat green = in.Float();
+				const GLfloat blue = in.Float();
+				glClearColor(red, green, blue, in.Float());
+				break;
+			}
+			case CALL_ENABLE:
+				glEnable(static_cast<GLenum>(in.Unsigned()));
+				break;
+			case CALL_DISABLE:
+				glDisable(static_cast<GLenum>(in.Unsigned()));
+				break;
+			case CALL_VIEWPORT:
+			{
+				const GLint x = static_cast<GLint>(in.Signed());
+				const GLint y = static_cast<GLint>(in.Signed());
+				const GLsizei width = static_cast<GLsizei>(in.Signed());
+				glViewport(x, y, width, static_cast<GLsizei>(in.Signed()));
+				break;
+			}
+			case CALL_BLEND_FUNC:
+			{
+				const GLenum source_factor = static_cast<GLenum>(in.Unsigned());
+				glBlendFunc(source_factor, static_cast<GLenum>(in.Unsigned()));
+				break;
+			}
+			case CALL_CULL_FACE:
+				glCullFace(static_cast<GLenum>(in.Unsigned()));
+				break;
+			case CALL_DEPTH_FUNC:
+				glDepthFunc(static_cast<GLenum>(in.Unsigned()));
+				break;
+			case CALL_DEPTH_MASK:
+				glDepthMask(static_cast<GLboolean>(in.Unsigned()));
+				break;
+			case CALL_PIXEL_STORE_I:
+			{
+				const GLenum name = static_cast<GLenum>(in.Unsigned());
+				glPixelStorei(name, static_cast<GLint>(in.Signed()));
+				break;
+			}
+			case CALL_READ_PIXELS:
+			{
+				const GLint x = static_cast<GLint>(in.Signed());
+				const GLint y = static_cast<GLint>(in.Signed());
+				const GLsizei width = static_cast<GLsizei>(in.Signed());
+				const GLsizei height = static_cast<GLsizei>(in.Signed());
+				const GLenum format = static_cast<GLenum>(in.Unsigned());
+				const GLenum type = static_cast<GLenum>(in.Unsigned());
+				// Room for the largest pixels, whatever the pack alignment.
+				scratch.resize(static_cast<size_t>(width + 8) * height * 16);
+				glReadPixels(x, y, width, height, format, type, &scratch[0]);
+				break;
+			}
+			case CALL_FINISH:
+				glFinish();
+				break;
+			case CALL_GET_ERROR:
+				glGetError();
+				break;
+			case CALL_GEN_TEXTURES:
+				in.Names(captured);
+				replayed.resize(captured.size());
+				if (!captured.empty())
+					glGenTextures(static_cast<GLsizei>(captured.size()), &replayed[0]);
+				AddNames(m_textures, captured, replayed);
+				break;
+			case CALL_DELETE_TEXTURES:
+				in.Names(captured);
+				RemoveNames(m_textures, captured);
+				if (!captured.empty())
+					glDeleteTextures(static_cast<GLsizei>(captured.size()), &captured[0]);
+				break;
+			case CALL_BIND_TEXTURE:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				glBindTexture(target, Map(m_textures, static_cast<GLuint>(in.Unsigned())));
+				break;
+			}
+			case CALL_ACTIVE_TEXTURE:
+				glActiveTexture(static_cast<GLenum>(in.Unsigned()));
+				break;
+			case CALL_TEX_IMAGE_2D:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLint level = static_cast<GLint>(in.Signed());
+				const GLint internal_format = static_cast<GLint>(in.Signed());
+				const GLsizei width = static_cast<GLsizei>(in.Signed());
+				const GLsizei height = static_cast<GLsizei>(in.Signed());
+				const GLint border = static_cast<GLint>(in.Signed());
+				const GLenum format = static_cast<GLenum>(in.Unsigned());
+				const GLenum type = static_cast<GLenum>(in.Unsigned());
+				size_t size;
+				const unsigned char *pixels = in.Data(size);
+				glTexImage2D(target, level, internal_format, width, height, border, format, type, pixels);
+				break;
+			}
+			case CALL_TEX_PARAMETER_I:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLenum name = static_cast<GLenum>(in.Unsigned());
+				glTexParameteri(target, name, static_cast<GLint>(in.Signed()));
+				break;
+			}
+			case CALL_GEN_BUFFERS:
+				in.Names(captured);
+				replayed.resize(captured.size());
+				if (!captured.empty())
+					glGenBuffers(static_cast<GLsizei>(captured.size()), &replayed[0]);
+				AddNames(m_buffers, captured, replayed);
+				break;
+			case CALL_DELETE_BUFFERS:
+				in.Names(captured);
+				RemoveNames(m_buffers, captured);
+				if (!captured.empty())
+					glDeleteBuffers(static_cast<GLsizei>(captured.size()), &captured[0]);
+				break;
+			case CALL_BIND_BUFFER:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				glBindBuffer(target, Map(m_buffers, static_cast<GLuint>(in.Unsigned())));
+				break;
+			}
+			case CALL_BIND_BUFFER_BASE:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLuint index = static_cast<GLuint>(in.Unsigned());
+				glBindBufferBase(target, index, Map(m_buffers, static_cast<GLuint>(in.Unsigned())));
+				break;
+			}
+			case CALL_BIND_BUFFER_RANGE:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLuint index = static_cast<GLuint>(in.Unsigned());
+				const GLuint buffer = Map(m_buffers, static_cast<GLuint>(in.Unsigned()));
+				const GLintptr offset = static_cast<GLintptr>(in.Signed());
+				glBindBufferRange(target, index, buffer, offset, static_cast<GLsizeiptr>(in.Signed()));
+				break;
+			}
+			case CALL_BUFFER_DATA:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLsizeiptr size = static_cast<GLsizeiptr>(in.Signed());
+				size_t data_size;
+				const unsigned char *data = in.Data(data_size);
+				glBufferData(target, size, data, static_cast<GLenum>(in.Unsigned()));
+				break;
+			}
+			case CALL_BUFFER_SUB_DATA:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLintptr offset = static_cast<GLintptr>(in.Signed());
+				const GLsizeiptr size = static_cast<GLsizeiptr>(in.Signed());
+				size_t data_size;
+				const unsigned char *data = in.Data(data_size);
+				if (0 != data)
+					glBufferSubData(target, offset, size, data);
+				break;
+			}
+			case CALL_MAP_BUFFER_RANGE:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLintptr offset = static_cast<GLintptr>(in.Signed());
+				const GLsizeiptr length = static_cast<GLsizeiptr>(in.Signed());
+				const GLbitfield access = static_cast<GLbitfield>(in.Unsigned());
+				m_mapped[target] = static_cast<unsigned char*>(glMapBufferRange(target, offset, length, access));
+				break;
+			}
+			case CALL_FLUSH_MAPPED_BUFFER_RANGE:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLintptr offset = static_cast<GLintptr>(in.Signed());
+				const GLsizeiptr length = static_cast<GLsizeiptr>(in.Signed());
+				size_t size;
+				const unsigned char *data = in.Data(size);
+				unsigned char *pointer = m_mapped[target];
+				if (0 != pointer && 0 != data)
+					std::memcpy(pointer + offset, data, size);
+				glFlushMappedBufferRange(target, offset, length);
+				break;
+			}
+			case CALL_UNMAP_BUFFER:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				size_t size;
+				const unsigned char *data = in.Data(size);
+				unsigned char *pointer = m_mapped[target];
+				if (0 != pointer && 0 != data)
+					std::memcpy(pointer, data, size);
+				m_mapped.erase(target);
+				glUnmapBuffer(target);
+				break;
+			}
+			case CALL_GEN_VERTEX_ARRAYS:
+				in.Names(captured);
+				replayed.resize(captured.size());
+				if (!captured.empty())
+					glGenVertexArrays(static_cast<GLsizei>(captured.size()), &replayed[0]);
+				AddNames(m_vertex_arrays, captured, replayed);
+				break;
+			case CALL_DELETE_VERTEX_ARRAYS:
+				in.Names(captured);
+				RemoveNames(m_vertex_arrays, captured);
+				if (!captured.empty())
+					glDeleteVertexArrays(static_cast<GLsizei>(captured.size()), &captured[0]);
+				break;
+			case CALL_BIND_VERTEX_ARRAY:
+				glBindVertexArray(Map(m_vertex_arrays, static_cast<GLuint>(in.Unsigned())));
+				break;
+			case CALL_ENABLE_VERTEX_ATTRIB_ARRAY:
+				glEnableVertexAttribArray(static_cast<GLuint>(in.Unsigned()));
+				break;
+			case CALL_DISABLE_VERTEX_ATTRIB_ARRAY:
+				glDisableVertexAttribArray(static_cast<GLuint>(in.Unsigned()));
+				break;
+			case CALL_VERTEX_ATTRIB_POINTER:
+			{
+				const GLuint index = static_cast<GLuint>(in.Unsigned());
+				const GLint size = static_cast<GLint>(in.Signed());
+				const GLenum type = static_cast<GLenum>(in.Unsigned());
+				const GLboolean normalized = static_cast<GLboolean>(in.Unsigned());
+				const GLsizei stride = static_cast<GLsizei>(in.Signed());
+				const size_t offset = static_cast<size_t>(in.Unsigned());
+				glVertexAttribPointer(index, size, type, normalized, stride, reinterpret_cast<const void*>(offset));
+				break;
+			}
+			case CALL_VERTEX_ATTRIB_I_POINTER:
+			{
+				const GLuint index = static_cast<GLuint>(in.Unsigned());
+				const GLint size = static_cast<GLint>(in.Signed());
+				const GLenum type = static_cast<GLenum>(in.Unsigned());
+				const GLsizei stride = static_cast<GLsizei>(in.Signed());
+				const size_t offset = static_cast<size_t>(in.Unsigned());
+				glVertexAttribIPointer(index, size, type, stride, reinterpret_cast<const void*>(offset));
+				break;
+			}
+			case CALL_VERTEX_ATTRIB_DIVISOR:
+			{
+				const GLuint index = static_cast<GLuint>(in.Unsigned());
+				glVertexAttribDivisor(index, static_cast<GLuint>(in.Unsigned()));
+				break;
+			}
+			case CALL_VERTEX_ATTRIB_4F:
+			{
+				const GLuint index = static_cast<GLuint>(in.Unsigned());
+				const GLfloat x = in.Float();
+				const GLfloat y = in.Float();
+				const GLfloat z = in.Float();
+				glVertexAttrib4f(index, x, y, z, in.Float());
+				break;
+			}
+			case CALL_DRAW_ARRAYS:
+			{
+				const GLenum mode = static_cast<GLenum>(in.Unsigned());
+				const GLint first = static_cast<GLint>(in.Signed());
+				glDrawArrays(mode, first, static_cast<GLsizei>(in.Signed()));
+				break;
+			}
+			case CALL_DRAW_ELEMENTS:
+			{
+				const GLenum mode = static_cast<GLenum>(in.Unsigned());
+				const GLsizei count = static_cast<GLsizei>(in.Signed());
+				const GLenum type = static_cast<GLenum>(in.Unsigned());
+				const size_t offset = static_cast<size_t>(in.Unsigned());
+				glDrawElements(mode, count, type, reinterpret_cast<const void*>(offset));
+				break;
+			}
+			case CALL_DRAW_ARRAYS_INSTANCED:
+			{
+				const GLenum mode = static_cast<GLenum>(in.Unsigned());
+				const GLint first = static_cast<GLint>(in.Signed());
+				const GLsizei count = static_cast<GLsizei>(in.Signed());
+				glDrawArraysInstanced(mode, first, count, static_cast<GLsizei>(in.Signed()));
+				break;
+			}
+			case CALL_DRAW_ELEMENTS_INSTANCED:
+			{
+				const GLenum mode = static_cast<GLenum>(in.Unsigned());
+				const GLsizei count = static_cast<GLsizei>(in.Signed());
+				const GLenum type = static_cast<GLenum>(in.Unsigned());
+				const size_t offset = static_cast<size_t>(in.Unsigned());
+				glDrawElementsInstanced(mode, count, type, reinterpret_cast<const void*>(offset), static_cast<GLsizei>(in.Signed()));
+				break;
+			}
+			case CALL_CREATE_SHADER:
+			{
+				const GLenum type = static_cast<GLenum>(in.Unsigned());
+				m_shaders[static_cast<GLuint>(in.Unsigned())] = glCreateShader(type);
+				break;
+			}
+			case CALL_SHADER_SOURCE:
+			{
+				const GLuint shader = Map(m_shaders, static_cast<GLuint>(in.Unsigned()));
+				const unsigned long long count = in.Unsigned();
+				strings.clear();
+				lengths.clear();
+				for (unsigned long long i = 0; i < count && !in.failed; ++i)
+				{
+					size_t length;
+					const unsigned char *source = in.Data(length);
+					strings.push_back(reinterpret_cast<const GLchar*>(source));
+					lengths.push_back(static_cast<GLint>(length));
+				}
+				if (!strings.empty() && !in.failed)
+					glShaderSource(shader, static_cast<GLsizei>(strings.size()), &strings[0], &lengths[0]);
+				break;
+			}
+			case CALL_COMPILE_SHADER:
+				glCompileShader(Map(m_shaders, static_cast<GLuint>(in.Unsigned())));
+				break;
+			case CALL_DELETE_SHADER:
+			{
+				captured.assign(1, static_cast<GLuint>(in.Unsigned()));
+				RemoveNames(m_shaders, captured);
+				glDeleteShader(captured[0]);
+				break;
+			}
+			case CALL_CREATE_PROGRAM:
+				m_programs[static_cast<GLuint>(in.Unsigned())] = glCreateProgram();
+				break;
+			case CALL_ATTACH_SHADER:
+			{
+				const GLuint program = Map(m_programs, static_cast<GLuint>(in.Unsigned()));
+				glAttachShader(program, Map(m_shaders, static_cast<GLuint>(in.Unsigned())));
+				break;
+			}
+			case CALL_DETACH_SHADER:
+			{
+				const GLuint program = Map(m_programs, static_cast<GLuint>(in.Unsigned()));
+				glDetachShader(program, Map(m_shaders, static_cast<GLuint>(in.Unsigned())));
+				break;
+			}
+			case CALL_LINK_PROGRAM:
+				glLinkProgram(Map(m_programs, static_cast<GLuint>(in.Unsigned())));
+				break;
+			case CALL_VALIDATE_PROGRAM:
+				glValidateProgram(Map(m_programs, static_cast<GLuint>(in.Unsigned())));
+				break;
+			case CALL_DELETE_PROGRAM:
+			{
+				const GLuint program = static_cast<GLuint>(in.Unsigned());
+				captured.assign(1, program);
+				RemoveNames(m_programs, captured);
+				m_block_indices.erase(program);
+				glDeleteProgram(captured[0]);
+				break;
+			}
+			case CALL_USE_PROGRAM:
+				glUseProgram(Map(m_programs, static_cast<GLuint>(in.Unsigned())));
+				break;
+			case CALL_PROGRAM_PARAMETER_I:
+			{
+				const GLuint program = Map(m_programs, static_cast<GLuint>(in.Unsigned()));
+				const GLenum name = static_cast<GLenum>(in.Unsigned());
+				glProgramParameteri(program, name, static_cast<GLint>(in.Signed()));
+				break;
+			}
+			case CALL_GET_UNIFORM_BLOCK_INDEX:
+			{
+				const GLuint program = static_cast<GLuint>(in.Unsigned());
+				size_t length;
+				const unsigned char *name = in.Data(length);
+				const GLuint index = static_cast<GLuint>(in.Unsigned());
+				if (0 != name)
+				{
+					const std::string block(reinterpret_cast<const char*>(name), length);
+					m_block_indices[program][index] = glGetUniformBlockIndex(Map(m_programs, program), block.c_str());
+				}
+				break;
+			}
+			case CALL_UNIFORM_BLOCK_BINDING:
+			{
+				const GLuint program = static_cast<GLuint>(in.Unsigned());
+				const GLuint index = Map(m_block_indices[program], static_cast<GLuint>(in.Unsigned()));
+				glUniformBlockBinding(Map(m_programs, program), index, static_cast<GLuint>(in.Unsigned()));
+				break;
+			}
+			case CALL_GEN_FRAMEBUFFERS:
+				in.Names(captured);
+				replayed.resize(captured.size());
+				if (!captured.empty())
+					glGenFramebuffers(static_cast<GLsizei>(captured.size()), &replayed[0]);
+				AddNames(m_framebuffers, captured, replayed);
+				break;
+			case CALL_DELETE_FRAMEBUFFERS:
+				in.Names(captured);
+				RemoveNames(m_framebuffers, captured);
+				if (!captured.empty())
+					glDeleteFramebuffers(static_cast<GLsizei>(captured.size()), &captured[0]);
+				break;
+			case CALL_BIND_FRAMEBUFFER:
+			{
+				// The default framebuffer of the capture, or one it never created, is the replay's.
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLuint captured_framebuffer = static_cast<GLuint>(in.Unsigned());
+				const GLuint replayed_framebuffer = Map(m_framebuffers, captured_framebuffer);
+				glBindFramebuffer(target, 0 != replayed_framebuffer ? replayed_framebuffer : framebuffer);
+				break;
+			}
+			case CALL_FRAMEBUFFER_TEXTURE_2D:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLenum attachment = static_cast<GLenum>(in.Unsigned());
+				const GLenum texture_target = static_cast<GLenum>(in.Unsigned());
+				const GLuint texture = Map(m_textures, static_cast<GLuint>(in.Unsigned()));
+				glFramebufferTexture2D(target, attachment, texture_target, texture, static_cast<GLint>(in.Signed()));
+				break;
+			}
+			case CALL_FRAMEBUFFER_RENDERBUFFER:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLenum attachment = static_cast<GLenum>(in.Unsigned());
+				const GLenum renderbuffer_target = static_cast<GLenum>(in.Unsigned());
+				glFramebufferRenderbuffer(target, attachment, renderbuffer_target, Map(m_renderbuffers, static_cast<GLuint>(in.Unsigned())));
+				break;
+			}
+			case CALL_GEN_RENDERBUFFERS:
+				in.Names(captured);
+				replayed.resize(captured.size());
+				if (!captured.empty())
+					glGenRenderbuffers(static_cast<GLsizei>(captured.size()), &replayed[0]);
+				AddNames(m_renderbuffers, captured, replayed);
+				break;
+			case CALL_DELETE_RENDERBUFFERS:
+				in.Names(captured);
+				RemoveNames(m_renderbuffers, captured);
+				if (!captured.empty())
+					glDeleteRenderbuffers(static_cast<GLsizei>(captured.size()), &captured[0]);
+				break;
+			case CALL_BIND_RENDERBUFFER:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				glBindRenderbuffer(target, Map(m_renderbuffers, static_cast<GLuint>(in.Unsigned())));
+				break;
+			}
+			case CALL_RENDERBUFFER_STORAGE:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				const GLenum internal_format = static_cast<GLenum>(in.Unsigned());
+				const GLsizei width = static_cast<GLsizei>(in.Signed());
+				glRenderbufferStorage(target, internal_format, width, static_cast<GLsizei>(in.Signed()));
+				break;
+			}
+			case CALL_DRAW_BUFFER:
+				glDrawBuffer(static_cast<GLenum>(in.Unsigned()));
+				break;
+			case CALL_READ_BUFFER:
+				glReadBuffer(static_cast<GLenum>(in.Unsigned()));
+				break;
+			case CALL_DRAW_BUFFERS:
+				in.Names(captured);
+				if (!captured.empty())
+					glDrawBuffers(static_cast<GLsizei>(captured.size()), &captured[0]);
+				break;
+			case CALL_CLEAR_BUFFER_FV:
+			{
+				const GLenum buffer = static_cast<GLenum>(in.Unsigned());
+				const GLint draw_buffer = static_cast<GLint>(in.Signed());
+				GLfloat value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				const int count = GL_COLOR == buffer ? 4 : 1;
+				for (int i = 0; i < count; ++i)
+					value[i] = in.Float();
+				glClearBufferfv(buffer, draw_buffer, value);
+				break;
+			}
+			case CALL_CLEAR_BUFFER_FI:
+			{
+				const GLenum buffer = static_cast<GLenum>(in.Unsigned());
+				const GLint draw_buffer = static_cast<GLint>(in.Signed());
+				const GLfloat depth = in.Float();
+				glClearBufferfi(buffer, draw_buffer, depth, static_cast<GLint>(in.Signed()));
+				break;
+			}
+			case CALL_INVALIDATE_FRAMEBUFFER:
+			{
+				const GLenum target = static_cast<GLenum>(in.Unsigned());
+				in.Names(captured);
+				// A replay without OpenGL 4.3 simply keeps the contents.
+				if (!captured.empty() && 0 != glInvalidateFramebuffer)
+					glInvalidateFramebuffer(target, static_cast<GLsizei>(captured.size()), &captured[0]);
+				break;
+			}
+			case CALL_FENCE_SYNC:
+			{
+				const GLenum condition = static_cast<GLenum>(in.Unsigned());
+				const GLbitfield flags = static_cast<GLbitfield>(in.Unsigned());
+				m_syncs[in.Unsigned()] = glFenceSync(condition, flags);
+				break;
+			}
+			case CALL_CLIENT_WAIT_SYNC:
+			{
+				const unsigned long long sync = in.Unsigned();
+				const GLbitfield flags = static_cast<GLbitfield>(in.Unsigned());
+				const GLuint64 timeout = static_cast<GLuint64>(in.Unsigned());
+				const std::unordered_map<unsigned long long, GLsync>::const_iterator found = m_syncs.find(sync);
+				if (found != m_syncs.end())
+					glClientWaitSync(found->second, flags, timeout);
+				break;
+			}
+			case CALL_DELETE_SYNC:
+			{
+				const std::unordered_map<unsigned long long, GLsync>::iterator found = m_syncs.find(in.Unsigned());
+				if (found != m_syncs.end())
+				{
+					glDeleteSync(found->second);
+					m_syncs.erase(found);
+				}
+				break;
+			}
+			default:
+				std::cerr << "The trace holds an unknown call (" << call << ")." << std::endl;
+				in.failed = true;
+				break;
+			}
+			if (time_calls && call < CALL_COUNT)
+			{
+				CallTiming &timing = m_timing[call];
+				++timing.count;
+				timing.milliseconds += Milliseconds(call_begin, Clock::now());
+			}
+		}
+		DeleteRemaining();
+		render::GetStateCache().Invalidate();
+		if (in.failed)
+		{
+			std::cerr << "The trace is damaged." << std::endl;
+			return false;
+		}
+		return true;
+	}
+	void Replayer::DeleteRemaining()
+	{
+		for (Names::const_iterator i = m_buffers.begin(); i != m_buffers.end(); ++i)
+			glDeleteBuffers(1, &i->second);
+		for (Names::const_iterator i = m_vertex_arrays.begin(); i != m_vertex_arrays.end(); ++i)
+			glDeleteVertexArrays(1, &i->second);
+		for (Names::const_iterator i = m_textures.begin(); i != m_textures.end(); ++i)
+			glDeleteTextures(1, &i->second);
+		for (Names::const_iterator i = m_framebuffers.begin(); i != m_framebuffers.end(); ++i)
+			glDeleteFramebuffers(1, &i->second);
+		for (Names::const_iterator i = m_renderbuffers.begin(); i != m_renderbuffers.end(); ++i)
+			glDeleteRenderbuffers(1, &i->second);
+		for (Names::const_iterator i = m_programs.begin(); i != m_programs.end(); ++i)
+			glDeleteProgram(i->second);
+		for (Names::const_iterator i = m_shaders.begin(); i != m_shaders.end(); ++i)
+			glDeleteShader(i->second);
+		for (std::unordered_map<unsigned long long, GLsync>::const_iterator i = m_syncs.begin(); i != m_syncs.end(); ++i)
+			glDeleteSync(i->second);
+		m_buffers.clear();
+		m_vertex_arrays.clear();
+		m_textures.clear();
+		m_framebuffers.clear();
+		m_renderbuffers.clear();
+		m_programs.clear();
+		m_shaders.clear();
+		m_block_indices.clear();
+		m_syncs.clear();
+		m_mapped.clear();
+		glBindVertexArray(0);
+		glUseProgram(0);
+	}
+}
@@ -0,0 +1,115 @@
+#ifndef OPENGL_GLFW_TCU_TRACE_H_
+#define OPENGL_GLFW_TCU_TRACE_H_
+
+#include "standard.h"
+#include "mapped_file.hpp"
+#include <unordered_map>
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+typedef struct __GLsync *GLsync;
+
+namespace trace
+{
+	// The calls a trace records. The numbers are part of the file format: add new calls at the end.
+	enum Call
+	{
+		CALL_END_FRAME,
+		CALL_CLEAR, CALL_CLEAR_COLOR, CALL_ENABLE, CALL_DISABLE, CALL_VIEWPORT, CALL_BLEND_FUNC, CALL_CULL_FACE,
+		CALL_DEPTH_FUNC, CALL_DEPTH_MASK, CALL_PIXEL_STORE_I, CALL_READ_PIXELS, CALL_FINISH, CALL_GET_ERROR,
+		CALL_GEN_TEXTURES, CALL_DELETE_TEXTURES, CALL_BIND_TEXTURE, CALL_ACTIVE_TEXTURE, CALL_TEX_IMAGE_2D, CALL_TEX_PARAMETER_I,
+		CALL_GEN_BUFFERS, CALL_DELETE_BUFFERS, CALL_BIND_BUFFER, CALL_BIND_BUFFER_BASE, CALL_BIND_BUFFER_RANGE,
+		CALL_BUFFER_DATA, CALL_BUFFER_SUB_DATA, CALL_MAP_BUFFER_RANGE, CALL_FLUSH_MAPPED_BUFFER_RANGE, CALL_UNMAP_BUFFER,
+		CALL_GEN_VERTEX_ARRAYS, CALL_DELETE_VERTEX_ARRAYS, CALL_BIND_VERTEX_ARRAY, CALL_ENABLE_VERTEX_ATTRIB_ARRAY,
+		CALL_DISABLE_VERTEX_ATTRIB_ARRAY, CALL_VERTEX_ATTRIB_POINTER, CALL_VERTEX_ATTRIB_I_POINTER, CALL_VERTEX_ATTRIB_DIVISOR,
+		CALL_VERTEX_ATTRIB_4F,
+		CALL_DRAW_ARRAYS, CALL_DRAW_ELEMENTS, CALL_DRAW_ARRAYS_INSTANCED, CALL_DRAW_ELEMENTS_INSTANCED,
+		CALL_CREATE_SHADER, CALL_SHADER_SOURCE, CALL_COMPILE_SHADER, CALL_DELETE_SHADER, CALL_CREATE_PROGRAM, CALL_ATTACH_SHADER,
+		CALL_DETACH_SHADER, CALL_LINK_PROGRAM, CALL_VALIDATE_PROGRAM, CALL_DELETE_PROGRAM, CALL_USE_PROGRAM, CALL_PROGRAM_PARAMETER_I,
+		CALL_GET_UNIFORM_BLOCK_INDEX, CALL_UNIFORM_BLOCK_BINDING,
+		CALL_GEN_FRAMEBUFFERS, CALL_DELETE_FRAMEBUFFERS, CALL_BIND_FRAMEBUFFER, CALL_FRAMEBUFFER_TEXTURE_2D,
+		CALL_FRAMEBUFFER_RENDERBUFFER, CALL_GEN_RENDERBUFFERS, CALL_DELETE_RENDERBUFFERS, CALL_BIND_RENDERBUFFER,
+		CALL_RENDERBUFFER_STORAGE, CALL_DRAW_BUFFER, CALL_READ_BUFFER, CALL_DRAW_BUFFERS, CALL_CLEAR_BUFFER_FV, CALL_CLEAR_BUFFER_FI,
+		CALL_INVALIDATE_FRAMEBUFFER,
+		CALL_FENCE_SYNC, CALL_CLIENT_WAIT_SYNC, CALL_DELETE_SYNC,
+		CALL_COUNT
+	};
+	// Returns the OpenGL function of call, e.g. "glBufferData".
+	const char *GetCallName(Call call);
+
+	// Starts recording the OpenGL calls of the program, with their buffer, texture and shader data,
+	// into a binary trace in file_name. width and height are the size of the default framebuffer.
+	// Call it after glewInit and before anything creates OpenGL objects: a trace has to create every
+	// object it uses. Returns false if the file cannot be written or a capture is running already.
+	//
+	// The capture swaps the function pointers behind the entry points (GLEW's for everything newer
+	// than OpenGL 1.1, and the ones opengl.h adds for the 1.1 entry points the program uses) for
+	// functions that record the call and then make it. Queries are not recorded, since a replay does
+	// not need their results. While capturing, the features a trace cannot follow are hidden:
+	// persistent mapping (ARB_buffer_storage), whose writes never pass through OpenGL, and program
+	// binaries, which only load on the driver that made them.
+	bool StartCapture(const std::string &file_name, int width, int height);
+	// Marks the end of a frame. Does nothing unless a capture is running.
+	void EndFrame();
+	// Puts the original entry points back and finishes the trace. Returns false if writing failed.
+	bool StopCapture();
+	bool IsCapturing();
+
+	// CallTiming is the time a replay spent in one kind of call.
+	struct CallTiming
+	{
+		CallTiming() : count(0), milliseconds(0.0) {}
+		unsigned long long count;
+		double milliseconds;
+	};
+	// Replayer plays a trace back as fast as it can, e.g. on a headless software context, to measure
+	// it without the program or a GPU. Object names are translated, since the replay's OpenGL hands
+	// out names of its own. The default framebuffer of the capture becomes a framebuffer of the
+	// replay's choice, of the trace's size.
+	class Replayer
+	{
+	public:
+		Replayer();
+		~Replayer();
+		// Opens a trace. Returns false if the file is not one.
+		bool Open(const std::string &file_name);
+		void Close();
+		int GetWidth() const { return m_width; }
+		int GetHeight() const { return m_height; }
+		int GetFrameCount() const { return m_frame_count; }
+		// Plays the whole trace once, rendering what the capture rendered to the default framebuffer into
+		// framebuffer. Frames end with glFinish, so frame_milliseconds gets the time every frame took
+		// to render, counted from the end of the previous one (the first frame includes what the trace
+		// did before it). last_frame gets the pixels of the framebuffer bound at the end of the last
+		// frame, as RGBA rows, bottom row first. If time_calls is true, every call is timed as well,
+		// which slows the replay down. Returns false, and prints why, if the trace is damaged.
+		//
+		// Replaying bypasses the state cache; it is invalidated afterwards.
+		bool Play(GLuint framebuffer, bool time_calls, std::vector<double> &frame_milliseconds, std::vector<unsigned char> &last_frame);
+		const CallTiming &GetTiming(Call call) const { return m_timing[call]; }
+	private:
+		typedef std::unordered_map<GLuint, GLuint> Names;
+		// Returns the replay's name for the captured name, or 0 if the trace never created it.
+		GLuint Map(const Names &names, GLuint name) const;
+		// Deletes what the trace left alive.
+		void DeleteRemaining();
+		mesh::MappedFile m_file;
+		int m_width;
+		int m_height;
+		int m_frame_count;
+		Names m_buffers;
+		Names m_vertex_arrays;
+		Names m_textures;
+		Names m_framebuffers;
+		Names m_renderbuffers;
+		Names m_programs;
+		Names m_shaders;
+		// The uniform block indices of each captured program, captured index to replay index.
+		std::unordered_map<GLuint, Names> m_block_indices;
+		std::unordered_map<unsigned long long, GLsync> m_syncs;
+		// The pointer of the buffer mapped to each target.
+		std::unordered_map<GLenum, unsigned char*> m_mapped;
+		CallTiming m_timing[CALL_COUNT];
+	};
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "uniform.hpp"
+#include "opengl.h"
+#include "state_cache.hpp"
+
+namespace uniform
+{
+	// The frame capacity is a third of the ring, so a frame never waits for the GPU to finish the last two.
+	const GLsizeiptr FRAMES_IN_RING = 3;
+	Mat4 Identity()
+	{
+		Mat4 matrix;
+		for (int column = 0; column < 4; ++column)
+		{
+			for (int row = 0; row < 4; ++row)
+				matrix.columns[column].v[row] = column == row ? 1.0f : 0.0f;
+		}
+		return matrix;
+	}
+	UniformArena::UniformArena()
+		: m_frame_capacity(0), m_offset_alignment(256), m_used(0), m_overflow_count(0)
+	{
+
+	}
+	UniformArena::~UniformArena()
+	{
+
+	}
+	void UniformArena::Create(GLsizeiptr frame_capacity)
+	{
+		// >> GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT: the minimum required alignment for uniform buffer sizes
+		// >> and offset. The initial value is 1.
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_offset_alignment);
+		if (m_offset_alignment < 1)
+			m_offset_alignment = 1;
+		m_frame_capacity = (frame_capacity + m_offset_alignment - 1) / m_offset_alignment * m_offset_alignment;
+		m_ring_buffer.Create(GL_UNIFORM_BUFFER, FRAMES_IN_RING * m_frame_capacity);
+		m_used = 0;
+	}
+	void UniformArena::Destroy()
+	{
+		if (0 != m_allocation.pointer)
+			m_ring_buffer.Commit(m_allocation, 0);
+		m_allocation = stream::Allocation();
+		m_ring_buffer.Destroy();
+	}
+	void UniformArena::Begin()
+	{
+		m_allocation = m_ring_buffer.Allocate(m_frame_capacity, m_offset_alignment);
+		m_used = 0;
+	}
+	void *UniformArena::Allocate(GLsizeiptr size, Range &range)
+	{
+		const GLsizeiptr offset = (m_used + m_offset_alignment - 1) / m_offset_alignment * m_offset_alignment;
+		if (0 == m_allocation.pointer || offset + size > m_allocation.size)
+		{
+			++m_overflow_count;
+			range = Range();
+			return 0;
+		}
+		m_used = offset + size;
+		range.offset = m_allocation.offset + offset;
+		range.size = size;
+		return static_cast<unsigned char*>(m_allocation.pointer) + offset;
+	}
+	void UniformArena::Flush()
+	{
+		if (0 == m_allocation.pointer)
+			return;
+		// One flush (or nothing, with a persistent mapping) for all of the frame's blocks.
+		m_ring_buffer.Commit(m_allocation, m_used);
+	}
+	void UniformArena::Bind(GLuint binding, const Range &range) const
+	{
+		if (range.size > 0)
+			render::GetStateCache().BindBufferRange(GL_UNIFORM_BUFFER, binding, m_ring_buffer.GetOpenGLID(), range.offset, range.size);
+	}
+	void UniformArena::EndFrame()
+	{
+		m_ring_buffer.Fence();
+	}
+}
@@ -0,0 +1,217 @@
+#ifndef OPENGL_GLFW_TCU_UNIFORM_H_
+#define OPENGL_GLFW_TCU_UNIFORM_H_
+
+#include "standard.h"
+#include "stream.hpp"
+#include <cstddef>
+typedef int GLint;
+typedef float GLfloat;
+
+namespace uniform
+{
+	// The GLSL types a uniform block can hold, as C++ types with the base alignment std140 and std430
+	// give them, so a C++ struct built from them mostly lines up with the GLSL block by itself. Where
+	// it does not (a float after a vec3, arrays of scalars in std140), the UNIFORM_CHECK_* macros
+	// below refuse to compile.
+	struct Vec2
+	{
+		alignas(8) GLfloat v[2];
+	};
+	// A vec3 is aligned like a vec4. In C++ it also takes 16 bytes, while GLSL lets a scalar use the last 4.
+	struct Vec3
+	{
+		alignas(16) GLfloat v[3];
+	};
+	struct Vec4
+	{
+		alignas(16) GLfloat v[4];
+	};
+	struct IVec4
+	{
+		alignas(16) GLint v[4];
+	};
+	// Matrices are column-major arrays of vec4 columns (a mat3 has three vec4 columns).
+	struct Mat3
+	{
+		Vec4 columns[3];
+	};
+	struct Mat4
+	{
+		Vec4 columns[4];
+	};
+	// Returns the identity matrix.
+	Mat4 Identity();
+
+	// The two layouts of uniform and shader storage blocks. std430 (storage blocks only) packs arrays
+	// of scalars and vec2 tightly; std140 rounds every array element and struct up to 16 bytes.
+	enum Packing
+	{
+		STD140, STD430
+	};
+	// TypeTraits gives the base alignment and the size of a GLSL type, in bytes.
+	template <typename T> struct TypeTraits;
+	template <> struct TypeTraits<GLfloat> { static const size_t ALIGNMENT = 4; static const size_t SIZE = 4; };
+	template <> struct TypeTraits<GLint> { static const size_t ALIGNMENT = 4; static const size_t SIZE = 4; };
+	template <> struct TypeTraits<GLuint> { static const size_t ALIGNMENT = 4; static const size_t SIZE = 4; };
+	template <> struct TypeTraits<Vec2> { static const size_t ALIGNMENT = 8; static const size_t SIZE = 8; };
+	template <> struct TypeTraits<Vec3> { static const size_t ALIGNMENT = 16; static const size_t SIZE = 12; };
+	template <> struct TypeTraits<Vec4> { static const size_t ALIGNMENT = 16; static const size_t SIZE = 16; };
+	template <> struct TypeTraits<IVec4> { static const size_t ALIGNMENT = 16; static const size_t SIZE = 16; };
+	template <> struct TypeTraits<Mat3> { static const size_t ALIGNMENT = 16; static const size_t SIZE = 48; };
+	template <> struct TypeTraits<Mat4> { static const size_t ALIGNMENT = 16; static const size_t SIZE = 64; };
+
+	// Rounds value up to a multiple of alignment, at compile time.
+	template <size_t Value, size_t Alignment>
+	struct AlignUp
+	{
+		static const size_t VALUE = (Value + Alignment - 1) / Alignment * Alignment;
+	};
+	// Member is one member of a block: Count values of type T (Count > 1 makes it an array).
+	template <typename T, size_t Count = 1>
+	struct Member
+	{
+		typedef T Type;
+		static const size_t COUNT = Count;
+	};
+	// MemberLayout applies the packing rules to a member: where it may start and how many bytes it takes.
+	template <Packing P, typename M>
+	struct MemberLayout
+	{
+		typedef TypeTraits<typename M::Type> Traits;
+		static const bool IS_ARRAY = M::COUNT > 1;
+		// >> If the member is an array of scalars or vectors, the base alignment and array stride are set
+		// >> to match the base alignment of a single array element, according to rules (1), (2), and (3),
+		// >> and rounded up to the base alignment of a vec4. (std430 does not round up to a vec4.)
+		static const size_t ALIGNMENT = (P == STD140 && IS_ARRAY) ? AlignUp<Traits::ALIGNMENT, 16>::VALUE : Traits::ALIGNMENT;
+		static const size_t STRIDE = IS_ARRAY ? AlignUp<Traits::SIZE, ALIGNMENT>::VALUE : Traits::SIZE;
+		static const size_t SIZE = IS_ARRAY ? STRIDE * M::COUNT : Traits::SIZE;
+	};
+	// BlockLayout<P, Offset, Members...> lays out Members from byte Offset on.
+	template <Packing P, size_t Offset, typename... Members> struct BlockLayout;
+	template <Packing P, size_t Offset>
+	struct BlockLayout<P, Offset>
+	{
+		static const size_t END = Offset;
+		static const size_t ALIGNMENT = 1;
+		template <size_t Index> struct OffsetOf;
+	};
+	template <Packing P, size_t Offset, typename First, typename... Rest>
+	struct BlockLayout<P, Offset, First, Rest...>
+	{
+		typedef MemberLayout<P, First> FirstLayout;
+		static const size_t FIRST_OFFSET = AlignUp<Offset, FirstLayout::ALIGNMENT>::VALUE;
+		typedef BlockLayout<P, FIRST_OFFSET + FirstLayout::SIZE, Rest...> RestLayout;
+		static const size_t END = RestLayout::END;
+		static const size_t ALIGNMENT = FirstLayout::ALIGNMENT > RestLayout::ALIGNMENT ? FirstLayout::ALIGNMENT : RestLayout::ALIGNMENT;
+		template <size_t Index, bool IsFirst = Index == 0>
+		struct OffsetOf
+		{
+			static const size_t VALUE = RestLayout::template OffsetOf<Index - 1>::VALUE;
+		};
+		template <size_t Index>
+		struct OffsetOf<Index, true>
+		{
+			static const size_t VALUE = FIRST_OFFSET;
+		};
+	};
+	// Block computes the layout of a uniform or storage block with the given packing at compile time.
+	// Describe the GLSL block member by member and check the C++ struct against it:
+	//
+	//   // layout(std140) uniform Object { mat4 transform; vec3 tint; float alpha; };
+	//   typedef uniform::Block<uniform::STD140, uniform::Member<uniform::Mat4>,
+	//       uniform::Member<uniform::Vec3>, uniform::Member<GLfloat> > ObjectBlock;
+	//   UNIFORM_CHECK_OFFSET(ObjectUniforms, transform, ObjectBlock, 0);
+	//   UNIFORM_CHECK_OFFSET(ObjectUniforms, tint, ObjectBlock, 1);
+	//   UNIFORM_CHECK_OFFSET(ObjectUniforms, alpha, ObjectBlock, 2);  // fails: GLSL puts alpha at 76
+	//   UNIFORM_CHECK_SIZE(ObjectUniforms, ObjectBlock);
+	template <Packing P, typename... Members>
+	struct Block
+	{
+		typedef BlockLayout<P, 0, Members...> Layout;
+		// The offset of the member at Index.
+		template <size_t Index>
+		struct Offset
+		{
+			static const size_t VALUE = Layout::template OffsetOf<Index>::VALUE;
+		};
+		// The size of the block's data, what GL_UNIFORM_BLOCK_DATA_SIZE reports. std140 rounds it up
+		// to a vec4 like a struct.
+		static const size_t SIZE = P == STD140 ? AlignUp<Layout::END, 16>::VALUE : AlignUp<Layout::END, Layout::ALIGNMENT>::VALUE;
+	};
+// Fails to compile unless member of the C++ struct Struct is at the offset the GLSL block Block
+// gives its member at Index.
+#define UNIFORM_CHECK_OFFSET(Struct, member, Block, Index) \
+	static_assert(offsetof(Struct, member) == Block::Offset<Index>::VALUE, #Struct "::" #member " is not where the uniform block expects it")
+// Fails to compile unless the C++ struct Struct holds the whole GLSL block Block.
+#define UNIFORM_CHECK_SIZE(Struct, Block) \
+	static_assert(sizeof(Struct) >= Block::SIZE, #Struct " is smaller than its uniform block")
+
+	// Range is a part of a uniform buffer holding one block, as glBindBufferRange takes it.
+	struct Range
+	{
+		Range() : offset(0), size(0) {}
+		GLintptr offset;
+		// 0 if the range could not be allocated.
+		GLsizeiptr size;
+	};
+	// UniformArena collects the uniform blocks of a frame in one stream::RingBuffer allocation, so a
+	// frame uploads its uniforms at once instead of with a glUniform* call per value, and every draw
+	// only selects its block with glBindBufferRange. A frame looks like:
+	//
+	//   arena.Begin();
+	//   Range range = arena.Push(object_uniforms);  // for every draw, or Allocate and fill in place
+	//   arena.Flush();                              // the upload
+	//   arena.Bind(binding, range); glDraw...;      // for every draw
+	//   arena.EndFrame();                           // after the frame's last draw
+	class UniformArena
+	{
+	public:
+		UniformArena();
+		~UniformArena();
+		// Creates the ring buffer for frames of up to frame_capacity bytes of blocks. Every block
+		// starts at a multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, which counts towards it.
+		void Create(GLsizeiptr frame_capacity);
+		void Destroy();
+		// Starts collecting the blocks of a frame.
+		void Begin();
+		// Reserves size bytes for a block and returns where to write it, or NULL (with an empty range)
+		// if the frame is full.
+		void *Allocate(GLsizeiptr size, Range &range);
+		template <typename T>
+		T *Allocate(Range &range)
+		{
+			return static_cast<T*>(Allocate(sizeof(T), range));
+		}
+		// Copies a block into the frame.
+		template <typename T>
+		Range Push(const T &block)
+		{
+			Range range;
+			T *destination = Allocate<T>(range);
+			if (0 != destination)
+				*destination = block;
+			return range;
+		}
+		// Hands the frame's blocks to OpenGL. Call after the last Allocate and before the first draw.
+		void Flush();
+		// Binds range of the frame to uniform block binding point binding.
+		void Bind(GLuint binding, const Range &range) const;
+		// Fences the frame's blocks. Call after the last draw that uses them.
+		void EndFrame();
+		GLint GetOffsetAlignment() const { return m_offset_alignment; }
+		// Returns the bytes the last flushed frame used, including the alignment padding.
+		GLsizeiptr GetUsed() const { return m_used; }
+		// Returns the number of Allocate calls that failed because the frame was full.
+		unsigned int GetOverflowCount() const { return m_overflow_count; }
+		const stream::RingBuffer &GetRingBuffer() const { return m_ring_buffer; }
+	private:
+		stream::RingBuffer m_ring_buffer;
+		stream::Allocation m_allocation;
+		GLsizeiptr m_frame_capacity;
+		GLint m_offset_alignment;
+		GLsizeiptr m_used;
+		unsigned int m_overflow_count;
+	};
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "vertex_format.hpp"
+#include "opengl.h"
+#include <cmath>
+
+namespace vertex
+{
+	Half ToHalf(float value)
+	{
+		GLuint bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		const GLuint sign = (bits >> 16) & 0x8000;
+		const int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+		GLuint mantissa = bits & 0x7FFFFF;
+		Half half;
+		if (((bits >> 23) & 0xFF) == 0xFF)
+		{
+			// Infinity stays infinity, NaN stays NaN.
+			half.bits = static_cast<GLushort>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+		}
+		else if (exponent >= 31)
+		{
+			// Too large for a half: infinity.
+			half.bits = static_cast<GLushort>(sign | 0x7C00);
+		}
+		else if (exponent <= 0)
+		{
+			// Denormal (or zero): shift the mantissa, with the implicit leading one, into place.
+			if (exponent < -10)
+			{
+				half.bits = static_cast<GLushort>(sign);
+			}
+			else
+			{
+				mantissa |= 0x800000;
+				const int shift = 14 - exponent;
+				GLuint result = mantissa >> shift;
+				// Round to nearest, ties to even.
+				const GLuint remainder = mantissa & ((1u << shift) - 1);
+				const GLuint halfway = 1u << (shift - 1);
+				if (remainder > halfway || (remainder == halfway && (result & 1)))
+					++result;
+				half.bits = static_cast<GLushort>(sign | result);
+			}
+		}
+		else
+		{
+			GLuint result = (static_cast<GLuint>(exponent) << 10) | (mantissa >> 13);
+			// Round to nearest, ties to even. A carry into the exponent is correct, up to infinity.
+			const GLuint remainder = mantissa & 0x1FFF;
+			if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+				++result;
+			half.bits = static_cast<GLushort>(sign | result);
+		}
+		return half;
+	}
+	float FromHalf(Half value)
+	{
+		const GLuint sign = (value.bits & 0x8000u) << 16;
+		const GLuint exponent = (value.bits >> 10) & 0x1F;
+		const GLuint mantissa = value.bits & 0x3FF;
+		float result;
+		if (exponent == 0)
+		{
+			result = std::ldexp(static_cast<float>(mantissa), -24);
+			return sign ? -result : result;
+		}
+		GLuint bits;
+		if (exponent == 31)
+			bits = sign | 0x7F800000 | (mantissa << 13);
+		else
+			bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+		std::memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+	// Converts value (-1.0 to 1.0) to a signed normalized integer of the given number of bits.
+	inline GLuint ToSignedNormalized(float value, int bit_count)
+	{
+		const float maximum = static_cast<float>((1 << (bit_count - 1)) - 1);
+		const float clamped = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+		const int integer = static_cast<int>(std::floor(clamped * maximum + 0.5f));
+		return static_cast<GLuint>(integer) & ((1u << bit_count) - 1);
+	}
+	Int2101010Rev PackInt2101010Rev(float x, float y, float z, float w)
+	{
+		Int2101010Rev packed;
+		packed.bits = ToSignedNormalized(x, 10) | (ToSignedNormalized(y, 10) << 10) | (ToSignedNormalized(z, 10) << 20) | (ToSignedNormalized(w, 2) << 30);
+		return packed;
+	}
+	GLubyte ToUnsignedByte(float value)
+	{
+		const float clamped = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+		return static_cast<GLubyte>(clamped * 255.0f + 0.5f);
+	}
+	void SetAttributePointer(GLuint location, GLint size, GLenum type, bool normalized, size_t stride, size_t offset)
+	{
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, size, type, normalized ? GL_TRUE : GL_FALSE, static_cast<GLsizei>(stride), (void*) offset);
+	}
+}
@@ -0,0 +1,173 @@
+#ifndef OPENGL_GLFW_TCU_VERTEX_FORMAT_H_
+#define OPENGL_GLFW_TCU_VERTEX_FORMAT_H_
+
+#include "standard.h"
+#include <cstddef>
+#include <cstring>
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+typedef int GLint;
+typedef float GLfloat;
+typedef unsigned char GLubyte;
+typedef signed char GLbyte;
+typedef unsigned short GLushort;
+typedef short GLshort;
+
+namespace vertex
+{
+	// Half is a 16 bit floating point component (GL_HALF_FLOAT).
+	struct Half
+	{
+		GLushort bits;
+	};
+	// Int2101010Rev packs four signed normalized components into 32 bits (GL_INT_2_10_10_10_REV):
+	// 10 bits each for x, y and z, 2 bits for w. Ideal for normals and tangents.
+	struct Int2101010Rev
+	{
+		GLuint bits;
+	};
+	// Converts a float to the nearest half float (round to nearest even, overflow becomes infinity).
+	Half ToHalf(float value);
+	float FromHalf(Half value);
+	// Packs x, y, z and w (each -1.0 to 1.0) into one GL_INT_2_10_10_10_REV value.
+	Int2101010Rev PackInt2101010Rev(float x, float y, float z, float w = 0.0f);
+	// Converts a colour component from 0.0 - 1.0 to 0 - 255.
+	GLubyte ToUnsignedByte(float value);
+
+	// ComponentTraits maps a component type to its OpenGL type and the number of components one value holds.
+	// The types are GL_FLOAT, GL_UNSIGNED_BYTE, GL_BYTE, GL_UNSIGNED_SHORT, GL_SHORT, GL_HALF_FLOAT and
+	// GL_INT_2_10_10_10_REV; the values are spelled out so this header does not need the OpenGL headers.
+	template <typename Component> struct ComponentTraits;
+	template <> struct ComponentTraits<GLfloat> { static const GLenum TYPE = 0x1406; static const int PACKED_COUNT = 1; };
+	template <> struct ComponentTraits<GLubyte> { static const GLenum TYPE = 0x1401; static const int PACKED_COUNT = 1; };
+	template <> struct ComponentTraits<GLbyte> { static const GLenum TYPE = 0x1400; static const int PACKED_COUNT = 1; };
+	template <> struct ComponentTraits<GLushort> { static const GLenum TYPE = 0x1403; static const int PACKED_COUNT = 1; };
+	template <> struct ComponentTraits<GLshort> { static const GLenum TYPE = 0x1402; static const int PACKED_COUNT = 1; };
+	template <> struct ComponentTraits<Half> { static const GLenum TYPE = 0x140B; static const int PACKED_COUNT = 1; };
+	template <> struct ComponentTraits<Int2101010Rev> { static const GLenum TYPE = 0x8D9F; static const int PACKED_COUNT = 4; };
+
+	// Attribute describes one vertex attribute: the shader location, the component type, the number
+	// of values and whether integer values are normalized to 0.0 - 1.0 (or -1.0 - 1.0).
+	template <GLuint Location, typename Component, int Count, bool Normalized = false>
+	struct Attribute
+	{
+		typedef Component ComponentType;
+		static const GLuint LOCATION = Location;
+		static const int COUNT = Count;
+		static const bool NORMALIZED = Normalized;
+		// The number of components OpenGL sees (4 for one packed 2_10_10_10 value).
+		static const GLint OPENGL_SIZE = Count * ComponentTraits<Component>::PACKED_COUNT;
+		static const GLenum OPENGL_TYPE = ComponentTraits<Component>::TYPE;
+		static const size_t SIZE = sizeof(Component) * Count;
+		// Attributes start at multiples of 4 bytes, which is what most hardware fetches best.
+		static const size_t ALIGNED_SIZE = (SIZE + 3) / 4 * 4;
+	};
+
+	// AttributeAt<Index, Attributes...>::Type is the attribute at Index, OFFSET its byte offset in the vertex.
+	template <size_t Index, typename... Attributes> struct AttributeAt;
+	template <typename First, typename... Rest>
+	struct AttributeAt<0, First, Rest...>
+	{
+		typedef First Type;
+		static const size_t OFFSET = 0;
+	};
+	template <size_t Index, typename First, typename... Rest>
+	struct AttributeAt<Index, First, Rest...>
+	{
+		typedef typename AttributeAt<Index - 1, Rest...>::Type Type;
+		static const size_t OFFSET = First::ALIGNED_SIZE + AttributeAt<Index - 1, Rest...>::OFFSET;
+	};
+	// StrideOf<Attributes...>::VALUE is the size of one interleaved vertex.
+	template <typename... Attributes> struct StrideOf;
+	template <> struct StrideOf<> { static const size_t VALUE = 0; };
+	template <typename First, typename... Rest>
+	struct StrideOf<First, Rest...> { static const size_t VALUE = First::ALIGNED_SIZE + StrideOf<Rest...>::VALUE; };
+
+	void SetAttributePointer(GLuint location, GLint size, GLenum type, bool normalized, size_t stride, size_t offset);
+	// AttributeDescription is an attribute of a Format as run time values, e.g. to store it in a file.
+	struct AttributeDescription
+	{
+		GLuint location;
+		GLint size;
+		GLenum type;
+		bool normalized;
+		size_t offset;
+	};
+
+	// Format describes an interleaved vertex layout at compile time. Format::Vertex is the vertex itself:
+	// a POD of exactly STRIDE bytes, so an array of them can be uploaded as is, and Apply points the
+	// vertex attributes of the bound VAO at it. For example:
+	//
+	//   typedef vertex::Format<
+	//       vertex::Attribute<0, vertex::Half, 2>,           // position, 4 bytes
+	//       vertex::Attribute<1, GLubyte, 4, true> > Format;  // colour, 4 bytes
+	//   Format::Vertex v;
+	//   v.Set<0>(vertex::ToHalf(x), vertex::ToHalf(y));
+	template <typename... Attributes>
+	struct Format
+	{
+		static const size_t STRIDE = StrideOf<Attributes...>::VALUE;
+		static const size_t ATTRIBUTE_COUNT = sizeof...(Attributes);
+		template <size_t Index>
+		struct Offset
+		{
+			static const size_t VALUE = AttributeAt<Index, Attributes...>::OFFSET;
+		};
+		struct Vertex
+		{
+			// Returns the values of the attribute at Index.
+			template <size_t Index>
+			typename AttributeAt<Index, Attributes...>::Type::ComponentType *Get()
+			{
+				return reinterpret_cast<typename AttributeAt<Index, Attributes...>::Type::ComponentType*>(bytes + Offset<Index>::VALUE);
+			}
+			// Sets the values of the attribute at Index. Pass as many values as the attribute has.
+			template <size_t Index, typename... Values>
+			void Set(Values... values)
+			{
+				typedef typename AttributeAt<Index, Attributes...>::Type::ComponentType ComponentType;
+				static_assert(sizeof...(Values) == AttributeAt<Index, Attributes...>::Type::COUNT, "wrong number of values for this attribute");
+				const ComponentType converted[] = { static_cast<ComponentType>(values)... };
+				std::memcpy(bytes + Offset<Index>::VALUE, converted, sizeof(converted));
+			}
+			// The interleaved attribute data.
+			alignas(4) unsigned char bytes[STRIDE];
+		};
+		// Enables the attributes and points them at vertices starting at base_offset in the bound GL_ARRAY_BUFFER.
+		static void Apply(size_t base_offset = 0)
+		{
+			ApplyFrom<0, Attributes...>(base_offset);
+		}
+		// Writes the ATTRIBUTE_COUNT attributes to descriptions.
+		static void Describe(AttributeDescription *descriptions)
+		{
+			DescribeFrom<0, Attributes...>(descriptions);
+		}
+	private:
+		template <size_t Index>
+		static void ApplyFrom(size_t)
+		{
+
+		}
+		template <size_t Index, typename First, typename... Rest>
+		static void ApplyFrom(size_t base_offset)
+		{
+			SetAttributePointer(First::LOCATION, First::OPENGL_SIZE, First::OPENGL_TYPE, First::NORMALIZED, STRIDE, base_offset + Offset<Index>::VALUE);
+			ApplyFrom<Index + 1, Rest...>(base_offset);
+		}
+		template <size_t Index>
+		static void DescribeFrom(AttributeDescription*)
+		{
+
+		}
+		template <size_t Index, typename First, typename... Rest>
+		static void DescribeFrom(AttributeDescription *descriptions)
+		{
+			const AttributeDescription description = { First::LOCATION, First::OPENGL_SIZE, First::OPENGL_TYPE, First::NORMALIZED, Offset<Index>::VALUE };
+			descriptions[Index] = description;
+			DescribeFrom<Index + 1, Rest...>(descriptions);
+		}
+	};
+}
+
+#endif